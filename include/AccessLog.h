@@ -0,0 +1,132 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * AccessLog.h
+ *
+ * A record of the HTTP requests the ObscuraCam has served: when, from where, what, with what 
+ * result, how much was sent and how long it took. Logging each request to Serial would slow 
+ * everything down, so instead each one is recorded as a fixed-size binary AccessEntry in a ring 
+ * buffer in PSRAM. Call poll() from loop(); once enough entries have accumulated and the server 
+ * has been quiet for a while, they're appended to the log file on the SD card in one batch. 
+ * When the log file would grow beyond its size limit, it is renamed to <name>.old (replacing any 
+ * earlier one) and a new one is started.
+ *
+ * The log file is an 8-byte header ("OCAL", then the format version and the entry size as 
+ * little-endian uint16s) followed by AccessEntry records. A record with method AL_BOOT marks 
+ * where the ObscuraCam restarted; the millis of the entries after it count from that restart. 
+ * tools/decode_access_log.py decodes and summarizes log files.
+ *
+ * If the ring fills before it can be written (e.g., no SD card), the oldest entries are dropped.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include "FS.h"                                   // File system
+#include "DiskUsage.h"                            // Per-directory space used
+
+#define AL_VERSION        (1)                       // Log file format version
+#define AL_URI_BYTES      (28)                      // Bytes of the URI kept in an entry (its tail)
+#define AL_BOOT           (0xFF)                    // AccessEntry.method for a boot marker
+
+// A log entry. The layout is the file format; change AL_VERSION if it changes.
+struct AccessEntry {
+  uint32_t millis;                                  // millis() when the response was finished
+  uint32_t ip;                                      // Client's IPv4 address, first octet in the low byte
+  uint32_t bytes;                                   // Response bytes sent, headers not included
+  uint32_t micros;                                  // How long it took to handle the request
+  uint16_t status;                                  // HTTP status code
+  uint8_t method;                                   // HTTPMethod, or AL_BOOT
+  uint8_t uriLen;                                   // Length of the whole URI (255 if longer)
+  char uri[AL_URI_BYTES];                           // The URI's last AL_URI_BYTES chars, '\0' padded
+};
+
+class AccessLog {
+public:
+  /**
+   * @brief Construct a new AccessLog object
+   *
+   * @param fs          The file system the log lives on
+   * @param diskUsage   The space used totals to report the log's growth to
+   * @param path        The full path of the log file; its directory is created if need be
+   * @param capacity    The size of the ring buffer (entries)
+   * @param batch       Entries that must be waiting before an idle-time write is done
+   * @param idleMillis  millis() without a request before the server is considered idle
+   * @param maxBytes    The size beyond which the log file is renamed and a new one started
+   */
+  AccessLog(fs::FS &fs, DiskUsage &diskUsage, const char *path, uint16_t capacity, uint16_t batch, 
+            unsigned long idleMillis, uint32_t maxBytes);
+
+  /**
+   * @brief Allocate the ring buffer and record a boot marker
+   *
+   * @return true   Success
+   * @return false  Couldn't allocate the ring buffer; requests won't be logged
+   */
+  bool begin();
+
+  /**
+   * @brief Record a request
+   *
+   * @param ip      The client's IPv4 address
+   * @param method  The request's HTTPMethod
+   * @param uri     The request's URI
+   * @param status  The HTTP status code sent
+   * @param bytes   The number of response bytes sent
+   * @param micros  How long the request took to handle
+   */
+  void add(uint32_t ip, uint8_t method, const String &uri, uint16_t status, uint32_t bytes, 
+           uint32_t micros);
+
+  /**
+   * @brief Write the waiting entries to the log file if there are enough and the server is idle, 
+   *        or if the ring is nearly full. Call this from loop().
+   *
+   */
+  void poll();
+
+  /**
+   * @brief Write all the waiting entries to the log file now
+   *
+   * @return true   Success
+   * @return false  Couldn't write them; they're still waiting
+   */
+  bool flush();
+
+  /**
+   * @brief Describe the log's state as a JSON object
+   *
+   */
+  String toJson() const;
+
+private:
+  fs::FS &fs;                                       // The file system the log lives on
+  DiskUsage &diskUsage;                             // The space used totals
+  const char *path;                                 // The log file's path
+  uint16_t capacity;                                // Ring buffer size (entries)
+  uint16_t batch;                                   // Entries to wait for before writing
+  unsigned long idleMillis;                         // Quiet time before writing (millis())
+  uint32_t maxBytes;                                // Log file size limit (bytes)
+  AccessEntry *ring;                                // The ring buffer
+  uint32_t added;                                   // Entries added since begin()
+  uint32_t written;                                 // Entries written (or dropped) since begin()
+  uint32_t dropped;                                 // Entries dropped because the ring was full
+  unsigned long lastMillis;                         // millis() when the last entry was added
+  uint32_t flushes;                                 // Batches written
+  uint32_t flushMicros;                             // Total micros() spent writing them
+
+  bool openLog(File &file);
+  uint16_t waiting() const { return added - written; }
+};
@@ -0,0 +1,160 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * AviWriter.h
+ *
+ * Assemble a sequence of JPEG frames into an MJPEG AVI file on the SD card, incrementally, so a 
+ * whole timelapse can be downloaded or played as one file.
+ *
+ * The headers are written when the file is opened, with the frame counts and sizes left as 
+ * zeros. Each frame is appended to the movi list as an "00dc" chunk, and its offset and size go 
+ * into an index preallocated in PSRAM. Nothing already written is rewritten: finalizing the file 
+ * just appends the idx1 chunk from the in-memory index and patches a handful of header fields.
+ *
+ * The file is flushed after the headers and after each write of frames, since FatFs only 
+ * records a file's new size in its directory entry when the file is synced or closed: without 
+ * that, a power failure leaves nothing to recover. So if the power fails before the file is 
+ * finalized, the frames are all still in the movi list in order. recover() walks the chunk headers (seeking past the frame data, not reading it), 
+ * rebuilds the index from them and finalizes the file.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include "FS.h"                                   // File system
+
+#define AVI_HEADER_BYTES  (224)                     // Bytes before the first frame chunk
+#define AVI_CHUNK_HEADER  (8)                       // Bytes in a chunk's id and size
+
+class AviWriter {
+public:
+  /**
+   * @brief Construct a new AviWriter object
+   *
+   */
+  AviWriter();
+
+  /**
+   * @brief Destroy the AviWriter object, finalizing any open file
+   *
+   */
+  ~AviWriter();
+
+  /**
+   * @brief Create a new AVI file and write its headers
+   *
+   * @param fs          The file system to create it in
+   * @param path        Its path
+   * @param width       The width of the frames (pixels)
+   * @param height      Their height (pixels)
+   * @param fps         The playback frame rate
+   * @param maxFrames   The most frames the file can hold (the size of the index)
+   * @return true       Success
+   * @return false      Couldn't allocate the index or create the file
+   */
+  bool open(fs::FS &fs, const String &path, uint16_t width, uint16_t height, uint8_t fps, 
+            uint32_t maxFrames);
+
+  /**
+   * @brief Whether a file is open
+   *
+   */
+  bool isOpen() const { return index != nullptr; }
+
+  /**
+   * @brief Append a frame
+   *
+   * @param jpg     The JPEG image
+   * @param len     Its length (bytes)
+   * @return true   Success
+   * @return false  The write failed or the file is full
+   */
+  bool addFrame(const uint8_t *jpg, size_t len);
+
+  /**
+   * @brief Append frames already laid out as chunks with formatChunk(), e.g. by a caller that 
+   *        batches them
+   *
+   * @param chunks  The chunks
+   * @param len     Their total length (bytes)
+   * @return true   Success
+   * @return false  The write failed, the chunks are malformed or the file is full
+   */
+  bool addChunks(const uint8_t *chunks, size_t len);
+
+  /**
+   * @brief Write the index, patch up the headers and close the file
+   *
+   * @return true   Success
+   * @return false  Something went wrong writing
+   */
+  bool close();
+
+  /**
+   * @brief The number of frames in the file, and the number it can hold
+   *
+   */
+  uint32_t frames() const { return nFrames; }
+  uint32_t capacity() const { return maxFrames; }
+
+  /**
+   * @brief The length of the file so far (bytes)
+   *
+   */
+  uint32_t size() const { return fileBytes; }
+
+  /**
+   * @brief The number of bytes a frame takes up as a chunk
+   *
+   * @param len     The length of the JPEG image
+   */
+  static size_t chunkSize(size_t len) { return AVI_CHUNK_HEADER + len + (len & 1); }
+
+  /**
+   * @brief Lay out a frame as a chunk
+   *
+   * @param dst     Where to put it; must have room for chunkSize(len) bytes
+   * @param jpg     The JPEG image
+   * @param len     Its length (bytes)
+   */
+  static void formatChunk(uint8_t *dst, const uint8_t *jpg, size_t len);
+
+  /**
+   * @brief If the given AVI file was never finalized, rebuild its index and finalize it
+   *
+   * @param fs      The file system the file is in
+   * @param path    The path of the file
+   * @return true   The file needed recovery and was recovered
+   * @return false  The file was fine, isn't an AVI or couldn't be recovered
+   */
+  static bool recover(fs::FS &fs, const String &path);
+
+private:
+  struct IndexEntry {                               // An entry in the in-memory index
+    uint32_t offset;                                //   Chunk offset from the "movi" fourcc
+    uint32_t length;                                //   JPEG length (bytes)
+  };
+
+  File file;                                        // The AVI file
+  IndexEntry *index;                                // The preallocated index
+  uint32_t maxFrames;                               // Its size (entries)
+  uint32_t nFrames;                                 // Entries in use
+  uint32_t fileBytes;                               // Length of the file so far
+  uint32_t largest;                                 // Largest frame so far (bytes)
+  uint32_t usPerFrame;                              // Playback micros() per frame
+
+  static bool finalize(File &file, uint32_t moviEnd, const IndexEntry *index, uint32_t nFrames, 
+                       uint32_t largest, uint32_t usPerFrame);
+};
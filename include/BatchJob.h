@@ -0,0 +1,110 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * BatchJob.h
+ *
+ * Many file operations -- delete, mkdir, move and copy -- run as one background Job, so the 
+ * editor can delete or move a whole selection of photos with one request instead of one per 
+ * file. The operations come as a JSON array of objects:
+ *
+ *    [{"op":"mkdir","path":"/keep"},
+ *     {"op":"move","from":"/photos/Image12.jpg","to":"/keep/Image12.jpg"},
+ *     {"op":"copy","from":"/photos/Image13.jpg","to":"/keep/Image13.jpg"},
+ *     {"op":"delete","path":"/photos/Image14.jpg"}]
+ *
+ * They're run in the order given, except that each run of consecutive operations of the same 
+ * kind is sorted by directory, so the FAT directory being looked up is usually the one just 
+ * used. (Mkdirs are in path order, so parents are made before their children; deletes are in 
+ * reverse order, so children go before their parents.) A run of moves or copies in which one 
+ * operation's destination is, or is inside or around, another's source or destination -- a 
+ * chain like a -> b, b -> c -- isn't sorted, since the order matters. So a batch can make a 
+ * directory, fill it, and delete what's been moved or copied out, in that order. A delete of a 
+ * directory deletes everything in it, as DELETE /edit does.
+ *
+ * Each operation's result is reported, in the order given, in the job's JSON.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include "FS.h"                                   // File system
+#include "Job.h"                                  // Background jobs
+#include "FileCopy.h"                             // SD to SD file copies
+#include "DiskUsage.h"                            // Per-directory space used
+#include <vector>
+
+#define BJ_MAX_OPS        (256)                     // Most operations in one batch
+#define BJ_STEP_MICROS    (20000)                   // About how long each step() may take (micros())
+
+class BatchJob : public Job {
+public:
+  /**
+   * @brief Construct a new BatchJob object
+   *
+   * @param fs          The file system to work on
+   * @param diskUsage   The space used totals to report changes to
+   * @param copyBytes   The size of the copy buffer (bytes)
+   * @param validPath   Says whether a path is acceptable
+   */
+  BatchJob(fs::FS &fs, DiskUsage &diskUsage, size_t copyBytes, bool (*validPath)(const String &));
+
+  /**
+   * @brief Parse the operations from their JSON description and sort them
+   *
+   * @param json    The JSON array of operations
+   * @return true   Success; the job is ready to run
+   * @return false  The JSON isn't a valid list of operations; see error()
+   */
+  bool parse(const String &json);
+
+  /**
+   * @brief Why parse() failed
+   *
+   */
+  const String &error() const { return errorText; }
+
+  const char *name() const override { return "batch"; }
+  bool step() override;
+  String toJson() const override;
+
+private:
+  enum OpType : uint8_t {                           // The operations
+    BJ_MKDIR, BJ_COPY, BJ_MOVE, BJ_DELETE
+  };
+  struct Op {                                       // An operation
+    OpType type;                                    //   What to do
+    String from;                                    //   The path to do it to
+    String to;                                      //   The destination of a move or copy
+    const char *result;                             //   nullptr until done, then "ok" or what went wrong
+  };
+  fs::FS &fs;                                       // The file system
+  DiskUsage &diskUsage;                             // The space used totals
+  bool (*validPath)(const String &);                // Says whether a path is acceptable
+  std::vector<Op> ops;                              // The operations, in the order given
+  std::vector<uint16_t> order;                      // The indexes of ops in the order to run them
+  size_t next;                                      // The index in order of the operation to do next
+  std::vector<String> deleting;                     // Directories being deleted, innermost last
+  FileCopy copier;                                  // Does the copies
+  bool copying;                                     // Whether a copy is in progress
+  uint32_t failed;                                  // Operations that failed
+  String errorText;                                 // Why parse() failed
+
+  bool addOp(const String &op, const String &path, const String &from, const String &to);
+  const char *run(Op &op, unsigned long stepStart);
+  const char *deleteStep(unsigned long stepStart);
+  const char *move(const Op &op);
+  bool entangled(size_t first, size_t last) const;
+  void finishOp(Op &op, const char *result);
+};
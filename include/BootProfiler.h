@@ -0,0 +1,86 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * BootProfiler.h
+ *
+ * Find out where the time goes between power-on and ready. setup() calls mark() at the end of 
+ * each phase of startup (waiting for Serial, bringing up the AP, initializing the camera, 
+ * mounting the SD card and so on), and the BootProfiler times each phase with the CPU's cycle 
+ * counter. At the end of setup() the boot's record is saved in NVS along with those of the 
+ * previous BP_HISTORY - 1 boots, so the effect of a change -- or of a slow SD card -- on 
+ * time-to-ready can be seen across reboots and power cycles.
+ *
+ * The cycle counter wraps every 2^32 cycles (about 18 s at 240 MHz), which is longer than any 
+ * single phase, so differences between consecutive marks are always right.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+
+#define BP_MAX_PHASES     (10)                      // Most phases that can be timed
+#define BP_HISTORY        (8)                       // Number of boots remembered
+
+class BootProfiler {
+public:
+  /**
+   * @brief Construct a new BootProfiler object
+   *
+   * @param phaseNames  The names of the phases, in order
+   * @param nPhases     How many there are (at most BP_MAX_PHASES)
+   */
+  BootProfiler(const char *const *phaseNames, uint8_t nPhases);
+
+  /**
+   * @brief Start timing. Call this first thing in setup().
+   *
+   */
+  void begin();
+
+  /**
+   * @brief Note the end of a phase; the time since the previous mark (or begin()) is charged to it
+   *
+   * @param phase   The phase's index in phaseNames
+   */
+  void mark(uint8_t phase);
+
+  /**
+   * @brief Save this boot's record in NVS with those of the previous boots
+   *
+   */
+  void save();
+
+  /**
+   * @brief Describe the boot history, newest first, as a JSON object
+   *
+   */
+  String toJson() const;
+
+private:
+  struct Record {                                   // The record of one boot
+    uint32_t boot;                                  //   Boot number
+    uint32_t resetReason;                           //   esp_reset_reason() for the boot
+    uint32_t preSetupMicros;                        //   micros() from app start to setup()
+    uint32_t totalMicros;                           //   micros() from app start to the last mark
+    uint32_t phaseMicros[BP_MAX_PHASES];            //   micros() for each phase
+  };
+
+  const char *const *names;                         // The phase names
+  uint8_t nPhases;                                  // The number of phases
+  uint32_t lastCycles;                              // Cycle count at the last mark
+  Record current;                                   // This boot's record
+  Record history[BP_HISTORY];                       // The previous boots' records, oldest first
+  uint8_t nHistory;                                 // How many there are
+};
@@ -0,0 +1,113 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Config.h
+ *
+ * Settings that can be changed without rebuilding the firmware. The defaults are compiled in 
+ * (the #defines in main.cpp); a text file on the SD card can override any of them with lines 
+ * of the form
+ *
+ *    # A comment
+ *    ssid = MyCamera
+ *    frameSize = SVGA
+ *    motionMillis = 250
+ *
+ * Keys are case sensitive and white space around keys and values is ignored. Booleans are 
+ * true/false, 1/0 or on/off; IP addresses are dotted quads; frame sizes are QVGA, CIF, VGA, SVGA, 
+ * XGA, HD, SXGA or UXGA. The photo path must be one validPath() accepts, with room for a photo's 
+ * file name. Unknown keys and bad values are skipped and reported.
+ *
+ * The file is read into a Settings struct once, at boot (or when a reload is asked for); the 
+ * rest of the code reads the struct, so nothing is parsed while handling requests. The 
+ * ConfigFile remembers how long the last load took and what was wrong with the file, if 
+ * anything.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include "FS.h"                                   // File system
+#include "IPAddress.h"                            // IP addresses
+#include "sensor.h"                               // framesize_t
+#include <vector>
+
+#define CFG_MAX_BYTES     (4096)                    // Largest config file read
+#define CFG_MAX_LISTED    (8)                       // Most problem lines named in the report
+#define CFG_LONGEST_PHOTO "Image65535.jpg"          // The longest photo file name photoPath must fit
+
+// The settings
+struct Settings {
+  String ssid;                                      // The AP's SSID and the mDNS name
+  String password;                                  // The AP's password
+  IPAddress localIp;                                // The IP of the web server
+  IPAddress gateway;                                // The gateway
+  IPAddress subnet;                                 // The subnet mask
+  framesize_t frameSize;                            // Photo size (with PSRAM)
+  uint8_t jpegQuality;                              // Photo JPEG quality (0 - 63, lower is better)
+  String photoPath;                                 // The dir, ending in "/", photos are kept in
+  bool aeEnable;                                    // Whether to use our exposure control
+  unsigned long aeIdleMillis;                       // millis() between exposure metering passes
+  bool motionEnable;                                // Whether motion-triggered capture starts out on
+  unsigned long motionMillis;                       // millis() between motion checks
+  bool keystoneEnable;                              // Whether to correct the perspective of photos
+  float keystoneCorners[8];                         // Where the screen's corners are in photos, as 
+                                                    //   for Keystone::begin()
+};
+
+class ConfigFile {
+public:
+  /**
+   * @brief Construct a new ConfigFile object
+   *
+   * @param path      The config file's path
+   * @param validPath Says whether a path is acceptable
+   */
+  ConfigFile(const char *path, bool (*validPath)(const String &));
+
+  /**
+   * @brief Read the config file and override the settings it gives. A missing file isn't an 
+   *        error; the settings are just left alone.
+   *
+   * @param fs        The file system the file is on
+   * @param settings  The settings to override
+   * @return true     The file was missing or everything in it was good
+   * @return false    Some of it couldn't be read or understood and was skipped
+   */
+  bool load(fs::FS &fs, Settings &settings);
+
+  /**
+   * @brief Describe the last load as a JSON object
+   *
+   */
+  String toJson() const;
+
+private:
+  String path;                                      // The file's path
+  bool (*validPath)(const String &);                // Says whether a path is acceptable
+  bool found;                                       // Whether it was there at the last load
+  uint32_t parseMicros;                             // micros() the last load took
+  uint16_t lines;                                   // Lines in the file
+  uint16_t applied;                                 // Settings it gave
+  std::vector<String> problems;                     // The first few bad lines
+
+  bool apply(const String &key, const String &value, Settings &settings);
+};
+
+/**
+ * @brief A string as a JSON string literal: quoted, with quotes, backslashes and control 
+ *        characters escaped
+ *
+ */
+String jsonString(const String &s);
@@ -0,0 +1,176 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * DiskUsage.h
+ *
+ * Storage accounting that answers "how full is the card, and what's using it?" instantly. 
+ * SD_MMC.usedBytes() and SD_MMC.totalBytes() both count the free clusters in the FAT, which 
+ * takes seconds on a big card, and adding up a directory's files means walking it. A DiskUsage 
+ * object instead keeps, for every directory, the number and total size of the files directly in 
+ * it. The code that writes, replaces, moves or deletes files tells it what changed with add() 
+ * and moveDir(), so the totals stay current without going to the card.
+ *
+ * Anything not reported -- files changed with the card out of the camera, writes that failed 
+ * partway -- makes the totals drift, so a DiskUsageScan walks the tree every so often (and once 
+ * at boot, to fill the totals in to begin with) and puts them right. It's a Job, but it runs on 
+ * a JobRunner of its own in idle time, so it never holds up the background jobs. The scan 
+ * replaces each directory's totals as it finishes listing it, so changes reported after that 
+ * still count. A directory that changes while it's being listed may or may not have had the 
+ * change listed, so it's listed again, up to DU_MAX_REWALKS times; if it's still changing after 
+ * that, the changes reported during the last listing are added to what it found. At the end it 
+ * reads the card's used and total bytes and notes by how much the cached file sizes had drifted 
+ * from the ones it found.
+ *
+ * Used bytes between scans are the card's figure from the last scan plus the sizes of the 
+ * changes reported since, so they leave out the slack at the ends of clusters until the next 
+ * scan.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include "FS.h"                                   // File system
+#include "SD_MMC.h"                               // SD card used and total bytes
+#include "Job.h"                                  // Background jobs
+#include <map>
+#include <vector>
+
+#define DU_STEP_MICROS    (20000)                   // About how long each scan step() may take (micros())
+#define DU_MAX_CHILDREN   (64)                      // Most subdirectories listed by toJson()
+#define DU_MAX_REWALKS    (3)                       // Most times a scan relists a changing directory
+
+class DiskUsage {
+public:
+  /**
+   * @brief Construct a new DiskUsage object
+   *
+   * @param scanMillis  millis() between reconciling scans
+   */
+  DiskUsage(unsigned long scanMillis);
+
+  /**
+   * @brief Note a change to a file
+   *
+   * @param path    The file's path
+   * @param bytes   How much bigger (or, if negative, smaller) it got (bytes)
+   * @param files   1 if it was created, -1 if it was deleted, otherwise 0
+   */
+  void add(const String &path, int64_t bytes, int32_t files);
+
+  /**
+   * @brief Note that a directory and everything in it has been moved
+   *
+   * @param from    Where it was
+   * @param to      Where it is now
+   */
+  void moveDir(const String &from, const String &to);
+
+  /**
+   * @brief Note that a directory has been deleted. Its files and those of the directories in it 
+   *        must have been reported deleted with add() already.
+   *
+   */
+  void removeDir(const String &path);
+
+  /**
+   * @brief Whether it's time for a reconciling scan
+   *
+   */
+  bool scanDue() const;
+
+  /**
+   * @brief Whether a scan has finished since boot, so the totals can be trusted
+   *
+   */
+  bool reconciled() const { return scans != 0; }
+
+  /**
+   * @brief The cached used and total bytes on the card
+   *
+   */
+  uint64_t usedBytes() const { return usedBase + usedDelta; }
+  uint64_t totalBytes() const { return cardBytes; }
+
+  /**
+   * @brief Describe the card and the usage of dir and of each of its subdirectories, including 
+   *        everything below them, as a JSON object
+   *
+   */
+  String toJson(const String &dir) const;
+
+  // For DiskUsageScan: start a scan, start listing a directory, whether it's changed since, 
+  // replace its totals with what the listing found and finish the scan
+  void beginScan();
+  void beginDir(const String &dir);
+  bool dirChanged() const { return walkChanged; }
+  void setDir(const String &dir, uint64_t bytes, uint32_t files);
+  void endScan(uint64_t used, uint64_t total);
+
+private:
+  struct Totals {                                   // What's directly in a directory
+    uint64_t bytes;                                 //   Total size of its files
+    uint32_t files;                                 //   Number of files
+    uint32_t scan;                                  //   The scan that last saw it
+  };
+  std::map<String, Totals> dirs;                    // The directories, by path
+  unsigned long scanMillis;                         // millis() between scans
+  uint32_t scans;                                   // Scans finished since boot
+  bool scanning;                                    // Whether a scan is in progress
+  unsigned long scanStartMillis;                    // millis() when the current or last scan began
+  unsigned long scanEndMillis;                      // millis() when the last scan finished
+  uint64_t usedBase;                                // The card's used bytes at the last scan
+  int64_t usedDelta;                                // Change in used bytes reported since then
+  uint64_t cardBytes;                               // The card's total bytes
+  String walkDir;                                   // The directory the scan is listing, if any
+  bool walkChanged;                                 // Whether it's changed since the listing began
+  bool walkGone;                                    // Whether it's been moved or deleted since
+  int64_t walkBytes;                                // Bytes reported added to it since
+  int32_t walkFiles;                                // Files reported added to it since
+  int64_t scanDrift;                                // Cached less found file sizes, so far this scan
+  int64_t lastDrift;                                // Cached less found file sizes at the last scan
+
+  void walkTouched(const String &path);
+};
+
+class DiskUsageScan : public Job {
+public:
+  /**
+   * @brief Construct a new DiskUsageScan object
+   *
+   * @param card    The SD card to scan
+   * @param du      The DiskUsage to put right
+   */
+  DiskUsageScan(fs::SDMMCFS &card, DiskUsage &du);
+  ~DiskUsageScan();
+
+  const char *name() const override { return "diskUsage"; }
+  bool step() override;
+  String toJson() const override;
+
+private:
+  fs::SDMMCFS &card;                                // The card being scanned
+  DiskUsage &du;                                    // What's being put right
+  std::vector<String> pending;                      // Directories yet to be walked
+  File dir;                                         // The directory being walked, if any
+  String dirPath;                                   // Its path
+  std::vector<String> subdirs;                      // The directories found in it so far
+  uint64_t dirBytes;                                // The total size of the files in it so far
+  uint32_t dirFiles;                                // The number of files in it so far
+  uint32_t rewalks;                                 // Times dirPath has been relisted
+  uint32_t dirs;                                    // Directories walked
+  uint32_t relisted;                                // Directories relisted because they changed
+  uint32_t files;                                   // Files seen
+  bool finished;                                    // Whether the scan is done
+};
@@ -0,0 +1,95 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * ExposureController.h
+ *
+ * The OV2640's built-in automatic exposure control is tuned for ordinary scenes. Inside the 
+ * trailer the scene is a bright screen in a dark room, and the built-in AEC routinely gets it 
+ * wrong. An ExposureController takes over: it turns off the sensor's AEC and AGC, meters 
+ * grayscale preview frames grabbed between photos, and sets the exposure (aec_value) and gain 
+ * (agc_gain) itself.
+ *
+ * Metering is done on a high percentile of the luma histogram rather than on the mean, so the 
+ * dark surroundings don't drag the screen into overexposure. The sensor's response is modeled as
+ * exposure * (gain + 1), and each step moves that product part of the way toward the value that
+ * would put the metered percentile on target. Exposure is preferred over gain to keep noise 
+ * down. A pass gives up after a bounded number of frames so it can never keep the camera busy.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include "sensor.h"                               // Camera sensor support
+
+class ExposureController {
+public:
+  /**
+   * @brief Construct a new ExposureController object
+   *
+   * @param target      The luma (0 - 255) the metered percentile should end up at
+   * @param percentile  The percentile (1 - 99) of the luma histogram to meter
+   * @param tolerance   How close (luma) to the target counts as converged
+   * @param maxFrames   The most frames a pass may take before it gives up
+   */
+  ExposureController(uint8_t target, uint8_t percentile, uint8_t tolerance, uint8_t maxFrames);
+
+  /**
+   * @brief Take over exposure control from the sensor, starting from its current settings
+   *
+   * @param s   The camera sensor
+   */
+  void begin(sensor_t *s);
+
+  /**
+   * @brief Meter a preview frame and, if need be, adjust the sensor's exposure and gain
+   *
+   * @param luma    The preview's grayscale pixels
+   * @param count   How many of them there are
+   * @return true   The exposure is on target, or this pass has used up its frames
+   * @return false  The exposure was adjusted; call again with a frame taken after the change
+   */
+  bool update(const uint8_t *luma, size_t count);
+
+  /**
+   * @brief Start a new pass, e.g. after the scene may have changed
+   *
+   */
+  void restart() { frames = 0; isConverged = false; }
+
+  /**
+   * @brief Whether the current pass is done
+   *
+   */
+  bool converged() const { return isConverged; }
+
+  /**
+   * @brief Describe the controller's state as a JSON object
+   *
+   */
+  String toJson() const;
+
+private:
+  sensor_t *sensor;                                 // The camera sensor, nullptr until begin()
+  uint8_t target;                                   // Target luma for the metered percentile
+  uint8_t percentile;                               // The percentile to meter
+  uint8_t tolerance;                                // Converged if within this of target
+  uint8_t maxFrames;                                // Frame limit for a pass
+  uint8_t frames;                                   // Frames used so far in this pass
+  bool isConverged;                                 // Whether this pass is done
+  uint8_t metered;                                  // The most recently metered luma
+  uint16_t aec;                                     // Current exposure (0 - 1200)
+  uint8_t agc;                                      // Current gain (0 - 30, i.e., 1x - 31x)
+  uint32_t adjustments;                             // Total adjustments made since begin()
+};
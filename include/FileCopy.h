@@ -0,0 +1,101 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * FileCopy.h
+ *
+ * Copy a file on the SD card to another place on the same card, a buffer-full at a time, so 
+ * nothing goes over the network and the work can be spread over several calls to step(). The 
+ * copy is written to <to>.tmp and renamed to <to> only once it's all there, so an interrupted 
+ * copy never leaves a truncated file under the real name. The buffer is in PSRAM; it's 
+ * allocated by the first begin() and reused for every copy after that. A finished copy is added
+ * to the DiskUsage totals.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include "FS.h"                                   // File system
+#include "DiskUsage.h"                            // Per-directory space used
+
+class FileCopy {
+public:
+  /**
+   * @brief Construct a new FileCopy object
+   *
+   * @param fs          The file system to copy within
+   * @param diskUsage   The space used totals to add finished copies to
+   * @param bufferBytes The size of the copy buffer (bytes)
+   */
+  FileCopy(fs::FS &fs, DiskUsage &diskUsage, size_t bufferBytes);
+  ~FileCopy();
+
+  /**
+   * @brief Start copying a file. The copy in progress, if any, is abandoned.
+   *
+   * @param from    The path of the file to copy
+   * @param to      The path of the copy, which must not exist
+   * @return true   Started; call step() until it returns false
+   * @return false  Couldn't start; see error()
+   */
+  bool begin(const String &from, const String &to);
+
+  /**
+   * @brief Copy buffer-fulls until the copy is done or budgetMicros has passed
+   *
+   * @return true   There's more to copy
+   * @return false  The copy is finished; ok() says whether it succeeded
+   */
+  bool step(uint32_t budgetMicros);
+
+  /**
+   * @brief Abandon the copy in progress, removing the partial copy
+   *
+   */
+  void abort();
+
+  /**
+   * @brief Whether the last copy finished successfully
+   *
+   */
+  bool ok() const { return error() == nullptr && !isCopying; }
+
+  /**
+   * @brief Why the last copy failed, or nullptr if it didn't
+   *
+   */
+  const char *error() const { return errorText; }
+
+  /**
+   * @brief Bytes copied and micros() spent copying, in the last copy
+   *
+   */
+  uint32_t bytes() const { return copied; }
+  uint32_t micros() const { return copyMicros; }
+
+private:
+  fs::FS &fs;                                       // The file system
+  DiskUsage &diskUsage;                             // The space used totals
+  size_t bufferBytes;                               // Size of the copy buffer
+  uint8_t *buffer;                                  // The copy buffer (PSRAM)
+  File src;                                         // The file being copied
+  File dst;                                         // The copy, while it's being written
+  String toPath;                                    // Where the copy is to end up
+  bool isCopying;                                   // Whether a copy is in progress
+  uint32_t copied;                                  // Bytes copied so far
+  uint32_t copyMicros;                              // micros() spent in step() so far
+  const char *errorText;                            // Why the copy failed, or nullptr
+
+  void fail(const char *what);
+};
@@ -0,0 +1,78 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * FsCheck.h
+ *
+ * A file system consistency check, run as a background Job. It walks the whole tree a few 
+ * entries per step and reports:
+ *
+ *    - How many directories and files there are and the total size of the files, compared with 
+ *      what the file system says is in use
+ *    - Empty files and leftover temporary files (".tmp" and ".part"), which point to 
+ *      interrupted writes
+ *    - Whether the photo counter is behind the highest-numbered photo, in which case the next 
+ *      photo would overwrite an existing one
+ *
+ * Any of the last two is a problem; the report's "ok" is false if any were found.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include "FS.h"                                   // File system
+#include "Job.h"                                  // Background jobs
+#include <vector>
+
+#define FC_MAX_LISTED     (8)                       // Most problem files named in the report
+#define FC_STEP_MICROS    (20000)                   // About how long each step() may take (micros())
+
+class FsCheck : public Job {
+public:
+  /**
+   * @brief Construct a new FsCheck object
+   *
+   * @param fs          The file system to check
+   * @param usedBytes   What the file system says is in use (bytes), e.g. DiskUsage::usedBytes()
+   * @param photoDir    The directory, ending in "/", photos are kept in
+   * @param photoPrefix The photos' file name prefix
+   * @param photoCount  The photo counter: the number of the last photo taken
+   */
+  FsCheck(fs::FS &fs, uint64_t usedBytes, const char *photoDir, const char *photoPrefix, 
+          uint32_t photoCount);
+  ~FsCheck();
+
+  const char *name() const override { return "fsCheck"; }
+  bool step() override;
+  String toJson() const override;
+
+private:
+  fs::FS &fs;                                       // The file system being checked
+  uint64_t usedBytes;                               // Bytes the file system says are in use
+  String photoDir;                                  // Where the photos are
+  String photoPrefix;                               // Their file name prefix
+  uint32_t photoCount;                              // The photo counter
+  std::vector<String> pending;                      // Directories yet to be walked
+  File dir;                                         // The directory being walked, if any
+  uint32_t dirs;                                    // Directories seen
+  uint32_t files;                                   // Files seen
+  uint64_t fileBytes;                               // Their total size
+  uint32_t maxPhoto;                                // The highest photo number seen
+  uint32_t emptyFiles;                              // Zero-length files seen
+  uint32_t tempFiles;                               // Leftover temporary files seen
+  std::vector<String> listed;                       // The first few problem files
+  bool finished;                                    // Whether the walk is done
+
+  void checkFile(const String &path, size_t size);
+};
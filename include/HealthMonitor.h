@@ -0,0 +1,114 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * HealthMonitor.h
+ *
+ * Long-term health tracking, for catching the leaks, heap fragmentation and slowdowns that only 
+ * show up after hours or days of use. Every period, a Snapshot of the heap (free, largest free 
+ * block, low-water mark, free PSRAM) and of the requests handled since the last snapshot (count, 
+ * mean and max latency) is added to a ring buffer in PSRAM. toJson() reports the snapshots along 
+ * with flags for the regressions they show:
+ *
+ *    - leak          Free internal heap has trended down by more than HM_LEAK_BYTES_PER_HOUR
+ *    - fragmentation The largest free block is less than HM_MIN_BLOCK_PCT percent of free heap
+ *    - latencyDrift  Mean latency over the newest quarter of the snapshots is more than 
+ *                    HM_DRIFT_FACTOR times that over the oldest quarter
+ *    - overBudget    A request in the current or latest period took longer than the budget
+ *
+ * The trend flags need at least HM_MIN_SNAPSHOTS snapshots before they're raised. The leak trend
+ * also leaves out the first HM_WARMUP_SECONDS of uptime, when the heap falls as caches and buffers
+ * fill, and isn't judged until the snapshots after that span HM_LEAK_SECONDS: over a shorter
+ * span, the heap's ordinary ups and downs look like a trend.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+
+#define HM_LEAK_BYTES_PER_HOUR (1024)               // Free heap decline that counts as a leak (bytes/hour)
+#define HM_MIN_BLOCK_PCT  (50)                      // Largest free block below this % of free heap is fragmented
+#define HM_DRIFT_FACTOR   (2)                       // Latency growth that counts as drift
+#define HM_MIN_SNAPSHOTS  (8)                       // Snapshots needed before trends are judged
+#define HM_WARMUP_SECONDS (3600)                    // Uptime left out of the leak trend (s)
+#define HM_LEAK_SECONDS   (4 * 3600)                // Span past warm-up needed to judge a leak (s)
+
+class HealthMonitor {
+public:
+  /**
+   * @brief Construct a new HealthMonitor object
+   *
+   * @param capacity      The number of snapshots to keep
+   * @param periodMillis  millis() between snapshots
+   * @param budgetMicros  The longest a request should take
+   */
+  HealthMonitor(uint16_t capacity, unsigned long periodMillis, uint32_t budgetMicros);
+
+  /**
+   * @brief Allocate the snapshot ring buffer and take the first snapshot
+   *
+   * @return true   Success
+   * @return false  Couldn't allocate the ring buffer
+   */
+  bool begin();
+
+  /**
+   * @brief Count a request handled and how long it took
+   *
+   */
+  void noteRequest(uint32_t micros);
+
+  /**
+   * @brief Take a snapshot if one is due. Call this from loop().
+   *
+   */
+  void poll();
+
+  /**
+   * @brief Describe the current state, the regression flags and the snapshots as a JSON object
+   *
+   */
+  String toJson() const;
+
+private:
+  struct Snapshot {                                 // What things looked like at one point
+    uint32_t seconds;                               //   Uptime (s)
+    uint32_t freeHeap;                              //   Free internal heap (bytes)
+    uint32_t largestBlock;                          //   Largest free internal block (bytes)
+    uint32_t minFreeHeap;                           //   Lowest free internal heap ever (bytes)
+    uint32_t freePsram;                             //   Free PSRAM (bytes)
+    uint32_t requests;                              //   Requests handled since the last snapshot
+    uint32_t meanMicros;                            //   Their mean latency
+    uint32_t maxMicros;                             //   Their longest latency
+    uint32_t overBudget;                            //   How many of them were over budget
+  };
+
+  uint16_t capacity;                                // Ring buffer size (snapshots)
+  unsigned long periodMillis;                       // millis() between snapshots
+  uint32_t budgetMicros;                            // The longest a request should take
+  Snapshot *ring;                                   // The ring buffer
+  uint32_t taken;                                   // Snapshots taken
+  unsigned long lastMillis;                         // millis() at the last snapshot
+  uint32_t requests;                                // Requests since the last snapshot
+  uint64_t requestMicros;                           // Their total latency
+  uint32_t maxMicros;                               // Their longest latency
+  uint32_t overBudget;                              // How many were over budget
+
+  uint16_t held() const { return taken < capacity ? taken : capacity; }
+  const Snapshot &at(uint16_t i) const { return ring[(taken - held() + i) % capacity]; }
+  void measure(Snapshot &s) const;
+  void snapshot(Snapshot &s);
+  float heapSlope(uint16_t first) const;
+  float meanLatency(uint16_t first, uint16_t count) const;
+};
@@ -0,0 +1,95 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Job.h
+ *
+ * Background jobs: work that takes too long to do inside a request handler without stalling the 
+ * web server (and the camera), such as benchmarking the SD card. A Job does its work a little at 
+ * a time, each call to step() taking no more than a few tens of milliseconds, and reports its 
+ * progress and, when it's finished, its results as JSON.
+ *
+ * A JobRunner holds at most one Job at a time. Handlers start() a job and reply straight away; 
+ * loop() calls JobRunner::step() to advance it. The finished job is kept so its results can be 
+ * asked for until the next one is started.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+
+class Job {
+public:
+  virtual ~Job() {}
+
+  /**
+   * @brief The job's name, for reporting
+   *
+   */
+  virtual const char *name() const = 0;
+
+  /**
+   * @brief Do the next bit of work
+   *
+   * @return true   There's more to do
+   * @return false  The job is finished (successfully or not)
+   */
+  virtual bool step() = 0;
+
+  /**
+   * @brief Describe the job's progress or results as a JSON object
+   *
+   */
+  virtual String toJson() const = 0;
+};
+
+class JobRunner {
+public:
+  JobRunner() : job(nullptr), active(false), startMillis(0), endMillis(0) {}
+  ~JobRunner() { delete job; }
+
+  /**
+   * @brief Start a job, taking ownership of it. Discards the previous, finished, job.
+   *
+   * @param newJob  The job, allocated with new
+   * @return true   The job has been started
+   * @return false  Another job is still running; newJob has been deleted
+   */
+  bool start(Job *newJob);
+
+  /**
+   * @brief Advance the running job, if any. Call this from loop().
+   *
+   */
+  void step();
+
+  /**
+   * @brief Whether a job is running
+   *
+   */
+  bool running() const { return active; }
+
+  /**
+   * @brief Describe the running or last job as a JSON object: its name, state, how long it has 
+   *        run and, as "job", the job's own report
+   *
+   */
+  String toJson() const;
+
+private:
+  Job *job;                                         // The running or last job; nullptr if none
+  bool active;                                      // Whether it's running
+  unsigned long startMillis;                        // millis() when it was started
+  unsigned long endMillis;                          // millis() when it finished
+};
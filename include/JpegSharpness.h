@@ -0,0 +1,40 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * JpegSharpness.h
+ *
+ * Score how sharp a JPEG image is without decoding it. The entropy-coded data is Huffman decoded 
+ * just far enough to recover the quantized DCT coefficients of the luma blocks -- no inverse DCT, 
+ * no color conversion, no output image. Motion blur and camera shake wash out high spatial 
+ * frequencies, so the dequantized AC coefficient energy per luma block drops as an image gets 
+ * blurrier. Comparing scores is only meaningful between images of the same scene taken with the 
+ * same settings, which is exactly the best-of-burst case.
+ *
+ * Only baseline (SOF0/SOF1) Huffman-coded JPEGs, which is what the OV2640 produces, are handled.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+
+/**
+ * @brief Score the sharpness of a baseline JPEG image from its luma AC coefficients
+ *
+ * @param jpg     The JPEG image
+ * @param len     Its length (bytes)
+ * @return        The mean absolute dequantized luma AC energy per block; larger is sharper. 0 if 
+ *                the image couldn't be parsed.
+ */
+uint32_t jpegSharpness(const uint8_t *jpg, size_t len);
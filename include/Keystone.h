@@ -0,0 +1,137 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Keystone.h
+ *
+ * Perspective ("keystone") correction for the ObscuraCam. Because the camera sits on a shelf
+ * above the iris, it sees the screen from an angle and the screen shows up in the photo as a
+ * trapezoid. A Keystone object knows where the four corners of the screen land in the photo and
+ * remaps the photo so the screen fills a proper rectangle again.
+ *
+ * The remap is driven by a precomputed fixed-point lookup table. To keep the table small and the
+ * work friendly to the PSRAM cache, the table only holds the source coordinates for the corners
+ * of 16 x 16 pixel tiles of the output image. The output is produced one tile at a time, with the
+ * source coordinates of the pixels inside a tile interpolated from the tile's corners. Over a
+ * tile that small the perspective mapping is, to all intents and purposes, linear, and all the
+ * reads for a tile come from a small, compact patch of the source image.
+ *
+ * Pixels are RGB565 stored high byte first, which is what jpg2rgb565() produces and fmt2jpg()
+ * consumes.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+
+#define KS_TILE_SHIFT     (4)                       // log2 of the tile edge length
+#define KS_TILE           (1 << KS_TILE_SHIFT)      // The tile edge length in pixels
+#define KS_FRAC_BITS      (4)                       // Fractional bits in source pixel coordinates
+#define KS_FRAC_ONE       (1 << KS_FRAC_BITS)       // 1.0 in source pixel coordinates
+#define KS_MIN_Z          (1e-3f)                   // Least homogeneous z allowed at a node
+#define KS_MAX_OUTSIDE    (1.0f)                    // How far outside the source a node may fall,
+                                                    //   in image widths and heights
+
+class Keystone {
+public:
+  /**
+   * @brief Construct a new, not yet usable, Keystone object
+   *
+   */
+  Keystone();
+
+  /**
+   * @brief Destroy the Keystone object, releasing its lookup table
+   *
+   */
+  ~Keystone();
+
+  /**
+   * @brief Build the remap lookup table for images of the given size
+   *
+   * @details The corners are where the corners of the screen appear in the source image, given
+   *          as fractions of the image's width and height, in the order top-left, top-right,
+   *          bottom-right, bottom-left, as {x0, y0, x1, y1, x2, y2, x3, y3}.
+   *
+   * @param width     The width of the images to be corrected (pixels)
+   * @param height    The height of the images to be corrected (pixels)
+   * @param corners   The corners of the screen in the source image
+   * @return true     Success. The Keystone object is ready to use.
+   * @return false    Failed. Couldn't allocate the lookup table, or the corners are degenerate
+   *                  or map some of the output to (or near) infinity or far outside the source.
+   */
+  bool begin(uint16_t width, uint16_t height, const float corners[8]);
+
+  /**
+   * @brief Release the lookup table
+   *
+   */
+  void end();
+
+  /**
+   * @brief Whether begin() succeeded and the Keystone object is ready to use
+   *
+   */
+  bool ready() const { return lut != nullptr; }
+
+  /**
+   * @brief The width and height, in pixels, of the images the lookup table was built for
+   *
+   */
+  uint16_t width() const { return w; }
+  uint16_t height() const { return h; }
+
+  /**
+   * @brief Remap an RGB565 image of the size given to begin() into a corrected one of the same
+   *        size, a tile at a time.
+   *
+   * @param src   The source image
+   * @param dst   Where to put the corrected image; must not overlap src
+   */
+  void apply(const uint8_t *src, uint8_t *dst) const;
+
+  /**
+   * @brief Correct a JPEG image: decode it (scaled down by 2^scaleShift), remap it and encode the
+   *        result as a JPEG again.
+   *
+   * @details The decoded size must match the size given to begin(). The work is abandoned if it
+   *          can't be finished within budgetMillis; the caller should then use the original.
+   *          On success *out points to a malloc()ed buffer the caller must free().
+   *
+   * @param jpg           The JPEG to correct
+   * @param len           Its length (bytes)
+   * @param scaleShift    0 - 3: decode at 1/1, 1/2, 1/4 or 1/8 scale
+   * @param quality       JPEG quality for the result (1 - 100, higher is better)
+   * @param budgetMillis  The most time, in millis(), the correction is allowed to add
+   * @param out           Set to the corrected JPEG
+   * @param outLen        Set to its length (bytes)
+   * @return true         Success
+   * @return false        Failed or over budget. *out is not set.
+   */
+  bool correctJpeg(const uint8_t *jpg, size_t len, uint8_t scaleShift, uint8_t quality,
+                   uint32_t budgetMillis, uint8_t **out, size_t *outLen) const;
+
+private:
+  struct Node {                                     // A tile-corner entry in the lookup table
+    int32_t x;                                      //   Source x in 1/KS_FRAC_ONE pixels
+    int32_t y;                                      //   Source y in 1/KS_FRAC_ONE pixels
+  };
+  uint16_t w;                                       // Image width (pixels)
+  uint16_t h;                                       // Image height (pixels)
+  uint16_t nodesX;                                  // Lookup table width (nodes)
+  uint16_t nodesY;                                  // Lookup table height (nodes)
+  Node *lut;                                        // The lookup table, nodesX * nodesY nodes
+
+  void applyTile(const uint8_t *src, uint8_t *dst, uint16_t tx, uint16_t ty) const;
+};
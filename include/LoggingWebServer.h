@@ -0,0 +1,113 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * LoggingWebServer.h
+ *
+ * A WebServer that records each request it handles in an AccessLog. WebServer has no hook for 
+ * seeing the responses its handlers send, so LoggingWebServer hides send(), sendContent() and 
+ * streamFile() with versions that note the status code and count the bytes before passing the 
+ * call on, and hides handleClient() with a version that times the request and adds the entry to 
+ * the log once a response has been sent. Handlers that write to client() directly should report 
+ * what they wrote with countBytes().
+ *
+ * Since the hiding isn't virtual, only calls made through a LoggingWebServer are seen; responses 
+ * WebServer sends on its own (e.g., for malformed requests) aren't logged.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include "WebServer.h"                            // Web server support
+#include "AccessLog.h"                            // Where the requests are recorded
+
+class LoggingWebServer : public WebServer {
+public:
+  /**
+   * @brief Construct a new LoggingWebServer object
+   *
+   * @param port  The port to listen on
+   * @param log   The AccessLog to record requests in
+   */
+  LoggingWebServer(int port, AccessLog &log) : WebServer(port), log(log), status(0), bytes(0), 
+    latency(0), ip(0), reqMethod(0), passes(0) {}
+
+  /**
+   * @brief Handle the next request, if any, and log it if a response was sent
+   *
+   */
+  void handleClient();
+
+  /**
+   * @brief Note bytes of the response sent other than by send(), sendContent() or streamFile()
+   *
+   */
+  void countBytes(size_t n) { bytes += n; }
+
+  /**
+   * @brief Whether the last handleClient() handled a request, and if so, how long it took
+   *
+   */
+  bool handledRequest() const { return status != 0; }
+  uint32_t requestMicros() const { return latency; }
+
+  /**
+   * @brief How many times handleClient() has been called. A request, uploads and all, is dealt
+   *        with within one call, so callbacks that see the same number belong to the same request
+   *
+   */
+  uint32_t pass() const { return passes; }
+
+  void send(int code) {
+    noteStatus(code);
+    WebServer::send(code);
+  }
+  template <typename T> void send(int code, T contentType) {
+    noteStatus(code);
+    WebServer::send(code, contentType);
+  }
+  template <typename T, typename U> void send(int code, T contentType, const U &content) {
+    noteStatus(code);
+    bytes += contentBytes(content);
+    WebServer::send(code, contentType, content);
+  }
+  template <typename T> void sendContent(const T &content) {
+    bytes += contentBytes(content);
+    WebServer::sendContent(content);
+  }
+  void sendContent(const char *content, size_t size) {
+    bytes += size;
+    WebServer::sendContent(content, size);
+  }
+  template <typename T> size_t streamFile(T &file, const String &contentType, const int code = 200) {
+    noteStatus(code);
+    size_t n = WebServer::streamFile(file, contentType, code);
+    bytes += n;
+    return n;
+  }
+
+private:
+  AccessLog &log;                                   // Where requests are recorded
+  uint16_t status;                                  // Status code of the response being sent; 0 if none
+  uint32_t bytes;                                   // Bytes of it sent so far
+  uint32_t latency;                                 // How long the last request took (micros())
+  uint32_t ip;                                      // The client's IPv4 address
+  uint8_t reqMethod;                                // The request's method
+  String reqUri;                                    // The request's URI
+  uint32_t passes;                                  // handleClient() calls so far
+
+  void noteStatus(int code);
+  static size_t contentBytes(const String &s) { return s.length(); }
+  static size_t contentBytes(const char *s) { return s == nullptr ? 0 : strlen(s); }
+};
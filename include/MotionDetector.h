@@ -0,0 +1,108 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * MotionDetector.h
+ *
+ * Notice when something moves across the screen, like a boat going by or a performer walking 
+ * through the scene. A MotionDetector is fed a sequence of grayscale preview frames. Each is cut 
+ * into 8 x 8 pixel blocks and each block's sum of absolute differences (SAD) from the same block 
+ * in the previous frame is computed. If enough blocks changed by more than a threshold, that's 
+ * motion.
+ *
+ * The ESP32 has no SIMD instructions, so the SAD kernel does the next best thing: it loads four 
+ * pixels at a time as a 32-bit word from each frame and works through a block row with no loop 
+ * overhead. That needs word-aligned rows; frames whose width isn't a multiple of 4, or that don't 
+ * start on a word boundary, go through a byte-at-a-time kernel instead.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+
+#define MD_BLOCK          (8)                       // Block edge length (pixels)
+
+class MotionDetector {
+public:
+  /**
+   * @brief Construct a new MotionDetector object
+   *
+   * @param threshold   Mean absolute per-pixel difference above which a block has changed
+   * @param minBlocks   Number of changed blocks that counts as motion
+   */
+  MotionDetector(uint8_t threshold, uint16_t minBlocks);
+
+  /**
+   * @brief Destroy the MotionDetector object, releasing its reference frame
+   *
+   */
+  ~MotionDetector();
+
+  /**
+   * @brief Compare a frame with the previous one and make it the new reference
+   *
+   * @param luma    The frame's grayscale pixels
+   * @param w       Its width (pixels)
+   * @param h       Its height (pixels)
+   * @return true   Motion was detected
+   * @return false  It wasn't, or there was no previous frame to compare with
+   */
+  bool update(const uint8_t *luma, uint16_t w, uint16_t h);
+
+  /**
+   * @brief Forget the reference frame, e.g. because the exposure changed
+   *
+   */
+  void reset() { haveRef = false; }
+
+  /**
+   * @brief Change the detection parameters
+   *
+   */
+  void setThreshold(uint8_t t) { threshold = t; }
+  void setMinBlocks(uint16_t n) { minBlocks = n; }
+  uint8_t getThreshold() const { return threshold; }
+  uint16_t getMinBlocks() const { return minBlocks; }
+
+  /**
+   * @brief The number of blocks that changed in the most recent comparison
+   *
+   */
+  uint16_t changedBlocks() const { return changed; }
+
+private:
+  uint8_t threshold;                                // Per-pixel mean difference threshold
+  uint16_t minBlocks;                               // Changed blocks needed for motion
+  uint16_t changed;                                 // Changed blocks in the last comparison
+  uint8_t *ref;                                     // The reference (previous) frame
+  uint16_t refW;                                    // Its width
+  uint16_t refH;                                    // Its height
+  bool haveRef;                                     // Whether ref holds a frame
+};
+
+/**
+ * @brief The sum of absolute differences between two 8 x 8 blocks
+ *
+ * @param a       The top left of the first block; must be 4-byte aligned
+ * @param b       The top left of the second block; must be 4-byte aligned
+ * @param stride  The distance (bytes) between rows in both images; a multiple of 4
+ * @return        The SAD
+ */
+uint32_t blockSad8(const uint8_t *a, const uint8_t *b, uint16_t stride);
+
+/**
+ * @brief The same as blockSad8(), a byte at a time, for blocks with no alignment requirements
+ *
+ */
+uint32_t blockSad8Bytes(const uint8_t *a, const uint8_t *b, uint16_t stride);
@@ -0,0 +1,143 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * OtaUpdate.h
+ *
+ * Over-the-air firmware update, streamed straight into the inactive OTA app partition as the
+ * bytes arrive -- nothing is staged on the SD card. The Update library erases each flash sector
+ * just before writing it, so the work is spread evenly over the upload rather than front-loaded.
+ * When the image is all there, finish() checks it (its MD5, if one was given, plus the image
+ * header and SHA-256 digest that esp_ota_end() checks) and marks the partition to be booted next.
+ * The running firmware carries on as before until restart() is called.
+ *
+ * The timing of the last update is kept in NVS: how long the upload took, how long finishing it
+ * took, how long the old firmware ran on before restarting, and how long after reset the new
+ * firmware was ready (recorded by markReady() at the end of setup()). Together they give the
+ * upload-to-reboot and upload-to-ready times.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+
+#define OTA_LABEL_CHARS   (17)                      // Room for a partition label and its '\0'
+
+class OtaUpdate {
+public:
+  /**
+   * @brief Construct a new OtaUpdate object
+   *
+   */
+  OtaUpdate();
+
+  /**
+   * @brief Load the record of the last update from NVS
+   *
+   */
+  void begin();
+
+  /**
+   * @brief Start an update into the inactive OTA partition
+   *
+   * @param md5     The image's MD5 as 32 hex digits, or "" not to check it
+   * @return true   Success; write() the image
+   * @return false  Failed; see error()
+   */
+  bool start(const String &md5);
+
+  /**
+   * @brief Write the next part of the image to flash
+   *
+   * @param data    The data
+   * @param len     Its length (bytes)
+   * @return true   Success
+   * @return false  Failed; the update has been abandoned. See error().
+   */
+  bool write(const uint8_t *data, size_t len);
+
+  /**
+   * @brief Check the image and, if it's good, boot it at the next restart
+   *
+   * @return true   Success; the record of the update has been saved in NVS
+   * @return false  Failed; the update has been abandoned. See error().
+   */
+  bool finish();
+
+  /**
+   * @brief Abandon the update in progress, if any
+   *
+   */
+  void abort();
+
+  /**
+   * @brief Whether an update is being received
+   *
+   */
+  bool receiving() const { return isReceiving; }
+
+  /**
+   * @brief Whether an update has been finished and is waiting for a restart to take effect
+   *
+   */
+  bool ready() const { return isReady; }
+
+  /**
+   * @brief Why the last update failed ("" if it didn't)
+   *
+   */
+  const String &error() const { return errorText; }
+
+  /**
+   * @brief Note how long the old firmware ran on after the update in NVS and restart
+   *
+   */
+  void restart();
+
+  /**
+   * @brief If this is the first boot after an update, note how long after reset the new firmware
+   *        was ready. Call at the end of setup().
+   *
+   */
+  void markReady();
+
+  /**
+   * @brief Describe the partitions, the update in progress and the last update as a JSON object
+   *
+   */
+  String toJson() const;
+
+private:
+  struct Record {                                   // The NVS record of the last update
+    uint32_t bytes;                                 //   Size of the image
+    uint32_t uploadMillis;                          //   millis() from start() to the last write()
+    uint32_t finishMillis;                          //   millis() finish() took
+    uint32_t rebootMillis;                          //   millis() from finish() to restart()
+    uint32_t readyMillis;                           //   millis() from reset to ready on the new image
+    char target[OTA_LABEL_CHARS];                   //   The partition the image was written to
+    bool pending;                                   //   Whether the new image has yet to boot
+    bool booted;                                    //   Whether the new image was the one that booted
+  };
+  Record last;                                      // The last finished update
+  bool isReceiving;                                 // Whether an update is in progress
+  bool isReady;                                     // Whether an update is waiting for a restart
+  uint32_t bytes;                                   // Bytes of the update in progress written so far
+  unsigned long startMillis;                        // millis() at start()
+  unsigned long lastWriteMillis;                    // millis() at the last write()
+  unsigned long finishedMillis;                     // millis() when finish() succeeded
+  String errorText;                                 // Why the last update failed
+
+  void fail(const char *what);
+  void save();
+};
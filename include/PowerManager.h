@@ -0,0 +1,111 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * PowerManager.h
+ *
+ * Run the CPU flat out only when there's real work to do. Between requests the sketch spends 
+ * nearly all its time waiting, so the PowerManager sets up ESP-IDF power management with dynamic 
+ * frequency scaling: the CPU idles at a low clock (with automatic light sleep when nothing, e.g. 
+ * the WiFi AP, prevents it) and is ramped up to full speed by a power management lock held while 
+ * a CpuBoost object is in scope -- around captures, JPEG work and sending files.
+ *
+ * If the framework was built without CONFIG_PM_ENABLE, boosting falls back to changing the 
+ * clock with setCpuFrequencyMhz().
+ *
+ * There's no way to measure current draw on the board, so energy is estimated from the time 
+ * spent boosted and idle and a nominal power for each. The estimate and the cost of switching 
+ * the clock are reported by toJson().
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include "esp_pm.h"                               // ESP-IDF power management
+
+class PowerManager {
+public:
+  /**
+   * @brief Construct a new PowerManager object
+   *
+   * @param maxMhz      CPU clock while boosted (MHz)
+   * @param minMhz      CPU clock while idle (MHz)
+   * @param boostWatts  Nominal power draw while boosted (W)
+   * @param idleWatts   Nominal power draw while idle (W)
+   */
+  PowerManager(uint16_t maxMhz, uint16_t minMhz, float boostWatts, float idleWatts);
+
+  /**
+   * @brief Set up dynamic frequency scaling and drop to the idle clock
+   *
+   * @param lightSleep  Whether to allow automatic light sleep when idle
+   * @return true       ESP-IDF power management is in use
+   * @return false      It isn't available; setCpuFrequencyMhz() will be used instead
+   */
+  bool begin(bool lightSleep);
+
+  /**
+   * @brief Run at the full clock until the matching relax(). Calls nest. Does nothing until 
+   *        begin() has been called.
+   *
+   */
+  void boost();
+
+  /**
+   * @brief Undo one boost(); the last one lets the clock drop back to idle
+   *
+   */
+  void relax();
+
+  /**
+   * @brief Count a photo taken, for the captures per watt-hour figure
+   *
+   */
+  void countCapture() { captures++; }
+
+  /**
+   * @brief Describe the power state and statistics as a JSON object
+   *
+   */
+  String toJson() const;
+
+private:
+  uint16_t maxMhz;                                  // Boosted CPU clock (MHz)
+  uint16_t minMhz;                                  // Idle CPU clock (MHz)
+  float boostWatts;                                 // Nominal power while boosted (W)
+  float idleWatts;                                  // Nominal power while idle (W)
+  bool active;                                      // Whether begin() has been called
+  bool usePm;                                       // Whether ESP-IDF power management is in use
+  esp_pm_lock_handle_t lock;                        // The CPU frequency lock
+  uint16_t depth;                                   // boost() nesting depth
+  uint64_t startMicros;                             // micros() when begin() was called
+  uint64_t boostStartMicros;                        // micros() when the current boost started
+  uint64_t boostedMicros;                           // Total micros() spent boosted
+  uint32_t boosts;                                  // Number of (outermost) boosts
+  uint32_t switchMicros;                            // Total micros() spent ramping the clock up
+  uint32_t maxSwitchMicros;                         // The longest ramp up
+  uint32_t captures;                                // Photos taken
+};
+
+/**
+ * @brief Boost the CPU clock for as long as the CpuBoost object is in scope
+ *
+ */
+class CpuBoost {
+public:
+  CpuBoost(PowerManager &pm) : pm(pm) { pm.boost(); }
+  ~CpuBoost() { pm.relax(); }
+private:
+  PowerManager &pm;
+};
@@ -0,0 +1,68 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * PreviewFrame.h
+ *
+ * A PreviewFrame is a small grayscale copy of what the camera currently sees. It's made by 
+ * grabbing a frame from the camera and decoding the JPEG at 1/8 scale, which only needs the DC 
+ * coefficient of each 8 x 8 block and so is cheap. For a UXGA frame the result is 200 x 150 
+ * pixels, which is plenty for metering exposure or looking for motion between photos.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+
+class PreviewFrame {
+public:
+  /**
+   * @brief Construct a new, empty, PreviewFrame object
+   *
+   */
+  PreviewFrame();
+
+  /**
+   * @brief Destroy the PreviewFrame object, releasing its buffers
+   *
+   */
+  ~PreviewFrame();
+
+  /**
+   * @brief Grab a frame from the camera and turn it into an 8-bit grayscale preview
+   *
+   * @return true   Success. luma() holds the new preview.
+   * @return false  Capture, allocation or decoding failed. The previous preview, if any, is gone.
+   */
+  bool grab();
+
+  /**
+   * @brief The grayscale pixels of the most recent preview, width() * height() of them
+   *
+   */
+  const uint8_t *luma() const { return y; }
+
+  /**
+   * @brief The size, in pixels, of the most recent preview
+   *
+   */
+  uint16_t width() const { return w; }
+  uint16_t height() const { return h; }
+
+private:
+  uint16_t w;                                       // Preview width (pixels)
+  uint16_t h;                                       // Preview height (pixels)
+  uint8_t *rgb;                                     // Decoded RGB565 preview
+  uint8_t *y;                                       // Grayscale preview
+};
@@ -0,0 +1,106 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Profiler.h
+ *
+ * Lightweight scoped timing using the Xtensa CCOUNT (cycle count) register. Put 
+ *
+ *    PROFILE_SCOPE("name");
+ *
+ * at the top of a function or block and every time the scope is exited its call count, total 
+ * cycles and maximum cycles are updated in a fixed table of PROFILE_MAX_SCOPES entries. Each 
+ * PROFILE_SCOPE finds its table entry once, the first time it runs; after that the overhead is 
+ * two register reads and a few adds. profileToJson() dumps the table.
+ *
+ * Nested scopes (including recursive calls) each count their full time, so totals of nested 
+ * scopes overlap. Counts are cycles, not time: with dynamic frequency scaling, a cycle's length 
+ * depends on the clock at the time.
+ *
+ * Profiling is turned on by building with PROFILE_ENABLE=1, which is what the esp32cam-profile 
+ * environment in platformio.ini does; that build also leaves the CPU clock at its boot-time speed, 
+ * so every cycle is the same length. With it off, as in the production esp32cam environment, 
+ * PROFILE_SCOPE compiles to nothing and there is no table.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+
+#ifndef PROFILE_ENABLE
+#define PROFILE_ENABLE    (0)
+#endif
+
+#define PROFILE_MAX_SCOPES (24)                     // Most distinct scopes that can be profiled
+
+#if PROFILE_ENABLE
+
+// A profile table entry
+struct ProfileSlot {
+  const char *name;                                 // The scope's name
+  uint32_t calls;                                   // Number of times it's been exited
+  uint64_t totalCycles;                             // Total cycles spent in it
+  uint32_t maxCycles;                               // Most cycles spent in it in one call
+};
+
+/**
+ * @brief Find (or make) the table entry for a scope
+ *
+ * @param name    The scope's name; must be a string literal or otherwise never go away
+ * @return        The entry, or nullptr if the table is full
+ */
+ProfileSlot *profileSlot(const char *name);
+
+/**
+ * @brief Zero the counts of all the entries in the table
+ *
+ */
+void profileReset();
+
+/**
+ * @brief Describe the table as a JSON object
+ *
+ */
+String profileToJson();
+
+// Times its lifetime and charges it to a table entry
+class ProfileScope {
+public:
+  ProfileScope(ProfileSlot *slot) : slot(slot), start(ESP.getCycleCount()) {}
+  ~ProfileScope() {
+    uint32_t cycles = ESP.getCycleCount() - start;
+    if (slot != nullptr) {
+      slot->calls++;
+      slot->totalCycles += cycles;
+      if (cycles > slot->maxCycles) {
+        slot->maxCycles = cycles;
+      }
+    }
+  }
+private:
+  ProfileSlot *slot;
+  uint32_t start;
+};
+
+#define PROFILE_CAT2(a, b) a##b
+#define PROFILE_CAT(a, b) PROFILE_CAT2(a, b)
+#define PROFILE_SCOPE(name) \
+  static ProfileSlot *PROFILE_CAT(_profileSlot, __LINE__) = profileSlot(name); \
+  ProfileScope PROFILE_CAT(_profileScope, __LINE__)(PROFILE_CAT(_profileSlot, __LINE__))
+
+#else
+
+#define PROFILE_SCOPE(name) do {} while (0)
+
+#endif
@@ -0,0 +1,115 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * SamplingProfiler.h
+ *
+ * A statistical profiler for finding out where the CPU time goes when the ObscuraCam is busy: 
+ * lwIP, FatFs, String handling, the camera driver or our own code. A hardware timer on each core 
+ * interrupts it at a fixed rate, and the interrupt handler records the program counter (and the 
+ * return address, for one level of call context) of whatever code it interrupted into a ring 
+ * buffer in internal RAM.
+ *
+ * The interrupted code's registers are in the exception frame FreeRTOS saves on the interrupted 
+ * task's stack; the port stores a pointer to that frame in the task's TCB (pxTopOfStack) on 
+ * entry to a non-nested interrupt. Samples taken while another interrupt handler was running are 
+ * therefore charged to the task that handler interrupted.
+ *
+ * Samples are dumped as text, one per line, "<core> <pc> <caller>" with the addresses in hex. 
+ * tools/fold_profile.py symbolizes them against the firmware ELF and turns them into folded 
+ * stacks for flamegraph.pl or speedscope.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+
+class SamplingProfiler {
+public:
+  /**
+   * @brief Construct a new SamplingProfiler object
+   *
+   * @param capacity  The size of the sample ring buffer (samples)
+   */
+  SamplingProfiler(uint16_t capacity);
+
+  /**
+   * @brief Start sampling both cores
+   *
+   * @param hz        Samples per second per core
+   * @param seconds   How long to sample for
+   * @return true     Sampling has started
+   * @return false    It's already running, or the buffer or timers couldn't be set up
+   */
+  bool start(uint16_t hz, uint16_t seconds);
+
+  /**
+   * @brief Stop sampling if it's been running long enough. Call this from loop().
+   *
+   */
+  void poll();
+
+  /**
+   * @brief Stop sampling now
+   *
+   */
+  void stop();
+
+  /**
+   * @brief Whether sampling is in progress
+   *
+   */
+  bool running() const { return isRunning; }
+
+  /**
+   * @brief The number of samples held (at most the capacity; older ones are overwritten)
+   *
+   */
+  uint32_t samples() const { uint32_t n = taken; return n < capacity ? n : capacity; }
+
+  /**
+   * @brief Format up to maxLines of the held samples, oldest first, starting with sample first
+   *
+   * @param first     The index of the first sample to format
+   * @param maxLines  The most samples to format
+   * @return          The samples as text, one per line
+   */
+  String format(uint32_t first, uint16_t maxLines) const;
+
+  /**
+   * @brief Describe the profiler's state as a JSON object
+   *
+   */
+  String toJson() const;
+
+private:
+  struct Sample {                                   // A sample
+    uint32_t pc;                                    //   Interrupted PC; bit 31 is the core
+    uint32_t caller;                                //   Its return address
+  };
+
+  uint16_t capacity;                                // Ring buffer size (samples)
+  Sample *ring;                                     // The ring buffer
+  volatile uint32_t taken;                          // Samples taken since start()
+  bool isRunning;                                   // Whether sampling is in progress
+  uint16_t hz;                                      // Samples per second per core
+  uint16_t seconds;                                 // How long to sample
+  unsigned long startMillis;                        // millis() when sampling started
+  hw_timer_t *timers[2];                            // The sampling timer for each core
+
+  static SamplingProfiler *active;                  // The profiler the ISR records for
+  static void IRAM_ATTR onTimer();
+  static void timerTask(void *param);
+  bool runOnCore(uint8_t core, bool attach);
+};
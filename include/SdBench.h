@@ -0,0 +1,96 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * SdBench.h
+ *
+ * An SD card benchmark, run as a background Job, for qualifying cards on the actual hardware 
+ * with the actual SD_MMC settings. It measures, in order:
+ *
+ *    - Sequential write and then read of a scratch file at each of several chunk sizes
+ *    - Random 4 KB reads from the scratch file
+ *    - Creating and then deleting a number of small files in a given directory (e.g., the photo 
+ *      directory, since how full a directory is affects how fast files can be made in it)
+ *
+ * Only the time spent in file system calls is counted, so serving requests between steps 
+ * doesn't distort the figures. Sequential write times include closing the file, so the data 
+ * are really on the card. The scratch and test files are removed when the benchmark finishes.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include "FS.h"                                   // File system
+#include "Job.h"                                  // Background jobs
+#include "DiskUsage.h"                            // Per-directory space used
+
+#define SB_CHUNK_SIZES    (4)                       // Number of chunk sizes tested
+#define SB_MAX_CHUNK      (32768)                   // The largest chunk size (bytes)
+#define SB_RANDOM_BYTES   (4096)                    // Size of a random read (bytes)
+#define SB_RANDOM_READS   (256)                     // Number of random reads
+#define SB_STEP_MICROS    (20000)                   // About how long each step() may take (micros())
+
+class SdBench : public Job {
+public:
+  /**
+   * @brief Construct a new SdBench object
+   *
+   * @param fs          The file system to benchmark
+   * @param diskUsage   The space used totals to report the scratch files to
+   * @param scratchPath The path of the scratch file to use
+   * @param dirPath     The directory, ending in "/", to create and delete files in
+   * @param fileBytes   The size of the scratch file (bytes)
+   * @param files       The number of files to create and delete
+   */
+  SdBench(fs::FS &fs, DiskUsage &diskUsage, const String &scratchPath, const String &dirPath, 
+          uint32_t fileBytes, uint16_t files);
+  ~SdBench();
+
+  const char *name() const override { return "sdBench"; }
+  bool step() override;
+  String toJson() const override;
+
+private:
+  enum Phase : uint8_t {                            // What the benchmark is doing
+    SB_WRITE, SB_READ, SB_RANDOM, SB_CREATE, SB_DELETE, SB_DONE, SB_FAILED
+  };
+
+  fs::FS &fs;                                       // The file system being benchmarked
+  DiskUsage &diskUsage;                             // The space used totals
+  String scratchPath;                               // The scratch file's path
+  String dirPath;                                   // Where to create and delete files
+  uint32_t fileBytes;                               // Scratch file size (bytes)
+  uint16_t files;                                   // Files to create and delete
+  uint32_t scratchCounted;                          // Bytes of scratch file reported to diskUsage
+  Phase phase;                                      // What we're doing
+  uint8_t chunkIx;                                  // Index of the chunk size being tested
+  File file;                                        // The open scratch file, if any
+  uint8_t *buf;                                     // I/O buffer, SB_MAX_CHUNK bytes
+  uint32_t writeBytes[SB_CHUNK_SIZES];              // Bytes written at each chunk size
+  uint64_t writeMicros[SB_CHUNK_SIZES];             //   and the time it took
+  uint32_t readBytes[SB_CHUNK_SIZES];               // Bytes read at each chunk size
+  uint64_t readMicros[SB_CHUNK_SIZES];              //   and the time it took
+  uint16_t randomReads;                             // Random reads done
+  uint64_t randomMicros;                            //   and the time they took
+  uint16_t created;                                 // Files created
+  uint64_t createMicros;                            //   and the time it took
+  uint16_t deleted;                                 // Files deleted
+  uint64_t deleteMicros;                            //   and the time it took
+  const char *error;                                // Why the benchmark failed, if it did
+
+  static const uint16_t chunkSizes[SB_CHUNK_SIZES];
+  String testFilePath(uint16_t n) const;
+  bool fail(const char *why);
+  void removeScratch();
+};
@@ -0,0 +1,154 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Timelapse.h
+ *
+ * A Timelapse object schedules and stores a timelapse sequence: a frame every so many 
+ * milliseconds, for a given number of frames (or until stopped). It doesn't take the photos 
+ * itself; the sketch asks due() and hands it each frame with addFrame().
+ *
+ * Writing to the SD card is the most expensive part of each frame, so frames are collected in a 
+ * PSRAM batch buffer and written out several at a time with one large write. The frames of a 
+ * sequence all go into one MJPEG AVI file, TLn.avi, which plays as a video or can be downloaded 
+ * in one go. Alongside it is a compact binary index, TLn.idx, that says where in the AVI each 
+ * frame's JPEG data is and when it was taken:
+ *
+ *    Header (8 bytes):         "TLI1", uint32_t intervalMillis
+ *    One entry per frame:      uint32_t offset, uint32_t length, uint32_t millis since start
+ *
+ * All values are little-endian. The index is written as each batch is, so everything up to the 
+ * last completed batch survives a power failure, and AviWriter::recover() can make the AVI 
+ * playable again.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include "FS.h"                                   // File system
+#include "AviWriter.h"                            // MJPEG AVI assembly
+#include "DiskUsage.h"                            // Per-directory space used
+
+#define TL_MAGIC          "TLI1"                    // Timelapse index file magic number
+
+class Timelapse {
+public:
+  /**
+   * @brief Construct a new Timelapse object
+   *
+   * @param fs            The file system to store sequences in
+   * @param diskUsage     The space used totals to report the sequences' growth to
+   * @param dir           The directory to store them in; must end with "/"
+   * @param batchBytes    The size of the batch buffer
+   * @param batchFrames   The most frames to collect before writing them out
+   * @param maxFrames     The most frames a sequence may have
+   */
+  Timelapse(fs::FS &fs, DiskUsage &diskUsage, const char *dir, size_t batchBytes, 
+            uint8_t batchFrames, uint32_t maxFrames);
+
+  /**
+   * @brief Destroy the Timelapse object, stopping any sequence in progress
+   *
+   */
+  ~Timelapse();
+
+  /**
+   * @brief Start a new sequence
+   *
+   * @param intervalMillis  millis() between frames
+   * @param count           Number of frames to take; 0 means until stop() is called (or there are 
+   *                        maxFrames of them)
+   * @param width           The width of the frames (pixels)
+   * @param height          Their height (pixels)
+   * @param fps             The frame rate at which the AVI should play back
+   * @return true           Success
+   * @return false          Couldn't allocate the batch buffer or create the files
+   */
+  bool start(uint32_t intervalMillis, uint32_t count, uint16_t width, uint16_t height, uint8_t fps);
+
+  /**
+   * @brief Stop the sequence in progress, writing out any frames still in the batch buffer
+   *
+   */
+  void stop();
+
+  /**
+   * @brief Whether a sequence is in progress
+   *
+   */
+  bool running() const { return isRunning; }
+
+  /**
+   * @brief Whether it's time for the next frame
+   *
+   */
+  bool due() const;
+
+  /**
+   * @brief The number of millis() until the next frame is due (0 if it's due now)
+   *
+   */
+  uint32_t millisToNext() const;
+
+  /**
+   * @brief Add a frame to the sequence. Stops the sequence once count frames have been added.
+   *
+   * @param jpg     The JPEG image
+   * @param len     Its length (bytes)
+   * @return true   Success
+   * @return false  Writing to the SD card failed; the sequence has been stopped
+   */
+  bool addFrame(const uint8_t *jpg, size_t len);
+
+  /**
+   * @brief Describe the state of the sequence as a JSON object
+   *
+   */
+  String toJson() const;
+
+private:
+  struct IndexEntry {                               // An index file entry
+    uint32_t offset;                                //   Offset of the frame's JPEG in the AVI file
+    uint32_t length;                                //   Its length (bytes)
+    uint32_t millis;                                //   millis() since the sequence started
+  };
+
+  fs::FS &fs;                                       // Where the sequences are stored
+  DiskUsage &diskUsage;                             // The space used totals
+  String dir;                                       // The directory they're stored in
+  String name;                                      // The current sequence's name (e.g. "TL3")
+  size_t batchBytes;                                // Size of the batch buffer
+  uint8_t batchFrames;                              // Most frames in a batch
+  uint32_t maxFrames;                               // Most frames in a sequence
+  uint8_t *batch;                                   // The batch buffer, frames laid out as AVI chunks
+  size_t batchUsed;                                 // Bytes of it in use
+  IndexEntry *batchIndex;                           // Index entries for the frames in the batch
+  uint8_t batchCount;                               // Number of frames in the batch
+  AviWriter avi;                                    // The AVI file
+  File index;                                       // The index file
+  bool isRunning;                                   // Whether a sequence is in progress
+  uint32_t interval;                                // millis() between frames
+  uint32_t count;                                   // Frames to take; 0 for no limit
+  uint32_t taken;                                   // Frames taken so far
+  uint32_t dataBytes;                               // Bytes in the AVI file, written or batched
+  unsigned long startMillis;                        // millis() when the sequence started
+  unsigned long nextMillis;                         // millis() when the next frame is due
+  uint32_t flushes;                                 // Batches written
+  uint32_t flushMicros;                             // Total micros() spent writing them
+  uint32_t aviCounted;                              // Bytes of the AVI file reported to diskUsage
+  uint32_t idxCounted;                              // Bytes of the index file reported to diskUsage
+
+  bool flush();
+  void grew(const char *ext, uint32_t &counted, uint32_t bytes);
+};
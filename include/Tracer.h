@@ -0,0 +1,111 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Tracer.h
+ *
+ * An event tracer for seeing what overlaps what: a photo download stalling a snap, say, or a 
+ * timelapse batch write holding up a page. Put
+ *
+ *    TRACE_SCOPE("name");
+ *
+ * at the top of a function or block, or bracket a stretch of code with traceBegin("name") and 
+ * traceEnd("name"), and a begin and an end event, each with a microsecond timestamp and the 
+ * calling task, are added to a ring buffer of TRACE_EVENTS entries. When the ring is full, the 
+ * oldest events are overwritten. 
+ *
+ * The events are exported in the Chrome Trace Event format: a "traceEvents" array of "B" and "E" 
+ * events with "M" (metadata) events naming the tasks. Perfetto (ui.perfetto.dev) and 
+ * chrome://tracing both read it.
+ *
+ * Like PROFILE_SCOPE, tracing is only compiled in when building with PROFILE_ENABLE=1.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include "Profiler.h"                             // PROFILE_ENABLE
+
+#define TRACE_EVENTS      (2048)                    // Events held in the ring buffer (12 bytes each, PSRAM)
+#define TRACE_MAX_TASKS   (12)                      // Most distinct tasks told apart in the trace
+
+#if PROFILE_ENABLE
+
+/**
+ * @brief Allocate the ring buffer and start tracing. Until this is called, events are ignored.
+ *
+ * @return true   Success
+ * @return false  Couldn't allocate the ring buffer
+ */
+bool traceInit();
+
+/**
+ * @brief Record the beginning or end of a span on the calling task
+ *
+ * @param name    The span's name; must be a string literal or otherwise never go away
+ */
+void traceBegin(const char *name);
+void traceEnd(const char *name);
+
+/**
+ * @brief Turn recording on or off. Exporting the trace turns it off so the export doesn't trace 
+ *        itself into the ring it's reading.
+ *
+ */
+void traceEnable(bool on);
+
+/**
+ * @brief Discard all the recorded events
+ *
+ */
+void traceClear();
+
+/**
+ * @brief The number of events held
+ *
+ */
+uint16_t traceCount();
+
+/**
+ * @brief Format the trace's metadata events (process and task names) as JSON objects, each 
+ *        preceded by a comma except the first
+ *
+ */
+String traceMetadataJson();
+
+/**
+ * @brief Format up to count of the held events, oldest first, starting with event first, as 
+ *        JSON objects, each preceded by a comma
+ *
+ */
+String traceEventsJson(uint16_t first, uint16_t count);
+
+// Traces its lifetime as a span
+class TraceScope {
+public:
+  TraceScope(const char *name) : name(name) { traceBegin(name); }
+  ~TraceScope() { traceEnd(name); }
+private:
+  const char *name;
+};
+
+#define TRACE_SCOPE(name) TraceScope PROFILE_CAT(_traceScope, __LINE__)(name)
+
+#else
+
+#define TRACE_SCOPE(name) do {} while (0)
+#define traceBegin(name) do {} while (0)
+#define traceEnd(name) do {} while (0)
+
+#endif
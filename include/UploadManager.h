@@ -0,0 +1,148 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * UploadManager.h
+ *
+ * The state of the upload in progress, and the buffered writer that puts it on the SD card. 
+ * Rather than pass each small piece of the body straight to the SD card, data are copied into a 
+ * PSRAM buffer, which is written out in one large write when it fills and when the upload ends.
+ * 
+ * The WebServer handles one request at a time, start to finish, so only one upload is ever in 
+ * progress: a second client's upload waits in the TCP backlog until the first is done. The 
+ * upload is identified by the client's address and port, so the pieces of the body are only 
+ * ever added to the upload they belong to, and an upload whose connection went away without 
+ * the server noticing is abandoned when the next one starts.
+ *
+ * The statistics (see toJson()) include the throughput: total bytes received over the time 
+ * during which an upload was in progress.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include "FS.h"                                   // File system
+
+struct UploadKey {                                  // What identifies an upload
+  uint32_t ip;                                      //   The client's IP address
+  uint16_t port;                                    //   And its port
+  bool operator==(const UploadKey &other) const { return ip == other.ip && port == other.port; }
+};
+
+class UploadManager {
+public:
+  /**
+   * @brief Construct a new UploadManager object
+   *
+   * @param fs          The file system uploads are written to
+   * @param bufferBytes The size of the buffer (bytes)
+   */
+  UploadManager(fs::FS &fs, size_t bufferBytes);
+  ~UploadManager();
+
+  /**
+   * @brief Allocate the buffer
+   *
+   * @return true   Success
+   * @return false  Couldn't allocate it
+   */
+  bool begin();
+
+  /**
+   * @brief Start an upload, abandoning any upload still in progress
+   *
+   * @param key     What identifies the upload
+   * @param path    The path of the file to write
+   * @param mode    The mode to open it with, FILE_WRITE or FILE_APPEND
+   * @return true   Success
+   * @return false  There's no buffer or the file can't be opened
+   */
+  bool open(const UploadKey &key, const String &path, const char *mode = FILE_WRITE);
+
+  /**
+   * @brief Whether the upload in progress, if any, is the one with the given key
+   *
+   */
+  bool isOpen(const UploadKey &key) const { return inUse && key == current; }
+
+  /**
+   * @brief Add data to the upload in progress
+   *
+   * @param data    The data
+   * @param len     Its length (bytes)
+   * @return true   Success
+   * @return false  Writing to the file failed
+   */
+  bool write(const uint8_t *data, size_t len);
+
+  /**
+   * @brief Finish the upload: write out what's buffered and close the file
+   *
+   * @return true   Success
+   * @return false  Writing to the file failed
+   */
+  bool close();
+
+  /**
+   * @brief Abandon the upload, closing the file and removing it
+   *
+   */
+  void abort();
+
+  /**
+   * @brief The number of bytes received for the upload so far, buffered or written
+   *
+   */
+  uint32_t received() const { return nReceived; }
+
+  /**
+   * @brief How long, in micros(), the upload has been in progress
+   *
+   */
+  uint32_t elapsed() const { return micros() - startMicros; }
+
+  /**
+   * @brief The path of the upload's file
+   *
+   */
+  const String &path() const { return filePath; }
+
+  /**
+   * @brief Describe the upload in progress and the statistics as a JSON object
+   *
+   */
+  String toJson() const;
+
+private:
+  fs::FS &fs;                                       // Where uploads go
+  size_t bufferBytes;                               // Size of buf
+  uint8_t *buf;                                     // Data not yet written
+  size_t used;                                      // Bytes of buf in use
+  bool inUse;                                       // Whether an upload is in progress
+  UploadKey current;                                // What identifies it
+  String filePath;                                  // Its file's path
+  File file;                                        // The open file
+  uint32_t nReceived;                               // Bytes received so far
+  unsigned long startMicros;                        // micros() when it started
+  uint64_t activeMicros;                            // Total micros() of completed or abandoned uploads
+  uint32_t uploads;                                 // Uploads completed
+  uint64_t bytes;                                   // Bytes received by completed uploads
+  uint32_t failures;                                // Uploads abandoned or failed
+  uint32_t flushes;                                 // Buffer writes done
+  uint64_t flushBytes;                              // Bytes they wrote
+  uint64_t flushMicros;                             // micros() they took
+
+  bool flush();
+  void release();
+};
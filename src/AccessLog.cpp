@@ -0,0 +1,170 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * AccessLog.cpp
+ *
+ * Implementation of the AccessLog class. See AccessLog.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "AccessLog.h"
+#include "Tracer.h"                               // TRACE_SCOPE()
+#include "esp_log.h"                              // log_?() support
+
+#define AL_MAGIC          "OCAL"                    // Log file header magic number
+
+AccessLog::AccessLog(fs::FS &fs, DiskUsage &diskUsage, const char *path, uint16_t capacity, 
+                     uint16_t batch, unsigned long idleMillis, uint32_t maxBytes) :
+  fs(fs), diskUsage(diskUsage), path(path), capacity(capacity), batch(batch), idleMillis(idleMillis), maxBytes(maxBytes),
+  ring(nullptr), added(0), written(0), dropped(0), lastMillis(0), flushes(0), flushMicros(0) {
+}
+
+bool AccessLog::begin() {
+  if (ring == nullptr) {
+    ring = (AccessEntry *)ps_malloc(sizeof(AccessEntry) * capacity);
+    if (ring == nullptr) {
+      log_e("Unable to allocate %d bytes for the access log.", sizeof(AccessEntry) * capacity);
+      return false;
+    }
+  }
+  add(0, AL_BOOT, "", 0, 0, 0);
+  return true;
+}
+
+void AccessLog::add(uint32_t ip, uint8_t method, const String &uri, uint16_t status, 
+                    uint32_t bytes, uint32_t micros) {
+  if (ring == nullptr) {
+    return;
+  }
+  if (waiting() == capacity) {
+    written++;
+    dropped++;
+  }
+  AccessEntry &e = ring[added++ % capacity];
+  e.millis = lastMillis = millis();
+  e.ip = ip;
+  e.bytes = bytes;
+  e.micros = micros;
+  e.status = status;
+  e.method = method;
+  e.uriLen = uri.length() > 255 ? 255 : uri.length();
+  size_t from = uri.length() > AL_URI_BYTES ? uri.length() - AL_URI_BYTES : 0;
+  memset(e.uri, 0, AL_URI_BYTES);
+  memcpy(e.uri, uri.c_str() + from, uri.length() - from);
+}
+
+void AccessLog::poll() {
+  uint16_t n = waiting();
+  if (n == 0) {
+    return;
+  }
+  if ((n >= batch && millis() - lastMillis >= idleMillis) || n >= capacity - capacity / 8) {
+    flush();
+  }
+}
+
+bool AccessLog::openLog(File &file) {
+  String p = path;
+  String dir = p.substring(0, p.lastIndexOf('/'));
+  if (dir.length() > 0 && !fs.exists(dir)) {
+    fs.mkdir(dir);
+  }
+  if (fs.exists(p)) {
+    File f = fs.open(p, FILE_READ);
+    size_t size = f.size();
+    f.close();
+    if (size + sizeof(AccessEntry) * waiting() > maxBytes) {
+      String old = p.substring(0, p.lastIndexOf('.')) + ".old";
+      if (fs.exists(old)) {
+        f = fs.open(old, FILE_READ);
+        size_t oldSize = f.size();
+        f.close();
+        if (fs.remove(old)) {
+          diskUsage.add(old, -(int64_t)oldSize, -1);
+        }
+      }
+      if (fs.rename(p, old)) {
+        diskUsage.add(p, -(int64_t)size, -1);
+        diskUsage.add(old, size, 1);
+      }
+    }
+  }
+  bool fresh = !fs.exists(p);
+  file = fs.open(p, FILE_APPEND);
+  if (!file) {
+    return false;
+  }
+  if (fresh) {
+    uint8_t header[8] = {AL_MAGIC[0], AL_MAGIC[1], AL_MAGIC[2], AL_MAGIC[3], 
+      AL_VERSION & 0xFF, AL_VERSION >> 8, sizeof(AccessEntry) & 0xFF, sizeof(AccessEntry) >> 8};
+    bool ok = file.write(header, sizeof(header)) == sizeof(header);
+    diskUsage.add(p, ok ? sizeof(header) : 0, 1);
+    if (!ok) {
+      file.close();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool AccessLog::flush() {
+  uint16_t n = waiting();
+  if (ring == nullptr || n == 0) {
+    return true;
+  }
+  TRACE_SCOPE("sdWrite");
+  unsigned long startMicros = micros();
+  File file;
+  if (!openLog(file)) {
+    log_w("Unable to open access log \"%s\".", path);
+    return false;
+  }
+
+  // The waiting entries are contiguous in the ring except when they wrap around its end
+  uint16_t first = written % capacity;
+  uint16_t run = min((uint16_t)(capacity - first), n);
+  bool ok = file.write((const uint8_t *)&ring[first], sizeof(AccessEntry) * run) == sizeof(AccessEntry) * run;
+  if (ok && run < n) {
+    ok = file.write((const uint8_t *)ring, sizeof(AccessEntry) * (n - run)) == sizeof(AccessEntry) * (n - run);
+  }
+  file.close();
+  if (!ok) {
+    log_w("Unable to write access log \"%s\".", path);
+    return false;
+  }
+  diskUsage.add(path, sizeof(AccessEntry) * n, 0);
+  written += n;
+  flushes++;
+  flushMicros += micros() - startMicros;
+  log_d("Wrote %d access log entries in %lu us.", n, micros() - startMicros);
+  return true;
+}
+
+String AccessLog::toJson() const {
+  String json = "{\"path\":\"";
+  json += path;
+  json += "\",\"logged\":";
+  json += added;
+  json += ",\"waiting\":";
+  json += waiting();
+  json += ",\"dropped\":";
+  json += dropped;
+  json += ",\"flushes\":";
+  json += flushes;
+  json += ",\"meanFlushMicros\":";
+  json += flushes == 0 ? 0 : flushMicros / flushes;
+  json += "}";
+  return json;
+}
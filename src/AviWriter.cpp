@@ -0,0 +1,283 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * AviWriter.cpp
+ *
+ * Implementation of the AviWriter class. See AviWriter.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "AviWriter.h"
+#include "esp_log.h"                              // log_?() support
+
+// Offsets of the header fields that are filled in when the file is finalized
+#define AVI_RIFF_SIZE     (4)                       // RIFF chunk size
+#define AVI_TOTAL_FRAMES  (48)                      // avih dwTotalFrames
+#define AVI_MAX_BPS       (36)                      // avih dwMaxBytesPerSec
+#define AVI_AVIH_BUFSIZE  (60)                      // avih dwSuggestedBufferSize
+#define AVI_STRH_LENGTH   (140)                     // strh dwLength
+#define AVI_STRH_BUFSIZE  (144)                     // strh dwSuggestedBufferSize
+#define AVI_MOVI_SIZE     (216)                     // movi LIST size
+#define AVI_MOVI_FOURCC   (220)                     // Where idx1 offsets are measured from
+#define AVIF_HASINDEX     (0x10)                    // avih flag: there's an idx1 chunk
+#define AVIIF_KEYFRAME    (0x10)                    // idx1 flag: the frame is a key frame
+
+namespace {
+
+void put32(uint8_t *p, uint32_t v) {
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+void put16(uint8_t *p, uint16_t v) {
+  p[0] = v; p[1] = v >> 8;
+}
+
+uint32_t get32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool patch32(File &f, uint32_t offset, uint32_t v) {
+  uint8_t b[4];
+  put32(b, v);
+  return f.seek(offset) && f.write(b, 4) == 4;
+}
+
+} // namespace
+
+AviWriter::AviWriter() : index(nullptr), maxFrames(0), nFrames(0), fileBytes(0), largest(0), 
+  usPerFrame(1) {
+}
+
+AviWriter::~AviWriter() {
+  close();
+}
+
+bool AviWriter::open(fs::FS &fs, const String &path, uint16_t width, uint16_t height, uint8_t fps, 
+                     uint32_t frameLimit) {
+  close();
+  index = (IndexEntry *)ps_malloc(sizeof(IndexEntry) * frameLimit);
+  if (index == nullptr) {
+    log_e("Unable to allocate an AVI index for %d frames.", frameLimit);
+    return false;
+  }
+  file = fs.open(path, FILE_WRITE);
+  if (!file) {
+    log_e("Unable to create \"%s\".", path.c_str());
+    free(index);
+    index = nullptr;
+    return false;
+  }
+
+  // Lay out the headers; the counts and sizes are filled in by finalize()
+  uint8_t h[AVI_HEADER_BYTES];
+  memset(h, 0, sizeof(h));
+  memcpy(h, "RIFF", 4);
+  memcpy(h + 8, "AVI LIST", 8);
+  put32(h + 16, 192);                               // hdrl LIST size
+  memcpy(h + 20, "hdrlavih", 8);
+  put32(h + 28, 56);
+  usPerFrame = 1000000UL / (fps == 0 ? 1 : fps);
+  put32(h + 32, usPerFrame);                        // dwMicroSecPerFrame
+  put32(h + 44, AVIF_HASINDEX);                     // dwFlags
+  put32(h + 56, 1);                                 // dwStreams
+  put32(h + 64, width);
+  put32(h + 68, height);
+  memcpy(h + 88, "LIST", 4);
+  put32(h + 92, 116);                               // strl LIST size
+  memcpy(h + 96, "strlstrh", 8);
+  put32(h + 104, 56);
+  memcpy(h + 108, "vidsMJPG", 8);                   // fccType, fccHandler
+  put32(h + 128, 1);                                // dwScale
+  put32(h + 132, fps);                              // dwRate
+  put32(h + 148, 0xFFFFFFFF);                       // dwQuality: default
+  put16(h + 160, width);                            // rcFrame right
+  put16(h + 162, height);                           // rcFrame bottom
+  memcpy(h + 164, "strf", 4);
+  put32(h + 168, 40);
+  put32(h + 172, 40);                               // biSize
+  put32(h + 176, width);
+  put32(h + 180, height);
+  put16(h + 184, 1);                                // biPlanes
+  put16(h + 186, 24);                               // biBitCount
+  memcpy(h + 188, "MJPG", 4);                       // biCompression
+  put32(h + 192, (uint32_t)width * height * 3);     // biSizeImage
+  memcpy(h + 212, "LIST", 4);
+  memcpy(h + 220, "movi", 4);
+  if (file.write(h, sizeof(h)) != sizeof(h)) {
+    log_e("Unable to write the AVI headers.");
+    file.close();
+    free(index);
+    index = nullptr;
+    return false;
+  }
+  file.flush();                                     // So recover() finds the headers after a reset
+
+  maxFrames = frameLimit;
+  nFrames = 0;
+  largest = 0;
+  fileBytes = AVI_HEADER_BYTES;
+  return true;
+}
+
+void AviWriter::formatChunk(uint8_t *dst, const uint8_t *jpg, size_t len) {
+  memcpy(dst, "00dc", 4);
+  put32(dst + 4, len);
+  memcpy(dst + AVI_CHUNK_HEADER, jpg, len);
+  if (len & 1) {
+    dst[AVI_CHUNK_HEADER + len] = 0;
+  }
+}
+
+bool AviWriter::addFrame(const uint8_t *jpg, size_t len) {
+  if (index == nullptr || nFrames >= maxFrames) {
+    return false;
+  }
+  uint8_t h[AVI_CHUNK_HEADER] = {'0', '0', 'd', 'c'};
+  put32(h + 4, len);
+  uint8_t pad = 0;
+  if (file.write(h, sizeof(h)) != sizeof(h) || file.write(jpg, len) != len || 
+      ((len & 1) && file.write(&pad, 1) != 1)) {
+    log_e("AVI frame write failed.");
+    return false;
+  }
+  file.flush();                                     // FatFs only updates the file's size on a sync
+  index[nFrames++] = {fileBytes - AVI_MOVI_FOURCC, (uint32_t)len};
+  largest = max(largest, (uint32_t)len);
+  fileBytes += chunkSize(len);
+  return true;
+}
+
+bool AviWriter::addChunks(const uint8_t *chunks, size_t len) {
+  if (index == nullptr) {
+    return false;
+  }
+
+  // Index the chunks first, so nothing is written if they're malformed or won't fit
+  uint32_t n = nFrames;
+  uint32_t big = largest;
+  for (size_t pos = 0; pos < len; ) {
+    if (pos + AVI_CHUNK_HEADER > len || n >= maxFrames) {
+      log_e("AVI chunks are malformed or won't fit.");
+      return false;
+    }
+    uint32_t frameLen = get32(chunks + pos + 4);
+    if (memcmp(chunks + pos, "00dc", 4) != 0 || pos + chunkSize(frameLen) > len) {
+      log_e("AVI chunks are malformed or won't fit.");
+      return false;
+    }
+    index[n++] = {(uint32_t)(fileBytes + pos - AVI_MOVI_FOURCC), frameLen};
+    big = max(big, frameLen);
+    pos += chunkSize(frameLen);
+  }
+  if (file.write(chunks, len) != len) {
+    log_e("AVI chunk write failed.");
+    return false;
+  }
+  file.flush();
+  nFrames = n;
+  largest = big;
+  fileBytes += len;
+  return true;
+}
+
+bool AviWriter::close() {
+  if (index == nullptr) {
+    return true;
+  }
+  bool ok = finalize(file, fileBytes, index, nFrames, largest, usPerFrame);
+  file.close();
+  free(index);
+  index = nullptr;
+  return ok;
+}
+
+bool AviWriter::finalize(File &file, uint32_t moviEnd, const IndexEntry *index, uint32_t nFrames, 
+                         uint32_t largest, uint32_t usPerFrame) {
+  // Append idx1, a bufferful of entries at a time
+  uint8_t buf[16 * 32];
+  memcpy(buf, "idx1", 4);
+  put32(buf + 4, nFrames * 16);
+  bool ok = file.seek(moviEnd) && file.write(buf, 8) == 8;
+  for (uint32_t i = 0; i < nFrames && ok; ) {
+    uint32_t n = 0;
+    for (; n < 32 && i < nFrames; n++, i++) {
+      memcpy(buf + 16 * n, "00dc", 4);
+      put32(buf + 16 * n + 4, AVIIF_KEYFRAME);
+      put32(buf + 16 * n + 8, index[i].offset);
+      put32(buf + 16 * n + 12, index[i].length);
+    }
+    ok = file.write(buf, 16 * n) == 16 * n;
+  }
+
+  // Patch the header fields that depend on the contents
+  uint32_t fileEnd = moviEnd + 8 + nFrames * 16;
+  ok = ok && patch32(file, AVI_RIFF_SIZE, fileEnd - 8);
+  ok = ok && patch32(file, AVI_TOTAL_FRAMES, nFrames);
+  ok = ok && patch32(file, AVI_AVIH_BUFSIZE, largest);
+  ok = ok && patch32(file, AVI_STRH_LENGTH, nFrames);
+  ok = ok && patch32(file, AVI_STRH_BUFSIZE, largest);
+  ok = ok && patch32(file, AVI_MOVI_SIZE, moviEnd - AVI_MOVI_FOURCC);
+  ok = ok && patch32(file, AVI_MAX_BPS, (uint32_t)((uint64_t)largest * 1000000ULL / usPerFrame));
+  file.flush();
+  if (!ok) {
+    log_e("Unable to finalize the AVI file.");
+  }
+  return ok;
+}
+
+bool AviWriter::recover(fs::FS &fs, const String &path) {
+  File f = fs.open(path, "r+");
+  if (!f) {
+    return false;
+  }
+  uint8_t h[AVI_HEADER_BYTES];
+  uint32_t fileLen = f.size();
+  if (f.read(h, sizeof(h)) != sizeof(h) || memcmp(h, "RIFF", 4) != 0 || 
+      memcmp(h + 8, "AVI ", 4) != 0 || memcmp(h + 220, "movi", 4) != 0 || get32(h + 4) != 0) {
+    // Not one of ours, or it was finalized
+    f.close();
+    return false;
+  }
+
+  // Count the complete chunks, then walk them again to build the index
+  uint32_t nFrames = 0;
+  uint32_t pos = AVI_HEADER_BYTES;
+  uint8_t ch[AVI_CHUNK_HEADER];
+  while (pos + AVI_CHUNK_HEADER <= fileLen && f.seek(pos) && f.read(ch, sizeof(ch)) == sizeof(ch) &&
+         memcmp(ch, "00dc", 4) == 0 && pos + chunkSize(get32(ch + 4)) <= fileLen) {
+    nFrames++;
+    pos += chunkSize(get32(ch + 4));
+  }
+  IndexEntry *index = (IndexEntry *)ps_malloc(sizeof(IndexEntry) * (nFrames == 0 ? 1 : nFrames));
+  if (index == nullptr) {
+    log_e("Unable to allocate an index to recover \"%s\".", path.c_str());
+    f.close();
+    return false;
+  }
+  uint32_t largest = 0;
+  pos = AVI_HEADER_BYTES;
+  for (uint32_t i = 0; i < nFrames; i++) {
+    f.seek(pos);
+    f.read(ch, sizeof(ch));
+    index[i] = {pos - AVI_MOVI_FOURCC, get32(ch + 4)};
+    largest = max(largest, index[i].length);
+    pos += chunkSize(index[i].length);
+  }
+  bool ok = finalize(f, pos, index, nFrames, largest, max(get32(h + 32), (uint32_t)1));
+  free(index);
+  f.close();
+  log_i("Recovered %d frames of \"%s\".", nFrames, path.c_str());
+  return ok;
+}
@@ -0,0 +1,431 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * BatchJob.cpp
+ *
+ * Implementation of the BatchJob class. See BatchJob.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "BatchJob.h"
+#include "Config.h"                               // jsonString()
+#include "esp_log.h"                              // log_?() support
+#include <algorithm>
+
+static const char *const opNames[] = {"mkdir", "copy", "move", "delete"};
+
+/**
+ * @brief Skip the white space in s starting at i
+ *
+ */
+static void skipSpace(const String &s, size_t &i) {
+  while (i < s.length() && isspace(s[i])) {
+    i++;
+  }
+}
+
+/**
+ * @brief Parse the JSON string in s starting at i, leaving i just past it
+ *
+ * @return true   Success; out is the string's value
+ * @return false  There's no well-formed string at i
+ */
+static bool parseString(const String &s, size_t &i, String &out) {
+  out = "";
+  if (i >= s.length() || s[i] != '"') {
+    return false;
+  }
+  for (i++; i < s.length(); i++) {
+    char c = s[i];
+    if (c == '"') {
+      i++;
+      return true;
+    }
+    if (c != '\\') {
+      out += c;
+      continue;
+    }
+    if (++i >= s.length()) {
+      return false;
+    }
+    c = s[i];
+    if (c == 'u') {
+      if (i + 4 >= s.length()) {
+        return false;
+      }
+      uint32_t u = strtoul(s.substring(i + 1, i + 5).c_str(), nullptr, 16);
+      if (u < 0x80) {
+        out += (char)u;
+      } else if (u < 0x800) {
+        out += (char)(0xC0 | (u >> 6));
+        out += (char)(0x80 | (u & 0x3F));
+      } else {
+        out += (char)(0xE0 | (u >> 12));
+        out += (char)(0x80 | ((u >> 6) & 0x3F));
+        out += (char)(0x80 | (u & 0x3F));
+      }
+      i += 4;
+    } else {
+      const char *from = "\"\\/bfnrt";
+      const char *to = "\"\\/\b\f\n\r\t";
+      const char *p = strchr(from, c);
+      if (p == nullptr || c == '\0') {
+        return false;
+      }
+      out += to[p - from];
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief The directory part of a path
+ *
+ */
+static String parentOf(const String &path) {
+  int slash = path.lastIndexOf('/');
+  return slash <= 0 ? String("/") : path.substring(0, slash);
+}
+
+/**
+ * @brief Whether one of the paths is the other or is inside it
+ *
+ */
+static bool overlaps(const String &a, const String &b) {
+  if (a.length() == 0 || b.length() == 0) {
+    return false;
+  }
+  const String &shorter = a.length() <= b.length() ? a : b;
+  const String &longer = a.length() <= b.length() ? b : a;
+  return longer.startsWith(shorter) && 
+    (longer.length() == shorter.length() || longer[shorter.length()] == '/');
+}
+
+BatchJob::BatchJob(fs::FS &fs, DiskUsage &diskUsage, size_t copyBytes, 
+                   bool (*validPath)(const String &)) :
+  fs(fs), diskUsage(diskUsage), validPath(validPath), next(0), copier(fs, diskUsage, copyBytes), 
+  copying(false), failed(0) {
+}
+
+bool BatchJob::addOp(const String &op, const String &path, const String &from, const String &to) {
+  uint8_t type = 0;
+  while (type <= BJ_DELETE && op != opNames[type]) {
+    type++;
+  }
+  if (type > BJ_DELETE) {
+    errorText = "Unknown operation \"" + op + "\".";
+    return false;
+  }
+  Op entry = {(OpType)type, path.length() != 0 ? path : from, to, nullptr};
+  bool twoPaths = type == BJ_MOVE || type == BJ_COPY;
+  if (!validPath(entry.from) || entry.from == "/" || (twoPaths && !validPath(entry.to))) {
+    entry.result = "bad path";
+    failed++;
+  }
+  ops.push_back(entry);
+  return true;
+}
+
+bool BatchJob::parse(const String &json) {
+  size_t i = 0;
+  skipSpace(json, i);
+  if (i >= json.length() || json[i] != '[') {
+    errorText = "Expected a JSON array of operations.";
+    return false;
+  }
+  i++;
+  while (true) {
+    skipSpace(json, i);
+    if (i >= json.length() || json[i] != '{') {
+      errorText = "Expected an operation object at " + String(i) + ".";
+      return false;
+    }
+    i++;
+    String fields[4];                             // op, path, from, to
+    const char *const fieldNames[] = {"op", "path", "from", "to"};
+    while (true) {
+      String key, value;
+      skipSpace(json, i);
+      if (!parseString(json, i, key)) {
+        errorText = "Expected a key at " + String(i) + ".";
+        return false;
+      }
+      skipSpace(json, i);
+      if (i >= json.length() || json[i] != ':') {
+        errorText = "Expected ':' at " + String(i) + ".";
+        return false;
+      }
+      i++;
+      skipSpace(json, i);
+      if (!parseString(json, i, value)) {
+        errorText = "Expected a string value at " + String(i) + ".";
+        return false;
+      }
+      for (uint8_t f = 0; f < 4; f++) {
+        if (key == fieldNames[f]) {
+          fields[f] = value;
+        }
+      }
+      skipSpace(json, i);
+      if (i < json.length() && json[i] == ',') {
+        i++;
+        continue;
+      }
+      if (i < json.length() && json[i] == '}') {
+        i++;
+        break;
+      }
+      errorText = "Expected ',' or '}' at " + String(i) + ".";
+      return false;
+    }
+    if (ops.size() == BJ_MAX_OPS) {
+      errorText = "More than " + String(BJ_MAX_OPS) + " operations.";
+      return false;
+    }
+    if (!addOp(fields[0], fields[1], fields[2], fields[3])) {
+      return false;
+    }
+    skipSpace(json, i);
+    if (i < json.length() && json[i] == ',') {
+      i++;
+      continue;
+    }
+    if (i < json.length() && json[i] == ']') {
+      i++;
+      break;
+    }
+    errorText = "Expected ',' or ']' at " + String(i) + ".";
+    return false;
+  }
+  skipSpace(json, i);
+  if (i != json.length()) {
+    errorText = "Unexpected text after the operations.";
+    return false;
+  }
+
+  // Sort each run of consecutive operations of the same type by directory. Operations of 
+  // different types, and moves and copies that touch each other's paths, stay in the order given, 
+  // since a later one may depend on an earlier one.
+  order.resize(ops.size());
+  for (uint16_t n = 0; n < ops.size(); n++) {
+    order[n] = n;
+  }
+  auto byDirectory = [this](uint16_t a, uint16_t b) {
+    const Op &opA = ops[a];
+    const Op &opB = ops[b];
+    if (opA.type == BJ_MKDIR) {
+      return opA.from < opB.from;
+    }
+    if (opA.type == BJ_DELETE) {
+      return opB.from < opA.from;
+    }
+    return parentOf(opA.from) < parentOf(opB.from);
+  };
+  for (size_t first = 0; first < order.size(); ) {
+    size_t last = first + 1;
+    while (last < order.size() && ops[last].type == ops[first].type) {
+      last++;
+    }
+    if (ops[first].type == BJ_MKDIR || ops[first].type == BJ_DELETE || !entangled(first, last)) {
+      std::stable_sort(order.begin() + first, order.begin() + last, byDirectory);
+    }
+    first = last;
+  }
+  return true;
+}
+
+bool BatchJob::entangled(size_t first, size_t last) const {
+  for (size_t a = first; a < last; a++) {
+    for (size_t b = first; b < last; b++) {
+      if (a != b && (overlaps(ops[a].to, ops[b].from) || overlaps(ops[a].to, ops[b].to))) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void BatchJob::finishOp(Op &op, const char *result) {
+  op.result = result;
+  if (strcmp(result, "ok") != 0) {
+    failed++;
+  }
+  next++;
+}
+
+const char *BatchJob::deleteStep(unsigned long stepStart) {
+  while (!deleting.empty()) {
+    if (micros() - stepStart >= BJ_STEP_MICROS) {
+      return nullptr;
+    }
+    String dirPath = deleting.back();
+    File dir = fs.open(dirPath);
+    if (!dir) {
+      deleting.clear();
+      return "failed";
+    }
+    bool listed = false;
+    bool deeper = false;
+    while (micros() - stepStart < BJ_STEP_MICROS) {
+      File entry = dir.openNextFile();
+      if (!entry) {
+        listed = true;
+        break;
+      }
+      String path = entry.path();
+      bool isDir = entry.isDirectory();
+      size_t size = isDir ? 0 : entry.size();
+      entry.close();
+      if (isDir) {
+        deleting.push_back(path);
+        deeper = true;
+        break;
+      }
+      if (fs.remove(path)) {
+        diskUsage.add(path, -(int64_t)size, -1);
+      }
+    }
+    dir.close();
+    if (deeper || !listed) {
+      continue;
+    }
+    if (!fs.rmdir(dirPath)) {
+      deleting.clear();
+      return "failed";
+    }
+    diskUsage.removeDir(dirPath);
+    deleting.pop_back();
+  }
+  return "ok";
+}
+
+const char *BatchJob::move(const Op &op) {
+  File file = fs.open(op.from);
+  bool isDir = file.isDirectory();
+  size_t size = isDir ? 0 : file.size();
+  file.close();
+  if (!fs.rename(op.from, op.to)) {
+    return "failed";
+  }
+  if (isDir) {
+    diskUsage.moveDir(op.from, op.to);
+  } else {
+    diskUsage.add(op.from, -(int64_t)size, -1);
+    diskUsage.add(op.to, size, 1);
+  }
+  return "ok";
+}
+
+const char *BatchJob::run(Op &op, unsigned long stepStart) {
+  switch (op.type) {
+    case BJ_MKDIR:
+      if (fs.exists(op.from)) {
+        return "exists";
+      }
+      return fs.mkdir(op.from) ? "ok" : "failed";
+    case BJ_MOVE:
+      if (!fs.exists(op.from)) {
+        return "not found";
+      }
+      if (fs.exists(op.to)) {
+        return "exists";
+      }
+      if (op.to.startsWith(op.from + "/")) {
+        return "bad path";
+      }
+      return move(op);
+    case BJ_COPY:
+      if (!copying) {
+        if (!copier.begin(op.from, op.to)) {
+          return copier.error();
+        }
+        copying = true;
+      }
+      if (copier.step(BJ_STEP_MICROS - min((uint32_t)(micros() - stepStart), (uint32_t)BJ_STEP_MICROS))) {
+        return nullptr;
+      }
+      copying = false;
+      return copier.ok() ? "ok" : copier.error();
+    case BJ_DELETE:
+      if (deleting.empty()) {
+        File file = fs.open(op.from);
+        if (!file) {
+          return "not found";
+        }
+        bool isDir = file.isDirectory();
+        size_t size = isDir ? 0 : file.size();
+        file.close();
+        if (!isDir) {
+          if (!fs.remove(op.from)) {
+            return "failed";
+          }
+          diskUsage.add(op.from, -(int64_t)size, -1);
+          return "ok";
+        }
+        deleting.push_back(op.from);
+      }
+      return deleteStep(stepStart);
+  }
+  return "failed";
+}
+
+bool BatchJob::step() {
+  unsigned long stepStart = micros();
+  while (micros() - stepStart < BJ_STEP_MICROS) {
+    if (next >= order.size()) {
+      log_i("Batch: %d operations, %d failed.", ops.size(), failed);
+      return false;
+    }
+    Op &op = ops[order[next]];
+    if (op.result != nullptr) {
+      next++;
+      continue;
+    }
+    const char *result = run(op, stepStart);
+    if (result == nullptr) {
+      return true;
+    }
+    finishOp(op, result);
+  }
+  return true;
+}
+
+String BatchJob::toJson() const {
+  String json = "{\"finished\":";
+  json += next >= order.size() ? "true" : "false";
+  json += ",\"ops\":";
+  json += ops.size();
+  json += ",\"done\":";
+  json += next;
+  json += ",\"failed\":";
+  json += failed;
+  json += ",\"results\":[";
+  for (size_t n = 0; n < ops.size(); n++) {
+    const Op &op = ops[n];
+    json += n == 0 ? "{\"op\":\"" : ",{\"op\":\"";
+    json += opNames[op.type];
+    json += "\",\"path\":";
+    json += jsonString(op.from);
+    if (op.type == BJ_MOVE || op.type == BJ_COPY) {
+      json += ",\"to\":";
+      json += jsonString(op.to);
+    }
+    json += ",\"result\":";
+    json += op.result == nullptr ? String("null") : "\"" + String(op.result) + "\"";
+    json += "}";
+  }
+  json += "]}";
+  return json;
+}
@@ -0,0 +1,106 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * BootProfiler.cpp
+ *
+ * Implementation of the BootProfiler class. See BootProfiler.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "BootProfiler.h"
+#include <Preferences.h>                          // NVS access
+#include "esp_timer.h"                            // esp_timer_get_time()
+#include "esp_system.h"                           // esp_reset_reason()
+#include "esp_log.h"                              // log_?() support
+
+#define BP_NAMESPACE      "bootprof"                // NVS namespace for the history
+#define BP_KEY            "hist"                    // NVS key for the history
+
+BootProfiler::BootProfiler(const char *const *phaseNames, uint8_t nPhases) :
+  names(phaseNames), nPhases(min(nPhases, (uint8_t)BP_MAX_PHASES)), lastCycles(0), nHistory(0) {
+  memset(&current, 0, sizeof(current));
+}
+
+void BootProfiler::begin() {
+  lastCycles = ESP.getCycleCount();
+  current.preSetupMicros = esp_timer_get_time();
+  current.resetReason = esp_reset_reason();
+
+  // Load the history
+  Preferences prefs;
+  if (prefs.begin(BP_NAMESPACE, true)) {
+    size_t len = prefs.getBytesLength(BP_KEY);
+    if (len % sizeof(Record) == 0 && len <= sizeof(history)) {
+      nHistory = prefs.getBytes(BP_KEY, history, len) / sizeof(Record);
+    }
+    prefs.end();
+  }
+  current.boot = nHistory == 0 ? 1 : history[nHistory - 1].boot + 1;
+}
+
+void BootProfiler::mark(uint8_t phase) {
+  uint32_t now = ESP.getCycleCount();
+  if (phase < nPhases) {
+    current.phaseMicros[phase] += (now - lastCycles) / getCpuFrequencyMhz();
+  }
+  lastCycles = now;
+  current.totalMicros = esp_timer_get_time();
+}
+
+void BootProfiler::save() {
+  if (nHistory == BP_HISTORY) {
+    memmove(history, history + 1, sizeof(Record) * (BP_HISTORY - 1));
+    nHistory--;
+  }
+  history[nHistory++] = current;
+  Preferences prefs;
+  if (!prefs.begin(BP_NAMESPACE, false) || 
+      prefs.putBytes(BP_KEY, history, sizeof(Record) * nHistory) != sizeof(Record) * nHistory) {
+    log_w("Unable to save the boot profile.");
+  }
+  prefs.end();
+  log_i("Boot %d: ready %lu ms after reset.", current.boot, current.totalMicros / 1000);
+}
+
+String BootProfiler::toJson() const {
+  String json = "{\"phases\":[";
+  for (uint8_t p = 0; p < nPhases; p++) {
+    json += p == 0 ? "\"" : ",\"";
+    json += names[p];
+    json += "\"";
+  }
+  json += "],\"boots\":[";
+  for (int i = nHistory - 1; i >= 0; i--) {
+    const Record &r = history[i];
+    json += i == nHistory - 1 ? "{\"boot\":" : ",{\"boot\":";
+    json += r.boot;
+    json += ",\"resetReason\":";
+    json += r.resetReason;
+    json += ",\"preSetupMicros\":";
+    json += r.preSetupMicros;
+    json += ",\"totalMicros\":";
+    json += r.totalMicros;
+    json += ",\"phaseMicros\":[";
+    for (uint8_t p = 0; p < nPhases; p++) {
+      if (p != 0) {
+        json += ",";
+      }
+      json += r.phaseMicros[p];
+    }
+    json += "]}";
+  }
+  json += "]}";
+  return json;
+}
@@ -0,0 +1,278 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Config.cpp
+ *
+ * Implementation of the ConfigFile class. See Config.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "Config.h"
+#include "esp_log.h"                              // log_?() support
+
+// The frame sizes a config file may ask for
+static const struct {
+  const char *name;
+  framesize_t size;
+} frameSizes[] = {
+  {"QVGA", FRAMESIZE_QVGA}, {"CIF", FRAMESIZE_CIF}, {"VGA", FRAMESIZE_VGA}, 
+  {"SVGA", FRAMESIZE_SVGA}, {"XGA", FRAMESIZE_XGA}, {"HD", FRAMESIZE_HD}, 
+  {"SXGA", FRAMESIZE_SXGA}, {"UXGA", FRAMESIZE_UXGA}
+};
+
+/**
+ * @brief Parse a boolean value
+ *
+ * @return true   Success; *out is the value
+ * @return false  It isn't a boolean
+ */
+static bool parseBool(const String &value, bool *out) {
+  if (value == "true" || value == "1" || value == "on") {
+    *out = true;
+  } else if (value == "false" || value == "0" || value == "off") {
+    *out = false;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Parse an unsigned decimal value no bigger than max
+ *
+ * @return true   Success; *out is the value
+ * @return false  It isn't a decimal number or it's too big
+ */
+static bool parseNumber(const String &value, unsigned long max, unsigned long *out) {
+  if (value.length() == 0 || value.length() > 10) {
+    return false;
+  }
+  for (size_t i = 0; i < value.length(); i++) {
+    if (!isdigit(value[i])) {
+      return false;
+    }
+  }
+  unsigned long n = strtoul(value.c_str(), nullptr, 10);
+  if (n > max) {
+    return false;
+  }
+  *out = n;
+  return true;
+}
+
+/**
+ * @brief Parse the keystone corners: eight comma-separated fractions of the photo's width and 
+ *        height, x then y for the top-left, top-right, bottom-right and bottom-left corners
+ *
+ * @return true   Success; out holds the corners
+ * @return false  They aren't eight numbers from 0 to 1, or they don't make a convex quadrilateral
+ *                taken in order round it
+ */
+static bool parseCorners(const String &value, float out[8]) {
+  float corners[8];
+  const char *p = value.c_str();
+  for (uint8_t i = 0; i < 8; i++) {
+    char *end;
+    corners[i] = strtof(p, &end);
+    if (end == p || corners[i] < 0.0f || corners[i] > 1.0f) {
+      return false;
+    }
+    while (*end == ' ') {
+      end++;
+    }
+    if (*end != (i < 7 ? ',' : '\0')) {
+      return false;
+    }
+    p = end + 1;
+  }
+
+  // Every turn going round the corners must be the same way; otherwise the quad is concave,
+  // crossed or degenerate, and the perspective mapping of it sends some of the photo to infinity
+  float turn = 0.0f;
+  for (uint8_t i = 0; i < 4; i++) {
+    const float *p0 = corners + 2 * i;
+    const float *p1 = corners + 2 * ((i + 1) % 4);
+    const float *p2 = corners + 2 * ((i + 2) % 4);
+    float cross = (p1[0] - p0[0]) * (p2[1] - p1[1]) - (p1[1] - p0[1]) * (p2[0] - p1[0]);
+    if (cross == 0.0f || (turn != 0.0f && (cross > 0.0f) != (turn > 0.0f))) {
+      return false;
+    }
+    turn = cross;
+  }
+  memcpy(out, corners, sizeof(corners));
+  return true;
+}
+
+ConfigFile::ConfigFile(const char *path, bool (*validPath)(const String &)) :
+  path(path), validPath(validPath), found(false), parseMicros(0), lines(0), applied(0) {
+}
+
+bool ConfigFile::apply(const String &key, const String &value, Settings &settings) {
+  unsigned long n;
+  if (key == "ssid") {
+    if (value.length() == 0 || value.length() > 32) {
+      return false;
+    }
+    settings.ssid = value;
+  } else if (key == "password") {
+    if (value.length() < 8 || value.length() > 63) {
+      return false;
+    }
+    settings.password = value;
+  } else if (key == "ip") {
+    return settings.localIp.fromString(value);
+  } else if (key == "gateway") {
+    return settings.gateway.fromString(value);
+  } else if (key == "subnet") {
+    return settings.subnet.fromString(value);
+  } else if (key == "frameSize") {
+    for (auto &f : frameSizes) {
+      if (value == f.name) {
+        settings.frameSize = f.size;
+        return true;
+      }
+    }
+    return false;
+  } else if (key == "jpegQuality") {
+    if (!parseNumber(value, 63, &n)) {
+      return false;
+    }
+    settings.jpegQuality = n;
+  } else if (key == "photoPath") {
+    String dir = value.endsWith("/") ? value : value + "/";
+    if (!validPath(value) || !validPath(dir + CFG_LONGEST_PHOTO)) {
+      return false;
+    }
+    settings.photoPath = dir;
+  } else if (key == "aeEnable") {
+    return parseBool(value, &settings.aeEnable);
+  } else if (key == "aeIdleMillis") {
+    return parseNumber(value, 24UL * 60 * 60 * 1000, &settings.aeIdleMillis);
+  } else if (key == "motionEnable") {
+    return parseBool(value, &settings.motionEnable);
+  } else if (key == "motionMillis") {
+    if (!parseNumber(value, 24UL * 60 * 60 * 1000, &n) || n < 50) {
+      return false;
+    }
+    settings.motionMillis = n;
+  } else if (key == "keystoneEnable") {
+    return parseBool(value, &settings.keystoneEnable);
+  } else if (key == "keystoneCorners") {
+    return parseCorners(value, settings.keystoneCorners);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool ConfigFile::load(fs::FS &fs, Settings &settings) {
+  unsigned long startMicros = micros();
+  lines = 0;
+  applied = 0;
+  problems.clear();
+  File file = fs.open(path, FILE_READ);
+  found = file && !file.isDirectory();
+  if (!found) {
+    file.close();
+    parseMicros = micros() - startMicros;
+    log_i("No config file %s; using the defaults.", path.c_str());
+    return true;
+  }
+  if (file.size() > CFG_MAX_BYTES) {
+    problems.push_back("File is over " + String(CFG_MAX_BYTES) + " bytes; the rest was ignored.");
+  }
+
+  // Read the whole (small) file at once and split it into lines
+  size_t len = min((size_t)file.size(), (size_t)CFG_MAX_BYTES);
+  char *text = (char *)malloc(len + 1);
+  if (text == nullptr) {
+    file.close();
+    problems.push_back("Out of memory.");
+    parseMicros = micros() - startMicros;
+    return false;
+  }
+  len = file.read((uint8_t *)text, len);
+  file.close();
+  text[len] = '\0';
+  char *next = text;
+  while (next != nullptr && *next != '\0') {
+    char *line = next;
+    next = strchr(line, '\n');
+    if (next != nullptr) {
+      *next++ = '\0';
+    }
+    lines++;
+    String entry(line);
+    entry.trim();
+    if (entry.length() == 0 || entry[0] == '#') {
+      continue;
+    }
+    int eq = entry.indexOf('=');
+    String key = eq < 0 ? entry : entry.substring(0, eq);
+    String value = eq < 0 ? String("") : entry.substring(eq + 1);
+    key.trim();
+    value.trim();
+    if (eq < 0 || !apply(key, value, settings)) {
+      if (problems.size() < CFG_MAX_LISTED) {
+        problems.push_back("Line " + String(lines) + ": " + key);
+      }
+      continue;
+    }
+    applied++;
+  }
+  free(text);
+  parseMicros = micros() - startMicros;
+  log_i("Config %s: %d settings from %d lines in %u us.", path.c_str(), applied, lines, parseMicros);
+  return problems.empty();
+}
+
+String ConfigFile::toJson() const {
+  String json = "{\"path\":";
+  json += jsonString(path);
+  json += ",\"found\":";
+  json += found ? "true" : "false";
+  json += ",\"parseMicros\":";
+  json += parseMicros;
+  json += ",\"lines\":";
+  json += lines;
+  json += ",\"applied\":";
+  json += applied;
+  json += ",\"problems\":[";
+  for (size_t i = 0; i < problems.size(); i++) {
+    json += i == 0 ? "" : ",";
+    json += jsonString(problems[i]);
+  }
+  json += "]}";
+  return json;
+}
+
+String jsonString(const String &s) {
+  String json = "\"";
+  for (size_t i = 0; i < s.length(); i++) {
+    char c = s[i];
+    if (c == '"' || c == '\\') {
+      json += '\\';
+      json += c;
+    } else if ((uint8_t)c < ' ' || c == 0x7F) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", (uint8_t)c);
+      json += buf;
+    } else {
+      json += c;
+    }
+  }
+  json += "\"";
+  return json;
+}
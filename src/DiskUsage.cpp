@@ -0,0 +1,293 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * DiskUsage.cpp
+ *
+ * Implementation of the DiskUsage and DiskUsageScan classes. See DiskUsage.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "DiskUsage.h"
+#include "esp_log.h"                              // log_?() support
+
+/**
+ * @brief The directory part of a path
+ *
+ */
+static String parentOf(const String &path) {
+  int slash = path.lastIndexOf('/');
+  return slash <= 0 ? String("/") : path.substring(0, slash);
+}
+
+DiskUsage::DiskUsage(unsigned long scanMillis) :
+  scanMillis(scanMillis), scans(0), scanning(false), scanStartMillis(0), scanEndMillis(0), usedBase(0), 
+  usedDelta(0), cardBytes(0), walkChanged(false), walkGone(false), walkBytes(0), walkFiles(0), 
+  scanDrift(0), lastDrift(0) {
+}
+
+/**
+ * @brief Note a move or delete of path, which may be the directory being listed or hold it
+ *
+ */
+void DiskUsage::walkTouched(const String &path) {
+  if (walkDir.length() != 0 && (walkDir == path || walkDir.startsWith(path + "/"))) {
+    walkChanged = true;
+    walkGone = true;
+  }
+}
+
+void DiskUsage::add(const String &path, int64_t bytes, int32_t files) {
+  auto it = dirs.find(parentOf(path));
+  if (it == dirs.end()) {
+    it = dirs.insert({parentOf(path), {0, 0, scanning ? scans + 1 : scans}}).first;
+  }
+  Totals &t = it->second;
+  t.bytes = (int64_t)t.bytes + bytes < 0 ? 0 : t.bytes + bytes;
+  t.files = (int32_t)t.files + files < 0 ? 0 : t.files + files;
+  usedDelta += bytes;
+  if (it->first == walkDir) {
+    walkChanged = true;
+    walkBytes += bytes;
+    walkFiles += files;
+  }
+}
+
+void DiskUsage::moveDir(const String &from, const String &to) {
+  walkTouched(from);
+  std::vector<std::pair<String, Totals>> moved;
+  for (auto it = dirs.begin(); it != dirs.end(); ) {
+    if (it->first == from || it->first.startsWith(from + "/")) {
+      moved.push_back({to + it->first.substring(from.length()), it->second});
+      it = dirs.erase(it);
+    } else {
+      it++;
+    }
+  }
+  // The scan won't find these under their old names, so keep their totals as they are
+  for (auto &m : moved) {
+    if (scanning) {
+      m.second.scan = scans + 1;
+    }
+    dirs[m.first] = m.second;
+  }
+}
+
+void DiskUsage::removeDir(const String &path) {
+  walkTouched(path);
+  for (auto it = dirs.begin(); it != dirs.end(); ) {
+    if (it->first == path || it->first.startsWith(path + "/")) {
+      it = dirs.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+bool DiskUsage::scanDue() const {
+  return scans == 0 || millis() - scanEndMillis >= scanMillis;
+}
+
+void DiskUsage::beginScan() {
+  scanning = true;
+  scanStartMillis = millis();
+  scanDrift = 0;
+}
+
+void DiskUsage::beginDir(const String &dir) {
+  walkDir = dir;
+  walkChanged = false;
+  walkGone = false;
+  walkBytes = 0;
+  walkFiles = 0;
+}
+
+void DiskUsage::setDir(const String &dir, uint64_t bytes, uint32_t files) {
+  bool gone = dir == walkDir && walkGone;
+  if (dir == walkDir) {
+    bytes = (int64_t)bytes + walkBytes < 0 ? 0 : bytes + walkBytes;
+    files = (int32_t)files + walkFiles < 0 ? 0 : files + walkFiles;
+    walkDir = String();
+  }
+  if (gone) {
+    return;
+  }
+  auto it = dirs.find(dir);
+  scanDrift += (it == dirs.end() ? 0 : (int64_t)it->second.bytes) - (int64_t)bytes;
+  dirs[dir] = {bytes, files, scans + 1};
+}
+
+void DiskUsage::endScan(uint64_t used, uint64_t total) {
+  // Forget the directories the scan didn't find; they've gone
+  for (auto it = dirs.begin(); it != dirs.end(); ) {
+    if (it->second.scan != scans + 1) {
+      scanDrift += it->second.bytes;
+      it = dirs.erase(it);
+    } else {
+      it++;
+    }
+  }
+  lastDrift = scans == 0 ? 0 : scanDrift;
+  walkDir = String();
+  usedBase = used;
+  usedDelta = 0;
+  cardBytes = total;
+  scanning = false;
+  scans++;
+  scanEndMillis = millis();
+  log_i("Disk usage scan %d: %llu of %llu bytes used; cached figure was off by %lld.", scans, used, 
+    total, lastDrift);
+}
+
+String DiskUsage::toJson(const String &path) const {
+  String dir = path.length() > 1 && path.endsWith("/") ? path.substring(0, path.length() - 1) : path;
+  String prefix = dir == "/" ? dir : dir + "/";
+  uint64_t bytes = 0;
+  uint32_t files = 0;
+  std::vector<std::pair<String, Totals>> children;
+  for (auto &d : dirs) {
+    if (d.first != dir && !d.first.startsWith(prefix)) {
+      continue;
+    }
+    bytes += d.second.bytes;
+    files += d.second.files;
+    if (d.first == dir) {
+      continue;
+    }
+    int slash = d.first.indexOf('/', prefix.length());
+    String child = slash < 0 ? d.first : d.first.substring(0, slash);
+    size_t c = 0;
+    while (c < children.size() && children[c].first != child) {
+      c++;
+    }
+    if (c == children.size()) {
+      if (children.size() == DU_MAX_CHILDREN) {
+        continue;
+      }
+      children.push_back({child, {0, 0, 0}});
+    }
+    children[c].second.bytes += d.second.bytes;
+    children[c].second.files += d.second.files;
+  }
+
+  String json = "{\"reconciled\":";
+  json += reconciled() ? "true" : "false";
+  json += ",\"scans\":";
+  json += scans;
+  json += ",\"millisSinceScan\":";
+  json += reconciled() ? String(millis() - scanEndMillis) : String("null");
+  json += ",\"lastDriftBytes\":";
+  json += String((double)lastDrift, 0);
+  json += ",\"totalBytes\":";
+  json += String((double)cardBytes, 0);
+  json += ",\"usedBytes\":";
+  json += String((double)usedBytes(), 0);
+  json += ",\"freeBytes\":";
+  json += String((double)(cardBytes > usedBytes() ? cardBytes - usedBytes() : 0), 0);
+  json += ",\"dir\":\"";
+  json += dir;
+  json += "\",\"bytes\":";
+  json += String((double)bytes, 0);
+  json += ",\"files\":";
+  json += files;
+  json += ",\"dirs\":[";
+  for (size_t c = 0; c < children.size(); c++) {
+    json += c == 0 ? "{\"path\":\"" : ",{\"path\":\"";
+    json += children[c].first;
+    json += "\",\"bytes\":";
+    json += String((double)children[c].second.bytes, 0);
+    json += ",\"files\":";
+    json += children[c].second.files;
+    json += "}";
+  }
+  json += "]}";
+  return json;
+}
+
+DiskUsageScan::DiskUsageScan(fs::SDMMCFS &card, DiskUsage &du) :
+  card(card), du(du), dirBytes(0), dirFiles(0), rewalks(0), dirs(0), relisted(0), files(0), 
+  finished(false) {
+  pending.push_back("/");
+  du.beginScan();
+}
+
+DiskUsageScan::~DiskUsageScan() {
+  if (dir) {
+    dir.close();
+  }
+}
+
+bool DiskUsageScan::step() {
+  unsigned long stepStart = micros();
+  while (micros() - stepStart < DU_STEP_MICROS) {
+    if (!dir) {
+      if (pending.empty()) {
+        du.endScan(card.usedBytes(), card.totalBytes());
+        finished = true;
+        return false;
+      }
+      dirPath = pending.back();
+      pending.pop_back();
+      dir = card.open(dirPath);
+      if (!dir || !dir.isDirectory()) {
+        dir.close();
+        rewalks = 0;
+        continue;
+      }
+      du.beginDir(dirPath);
+      subdirs.clear();
+      dirBytes = 0;
+      dirFiles = 0;
+      if (rewalks == 0) {
+        dirs++;
+      }
+    }
+    File entry = dir.openNextFile();
+    if (!entry) {
+      dir.close();
+      if (du.dirChanged() && rewalks < DU_MAX_REWALKS) {
+        pending.push_back(dirPath);                 // List it again, from the top
+        rewalks++;
+        relisted++;
+        continue;
+      }
+      du.setDir(dirPath, dirBytes, dirFiles);
+      pending.insert(pending.end(), subdirs.begin(), subdirs.end());
+      files += dirFiles;
+      rewalks = 0;
+      continue;
+    }
+    if (entry.isDirectory()) {
+      subdirs.push_back(entry.path());
+    } else {
+      dirBytes += entry.size();
+      dirFiles++;
+    }
+    entry.close();
+  }
+  return true;
+}
+
+String DiskUsageScan::toJson() const {
+  String json = "{\"finished\":";
+  json += finished ? "true" : "false";
+  json += ",\"dirs\":";
+  json += dirs;
+  json += ",\"relisted\":";
+  json += relisted;
+  json += ",\"files\":";
+  json += files;
+  json += "}";
+  return json;
+}
@@ -0,0 +1,119 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * ExposureController.cpp
+ *
+ * Implementation of the ExposureController class. See ExposureController.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "ExposureController.h"
+#include "esp_log.h"                              // log_?() support
+
+#define EC_MAX_AEC        (1200)                    // Largest OV2640 aec_value
+#define EC_MAX_AGC        (30)                      // Largest OV2640 agc_gain
+#define EC_MAX_STEP       (4.0f)                    // Most the exposure may change in one step
+#define EC_DAMPING        (0.8f)                    // Fraction (in log terms) of the error corrected per step
+
+ExposureController::ExposureController(uint8_t target, uint8_t percentile, uint8_t tolerance, 
+  uint8_t maxFrames) :
+  sensor(nullptr), target(target), percentile(percentile), tolerance(tolerance), 
+  maxFrames(maxFrames), frames(0), isConverged(false), metered(0), aec(300), agc(0), 
+  adjustments(0) {
+}
+
+void ExposureController::begin(sensor_t *s) {
+  sensor = s;
+  aec = s->status.aec_value;
+  agc = s->status.agc_gain;
+  s->set_exposure_ctrl(s, 0);
+  s->set_gain_ctrl(s, 0);
+  s->set_aec_value(s, aec);
+  s->set_agc_gain(s, agc);
+  restart();
+  log_d("Exposure controller started at aec %d, agc %d.", aec, agc);
+}
+
+bool ExposureController::update(const uint8_t *luma, size_t count) {
+  if (sensor == nullptr || count == 0 || isConverged) {
+    return true;
+  }
+
+  // Find the metered percentile from a luma histogram
+  uint32_t hist[256] = {0};
+  for (size_t i = 0; i < count; i++) {
+    hist[luma[i]]++;
+  }
+  uint32_t rank = (uint32_t)((uint64_t)count * percentile / 100);
+  uint32_t seen = 0;
+  uint16_t level = 0;
+  while (level < 255 && seen + hist[level] <= rank) {
+    seen += hist[level++];
+  }
+  metered = level;
+  frames++;
+
+  if (abs((int)metered - (int)target) <= tolerance) {
+    log_d("Exposure converged in %d frames (luma %d, aec %d, agc %d).", frames, metered, aec, agc);
+    isConverged = true;
+    return true;
+  }
+  if (frames >= maxFrames) {
+    log_w("Exposure didn't converge in %d frames (luma %d, aec %d, agc %d).", frames, metered, aec, agc);
+    isConverged = true;
+    return true;
+  }
+
+  // Work out the exposure that should put the metered level on target
+  float ratio = metered >= 255 ? 1.0f / EC_MAX_STEP : (float)target / (metered == 0 ? 1 : metered);
+  ratio = powf(ratio, EC_DAMPING);
+  ratio = constrain(ratio, 1.0f / EC_MAX_STEP, EC_MAX_STEP);
+  float exposure = (float)(aec == 0 ? 1 : aec) * (agc + 1) * ratio;
+
+  // Get it with as much exposure time and as little gain as possible
+  uint16_t newAec = (uint16_t)constrain(exposure, 1.0f, (float)EC_MAX_AEC);
+  uint8_t newAgc = (uint8_t)constrain(roundf(exposure / newAec) - 1.0f, 0.0f, (float)EC_MAX_AGC);
+  if (newAec == aec && newAgc == agc) {
+    // We're pinned at a limit; nothing more to be done
+    isConverged = true;
+    return true;
+  }
+  aec = newAec;
+  agc = newAgc;
+  sensor->set_aec_value(sensor, aec);
+  sensor->set_agc_gain(sensor, agc);
+  adjustments++;
+  log_d("Exposure: luma %d -> aec %d, agc %d.", metered, aec, agc);
+  return false;
+}
+
+String ExposureController::toJson() const {
+  String json = "{\"target\":";
+  json += target;
+  json += ",\"metered\":";
+  json += metered;
+  json += ",\"aec\":";
+  json += aec;
+  json += ",\"agc\":";
+  json += agc;
+  json += ",\"frames\":";
+  json += frames;
+  json += ",\"converged\":";
+  json += isConverged ? "true" : "false";
+  json += ",\"adjustments\":";
+  json += adjustments;
+  json += "}";
+  return json;
+}
@@ -0,0 +1,121 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * FileCopy.cpp
+ *
+ * Implementation of the FileCopy class. See FileCopy.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "FileCopy.h"
+#include "Tracer.h"                               // TRACE_SCOPE()
+#include "esp_log.h"                              // log_?() support
+
+#define FCOPY_SUFFIX      ".tmp"                    // Added to the copy's name until it's complete
+
+FileCopy::FileCopy(fs::FS &fs, DiskUsage &diskUsage, size_t bufferBytes) :
+  fs(fs), diskUsage(diskUsage), bufferBytes(bufferBytes), buffer(nullptr), isCopying(false), copied(0), copyMicros(0), 
+  errorText(nullptr) {
+}
+
+FileCopy::~FileCopy() {
+  abort();
+  free(buffer);
+}
+
+bool FileCopy::begin(const String &from, const String &to) {
+  abort();
+  errorText = nullptr;
+  copied = 0;
+  copyMicros = 0;
+  toPath = to;
+  if (buffer == nullptr) {
+    buffer = (uint8_t *)ps_malloc(bufferBytes);
+    if (buffer == nullptr) {
+      log_e("Unable to allocate %d bytes for the copy buffer.", bufferBytes);
+      fail("no buffer");
+      return false;
+    }
+  }
+  if (fs.exists(to)) {
+    fail("exists");
+    return false;
+  }
+  src = fs.open(from, FILE_READ);
+  if (!src || src.isDirectory()) {
+    src.close();
+    fail("not found");
+    return false;
+  }
+  dst = fs.open(to + FCOPY_SUFFIX, FILE_WRITE);
+  if (!dst) {
+    src.close();
+    fail("can't create");
+    return false;
+  }
+  isCopying = true;
+  return true;
+}
+
+bool FileCopy::step(uint32_t budgetMicros) {
+  if (!isCopying) {
+    return false;
+  }
+  TRACE_SCOPE("sdCopy");
+  unsigned long stepStart = ::micros();
+  while (::micros() - stepStart < budgetMicros) {
+    int got = src.read(buffer, bufferBytes);
+    if (got < 0) {
+      fail("read failed");
+      break;
+    }
+    if (got == 0) {
+      src.close();
+      dst.close();
+      isCopying = false;
+      if (!fs.rename(toPath + FCOPY_SUFFIX, toPath)) {
+        fs.remove(toPath + FCOPY_SUFFIX);
+        fail("rename failed");
+      } else {
+        diskUsage.add(toPath, copied, 1);
+      }
+      break;
+    }
+    if (dst.write(buffer, got) != (size_t)got) {
+      fail("write failed");
+      break;
+    }
+    copied += got;
+  }
+  copyMicros += ::micros() - stepStart;
+  return isCopying;
+}
+
+void FileCopy::abort() {
+  if (isCopying) {
+    fail("aborted");
+  }
+}
+
+void FileCopy::fail(const char *what) {
+  errorText = what;
+  if (isCopying) {
+    src.close();
+    dst.close();
+    fs.remove(toPath + FCOPY_SUFFIX);
+    isCopying = false;
+  }
+  log_w("Copy to \"%s\" failed: %s.", toPath.c_str(), what);
+}
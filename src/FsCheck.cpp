@@ -0,0 +1,127 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * FsCheck.cpp
+ *
+ * Implementation of the FsCheck class. See FsCheck.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "FsCheck.h"
+#include "esp_log.h"                              // log_?() support
+
+FsCheck::FsCheck(fs::FS &fs, uint64_t usedBytes, const char *photoDir, const char *photoPrefix, 
+                 uint32_t photoCount) :
+  fs(fs), usedBytes(usedBytes), photoDir(photoDir), photoPrefix(photoPrefix), photoCount(photoCount),
+  dirs(0), files(0), fileBytes(0), maxPhoto(0), emptyFiles(0), tempFiles(0), finished(false) {
+  pending.push_back("/");
+}
+
+FsCheck::~FsCheck() {
+  if (dir) {
+    dir.close();
+  }
+}
+
+void FsCheck::checkFile(const String &path, size_t size) {
+  files++;
+  fileBytes += size;
+  bool problem = false;
+  if (size == 0) {
+    emptyFiles++;
+    problem = true;
+  }
+  if (path.endsWith(".tmp") || path.endsWith(".part")) {
+    tempFiles++;
+    problem = true;
+  }
+  if (problem && listed.size() < FC_MAX_LISTED) {
+    listed.push_back(path);
+  }
+  String photoStart = photoDir + photoPrefix;
+  if (path.startsWith(photoStart) && path.endsWith(".jpg")) {
+    uint32_t n = path.substring(photoStart.length(), path.length() - 4).toInt();
+    if (n > maxPhoto) {
+      maxPhoto = n;
+    }
+  }
+}
+
+bool FsCheck::step() {
+  unsigned long stepStart = micros();
+  while (micros() - stepStart < FC_STEP_MICROS) {
+    if (!dir) {
+      if (pending.empty()) {
+        finished = true;
+        log_i("FS check: %d dirs, %d files, %llu bytes.", dirs, files, fileBytes);
+        return false;
+      }
+      dir = fs.open(pending.back());
+      pending.pop_back();
+      if (!dir || !dir.isDirectory()) {
+        dir.close();
+        continue;
+      }
+      dirs++;
+    }
+    File entry = dir.openNextFile();
+    if (!entry) {
+      dir.close();
+      continue;
+    }
+    String path = entry.path();
+    if (entry.isDirectory()) {
+      pending.push_back(path);
+    } else {
+      checkFile(path, entry.size());
+    }
+    entry.close();
+  }
+  return true;
+}
+
+String FsCheck::toJson() const {
+  bool counterBehind = maxPhoto > photoCount;
+  String json = "{\"finished\":";
+  json += finished ? "true" : "false";
+  json += ",\"ok\":";
+  json += emptyFiles == 0 && tempFiles == 0 && !counterBehind ? "true" : "false";
+  json += ",\"dirs\":";
+  json += dirs;
+  json += ",\"files\":";
+  json += files;
+  json += ",\"fileBytes\":";
+  json += String((double)fileBytes, 0);
+  json += ",\"usedBytes\":";
+  json += String((double)usedBytes, 0);
+  json += ",\"emptyFiles\":";
+  json += emptyFiles;
+  json += ",\"tempFiles\":";
+  json += tempFiles;
+  json += ",\"maxPhoto\":";
+  json += maxPhoto;
+  json += ",\"photoCounter\":";
+  json += photoCount;
+  json += ",\"counterBehind\":";
+  json += counterBehind ? "true" : "false";
+  json += ",\"problemFiles\":[";
+  for (size_t i = 0; i < listed.size(); i++) {
+    json += i == 0 ? "\"" : ",\"";
+    json += listed[i];
+    json += "\"";
+  }
+  json += "]}";
+  return json;
+}
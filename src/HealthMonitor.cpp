@@ -0,0 +1,168 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * HealthMonitor.cpp
+ *
+ * Implementation of the HealthMonitor class. See HealthMonitor.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "HealthMonitor.h"
+#include "esp_heap_caps.h"                        // heap_caps_*() heap statistics
+#include "esp_log.h"                              // log_?() support
+
+#define HM_CAPS           (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT) // The heap we watch
+
+HealthMonitor::HealthMonitor(uint16_t capacity, unsigned long periodMillis, uint32_t budgetMicros) :
+  capacity(capacity), periodMillis(periodMillis), budgetMicros(budgetMicros), ring(nullptr), 
+  taken(0), lastMillis(0), requests(0), requestMicros(0), maxMicros(0), overBudget(0) {
+}
+
+bool HealthMonitor::begin() {
+  if (ring == nullptr) {
+    ring = (Snapshot *)ps_malloc(sizeof(Snapshot) * capacity);
+    if (ring == nullptr) {
+      log_e("Unable to allocate %d bytes for health snapshots.", sizeof(Snapshot) * capacity);
+      return false;
+    }
+  }
+  snapshot(ring[taken++ % capacity]);
+  return true;
+}
+
+void HealthMonitor::noteRequest(uint32_t micros) {
+  requests++;
+  requestMicros += micros;
+  if (micros > maxMicros) {
+    maxMicros = micros;
+  }
+  if (micros > budgetMicros) {
+    overBudget++;
+  }
+}
+
+void HealthMonitor::poll() {
+  if (ring != nullptr && millis() - lastMillis >= periodMillis) {
+    snapshot(ring[taken++ % capacity]);
+  }
+}
+
+void HealthMonitor::measure(Snapshot &s) const {
+  s.seconds = millis() / 1000;
+  s.freeHeap = heap_caps_get_free_size(HM_CAPS);
+  s.largestBlock = heap_caps_get_largest_free_block(HM_CAPS);
+  s.minFreeHeap = heap_caps_get_minimum_free_size(HM_CAPS);
+  s.freePsram = ESP.getFreePsram();
+}
+
+void HealthMonitor::snapshot(Snapshot &s) {
+  lastMillis = millis();
+  measure(s);
+  s.requests = requests;
+  s.meanMicros = requests == 0 ? 0 : requestMicros / requests;
+  s.maxMicros = maxMicros;
+  s.overBudget = overBudget;
+  requests = 0;
+  overBudget = 0;
+  requestMicros = 0;
+  maxMicros = 0;
+}
+
+/**
+ * @brief The least-squares slope of free heap against uptime over the held snapshots from first 
+ *        on (bytes/hour)
+ *
+ */
+float HealthMonitor::heapSlope(uint16_t first) const {
+  uint16_t n = held() - first;
+  double sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (uint16_t i = first; i < held(); i++) {
+    double x = (at(i).seconds - at(first).seconds) / 3600.0;
+    double y = at(i).freeHeap;
+    sx += x;
+    sy += y;
+    sxx += x * x;
+    sxy += x * y;
+  }
+  double den = n * sxx - sx * sx;
+  return den == 0 ? 0 : (n * sxy - sx * sy) / den;
+}
+
+/**
+ * @brief The request-weighted mean latency over count snapshots starting at first (micros)
+ *
+ */
+float HealthMonitor::meanLatency(uint16_t first, uint16_t count) const {
+  uint64_t total = 0;
+  uint32_t n = 0;
+  for (uint16_t i = first; i < first + count; i++) {
+    total += (uint64_t)at(i).meanMicros * at(i).requests;
+    n += at(i).requests;
+  }
+  return n == 0 ? 0 : (float)total / n;
+}
+
+String HealthMonitor::toJson() const {
+  Snapshot now;
+  measure(now);
+  uint16_t n = held();
+  bool judged = n >= HM_MIN_SNAPSHOTS;
+  uint16_t settled = 0;                             // The first snapshot past warm-up
+  while (settled < n && at(settled).seconds < HM_WARMUP_SECONDS) {
+    settled++;
+  }
+  bool leakJudged = n - settled >= HM_MIN_SNAPSHOTS && 
+    at(n - 1).seconds - at(settled).seconds >= HM_LEAK_SECONDS;
+  float slope = leakJudged ? heapSlope(settled) : 0;
+  float oldLatency = judged ? meanLatency(0, n / 4) : 0;
+  float newLatency = judged ? meanLatency(n - n / 4, n / 4) : 0;
+
+  String json = "{\"uptime\":";
+  json += now.seconds;
+  json += ",\"freeHeap\":";
+  json += now.freeHeap;
+  json += ",\"largestBlock\":";
+  json += now.largestBlock;
+  json += ",\"minFreeHeap\":";
+  json += now.minFreeHeap;
+  json += ",\"freePsram\":";
+  json += now.freePsram;
+  json += ",\"heapSlopePerHour\":";
+  json += leakJudged ? String(slope, 1) : String("null");
+  json += ",\"flags\":{\"leak\":";
+  json += leakJudged && slope < -HM_LEAK_BYTES_PER_HOUR ? "true" : "false";
+  json += ",\"fragmentation\":";
+  json += (uint64_t)now.largestBlock * 100 < (uint64_t)now.freeHeap * HM_MIN_BLOCK_PCT ? "true" : "false";
+  json += ",\"latencyDrift\":";
+  json += judged && oldLatency > 0 && newLatency > oldLatency * HM_DRIFT_FACTOR ? "true" : "false";
+  json += ",\"overBudget\":";
+  json += overBudget > 0 || (n > 0 && at(n - 1).overBudget > 0) ? "true" : "false";
+  json += "},\"periodMillis\":";
+  json += periodMillis;
+  json += ",\"budgetMicros\":";
+  json += budgetMicros;
+  json += ",\"snapshots\":[";
+  for (uint16_t i = 0; i < n; i++) {
+    const Snapshot &s = at(i);
+    char buf[144];
+    snprintf(buf, sizeof(buf), "%s[%u,%u,%u,%u,%u,%u,%u,%u,%u]", i == 0 ? "" : ",", s.seconds, 
+      s.freeHeap, s.largestBlock, s.minFreeHeap, s.freePsram, s.requests, s.meanMicros, s.maxMicros,
+      s.overBudget);
+    json += buf;
+  }
+  json += "],\"snapshotFields\":[\"seconds\",\"freeHeap\",\"largestBlock\",\"minFreeHeap\","
+    "\"freePsram\",\"requests\",\"meanMicros\",\"maxMicros\",\"overBudget\"]}";
+  return json;
+}
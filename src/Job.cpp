@@ -0,0 +1,64 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Job.cpp
+ *
+ * Implementation of the JobRunner class. See Job.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "Job.h"
+#include "esp_log.h"                              // log_?() support
+
+bool JobRunner::start(Job *newJob) {
+  if (active) {
+    log_w("Can't start job \"%s\"; \"%s\" is running.", newJob->name(), job->name());
+    delete newJob;
+    return false;
+  }
+  delete job;
+  job = newJob;
+  active = true;
+  startMillis = millis();
+  log_i("Job \"%s\" started.", job->name());
+  return true;
+}
+
+void JobRunner::step() {
+  if (!active) {
+    return;
+  }
+  if (!job->step()) {
+    active = false;
+    endMillis = millis();
+    log_i("Job \"%s\" finished in %lu ms.", job->name(), endMillis - startMillis);
+  }
+}
+
+String JobRunner::toJson() const {
+  if (job == nullptr) {
+    return "{\"name\":null}";
+  }
+  String json = "{\"name\":\"";
+  json += job->name();
+  json += "\",\"running\":";
+  json += active ? "true" : "false";
+  json += ",\"millis\":";
+  json += (active ? millis() : endMillis) - startMillis;
+  json += ",\"job\":";
+  json += job->toJson();
+  json += "}";
+  return json;
+}
@@ -0,0 +1,384 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * JpegSharpness.cpp
+ *
+ * Implementation of jpegSharpness(). See JpegSharpness.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "JpegSharpness.h"
+#include "esp_log.h"                              // log_?() support
+
+#define JS_MAX_COMPS      (3)                       // Most image components we handle
+#define JS_LOOKUP_BITS    (8)                       // Huffman codes this long or shorter decode in one step
+
+namespace {
+
+// A Huffman decoding table
+struct HuffTable {
+  bool defined;
+  uint8_t lookupLen[1 << JS_LOOKUP_BITS];           // Code length for short codes (0: not short)
+  uint8_t lookupSym[1 << JS_LOOKUP_BITS];           // Symbol for short codes
+  int32_t minCode[17];                              // Smallest code of each length
+  int32_t maxCode[18];                              // Largest code of each length; -1 if none
+  uint8_t valPtr[17];                               // Index in vals of the first code of each length
+  uint8_t vals[256];                                // The symbols
+};
+
+// An image component
+struct Component {
+  uint8_t id;
+  uint8_t h;                                        // Horizontal sampling factor
+  uint8_t v;                                        // Vertical sampling factor
+  uint8_t tq;                                       // Quantization table
+  uint8_t td;                                       // DC Huffman table
+  uint8_t ta;                                       // AC Huffman table
+};
+
+// Everything we learn from the headers
+struct Jpeg {
+  uint16_t quant[4][64];                            // Quantization tables, zig-zag order
+  HuffTable dc[4];
+  HuffTable ac[4];
+  Component comp[JS_MAX_COMPS];
+  uint8_t nComps;
+  uint8_t scanComp[JS_MAX_COMPS];                   // Index in comp of each component in the scan
+  uint8_t nScanComps;
+  uint16_t width;
+  uint16_t height;
+  uint16_t restartInterval;
+};
+
+// A reader for the entropy-coded bit stream. Stuffed zero bytes are dropped; once a marker is
+// reached, zeros are fed.
+struct BitReader {
+  const uint8_t *p;
+  const uint8_t *end;
+  uint32_t buf;
+  int bits;
+  bool atMarker;
+
+  void fill() {
+    while (bits <= 24) {
+      uint8_t b = 0;
+      if (!atMarker && p < end) {
+        b = *p++;
+        if (b == 0xFF) {
+          if (p < end && *p == 0x00) {
+            p++;
+          } else {
+            atMarker = true;
+            p--;
+            b = 0;
+          }
+        }
+      }
+      buf |= (uint32_t)b << (24 - bits);
+      bits += 8;
+    }
+  }
+
+  uint32_t get(int n) {
+    fill();
+    uint32_t v = buf >> (32 - n);
+    buf <<= n;
+    bits -= n;
+    return v;
+  }
+
+  // Skip to just past the next RSTn marker
+  void restart() {
+    while (p + 1 < end && !(p[0] == 0xFF && p[1] >= 0xD0 && p[1] <= 0xD7)) {
+      p++;
+    }
+    p = (p + 1 < end) ? p + 2 : end;
+    buf = 0;
+    bits = 0;
+    atMarker = false;
+  }
+};
+
+uint16_t be16(const uint8_t *p) {
+  return (p[0] << 8) | p[1];
+}
+
+// Build a decoding table from a DHT segment's code counts and symbols; false if they aren't a
+// valid code
+bool buildHuff(HuffTable &t, const uint8_t *counts, const uint8_t *syms, uint16_t nSyms) {
+  t.defined = false;
+  memset(t.lookupLen, 0, sizeof(t.lookupLen));
+  memcpy(t.vals, syms, nSyms);
+  int32_t code = 0;
+  uint16_t k = 0;
+  for (int len = 1; len <= 16; len++) {
+    t.valPtr[len] = k;
+    t.minCode[len] = code;
+    for (int i = 0; i < counts[len - 1]; i++, k++, code++) {
+      if (code >= (1 << len)) {
+        return false;                               // More codes than len bits can hold
+      }
+      if (len <= JS_LOOKUP_BITS) {
+        int shift = JS_LOOKUP_BITS - len;
+        for (int j = 0; j < (1 << shift); j++) {
+          t.lookupLen[(code << shift) | j] = len;
+          t.lookupSym[(code << shift) | j] = syms[k];
+        }
+      }
+    }
+    t.maxCode[len] = counts[len - 1] ? code - 1 : -1;
+    code <<= 1;
+  }
+  t.maxCode[17] = INT32_MAX;
+  t.defined = true;
+  return k == nSyms;
+}
+
+// Decode one Huffman-coded symbol; -1 if the code is invalid
+int decodeHuff(BitReader &br, const HuffTable &t) {
+  br.fill();
+  uint32_t look = br.buf >> (32 - JS_LOOKUP_BITS);
+  if (t.lookupLen[look] != 0) {
+    uint8_t len = t.lookupLen[look];
+    br.buf <<= len;
+    br.bits -= len;
+    return t.lookupSym[look];
+  }
+  for (int len = JS_LOOKUP_BITS + 1; len <= 16; len++) {
+    int32_t code = br.buf >> (32 - len);
+    if (code <= t.maxCode[len]) {
+      br.buf <<= len;
+      br.bits -= len;
+      return t.vals[t.valPtr[len] + code - t.minCode[len]];
+    }
+  }
+  return -1;
+}
+
+// Decode the size-s magnitude that follows a Huffman-coded size
+int32_t receiveExtend(BitReader &br, int s) {
+  if (s == 0) {
+    return 0;
+  }
+  int32_t v = br.get(s);
+  return v < (1 << (s - 1)) ? v - (1 << s) + 1 : v;
+}
+
+// Parse the headers up to and including SOS; returns the start of the entropy-coded data
+const uint8_t *parseHeaders(Jpeg &j, const uint8_t *p, const uint8_t *end) {
+  if (end - p < 4 || p[0] != 0xFF || p[1] != 0xD8) {
+    return nullptr;
+  }
+  p += 2;
+  while (p + 4 <= end) {
+    if (p[0] != 0xFF) {
+      return nullptr;
+    }
+    uint8_t marker = p[1];
+    if (marker == 0xFF) {
+      p++;
+      continue;
+    }
+    uint16_t segLen = be16(p + 2);
+    const uint8_t *seg = p + 4;
+    const uint8_t *segEnd = p + 2 + segLen;
+    if (segLen < 2 || segEnd > end) {
+      return nullptr;
+    }
+    switch (marker) {
+      case 0xDB:                                    // DQT
+        while (seg < segEnd) {
+          uint8_t pq = seg[0] >> 4, tq = seg[0] & 0x0F;
+          seg++;
+          if (tq > 3 || seg + (pq ? 128 : 64) > segEnd) {
+            return nullptr;
+          }
+          for (int i = 0; i < 64; i++) {
+            j.quant[tq][i] = pq ? be16(seg + 2 * i) : seg[i];
+          }
+          seg += pq ? 128 : 64;
+        }
+        break;
+      case 0xC0:                                    // SOF0, baseline
+      case 0xC1:                                    // SOF1, extended sequential Huffman
+        if (segLen < 8) {
+          return nullptr;
+        }
+        j.height = be16(seg + 1);
+        j.width = be16(seg + 3);
+        j.nComps = seg[5];
+        if (j.nComps == 0 || j.nComps > JS_MAX_COMPS || segLen < 8 + 3 * j.nComps) {
+          return nullptr;
+        }
+        for (int i = 0; i < j.nComps; i++) {
+          j.comp[i].id = seg[6 + 3 * i];
+          j.comp[i].h = seg[7 + 3 * i] >> 4;
+          j.comp[i].v = seg[7 + 3 * i] & 0x0F;
+          j.comp[i].tq = seg[8 + 3 * i] & 0x03;
+          if (j.comp[i].h == 0 || j.comp[i].v == 0) {
+            return nullptr;
+          }
+        }
+        break;
+      case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+      case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+        return nullptr;                             // Progressive, lossless or arithmetic
+      case 0xC4:                                    // DHT
+        while (seg + 17 <= segEnd) {
+          uint8_t tc = seg[0] >> 4, th = seg[0] & 0x0F;
+          uint16_t nSyms = 0;
+          for (int i = 0; i < 16; i++) {
+            nSyms += seg[1 + i];
+          }
+          if (th > 3 || nSyms > 256 || seg + 17 + nSyms > segEnd) {
+            return nullptr;
+          }
+          if (!buildHuff(tc ? j.ac[th] : j.dc[th], seg + 1, seg + 17, nSyms)) {
+            return nullptr;
+          }
+          seg += 17 + nSyms;
+        }
+        break;
+      case 0xDD:                                    // DRI
+        if (segLen < 4) {
+          return nullptr;
+        }
+        j.restartInterval = be16(seg);
+        break;
+      case 0xDA:                                    // SOS
+        if (segLen < 3) {
+          return nullptr;
+        }
+        j.nScanComps = seg[0];
+        if (j.nScanComps == 0 || j.nScanComps > j.nComps || segLen < 6 + 2 * j.nScanComps) {
+          return nullptr;
+        }
+        for (int i = 0; i < j.nScanComps; i++) {
+          uint8_t id = seg[1 + 2 * i];
+          int c = 0;
+          while (c < j.nComps && j.comp[c].id != id) {
+            c++;
+          }
+          if (c == j.nComps) {
+            return nullptr;
+          }
+          j.scanComp[i] = c;
+          j.comp[c].td = seg[2 + 2 * i] >> 4;
+          j.comp[c].ta = seg[2 + 2 * i] & 0x03;
+          if (j.comp[c].td > 3 || !j.dc[j.comp[c].td].defined || !j.ac[j.comp[c].ta].defined) {
+            return nullptr;
+          }
+        }
+        return j.width == 0 ? nullptr : segEnd;
+      default:                                      // APPn, COM and the like
+        break;
+    }
+    p = segEnd;
+  }
+  return nullptr;
+}
+
+} // namespace
+
+uint32_t jpegSharpness(const uint8_t *jpg, size_t len) {
+  Jpeg *j = (Jpeg *)calloc(1, sizeof(Jpeg));
+  if (j == nullptr) {
+    log_e("Unable to allocate JPEG parsing tables.");
+    return 0;
+  }
+  const uint8_t *data = parseHeaders(*j, jpg, jpg + len);
+  if (data == nullptr) {
+    log_w("Not a baseline JPEG we can score.");
+    free(j);
+    return 0;
+  }
+
+  // Work out the MCU layout
+  uint8_t hMax = 1, vMax = 1;
+  for (int i = 0; i < j->nComps; i++) {
+    hMax = max(hMax, j->comp[i].h);
+    vMax = max(vMax, j->comp[i].v);
+  }
+  uint32_t mcus;
+  if (j->nScanComps == 1) {
+    // Non-interleaved: one block per MCU
+    const Component &c = j->comp[j->scanComp[0]];
+    uint32_t cw = (j->width * c.h + hMax - 1) / hMax;
+    uint32_t ch = (j->height * c.v + vMax - 1) / vMax;
+    mcus = ((cw + 7) / 8) * ((ch + 7) / 8);
+  } else {
+    mcus = ((j->width + 8 * hMax - 1) / (8 * hMax)) * ((j->height + 8 * vMax - 1) / (8 * vMax));
+  }
+
+  BitReader br = {data, jpg + len, 0, 0, false};
+  uint64_t energy = 0;
+  uint32_t lumaBlocks = 0;
+  bool ok = true;
+  for (uint32_t m = 0; m < mcus && ok; m++) {
+    if (j->restartInterval != 0 && m != 0 && m % j->restartInterval == 0) {
+      br.restart();
+    }
+    for (int s = 0; s < j->nScanComps && ok; s++) {
+      const Component &c = j->comp[j->scanComp[s]];
+      bool isLuma = j->scanComp[s] == 0;
+      const uint16_t *q = j->quant[c.tq];
+      int blocks = j->nScanComps == 1 ? 1 : c.h * c.v;
+      for (int b = 0; b < blocks && ok; b++) {
+        // DC: decode and discard
+        int t = decodeHuff(br, j->dc[c.td]);
+        if (t < 0 || t > 11) {
+          ok = false;
+          break;
+        }
+        receiveExtend(br, t);
+
+        // AC: accumulate the dequantized magnitudes for luma
+        for (int k = 1; k < 64; ) {
+          int rs = decodeHuff(br, j->ac[c.ta]);
+          if (rs < 0) {
+            ok = false;
+            break;
+          }
+          int r = rs >> 4, sz = rs & 0x0F;
+          if (sz == 0) {
+            if (r != 15) {
+              break;                                // EOB
+            }
+            k += 16;
+            continue;
+          }
+          k += r;
+          if (k > 63) {
+            ok = false;
+            break;
+          }
+          int32_t v = receiveExtend(br, sz);
+          if (isLuma) {
+            energy += (uint32_t)abs(v) * q[k];
+          }
+          k++;
+        }
+        if (isLuma) {
+          lumaBlocks++;
+        }
+      }
+    }
+  }
+  free(j);
+  if (!ok) {
+    log_w("Corrupt JPEG data after %d luma blocks.", lumaBlocks);
+  }
+  return lumaBlocks == 0 ? 0 : (uint32_t)(energy / lumaBlocks);
+}
@@ -0,0 +1,207 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Keystone.cpp
+ *
+ * Implementation of the Keystone class. See Keystone.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "Keystone.h"
+#include "img_converters.h"                       // jpg2rgb565() and fmt2jpg()
+#include "esp_log.h"                              // log_?() support
+
+Keystone::Keystone() : w(0), h(0), nodesX(0), nodesY(0), lut(nullptr) {
+}
+
+Keystone::~Keystone() {
+  end();
+}
+
+bool Keystone::begin(uint16_t width, uint16_t height, const float corners[8]) {
+  end();
+
+  // Work out the homography that takes the unit square (the corrected image) to the quad the
+  // screen occupies in the source image. (Heckbert, "Fundamentals of Texture Mapping," 1989.)
+  float x0 = corners[0], y0 = corners[1], x1 = corners[2], y1 = corners[3];
+  float x2 = corners[4], y2 = corners[5], x3 = corners[6], y3 = corners[7];
+  float dx1 = x1 - x2, dx2 = x3 - x2, dx3 = x0 - x1 + x2 - x3;
+  float dy1 = y1 - y2, dy2 = y3 - y2, dy3 = y0 - y1 + y2 - y3;
+  float a, b, c, d, e, f, g, k;
+  if (dx3 == 0.0f && dy3 == 0.0f) {
+    // It's a parallelogram; the mapping is affine
+    a = x1 - x0; b = x2 - x1; c = x0;
+    d = y1 - y0; e = y2 - y1; f = y0;
+    g = 0.0f; k = 0.0f;
+  } else {
+    float den = dx1 * dy2 - dx2 * dy1;
+    if (den == 0.0f) {
+      log_e("Keystone corners are degenerate.");
+      return false;
+    }
+    g = (dx3 * dy2 - dx2 * dy3) / den;
+    k = (dx1 * dy3 - dx3 * dy1) / den;
+    a = x1 - x0 + g * x1; b = x3 - x0 + k * x3; c = x0;
+    d = y1 - y0 + g * y1; e = y3 - y0 + k * y3; f = y0;
+  }
+
+  // Evaluate it at the corners of each output tile
+  uint16_t nx = (width + KS_TILE - 1) / KS_TILE + 1;
+  uint16_t ny = (height + KS_TILE - 1) / KS_TILE + 1;
+  Node *table = (Node *)malloc(sizeof(Node) * nx * ny);
+  if (table == nullptr) {
+    log_e("Unable to allocate %d bytes for the keystone lookup table.", sizeof(Node) * nx * ny);
+    return false;
+  }
+  // Refuse nodes at or past the horizon or far outside the source, so the conversions here and the
+  // fixed-point arithmetic in applyTile stay well within int32_t
+  for (uint16_t j = 0; j < ny; j++) {
+    float v = (float)(j * KS_TILE) / height;
+    for (uint16_t i = 0; i < nx; i++) {
+      float u = (float)(i * KS_TILE) / width;
+      float z = g * u + k * v + 1.0f;
+      float x = z > KS_MIN_Z ? (a * u + b * v + c) / z : 0.0f;
+      float y = z > KS_MIN_Z ? (d * u + e * v + f) / z : 0.0f;
+      if (z <= KS_MIN_Z || x < -KS_MAX_OUTSIDE || x > 1.0f + KS_MAX_OUTSIDE ||
+          y < -KS_MAX_OUTSIDE || y > 1.0f + KS_MAX_OUTSIDE) {
+        log_e("Keystone corners map part of the image to infinity or far outside the photo.");
+        free(table);
+        return false;
+      }
+      table[j * nx + i].x = (int32_t)(x * width * KS_FRAC_ONE);
+      table[j * nx + i].y = (int32_t)(y * height * KS_FRAC_ONE);
+    }
+  }
+
+  w = width;
+  h = height;
+  nodesX = nx;
+  nodesY = ny;
+  lut = table;
+  log_d("Keystone lookup table built for %dx%d (%d nodes).", w, h, nx * ny);
+  return true;
+}
+
+void Keystone::end() {
+  if (lut != nullptr) {
+    free(lut);
+    lut = nullptr;
+  }
+  w = h = nodesX = nodesY = 0;
+}
+
+void Keystone::apply(const uint8_t *src, uint8_t *dst) const {
+  if (lut == nullptr) {
+    return;
+  }
+  for (uint16_t ty = 0; ty + 1 < nodesY; ty++) {
+    for (uint16_t tx = 0; tx + 1 < nodesX; tx++) {
+      applyTile(src, dst, tx, ty);
+    }
+  }
+}
+
+void Keystone::applyTile(const uint8_t *src, uint8_t *dst, uint16_t tx, uint16_t ty) const {
+  const Node &n00 = lut[ty * nodesX + tx];
+  const Node &n10 = lut[ty * nodesX + tx + 1];
+  const Node &n01 = lut[(ty + 1) * nodesX + tx];
+  const Node &n11 = lut[(ty + 1) * nodesX + tx + 1];
+  uint16_t ox = tx * KS_TILE;
+  uint16_t oy = ty * KS_TILE;
+  uint16_t cols = (ox + KS_TILE <= w) ? KS_TILE : w - ox;
+  uint16_t rows = (oy + KS_TILE <= h) ? KS_TILE : h - oy;
+  const int32_t maxX = (int32_t)(w - 1) << KS_FRAC_BITS;
+  const int32_t maxY = (int32_t)(h - 1) << KS_FRAC_BITS;
+
+  for (uint16_t r = 0; r < rows; r++) {
+    // Ends of this row of the tile, with KS_FRAC_BITS + KS_TILE_SHIFT fractional bits
+    int32_t lx = n00.x * KS_TILE + (n01.x - n00.x) * r;
+    int32_t ly = n00.y * KS_TILE + (n01.y - n00.y) * r;
+    int32_t rx = n10.x * KS_TILE + (n11.x - n10.x) * r;
+    int32_t ry = n10.y * KS_TILE + (n11.y - n10.y) * r;
+
+    // Walk along the row, with KS_FRAC_BITS + 2 * KS_TILE_SHIFT fractional bits
+    int32_t x = lx * KS_TILE, dx = rx - lx;
+    int32_t y = ly * KS_TILE, dy = ry - ly;
+    uint8_t *out = dst + ((uint32_t)(oy + r) * w + ox) * 2;
+    for (uint16_t col = 0; col < cols; col++, x += dx, y += dy) {
+      int32_t sx = x >> (2 * KS_TILE_SHIFT);
+      int32_t sy = y >> (2 * KS_TILE_SHIFT);
+      sx = sx < 0 ? 0 : (sx > maxX ? maxX : sx);
+      sy = sy < 0 ? 0 : (sy > maxY ? maxY : sy);
+      uint32_t ix = sx >> KS_FRAC_BITS, fx = sx & (KS_FRAC_ONE - 1);
+      uint32_t iy = sy >> KS_FRAC_BITS, fy = sy & (KS_FRAC_ONE - 1);
+      uint32_t stepX = (ix + 1 < w) ? 2 : 0;
+      uint32_t stepY = (iy + 1 < h) ? w * 2 : 0;
+
+      // Bilinear blend of the four neighbouring source pixels
+      const uint8_t *p = src + (iy * w + ix) * 2;
+      uint16_t c00 = (p[0] << 8) | p[1];
+      uint16_t c10 = (p[stepX] << 8) | p[stepX + 1];
+      uint16_t c01 = (p[stepY] << 8) | p[stepY + 1];
+      uint16_t c11 = (p[stepY + stepX] << 8) | p[stepY + stepX + 1];
+      uint32_t w00 = (KS_FRAC_ONE - fx) * (KS_FRAC_ONE - fy);
+      uint32_t w10 = fx * (KS_FRAC_ONE - fy);
+      uint32_t w01 = (KS_FRAC_ONE - fx) * fy;
+      uint32_t w11 = fx * fy;
+      uint32_t red = ((c00 >> 11) * w00 + (c10 >> 11) * w10 +
+                      (c01 >> 11) * w01 + (c11 >> 11) * w11) >> (2 * KS_FRAC_BITS);
+      uint32_t grn = (((c00 >> 5) & 0x3F) * w00 + ((c10 >> 5) & 0x3F) * w10 +
+                      ((c01 >> 5) & 0x3F) * w01 + ((c11 >> 5) & 0x3F) * w11) >> (2 * KS_FRAC_BITS);
+      uint32_t blu = ((c00 & 0x1F) * w00 + (c10 & 0x1F) * w10 +
+                      (c01 & 0x1F) * w01 + (c11 & 0x1F) * w11) >> (2 * KS_FRAC_BITS);
+      uint16_t c = (red << 11) | (grn << 5) | blu;
+      *out++ = c >> 8;
+      *out++ = c & 0xFF;
+    }
+  }
+}
+
+bool Keystone::correctJpeg(const uint8_t *jpg, size_t len, uint8_t scaleShift, uint8_t quality,
+                           uint32_t budgetMillis, uint8_t **out, size_t *outLen) const {
+  if (lut == nullptr) {
+    return false;
+  }
+  uint32_t startMillis = millis();
+  size_t imgBytes = (size_t)w * h * 2;
+  uint8_t *decoded = (uint8_t *)ps_malloc(imgBytes);
+  uint8_t *corrected = (uint8_t *)ps_malloc(imgBytes);
+  bool success = false;
+  if (decoded == nullptr || corrected == nullptr) {
+    log_e("Unable to allocate keystone image buffers.");
+  } else if (!jpg2rgb565(jpg, len, decoded, (jpg_scale_t)scaleShift)) {
+    log_e("Keystone: JPEG decode failed.");
+  } else if (millis() - startMillis > budgetMillis) {
+    log_w("Keystone: over budget after decode (%lu ms).", millis() - startMillis);
+  } else {
+    apply(decoded, corrected);
+    free(decoded);
+    decoded = nullptr;
+    if (millis() - startMillis > budgetMillis) {
+      log_w("Keystone: over budget after remap (%lu ms).", millis() - startMillis);
+    } else if (!fmt2jpg(corrected, imgBytes, w, h, PIXFORMAT_RGB565, quality, out, outLen)) {
+      log_e("Keystone: JPEG encode failed.");
+    } else if (millis() - startMillis > budgetMillis) {
+      log_w("Keystone: over budget after encode (%lu ms).", millis() - startMillis);
+      free(*out);
+    } else {
+      log_d("Keystone: corrected %dx%d image in %lu ms.", w, h, millis() - startMillis);
+      success = true;
+    }
+  }
+  free(decoded);
+  free(corrected);
+  return success;
+}
@@ -0,0 +1,44 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * LoggingWebServer.cpp
+ *
+ * Implementation of the LoggingWebServer class. See LoggingWebServer.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "LoggingWebServer.h"
+
+void LoggingWebServer::handleClient() {
+  status = 0;
+  bytes = 0;
+  passes++;
+  unsigned long startMicros = micros();
+  WebServer::handleClient();
+  if (status != 0) {
+    latency = micros() - startMicros;
+    log.add(ip, reqMethod, reqUri, status, bytes, latency);
+  }
+}
+
+void LoggingWebServer::noteStatus(int code) {
+  // WebServer forgets the request once it's been handled, so remember what we need now
+  if (status == 0) {
+    ip = client().remoteIP();
+    reqMethod = method();
+    reqUri = uri();
+  }
+  status = code;
+}
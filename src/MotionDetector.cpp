@@ -0,0 +1,97 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * MotionDetector.cpp
+ *
+ * Implementation of the MotionDetector class. See MotionDetector.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "MotionDetector.h"
+#include "esp_log.h"                              // log_?() support
+
+// Sum of the absolute differences of the four bytes packed in words a and b
+static inline uint32_t sad4(uint32_t a, uint32_t b) {
+  int32_t d0 = (int32_t)(a & 0xFF) - (int32_t)(b & 0xFF);
+  int32_t d1 = (int32_t)((a >> 8) & 0xFF) - (int32_t)((b >> 8) & 0xFF);
+  int32_t d2 = (int32_t)((a >> 16) & 0xFF) - (int32_t)((b >> 16) & 0xFF);
+  int32_t d3 = (int32_t)(a >> 24) - (int32_t)(b >> 24);
+  return abs(d0) + abs(d1) + abs(d2) + abs(d3);
+}
+
+uint32_t blockSad8(const uint8_t *a, const uint8_t *b, uint16_t stride) {
+  uint32_t sad = 0;
+  for (int row = 0; row < MD_BLOCK; row++, a += stride, b += stride) {
+    const uint32_t *wa = (const uint32_t *)a;
+    const uint32_t *wb = (const uint32_t *)b;
+    sad += sad4(wa[0], wb[0]) + sad4(wa[1], wb[1]);
+  }
+  return sad;
+}
+
+uint32_t blockSad8Bytes(const uint8_t *a, const uint8_t *b, uint16_t stride) {
+  uint32_t sad = 0;
+  for (int row = 0; row < MD_BLOCK; row++, a += stride, b += stride) {
+    for (int col = 0; col < MD_BLOCK; col++) {
+      sad += abs((int)a[col] - (int)b[col]);
+    }
+  }
+  return sad;
+}
+
+MotionDetector::MotionDetector(uint8_t threshold, uint16_t minBlocks) :
+  threshold(threshold), minBlocks(minBlocks), changed(0), ref(nullptr), refW(0), refH(0), 
+  haveRef(false) {
+}
+
+MotionDetector::~MotionDetector() {
+  free(ref);
+}
+
+bool MotionDetector::update(const uint8_t *luma, uint16_t w, uint16_t h) {
+  if (w != refW || h != refH) {
+    free(ref);
+    ref = (uint8_t *)malloc((size_t)w * h);
+    refW = ref == nullptr ? 0 : w;
+    refH = ref == nullptr ? 0 : h;
+    haveRef = false;
+    if (ref == nullptr) {
+      log_e("Unable to allocate the motion reference frame.");
+      return false;
+    }
+  }
+
+  bool motion = false;
+  changed = 0;
+  if (haveRef) {
+    uint32_t limit = (uint32_t)threshold * MD_BLOCK * MD_BLOCK;
+    bool aligned = ((uintptr_t)luma & 3) == 0 && (w & 3) == 0;
+    uint32_t (*sad)(const uint8_t *, const uint8_t *, uint16_t) = 
+      aligned ? blockSad8 : blockSad8Bytes;
+    for (uint16_t y = 0; y + MD_BLOCK <= h; y += MD_BLOCK) {
+      const uint8_t *a = luma + (size_t)y * w;
+      const uint8_t *b = ref + (size_t)y * w;
+      for (uint16_t x = 0; x + MD_BLOCK <= w; x += MD_BLOCK) {
+        if (sad(a + x, b + x, w) > limit) {
+          changed++;
+        }
+      }
+    }
+    motion = changed >= minBlocks;
+  }
+  memcpy(ref, luma, (size_t)w * h);
+  haveRef = true;
+  return motion;
+}
@@ -0,0 +1,207 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * OtaUpdate.cpp
+ *
+ * Implementation of the OtaUpdate class. See OtaUpdate.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "OtaUpdate.h"
+#include <Update.h>                               // Writing OTA app partitions
+#include <Preferences.h>                          // NVS access
+#include "esp_ota_ops.h"                          // esp_ota_get_*_partition()
+#include "esp_timer.h"                            // esp_timer_get_time()
+#include "Tracer.h"                               // TRACE_SCOPE()
+#include "esp_log.h"                              // log_?() support
+
+#define OTA_NAMESPACE     "ota"                     // NVS namespace for the record of the last update
+#define OTA_KEY           "last"                    // NVS key for the record of the last update
+#define OTA_MD5_CHARS     (32)                      // Hex digits in an MD5
+
+OtaUpdate::OtaUpdate() :
+  isReceiving(false), isReady(false), bytes(0), startMillis(0), lastWriteMillis(0),
+  finishedMillis(0) {
+  memset(&last, 0, sizeof(last));
+}
+
+void OtaUpdate::begin() {
+  Preferences prefs;
+  if (prefs.begin(OTA_NAMESPACE, true)) {
+    if (prefs.getBytesLength(OTA_KEY) == sizeof(last)) {
+      prefs.getBytes(OTA_KEY, &last, sizeof(last));
+    }
+    prefs.end();
+  }
+}
+
+bool OtaUpdate::start(const String &md5) {
+  abort();
+  errorText = "";
+  isReady = false;
+  if (md5.length() != 0 && md5.length() != OTA_MD5_CHARS) {
+    fail("The MD5 must be 32 hex digits.");
+    return false;
+  }
+  if (!Update.begin(UPDATE_SIZE_UNKNOWN, U_FLASH)) {
+    fail(Update.errorString());
+    return false;
+  }
+  if (md5.length() != 0 && !Update.setMD5(md5.c_str())) {
+    Update.abort();
+    fail("The MD5 must be 32 hex digits.");
+    return false;
+  }
+  isReceiving = true;
+  bytes = 0;
+  startMillis = lastWriteMillis = millis();
+  log_i("OTA update started.");
+  return true;
+}
+
+bool OtaUpdate::write(const uint8_t *data, size_t len) {
+  if (!isReceiving) {
+    return false;
+  }
+  TRACE_SCOPE("flashWrite");
+  if (Update.write((uint8_t *)data, len) != len) {
+    const char *why = Update.errorString();         // Before abort() replaces it
+    Update.abort();
+    isReceiving = false;
+    fail(why);
+    return false;
+  }
+  bytes += len;
+  lastWriteMillis = millis();
+  return true;
+}
+
+bool OtaUpdate::finish() {
+  if (!isReceiving) {
+    return false;
+  }
+  isReceiving = false;
+  unsigned long finishStart = millis();
+  if (!Update.end(true)) {
+    fail(Update.errorString());
+    return false;
+  }
+  finishedMillis = millis();
+  const esp_partition_t *target = esp_ota_get_boot_partition();
+  last.bytes = bytes;
+  last.uploadMillis = lastWriteMillis - startMillis;
+  last.finishMillis = finishedMillis - finishStart;
+  last.rebootMillis = 0;
+  last.readyMillis = 0;
+  strlcpy(last.target, target == nullptr ? "" : target->label, sizeof(last.target));
+  last.pending = true;
+  last.booted = false;
+  save();
+  isReady = true;
+  log_i("OTA update of %u bytes into %s received in %u ms and checked in %u ms.", last.bytes,
+    last.target, last.uploadMillis, last.finishMillis);
+  return true;
+}
+
+void OtaUpdate::abort() {
+  if (isReceiving) {
+    Update.abort();
+    isReceiving = false;
+    fail("Aborted.");
+  }
+}
+
+void OtaUpdate::restart() {
+  if (isReady) {
+    last.rebootMillis = millis() - finishedMillis;
+    save();
+  }
+  log_i("Restarting.");
+  ESP.restart();
+}
+
+void OtaUpdate::markReady() {
+  if (!last.pending) {
+    return;
+  }
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  last.readyMillis = esp_timer_get_time() / 1000;
+  last.booted = running != nullptr && strcmp(running->label, last.target) == 0;
+  last.pending = false;
+  save();
+  if (last.booted) {
+    log_i("Running the updated firmware; ready %u ms after reset.", last.readyMillis);
+  } else {
+    log_w("The updated firmware in %s didn't boot.", last.target);
+  }
+}
+
+String OtaUpdate::toJson() const {
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  const esp_partition_t *next = esp_ota_get_next_update_partition(nullptr);
+  String json = "{\"running\":\"";
+  json += running == nullptr ? "" : running->label;
+  json += "\",\"next\":\"";
+  json += next == nullptr ? "" : next->label;
+  json += "\",\"state\":\"";
+  json += isReceiving ? "receiving" : isReady ? "ready" : errorText.length() != 0 ? "failed" : "idle";
+  json += "\",\"bytes\":";
+  json += bytes;
+  json += ",\"error\":\"";
+  json += errorText;
+  json += "\",\"last\":";
+  if (last.target[0] == '\0') {
+    json += "null}";
+    return json;
+  }
+  json += "{\"target\":\"";
+  json += last.target;
+  json += "\",\"bytes\":";
+  json += last.bytes;
+  json += ",\"uploadMillis\":";
+  json += last.uploadMillis;
+  json += ",\"MBps\":";
+  json += last.uploadMillis == 0 ? String("null") : String((double)last.bytes / last.uploadMillis / 1000, 3);
+  json += ",\"finishMillis\":";
+  json += last.finishMillis;
+  json += ",\"rebootMillis\":";
+  json += last.rebootMillis;
+  json += ",\"uploadToRebootMillis\":";
+  json += last.uploadMillis + last.finishMillis + last.rebootMillis;
+  json += ",\"readyMillis\":";
+  json += last.readyMillis;
+  json += ",\"uploadToReadyMillis\":";
+  json += last.pending ? String("null") :
+    String(last.uploadMillis + last.finishMillis + last.rebootMillis + last.readyMillis);
+  json += ",\"pending\":";
+  json += last.pending ? "true" : "false";
+  json += ",\"booted\":";
+  json += last.booted ? "true" : "false";
+  json += "}}";
+  return json;
+}
+
+void OtaUpdate::fail(const char *what) {
+  errorText = what;
+  log_e("OTA update failed: %s", what);
+}
+
+void OtaUpdate::save() {
+  Preferences prefs;
+  if (!prefs.begin(OTA_NAMESPACE, false) || prefs.putBytes(OTA_KEY, &last, sizeof(last)) != sizeof(last)) {
+    log_w("Unable to save the OTA update record.");
+  }
+  prefs.end();
+}
@@ -0,0 +1,116 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * PowerManager.cpp
+ *
+ * Implementation of the PowerManager class. See PowerManager.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "PowerManager.h"
+#include "esp_timer.h"                            // esp_timer_get_time()
+#include "esp_log.h"                              // log_?() support
+
+PowerManager::PowerManager(uint16_t maxMhz, uint16_t minMhz, float boostWatts, float idleWatts) :
+  maxMhz(maxMhz), minMhz(minMhz), boostWatts(boostWatts), idleWatts(idleWatts), active(false), usePm(false), 
+  lock(nullptr), depth(0), startMicros(0), boostStartMicros(0), boostedMicros(0), boosts(0), 
+  switchMicros(0), maxSwitchMicros(0), captures(0) {
+}
+
+bool PowerManager::begin(bool lightSleep) {
+  startMicros = esp_timer_get_time();
+  active = true;
+#ifdef CONFIG_PM_ENABLE
+  esp_pm_config_esp32_t config = {
+    .max_freq_mhz = maxMhz,
+    .min_freq_mhz = minMhz,
+    .light_sleep_enable = lightSleep
+  };
+  esp_err_t err = esp_pm_configure(&config);
+  if (err == ESP_OK) {
+    err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "boost", &lock);
+  }
+  if (err == ESP_OK) {
+    usePm = true;
+    log_i("Power management: %d - %d MHz, light sleep %s.", minMhz, maxMhz, lightSleep ? "on" : "off");
+    return true;
+  }
+  log_w("Power management configuration failed (0x%x); falling back.", err);
+#else
+  (void)lightSleep;
+#endif
+  setCpuFrequencyMhz(minMhz);
+  return false;
+}
+
+void PowerManager::boost() {
+  if (!active || depth++ != 0) {
+    return;
+  }
+  uint64_t t0 = esp_timer_get_time();
+  if (usePm) {
+    esp_pm_lock_acquire(lock);
+  } else {
+    setCpuFrequencyMhz(maxMhz);
+  }
+  boostStartMicros = esp_timer_get_time();
+  uint32_t sw = boostStartMicros - t0;
+  switchMicros += sw;
+  maxSwitchMicros = max(maxSwitchMicros, sw);
+  boosts++;
+}
+
+void PowerManager::relax() {
+  if (!active || depth == 0 || --depth != 0) {
+    return;
+  }
+  boostedMicros += esp_timer_get_time() - boostStartMicros;
+  if (usePm) {
+    esp_pm_lock_release(lock);
+  } else {
+    setCpuFrequencyMhz(minMhz);
+  }
+}
+
+String PowerManager::toJson() const {
+  uint64_t now = esp_timer_get_time();
+  uint64_t boosted = boostedMicros + (depth != 0 ? now - boostStartMicros : 0);
+  float totalSecs = (now - startMicros) / 1e6f;
+  float boostedSecs = boosted / 1e6f;
+  float wattHours = (boostWatts * boostedSecs + idleWatts * (totalSecs - boostedSecs)) / 3600.0f;
+
+  String json = "{\"idfPm\":";
+  json += usePm ? "true" : "false";
+  json += ",\"cpuMhz\":";
+  json += getCpuFrequencyMhz();
+  json += ",\"uptimeSecs\":";
+  json += String(totalSecs, 1);
+  json += ",\"boostedSecs\":";
+  json += String(boostedSecs, 1);
+  json += ",\"boosts\":";
+  json += boosts;
+  json += ",\"meanSwitchMicros\":";
+  json += boosts == 0 ? 0 : switchMicros / boosts;
+  json += ",\"maxSwitchMicros\":";
+  json += maxSwitchMicros;
+  json += ",\"captures\":";
+  json += captures;
+  json += ",\"estWattHours\":";
+  json += String(wattHours, 4);
+  json += ",\"estCapturesPerWattHour\":";
+  json += String(wattHours > 0.0f ? captures / wattHours : 0.0f, 1);
+  json += "}";
+  return json;
+}
@@ -0,0 +1,85 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * PreviewFrame.cpp
+ *
+ * Implementation of the PreviewFrame class. See PreviewFrame.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "PreviewFrame.h"
+#include "esp_camera.h"                           // Camera support
+#include "img_converters.h"                       // jpg2rgb565()
+#include "Tracer.h"                               // traceBegin() and traceEnd()
+#include "esp_log.h"                              // log_?() support
+
+#define PF_SCALE_SHIFT    (3)                       // Decode at 1/8 scale
+
+PreviewFrame::PreviewFrame() : w(0), h(0), rgb(nullptr), y(nullptr) {
+}
+
+PreviewFrame::~PreviewFrame() {
+  free(rgb);
+  free(y);
+}
+
+bool PreviewFrame::grab() {
+  traceBegin("capture");
+  camera_fb_t *fb = esp_camera_fb_get();
+  traceEnd("capture");
+  if (!fb) {
+    log_w("Preview capture failed.");
+    return false;
+  }
+
+  // (Re)allocate the buffers if the frame size has changed
+  uint16_t fw = fb->width >> PF_SCALE_SHIFT;
+  uint16_t fh = fb->height >> PF_SCALE_SHIFT;
+  if (fw != w || fh != h) {
+    free(rgb);
+    free(y);
+    w = fw;
+    h = fh;
+    rgb = (uint8_t *)ps_malloc((size_t)w * h * 2);
+    y = (uint8_t *)malloc((size_t)w * h);
+    if (rgb == nullptr || y == nullptr) {
+      log_e("Unable to allocate preview buffers.");
+      free(rgb);
+      free(y);
+      rgb = y = nullptr;
+      w = h = 0;
+      esp_camera_fb_return(fb);
+      return false;
+    }
+  }
+
+  bool decoded = jpg2rgb565(fb->buf, fb->len, rgb, JPG_SCALE_8X);
+  esp_camera_fb_return(fb);
+  if (!decoded) {
+    log_w("Preview decode failed.");
+    return false;
+  }
+
+  // RGB565 (high byte first) to 8-bit luma, Y = (77 R + 150 G + 29 B) / 256
+  const uint8_t *p = rgb;
+  for (size_t i = 0; i < (size_t)w * h; i++, p += 2) {
+    uint16_t c = (p[0] << 8) | p[1];
+    uint32_t r = (c >> 8) & 0xF8;
+    uint32_t g = (c >> 3) & 0xFC;
+    uint32_t b = (c << 3) & 0xF8;
+    y[i] = (77 * r + 150 * g + 29 * b) >> 8;
+  }
+  return true;
+}
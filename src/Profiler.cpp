@@ -0,0 +1,78 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Profiler.cpp
+ *
+ * Implementation of the scoped profiler table. See Profiler.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "Profiler.h"
+
+#if PROFILE_ENABLE
+
+static ProfileSlot slots[PROFILE_MAX_SCOPES];       // The table
+static uint8_t nSlots = 0;                          // Entries in use
+static portMUX_TYPE slotsMux = portMUX_INITIALIZER_UNLOCKED;
+
+ProfileSlot *profileSlot(const char *name) {
+  ProfileSlot *slot = nullptr;
+  portENTER_CRITICAL(&slotsMux);
+  for (uint8_t i = 0; i < nSlots && slot == nullptr; i++) {
+    if (strcmp(slots[i].name, name) == 0) {
+      slot = &slots[i];
+    }
+  }
+  if (slot == nullptr && nSlots < PROFILE_MAX_SCOPES) {
+    slot = &slots[nSlots++];
+    *slot = {name, 0, 0, 0};
+  }
+  portEXIT_CRITICAL(&slotsMux);
+  return slot;
+}
+
+void profileReset() {
+  portENTER_CRITICAL(&slotsMux);
+  for (uint8_t i = 0; i < nSlots; i++) {
+    slots[i].calls = 0;
+    slots[i].totalCycles = 0;
+    slots[i].maxCycles = 0;
+  }
+  portEXIT_CRITICAL(&slotsMux);
+}
+
+String profileToJson() {
+  String json = "{\"cpuMhz\":";
+  json += getCpuFrequencyMhz();
+  json += ",\"scopes\":[";
+  for (uint8_t i = 0; i < nSlots; i++) {
+    const ProfileSlot &s = slots[i];
+    json += i == 0 ? "{\"name\":\"" : ",{\"name\":\"";
+    json += s.name;
+    json += "\",\"calls\":";
+    json += s.calls;
+    json += ",\"totalCycles\":";
+    json += String((double)s.totalCycles, 0);
+    json += ",\"meanCycles\":";
+    json += s.calls == 0 ? 0 : (uint32_t)(s.totalCycles / s.calls);
+    json += ",\"maxCycles\":";
+    json += s.maxCycles;
+    json += "}";
+  }
+  json += "]}";
+  return json;
+}
+
+#endif
@@ -0,0 +1,179 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * SamplingProfiler.cpp
+ *
+ * Implementation of the SamplingProfiler class. See SamplingProfiler.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "SamplingProfiler.h"
+#include "freertos/xtensa_context.h"              // XtExcFrame
+#include "esp_heap_caps.h"                        // heap_caps_malloc()
+#include "esp_log.h"                              // log_?() support
+
+#define SP_FIRST_TIMER    (0)                       // Hardware timer for core 0; core 1 uses the next
+#define SP_CORE_BIT       (0x80000000UL)            // Set in Sample.pc for samples from core 1
+#define SP_SETUP_MILLIS   (1000)                    // Most millis() to wait for timer setup on a core
+
+SamplingProfiler *SamplingProfiler::active = nullptr;
+static portMUX_TYPE profilerMux = portMUX_INITIALIZER_UNLOCKED;  // Both cores' ISRs share the ring
+
+namespace {
+// What a timerTask is to do
+struct TimerJob {
+  SamplingProfiler *profiler;
+  uint8_t core;
+  bool attach;
+  bool ok;
+  SemaphoreHandle_t done;
+};
+}
+
+SamplingProfiler::SamplingProfiler(uint16_t capacity) :
+  capacity(capacity), ring(nullptr), taken(0), isRunning(false), hz(0), seconds(0), 
+  startMillis(0), timers{nullptr, nullptr} {
+}
+
+void IRAM_ATTR SamplingProfiler::onTimer() {
+  SamplingProfiler *p = active;
+  if (p == nullptr || p->ring == nullptr) {
+    return;
+  }
+  uint32_t core = xPortGetCoreID();
+  const XtExcFrame *frame = *(XtExcFrame * const *)xTaskGetCurrentTaskHandleForCPU(core);
+  if (frame == nullptr) {
+    return;
+  }
+
+  // The windowed ABI keeps the call increment in a0's top two bits; code lives at 0x4xxxxxxx
+  uint32_t caller = (frame->a0 & 0x3FFFFFFFUL) | 0x40000000UL;
+  portENTER_CRITICAL_ISR(&profilerMux);
+  uint32_t ix = p->taken++ % p->capacity;
+  p->ring[ix].pc = (uint32_t)frame->pc | (core != 0 ? SP_CORE_BIT : 0);
+  p->ring[ix].caller = caller;
+  portEXIT_CRITICAL_ISR(&profilerMux);
+}
+
+void SamplingProfiler::timerTask(void *param) {
+  TimerJob *job = (TimerJob *)param;
+  SamplingProfiler *p = job->profiler;
+  uint8_t num = SP_FIRST_TIMER + job->core;
+  if (job->attach) {
+    // Interrupts are allocated on the core that asks, so this has to run on the core to sample
+    p->timers[job->core] = timerBegin(num, 80, true);
+    job->ok = p->timers[job->core] != nullptr;
+    if (job->ok) {
+      timerAttachInterrupt(p->timers[job->core], &SamplingProfiler::onTimer, true);
+      timerAlarmWrite(p->timers[job->core], 1000000UL / p->hz, true);
+      timerAlarmEnable(p->timers[job->core]);
+    }
+  } else {
+    // ...and freed on the core that allocated them
+    if (p->timers[job->core] != nullptr) {
+      timerAlarmDisable(p->timers[job->core]);
+      timerDetachInterrupt(p->timers[job->core]);
+      timerEnd(p->timers[job->core]);
+      p->timers[job->core] = nullptr;
+    }
+    job->ok = true;
+  }
+  xSemaphoreGive(job->done);
+  vTaskDelete(nullptr);
+}
+
+bool SamplingProfiler::runOnCore(uint8_t core, bool attach) {
+  TimerJob job = {this, core, attach, false, xSemaphoreCreateBinary()};
+  if (job.done == nullptr) {
+    return false;
+  }
+  bool ok = xTaskCreatePinnedToCore(timerTask, "profTimer", 2048, &job, 5, nullptr, core) == pdPASS &&
+    xSemaphoreTake(job.done, pdMS_TO_TICKS(SP_SETUP_MILLIS)) == pdTRUE && job.ok;
+  vSemaphoreDelete(job.done);
+  return ok;
+}
+
+bool SamplingProfiler::start(uint16_t samplesPerSec, uint16_t secs) {
+  if (isRunning || active != nullptr || samplesPerSec == 0) {
+    return false;
+  }
+  if (ring == nullptr) {
+    ring = (Sample *)heap_caps_malloc(sizeof(Sample) * capacity, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (ring == nullptr) {
+      log_e("Unable to allocate %d bytes for profile samples.", sizeof(Sample) * capacity);
+      return false;
+    }
+  }
+  hz = samplesPerSec;
+  seconds = secs;
+  taken = 0;
+  active = this;
+  isRunning = true;
+  startMillis = millis();
+  if (!runOnCore(0, true) || !runOnCore(1, true)) {
+    log_e("Unable to start the profiling timers.");
+    stop();
+    return false;
+  }
+  log_i("Profiling at %d Hz per core for %d s.", hz, seconds);
+  return true;
+}
+
+void SamplingProfiler::poll() {
+  if (isRunning && millis() - startMillis >= seconds * 1000UL) {
+    stop();
+  }
+}
+
+void SamplingProfiler::stop() {
+  runOnCore(0, false);
+  runOnCore(1, false);
+  active = nullptr;
+  if (isRunning) {
+    log_i("Profiling stopped with %d samples.", taken);
+  }
+  isRunning = false;
+}
+
+String SamplingProfiler::format(uint32_t first, uint16_t maxLines) const {
+  String text;
+  uint32_t held = samples();
+  uint32_t oldest = taken - held;
+  char line[32];
+  for (uint32_t i = first; i < held && i < first + maxLines; i++) {
+    const Sample &s = ring[(oldest + i) % capacity];
+    snprintf(line, sizeof(line), "%d %08x %08x\n", (s.pc & SP_CORE_BIT) ? 1 : 0, 
+      (unsigned)(s.pc & ~SP_CORE_BIT), (unsigned)s.caller);
+    text += line;
+  }
+  return text;
+}
+
+String SamplingProfiler::toJson() const {
+  String json = "{\"running\":";
+  json += isRunning ? "true" : "false";
+  json += ",\"hz\":";
+  json += hz;
+  json += ",\"seconds\":";
+  json += seconds;
+  json += ",\"taken\":";
+  json += taken;
+  json += ",\"held\":";
+  json += samples();
+  json += ",\"capacity\":";
+  json += capacity;
+  json += "}";
+  return json;
+}
@@ -0,0 +1,224 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * SdBench.cpp
+ *
+ * Implementation of the SdBench class. See SdBench.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "SdBench.h"
+#include "esp_log.h"                              // log_?() support
+
+const uint16_t SdBench::chunkSizes[SB_CHUNK_SIZES] = {512, 4096, 16384, SB_MAX_CHUNK};
+
+static const char *const phaseNames[] = {"write", "read", "random", "create", "delete", "done", "failed"};
+
+SdBench::SdBench(fs::FS &fs, DiskUsage &diskUsage, const String &scratchPath, const String &dirPath, 
+                 uint32_t fileBytes, uint16_t files) :
+  fs(fs), diskUsage(diskUsage), scratchPath(scratchPath), dirPath(dirPath), fileBytes(fileBytes), 
+  files(files), scratchCounted(0), phase(SB_WRITE), chunkIx(0), buf(nullptr), writeBytes{}, writeMicros{}, readBytes{}, readMicros{}, 
+  randomReads(0), randomMicros(0), created(0), createMicros(0), deleted(0), deleteMicros(0), 
+  error(nullptr) {
+  // Keep the scratch file a whole number of the largest chunks
+  this->fileBytes = max(fileBytes - fileBytes % SB_MAX_CHUNK, (uint32_t)SB_MAX_CHUNK);
+  buf = (uint8_t *)malloc(SB_MAX_CHUNK);
+  if (buf == nullptr) {
+    fail("Unable to allocate the I/O buffer.");
+    return;
+  }
+  for (uint32_t i = 0; i < SB_MAX_CHUNK; i++) {
+    buf[i] = (uint8_t)(i * 31 + 7);
+  }
+}
+
+SdBench::~SdBench() {
+  if (file) {
+    file.close();
+  }
+  free(buf);
+}
+
+String SdBench::testFilePath(uint16_t n) const {
+  return dirPath + "bench" + String(n) + ".tmp";
+}
+
+bool SdBench::fail(const char *why) {
+  log_e("SD benchmark: %s", why);
+  error = why;
+  phase = SB_FAILED;
+  if (file) {
+    file.close();
+  }
+  removeScratch();
+  for (uint16_t n = deleted; n < created; n++) {    // The test files not yet deleted
+    if (fs.remove(testFilePath(n))) {
+      diskUsage.add(testFilePath(n), 0, -1);
+    }
+  }
+  return false;
+}
+
+void SdBench::removeScratch() {
+  if (fs.remove(scratchPath) && scratchCounted != 0) {
+    diskUsage.add(scratchPath, -(int64_t)scratchCounted, -1);
+    scratchCounted = 0;
+  }
+}
+
+bool SdBench::step() {
+  unsigned long stepStart = micros();
+  while (micros() - stepStart < SB_STEP_MICROS) {
+    unsigned long t = micros();
+    switch (phase) {
+      case SB_WRITE: {
+        uint16_t chunk = chunkSizes[chunkIx];
+        if (writeBytes[chunkIx] == 0) {
+          file = fs.open(scratchPath, FILE_WRITE);
+          if (!file) {
+            return fail("Unable to create the scratch file.");
+          }
+        }
+        if (file.write(buf, chunk) != chunk) {
+          return fail("Write failed.");
+        }
+        writeBytes[chunkIx] += chunk;
+        if (writeBytes[chunkIx] >= fileBytes) {
+          file.close();
+          if (scratchCounted == 0) {
+            diskUsage.add(scratchPath, writeBytes[chunkIx], 1);
+            scratchCounted = writeBytes[chunkIx];
+          }
+          phase = SB_READ;
+        }
+        writeMicros[chunkIx] += micros() - t;
+        break;
+      }
+
+      case SB_READ: {
+        uint16_t chunk = chunkSizes[chunkIx];
+        if (readBytes[chunkIx] == 0) {
+          file = fs.open(scratchPath, FILE_READ);
+          if (!file) {
+            return fail("Unable to open the scratch file.");
+          }
+        }
+        if (file.read(buf, chunk) != chunk) {
+          return fail("Read failed.");
+        }
+        readBytes[chunkIx] += chunk;
+        bool finished = readBytes[chunkIx] >= fileBytes;
+        if (finished) {
+          file.close();
+        }
+        readMicros[chunkIx] += micros() - t;
+        if (finished) {
+          phase = ++chunkIx < SB_CHUNK_SIZES ? SB_WRITE : SB_RANDOM;
+        }
+        break;
+      }
+
+      case SB_RANDOM: {
+        if (randomReads == 0) {
+          file = fs.open(scratchPath, FILE_READ);
+          if (!file) {
+            return fail("Unable to open the scratch file.");
+          }
+        }
+        uint32_t offset = (esp_random() % (fileBytes / SB_RANDOM_BYTES)) * SB_RANDOM_BYTES;
+        if (!file.seek(offset) || file.read(buf, SB_RANDOM_BYTES) != SB_RANDOM_BYTES) {
+          return fail("Random read failed.");
+        }
+        randomMicros += micros() - t;
+        if (++randomReads >= SB_RANDOM_READS) {
+          file.close();
+          removeScratch();
+          phase = files > 0 ? SB_CREATE : SB_DONE;
+        }
+        break;
+      }
+
+      case SB_CREATE: {
+        File f = fs.open(testFilePath(created), FILE_WRITE);
+        if (!f) {
+          return fail("Unable to create a test file.");
+        }
+        f.close();
+        diskUsage.add(testFilePath(created), 0, 1);
+        createMicros += micros() - t;
+        if (++created >= files) {
+          phase = SB_DELETE;
+        }
+        break;
+      }
+
+      case SB_DELETE:
+        if (!fs.remove(testFilePath(deleted))) {
+          return fail("Unable to delete a test file.");
+        }
+        diskUsage.add(testFilePath(deleted), 0, -1);
+        deleteMicros += micros() - t;
+        if (++deleted >= files) {
+          phase = SB_DONE;
+        }
+        break;
+
+      case SB_DONE:
+      case SB_FAILED:
+        free(buf);
+        buf = nullptr;
+        return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Format a rate per second as JSON, given a count and the micros() it took
+ *
+ */
+static String rate(double count, uint64_t micros) {
+  return micros == 0 ? String("null") : String(count * 1000000.0 / micros, 2);
+}
+
+String SdBench::toJson() const {
+  String json = "{\"phase\":\"";
+  json += phaseNames[phase];
+  json += "\",\"fileBytes\":";
+  json += fileBytes;
+  json += ",\"sequential\":[";
+  for (uint8_t i = 0; i < SB_CHUNK_SIZES; i++) {
+    json += i == 0 ? "{\"chunk\":" : ",{\"chunk\":";
+    json += chunkSizes[i];
+    json += ",\"writeMBps\":";
+    json += rate(writeBytes[i] / 1000000.0, writeMicros[i]);
+    json += ",\"readMBps\":";
+    json += rate(readBytes[i] / 1000000.0, readMicros[i]);
+    json += "}";
+  }
+  json += "],\"random4kOps\":";
+  json += rate(randomReads, randomMicros);
+  json += ",\"createOps\":";
+  json += rate(created, createMicros);
+  json += ",\"deleteOps\":";
+  json += rate(deleted, deleteMicros);
+  if (error != nullptr) {
+    json += ",\"error\":\"";
+    json += error;
+    json += "\"";
+  }
+  json += "}";
+  return json;
+}
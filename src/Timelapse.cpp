@@ -0,0 +1,220 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Timelapse.cpp
+ *
+ * Implementation of the Timelapse class. See Timelapse.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "Timelapse.h"
+#include "Tracer.h"                               // TRACE_SCOPE()
+#include "esp_log.h"                              // log_?() support
+
+Timelapse::Timelapse(fs::FS &fs, DiskUsage &diskUsage, const char *dir, size_t batchBytes, 
+  uint8_t batchFrames, uint32_t maxFrames) :
+  fs(fs), diskUsage(diskUsage), dir(dir), batchBytes(batchBytes), batchFrames(batchFrames), maxFrames(maxFrames), batch(nullptr), 
+  batchUsed(0), batchIndex(nullptr), batchCount(0), isRunning(false), interval(0), count(0), 
+  taken(0), dataBytes(0), startMillis(0), nextMillis(0), flushes(0), flushMicros(0), aviCounted(0), 
+  idxCounted(0) {
+}
+
+Timelapse::~Timelapse() {
+  stop();
+}
+
+bool Timelapse::start(uint32_t intervalMillis, uint32_t frameCount, uint16_t width, uint16_t height, 
+  uint8_t fps) {
+  stop();
+
+  batch = (uint8_t *)ps_malloc(batchBytes);
+  batchIndex = (IndexEntry *)malloc(sizeof(IndexEntry) * batchFrames);
+  if (batch == nullptr || batchIndex == nullptr) {
+    log_e("Unable to allocate the timelapse batch buffer.");
+    stop();
+    return false;
+  }
+
+  // Find an unused name for the sequence
+  if (!fs.exists(dir.substring(0, dir.length() - 1))) {
+    fs.mkdir(dir.substring(0, dir.length() - 1));
+  }
+  uint16_t n = 1;
+  while (fs.exists(dir + "TL" + String(n) + ".idx")) {
+    n++;
+  }
+  name = "TL" + String(n);
+  index = fs.open(dir + name + ".idx", FILE_WRITE);
+  if (!index || !avi.open(fs, dir + name + ".avi", width, height, fps, 
+                          frameCount == 0 ? maxFrames : min(frameCount, maxFrames))) {
+    log_e("Unable to create the files for timelapse %s.", name.c_str());
+    stop();
+    return false;
+  }
+  index.write((const uint8_t *)TL_MAGIC, 4);
+  index.write((const uint8_t *)&intervalMillis, sizeof(intervalMillis));
+  diskUsage.add(dir + name + ".avi", avi.size(), 1);
+  diskUsage.add(dir + name + ".idx", index.size(), 1);
+  aviCounted = avi.size();
+  idxCounted = index.size();
+
+  interval = intervalMillis;
+  count = frameCount;
+  taken = 0;
+  dataBytes = avi.size();
+  batchUsed = 0;
+  batchCount = 0;
+  flushes = 0;
+  flushMicros = 0;
+  startMillis = nextMillis = millis();
+  isRunning = true;
+  log_i("Timelapse %s started: a frame every %d ms.", name.c_str(), interval);
+  return true;
+}
+
+void Timelapse::stop() {
+  if (isRunning) {
+    flush();
+    log_i("Timelapse %s stopped after %d frames.", name.c_str(), taken);
+  }
+  isRunning = false;
+  if (avi.isOpen()) {
+    avi.close();
+    if (aviCounted != 0) {
+      File f = fs.open(dir + name + ".avi", FILE_READ);
+      grew(".avi", aviCounted, f.size());
+      f.close();
+    }
+  }
+  if (index) {
+    index.close();
+  }
+  aviCounted = 0;
+  idxCounted = 0;
+  free(batch);
+  batch = nullptr;
+  free(batchIndex);
+  batchIndex = nullptr;
+}
+
+bool Timelapse::due() const {
+  return isRunning && (long)(millis() - nextMillis) >= 0;
+}
+
+uint32_t Timelapse::millisToNext() const {
+  return due() ? 0 : nextMillis - millis();
+}
+
+bool Timelapse::addFrame(const uint8_t *jpg, size_t len) {
+  if (!isRunning) {
+    return false;
+  }
+
+  // Make room in the batch, or, if the frame will never fit, write it straight through
+  size_t chunkLen = AviWriter::chunkSize(len);
+  if (batchCount == batchFrames || batchUsed + chunkLen > batchBytes) {
+    if (!flush()) {
+      stop();
+      return false;
+    }
+  }
+  IndexEntry entry = {dataBytes + AVI_CHUNK_HEADER, (uint32_t)len, (uint32_t)(millis() - startMillis)};
+  if (chunkLen > batchBytes) {
+    if (!avi.addFrame(jpg, len) || 
+        index.write((const uint8_t *)&entry, sizeof(entry)) != sizeof(entry)) {
+      log_e("Timelapse write failed.");
+      stop();
+      return false;
+    }
+    index.flush();
+    grew(".avi", aviCounted, avi.size());
+    grew(".idx", idxCounted, index.size());
+  } else {
+    AviWriter::formatChunk(batch + batchUsed, jpg, len);
+    batchUsed += chunkLen;
+    batchIndex[batchCount++] = entry;
+  }
+  dataBytes += chunkLen;
+  taken++;
+
+  // Schedule the next frame, skipping any we've fallen too far behind to take
+  nextMillis += interval;
+  if ((long)(millis() - nextMillis) > 0) {
+    nextMillis = millis();
+  }
+  if ((count != 0 && taken >= count) || taken >= avi.capacity()) {
+    stop();
+  }
+  return true;
+}
+
+bool Timelapse::flush() {
+  if (batchCount == 0) {
+    return true;
+  }
+  TRACE_SCOPE("sdWrite");
+  unsigned long startMicros = micros();
+  size_t idxBytes = sizeof(IndexEntry) * batchCount;
+  bool ok = avi.addChunks(batch, batchUsed) && 
+    index.write((const uint8_t *)batchIndex, idxBytes) == idxBytes;
+  index.flush();
+  grew(".avi", aviCounted, avi.size());
+  grew(".idx", idxCounted, index.size());
+  flushMicros += micros() - startMicros;
+  flushes++;
+  log_d("Timelapse batch of %d frames (%d bytes) written in %lu us.", batchCount, batchUsed, 
+    micros() - startMicros);
+  batchUsed = 0;
+  batchCount = 0;
+  if (!ok) {
+    log_e("Timelapse batch write failed.");
+  }
+  return ok;
+}
+
+/**
+ * @brief Report the growth of one of the sequence's files to diskUsage
+ *
+ * @param ext     Which file: ".avi" or ".idx"
+ * @param counted The bytes of it reported so far; updated
+ * @param bytes   Its size now
+ */
+void Timelapse::grew(const char *ext, uint32_t &counted, uint32_t bytes) {
+  diskUsage.add(dir + name + ext, (int64_t)bytes - counted, 0);
+  counted = bytes;
+}
+
+String Timelapse::toJson() const {
+  String json = "{\"running\":";
+  json += isRunning ? "true" : "false";
+  json += ",\"name\":\"";
+  json += name;
+  json += "\",\"intervalMillis\":";
+  json += interval;
+  json += ",\"count\":";
+  json += count;
+  json += ",\"taken\":";
+  json += taken;
+  json += ",\"bytes\":";
+  json += dataBytes;
+  json += ",\"batchesWritten\":";
+  json += flushes;
+  json += ",\"meanBatchMicros\":";
+  json += flushes == 0 ? 0 : flushMicros / flushes;
+  json += ",\"millisToNext\":";
+  json += millisToNext();
+  json += "}";
+  return json;
+}
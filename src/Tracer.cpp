@@ -0,0 +1,146 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Tracer.cpp
+ *
+ * Implementation of the event tracer. See Tracer.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "Tracer.h"
+#include "esp_timer.h"                            // esp_timer_get_time()
+#include "esp_log.h"                              // log_?() support
+
+#if PROFILE_ENABLE
+
+// A trace event
+struct TraceEvent {
+  uint32_t micros;                                  // esp_timer_get_time() when it happened (low 32 bits)
+  const char *name;                                 // The span's name
+  char phase;                                       // 'B' or 'E'
+  uint8_t task;                                     // Index of the task in tasks[]
+  uint8_t core;                                     // The core it ran on
+};
+
+// A task seen in the trace
+struct TraceTask {
+  TaskHandle_t handle;                              // Its handle
+  char name[configMAX_TASK_NAME_LEN];               // Its name when first seen
+};
+
+static TraceEvent *ring = nullptr;                  // The ring buffer
+static uint32_t recorded = 0;                       // Events recorded since the last clear
+static bool enabled = false;                        // Whether events are being recorded
+static TraceTask tasks[TRACE_MAX_TASKS];            // The tasks seen so far; the last is "others"
+static uint8_t nTasks = 0;                          // Entries of tasks[] in use
+static portMUX_TYPE traceMux = portMUX_INITIALIZER_UNLOCKED;
+
+bool traceInit() {
+  if (ring == nullptr) {
+    ring = (TraceEvent *)ps_malloc(sizeof(TraceEvent) * TRACE_EVENTS);
+    if (ring == nullptr) {
+      log_e("Unable to allocate %d bytes for the trace buffer.", sizeof(TraceEvent) * TRACE_EVENTS);
+      return false;
+    }
+  }
+  enabled = true;
+  return true;
+}
+
+/**
+ * @brief Find (or make) the tasks[] entry for the running task. Call inside the critical section.
+ *
+ */
+static uint8_t taskIndex(TaskHandle_t handle) {
+  for (uint8_t i = 0; i < nTasks; i++) {
+    if (tasks[i].handle == handle) {
+      return i;
+    }
+  }
+  if (nTasks == TRACE_MAX_TASKS) {
+    return TRACE_MAX_TASKS - 1;
+  }
+  tasks[nTasks].handle = handle;
+  if (nTasks == TRACE_MAX_TASKS - 1) {
+    strcpy(tasks[nTasks].name, "others");
+  } else {
+    strncpy(tasks[nTasks].name, pcTaskGetTaskName(handle), sizeof(tasks[nTasks].name) - 1);
+    tasks[nTasks].name[sizeof(tasks[nTasks].name) - 1] = '\0';
+  }
+  return nTasks++;
+}
+
+static void traceEvent(const char *name, char phase) {
+  if (!enabled) {
+    return;
+  }
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  TaskHandle_t handle = xTaskGetCurrentTaskHandle();
+  portENTER_CRITICAL(&traceMux);
+  TraceEvent &e = ring[recorded++ % TRACE_EVENTS];
+  e = {now, name, phase, taskIndex(handle), (uint8_t)xPortGetCoreID()};
+  portEXIT_CRITICAL(&traceMux);
+}
+
+void traceBegin(const char *name) {
+  traceEvent(name, 'B');
+}
+
+void traceEnd(const char *name) {
+  traceEvent(name, 'E');
+}
+
+void traceEnable(bool on) {
+  enabled = on && ring != nullptr;
+}
+
+void traceClear() {
+  portENTER_CRITICAL(&traceMux);
+  recorded = 0;
+  portEXIT_CRITICAL(&traceMux);
+}
+
+uint16_t traceCount() {
+  return recorded < TRACE_EVENTS ? recorded : TRACE_EVENTS;
+}
+
+String traceMetadataJson() {
+  String json = "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"ObscuraCam\"}}";
+  for (uint8_t i = 0; i < nTasks; i++) {
+    json += ",{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":";
+    json += i + 1;
+    json += ",\"args\":{\"name\":\"";
+    json += tasks[i].name;
+    json += "\"}}";
+  }
+  return json;
+}
+
+String traceEventsJson(uint16_t first, uint16_t count) {
+  String json;
+  uint16_t held = traceCount();
+  uint32_t oldest = recorded - held;
+  uint32_t base = held == 0 ? 0 : ring[oldest % TRACE_EVENTS].micros;
+  char buf[112];
+  for (uint16_t i = first; i < held && i < first + count; i++) {
+    const TraceEvent &e = ring[(oldest + i) % TRACE_EVENTS];
+    snprintf(buf, sizeof(buf), ",{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%u,\"pid\":1,\"tid\":%d,"
+      "\"args\":{\"core\":%d}}", e.name, e.phase, (unsigned)(e.micros - base), e.task + 1, e.core);
+    json += buf;
+  }
+  return json;
+}
+
+#endif
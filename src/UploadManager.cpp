@@ -0,0 +1,172 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * UploadManager.cpp
+ *
+ * Implementation of the UploadManager class. See UploadManager.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "UploadManager.h"
+#include "Tracer.h"                               // TRACE_SCOPE()
+#include "esp_log.h"                              // log_?() support
+
+UploadManager::UploadManager(fs::FS &fs, size_t bufferBytes) :
+  fs(fs), bufferBytes(bufferBytes), buf(nullptr), used(0), inUse(false), current{0, 0}, 
+  nReceived(0), startMicros(0), activeMicros(0), uploads(0), bytes(0), failures(0), flushes(0), 
+  flushBytes(0), flushMicros(0) {
+}
+
+UploadManager::~UploadManager() {
+  if (inUse) {
+    file.close();
+  }
+  free(buf);
+}
+
+bool UploadManager::begin() {
+  if (buf != nullptr) {
+    return true;
+  }
+  buf = (uint8_t *)ps_malloc(bufferBytes);
+  if (buf == nullptr) {
+    log_e("Unable to allocate %d bytes for the upload buffer.", bufferBytes);
+    return false;
+  }
+  return true;
+}
+
+bool UploadManager::open(const UploadKey &key, const String &path, const char *mode) {
+  if (buf == nullptr) {
+    return false;
+  }
+  if (inUse) {
+    log_w("Upload: \"%s\" was never finished.", filePath.c_str());
+    abort();
+  }
+  file = fs.open(path, mode);
+  if (!file) {
+    log_w("Upload: unable to open \"%s\".", path.c_str());
+    return false;
+  }
+  inUse = true;
+  current = key;
+  filePath = path;
+  used = 0;
+  nReceived = 0;
+  startMicros = micros();
+  return true;
+}
+
+bool UploadManager::write(const uint8_t *data, size_t len) {
+  if (!inUse) {
+    return false;
+  }
+  nReceived += len;
+  while (len > 0) {
+    size_t n = min(len, bufferBytes - used);
+    memcpy(buf + used, data, n);
+    used += n;
+    data += n;
+    len -= n;
+    if (used == bufferBytes && !flush()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool UploadManager::flush() {
+  if (used == 0) {
+    return true;
+  }
+  TRACE_SCOPE("sdWrite");
+  unsigned long t0 = micros();
+  bool ok = file.write(buf, used) == used;
+  flushMicros += micros() - t0;
+  flushBytes += used;
+  flushes++;
+  used = 0;
+  if (!ok) {
+    log_e("Upload: write to \"%s\" failed.", filePath.c_str());
+  }
+  return ok;
+}
+
+void UploadManager::release() {
+  inUse = false;
+  filePath = String();
+  activeMicros += micros() - startMicros;
+}
+
+bool UploadManager::close() {
+  if (!inUse) {
+    return false;
+  }
+  bool ok = flush();
+  file.close();
+  if (ok) {
+    uploads++;
+    bytes += nReceived;
+    log_d("Upload: \"%s\", %d bytes in %lu us.", filePath.c_str(), nReceived, 
+      micros() - startMicros);
+  } else {
+    failures++;
+  }
+  release();
+  return ok;
+}
+
+void UploadManager::abort() {
+  if (!inUse) {
+    return;
+  }
+  file.close();
+  fs.remove(filePath);
+  failures++;
+  log_w("Upload: \"%s\" abandoned after %d bytes.", filePath.c_str(), nReceived);
+  release();
+}
+
+String UploadManager::toJson() const {
+  uint64_t busy = activeMicros + (inUse ? micros() - startMicros : 0);
+  uint64_t total = bytes + (inUse ? nReceived : 0);
+  String json = "{\"active\":";
+  if (inUse) {
+    json += "{\"path\":\"";
+    json += filePath;
+    json += "\",\"received\":";
+    json += nReceived;
+    json += "}";
+  } else {
+    json += "null";
+  }
+  json += ",\"uploads\":";
+  json += uploads;
+  json += ",\"failures\":";
+  json += failures;
+  json += ",\"bytes\":";
+  json += String((double)bytes, 0);
+  json += ",\"MBps\":";
+  json += busy == 0 ? String("null") : String((double)total / busy, 3);
+  json += ",\"flushes\":";
+  json += flushes;
+  json += ",\"meanFlushBytes\":";
+  json += flushes == 0 ? 0 : (uint32_t)(flushBytes / flushes);
+  json += ",\"sdMBps\":";
+  json += flushMicros == 0 ? String("null") : String((double)flushBytes / flushMicros, 3);
+  json += "}";
+  return json;
+}
@@ -49,6 +49,8 @@
 #include "WiFi.h"                                 // WiFi support
 #include "ESPmDNS.h"                              // mDNS support
 #include "WebServer.h"                            // Web server support
+#include "uri/UriGlob.h"                          // Wildcard URIs for handlers
+#include "LoggingWebServer.h"                     // WebServer that keeps an access log
 #include "esp_camera.h"                           // Camera support
 #include "sensor.h"                               // Camera sensor support
 #include "FS.h"                                   // File system
@@ -56,6 +58,28 @@
 #include "esp_log.h"                              // log_?() support
 #include "soc/soc.h"                              // Disable brownout checking
 #include <EEPROM.h>                               // EEPROM access
+#include "Keystone.h"                             // Perspective correction
+#include "PreviewFrame.h"                         // Low-res grayscale frames between photos
+#include "ExposureController.h"                   // Our own auto exposure
+#include "JpegSharpness.h"                        // Sharpness scoring for best-of-burst
+#include "MotionDetector.h"                       // Frame differencing for motion-triggered capture
+#include "Timelapse.h"                            // Timelapse scheduling and storage
+#include "esp_sleep.h"                            // Light sleep between timelapse frames
+#include "PowerManager.h"                         // Dynamic CPU frequency scaling
+#include "BootProfiler.h"                         // Startup phase timing
+#include "Profiler.h"                             // PROFILE_SCOPE() cycle-count timing
+#include "SamplingProfiler.h"                     // Timer-interrupt PC sampling
+#include "Tracer.h"                               // TRACE_SCOPE() begin/end event timeline
+#include "Job.h"                                  // Background jobs
+#include "SdBench.h"                              // SD card benchmark job
+#include "HealthMonitor.h"                        // Heap and latency trends
+#include "FsCheck.h"                              // File system consistency check job
+#include "UploadManager.h"                        // Per-upload state and buffered SD writes
+#include "OtaUpdate.h"                            // Streaming OTA firmware updates
+#include "BatchJob.h"                             // Many file operations as one background job
+#include "FileCopy.h"                             // SD to SD file copies
+#include "DiskUsage.h"                            // Cached storage accounting
+#include "Config.h"                               // Settings from a file on the SD card
 
 // Pin definition for CAMERA_MODEL_AI_THINKER
 #define PWDN_GPIO_NUM     (32)
@@ -79,7 +103,7 @@
 #define BANNER            "\nObscuraCam v0.1.0\n"
 #define IC_ADDR           (0)                       // Image counter address in "EEPROM"
 #define SERIAL_MILLIS     (3000)                    // Millis to wait for Serial to become ready
-#define AP_MILLIS         (100)                     // Millis to wait for AP to become ready
+#define AP_MILLIS         (2000)                    // Most millis to wait for AP to become ready
 #define FLASH_MILLIS      (200)                     // LED_BUILTIN default flash length (millis())
 #define FAIL_MILLIS       (1000)                    // millis() between flash groups for init failures
 #define READY_FLASH_COUNT  (5)                      // Number of flashes to say hello/goodbye
@@ -91,7 +115,87 @@
 #define AWAKE_MILLIS      (300000UL)                // millis() to stay awake waiting for shutter press
 #define PHOTO_PATH        "/photos/"                // The full path for dir where photos are to be kept
 #define PHOTO_PREFIX      "Image"                   // The filename prefix for the photos taken
+#define CONFIG_PATH       "/config.txt"             // The file on the SD card that can override the defaults
+#define CAM_FRAME_SIZE    (FRAMESIZE_UXGA)          // Default photo size (with PSRAM)
+#define CAM_JPEG_QUALITY  (10)                      // Default photo JPEG quality (0 - 63, lower is better)
 #define VIEW_URL_FRONT    "/view.htm?image="        // The first part of the url for the page to view the new pix
+#define BURST_MAX         (5)                       // Most frames /snap?burst=n may choose the sharpest from
+#define MAX_PATH_CHARS    (128)                     // Longest SD card path accepted in a request
+#define LIST_MAX_ENTRIES  (2048)                    // Most entries /list will return
+#define NOT_FOUND_ARGS    (8)                       // Most request arguments echoed in a 404 response
+#define NOT_FOUND_CHARS   (64)                      // Most characters of each one echoed
+#define UPLOAD_BUF_BYTES  (32768)                   // Buffer gathering upload data for SD writes (PSRAM)
+#define FILES_URI         "/files"                  // URI prefix for raw-body PUT and PATCH uploads
+#define TEMP_SUFFIX       ".tmp"                    // Added to a file's name while it's being uploaded
+#define PART_SUFFIX       ".part"                   // Added to a file's name while a resumable upload is partial
+#define EDIT_COPY_BYTES   (65536)                   // Size of the PUT /edit copy buffer (PSRAM)
+#define EDIT_COPY_MICROS  (100000UL)                // micros() of copying between yield()s
+#define BATCH_MAX_BYTES   (32768)                   // Largest /batch request body accepted
+#define BATCH_COPY_BYTES  (32768)                   // Size of a /batch job's copy buffer (PSRAM)
+#define OTA_REBOOT_MILLIS (1000UL)                 // millis() from a reboot request to the restart
+#define RANGE_BUF_BYTES   (2048)                    // Size of the buffer for sending byte ranges of files
+
+// Keystone (perspective) correction
+#define KEYSTONE_ENABLE   (false)                   // Whether to correct the perspective of photos
+#define KEYSTONE_SCALE    (1)                       // log2 of how much to scale photos down when correcting
+#define KEYSTONE_QUALITY  (80)                      // JPEG quality (1 - 100) of corrected photos
+#define KEYSTONE_MILLIS   (1500)                    // Most millis() correction may add; else keep original
+#define KEYSTONE_CORNERS  {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f} // Default keystoneCorners: none
+
+// Exposure control
+#define AE_ENABLE         (true)                    // Whether to use our exposure control, not the sensor's
+#define AE_TARGET         (200)                     // Target luma (0 - 255) for the metered percentile
+#define AE_PERCENTILE     (95)                      // Percentile of the luma histogram to meter
+#define AE_TOLERANCE      (12)                      // How close to AE_TARGET is close enough
+#define AE_MAX_FRAMES     (8)                       // Most preview frames one metering pass may use
+#define AE_IDLE_MILLIS    (15000UL)                 // millis() between metering passes
+#define AE_STEP_MILLIS    (250UL)                   // millis() between frames in a pass; lets changes take
+
+// Motion-triggered capture
+#define MOTION_ENABLE     (false)                   // Whether motion-triggered capture starts out on
+#define MOTION_MILLIS     (500UL)                   // Default millis() between motion checks (the duty cycle)
+#define MOTION_THRESHOLD  (12)                      // Mean per-pixel difference for an 8 x 8 block to have changed
+#define MOTION_BLOCKS     (6)                       // Changed blocks that count as motion
+#define MOTION_HOLDOFF    (10000UL)                 // Min millis() between motion-triggered photos
+
+// Timelapse
+#define TIMELAPSE_PATH    "/timelapse/"             // The dir where timelapse sequences are to be kept
+#define TL_BATCH_BYTES    (1024 * 1024)             // Size of the PSRAM buffer for batching frame writes
+#define TL_BATCH_FRAMES   (8)                       // Most frames to batch before writing them out
+#define TL_MIN_SLEEP      (2000UL)                  // Don't light sleep for fewer millis() than this
+#define TL_WARMUP_FRAMES  (2)                       // Frames to discard after waking from light sleep
+#define TL_MAX_FRAMES     (4096)                    // Most frames in one timelapse AVI
+#define TL_FPS            (10)                      // Playback frame rate of timelapse AVIs
+
+// Power management
+#define PM_ENABLE         (true)                    // Whether to scale the CPU clock with the workload
+#define PM_MAX_MHZ        (240)                     // CPU clock while capturing or sending (MHz)
+#define PM_MIN_MHZ        (80)                      // CPU clock while idle (MHz)
+#define PM_LIGHT_SLEEP    (true)                    // Whether to allow automatic light sleep when idle
+#define PM_BOOST_WATTS    (1.2f)                    // Nominal board power draw at PM_MAX_MHZ (W)
+#define PM_IDLE_WATTS     (0.7f)                    // Nominal board power draw at PM_MIN_MHZ (W)
+
+// Sampling profiler (PROFILE_ENABLE builds only)
+#define PROF_SAMPLES      (4096)                    // Sample ring buffer size (8 bytes each, internal RAM)
+#define PROF_HZ           (250)                     // Default samples per second per core
+#define PROF_MAX_HZ       (2000)                    // Most samples per second per core allowed
+#define PROF_MAX_SECONDS  (120)                     // Longest sampling run allowed (s)
+#define PROF_LINES        (256)                     // Samples formatted per chunk of a /profile dump
+#define TRACE_CHUNK       (128)                     // Events formatted per chunk of a /trace.json dump
+
+// Benchmarks
+#define BENCH_SD_SCRATCH  "/bench.tmp"              // The SD benchmark's scratch file
+#define BENCH_SD_MB       (4)                       // Default SD benchmark scratch file size (MB)
+#define BENCH_SD_MAX_MB   (64)                      // Largest SD benchmark scratch file allowed (MB)
+#define BENCH_SD_FILES    (50)                      // Files the SD benchmark creates and deletes
+#define DU_SCAN_MILLIS    (60UL * 60 * 1000)        // millis() between disk usage reconciling scans
+#define BENCH_NET_CHUNK   (RANGE_BUF_BYTES)         // Bytes per write in the network benchmark
+#define BENCH_NET_MAX     (64UL * 1024 * 1024)      // Largest network benchmark download allowed (bytes)
+
+// Health monitoring
+#define HEALTH_SNAPSHOTS  (288)                     // Health snapshots kept (36 bytes each, PSRAM)
+#define HEALTH_MILLIS     (5UL * 60 * 1000)         // millis() between health snapshots (24 h kept)
+#define HEALTH_BUDGET_MICROS (5000000UL)            // Requests taking longer than this are over budget
 
 // AP- and Webserver-related constants
 #define SSID              "ObscuraCam"              // The AP's SSID and the mDNS name for the web server
@@ -101,10 +205,104 @@
 #define SUBNET            (255, 255, 255, 0)        // The subnet mask
 #define PORT              (80)                      // The web server's port
 
+// Access log
+#define ACCESS_LOG_PATH   "/logs/access.bin"        // The access log file (the previous one is access.old)
+#define ACCESS_ENTRIES    (256)                     // Access log ring buffer size (48 bytes each, PSRAM)
+#define ACCESS_BATCH      (64)                      // Entries to accumulate before writing them when idle
+#define ACCESS_IDLE_MILLIS (2000UL)                 // millis() without a request before writing entries
+#define ACCESS_MAX_BYTES  (1024UL * 1024)           // Access log size at which a new one is started
+
+// The phases of setup() timed by the boot profiler
+enum BootPhase : uint8_t {
+  BOOT_SERIAL,                                      // Waiting for Serial
+  BOOT_AP,                                          // Starting the AP and mDNS
+  BOOT_HTTP,                                        // Starting the web server
+  BOOT_CAMERA,                                      // Initializing the camera
+  BOOT_SD,                                          // Mounting the SD card
+  BOOT_RECOVERY,                                    // Recovering timelapse AVIs
+  BOOT_EEPROM,                                      // Reading the image counter from "EEPROM"
+  BOOT_READY_FLASH,                                 // Flashing the LED to say we're ready
+  BOOT_CONFIG,                                      // Reading the config file
+  BOOT_PHASE_COUNT
+};
+const char *const bootPhaseNames[BOOT_PHASE_COUNT] = {
+  "serial", "ap", "http", "camera", "sd", "recovery", "eeprom", "readyFlash", "config"
+};
+
 // Global variables
-WebServer server(PORT);                             // The web server
+const Settings defaultSettings = {                  // The settings when there's no config file
+  SSID, PASSWORD, IPAddress LOCAL_IP, IPAddress GATEWAY, IPAddress SUBNET, CAM_FRAME_SIZE, 
+  CAM_JPEG_QUALITY, PHOTO_PATH, AE_ENABLE, AE_IDLE_MILLIS, MOTION_ENABLE, MOTION_MILLIS, 
+  KEYSTONE_ENABLE, KEYSTONE_CORNERS
+};
+Settings settings = defaultSettings;                // The settings in effect
+bool validPath(const String &path);                 // Path checking, used by configFile (see below)
+ConfigFile configFile(CONFIG_PATH, validPath);      // Where they come from
+bool configRebootNeeded = false;                    // Whether a reload changed settings only a reboot applies
+framesize_t maxFrameSize;                           // The frame size the camera was started with
+DiskUsage diskUsage(DU_SCAN_MILLIS);                // Cached per-directory storage use
+AccessLog accessLog(SD_MMC, diskUsage, ACCESS_LOG_PATH, ACCESS_ENTRIES, ACCESS_BATCH, ACCESS_IDLE_MILLIS, 
+                    ACCESS_MAX_BYTES);
+LoggingWebServer server(PORT, accessLog);           // The web server
 uint16_t imageCtr;                                  // The image counter for numbering image files
-File uploadFile;                                    // File handle for uploading files
+uint8_t fbCount;                                    // Number of camera frame buffers
+UploadManager uploads(SD_MMC, UPLOAD_BUF_BYTES);     // The upload in progress
+struct UploadStats {                                // Completed upload statistics for one protocol
+  uint32_t uploads;                                 //   Uploads completed
+  uint64_t bytes;                                   //   Bytes they transferred
+  uint64_t micros;                                  //   micros() they took, start to end
+};
+UploadStats multipartStats = {0, 0, 0};             // For multipart POSTs to /edit
+UploadStats rawStats = {0, 0, 0};                   // For raw-body PUTs to FILES_URI
+int rawUploadCode = 500;                            // HTTP status for the current raw-body PUT or PATCH
+int postUploadCode = 200;                           // HTTP status for the current multipart POST to /edit
+uint32_t postUploadPass = 0;                        // The server.pass() postUploadCode belongs to
+FileCopy fileCopy(SD_MMC, diskUsage, EDIT_COPY_BYTES); // Does PUT /edit copies
+struct {                                            // PUT /edit copy statistics
+  uint32_t copies;                                  //   Copies completed
+  uint64_t bytes;                                   //   Bytes they copied
+  uint64_t micros;                                  //   micros() they took
+} copyStats = {0, 0, 0};
+OtaUpdate ota;                                      // Firmware updates
+uint32_t otaPass = 0;                               // The server.pass() the last image arrived in
+bool rebootPending = false;                         // Whether a restart has been asked for
+unsigned long rebootMillis;                         // millis() when it's to happen
+Keystone keystone;                                  // Perspective corrector for photos
+PreviewFrame preview;                               // The latest low-res grayscale preview
+ExposureController exposure(AE_TARGET, AE_PERCENTILE, AE_TOLERANCE, AE_MAX_FRAMES);
+unsigned long aeMillis = 0;                         // millis() at the last exposure metering step
+MotionDetector motion(MOTION_THRESHOLD, MOTION_BLOCKS);
+bool motionEnabled = MOTION_ENABLE;                 // Whether motion-triggered capture is on
+unsigned long motionInterval = MOTION_MILLIS;       // millis() between motion checks
+unsigned long motionMillis = 0;                     // millis() at the last motion check
+unsigned long motionPhotoMillis = 0;                // millis() at the last motion-triggered photo
+struct {                                            // Motion detection statistics
+  unsigned long sinceMillis;                        //   millis() when they were last reset
+  uint32_t passes;                                  //   Frames checked for motion
+  uint32_t triggers;                                //   Motion-triggered photos taken
+  uint64_t busyMicros;                              //   micros() spent checking
+  String lastPhoto;                                 //   Path of the last motion-triggered photo
+} motionStats;
+Timelapse timelapse(SD_MMC, diskUsage, TIMELAPSE_PATH, TL_BATCH_BYTES, TL_BATCH_FRAMES, 
+                    TL_MAX_FRAMES);
+bool timelapseSleep = false;                        // Whether to light sleep between timelapse frames
+bool apStopped = false;                             // Whether the AP is off for a sleeping timelapse
+PowerManager power(PM_MAX_MHZ, PM_MIN_MHZ, PM_BOOST_WATTS, PM_IDLE_WATTS);
+BootProfiler bootProfiler(bootPhaseNames, BOOT_PHASE_COUNT);
+JobRunner jobs;                                     // The background job, if any
+JobRunner duScan;                                   // The DiskUsageScan, if any; runs apart from jobs
+HealthMonitor health(HEALTH_SNAPSHOTS, HEALTH_MILLIS, HEALTH_BUDGET_MICROS);
+struct NetBenchResult {                             // Result of a network benchmark run
+  uint32_t bytes;                                   //   Bytes transferred
+  uint32_t micros;                                  //   micros() it took
+  unsigned long atMillis;                           //   millis() when it finished; 0 if never run
+};
+NetBenchResult netDownload = {0, 0, 0};             // The last /bench/net download
+NetBenchResult netUpload = {0, 0, 0};               // The last /bench/upload upload
+unsigned long netUploadStart;                       // micros() when the current upload started
+#if PROFILE_ENABLE
+SamplingProfiler sampler(PROF_SAMPLES);             // Statistical profiler for both cores
+#endif
 
 /**
  * @brief Flash the built-in little red LED
@@ -123,6 +321,52 @@ void flashBuiltinLed(uint8_t flashCount, uint8_t flashLen = FLASH_MILLIS) {
   }
 }
 
+/**
+ * @brief   Start the WiFi access point and mDNS
+ * 
+ * @details The AP configuration is kept in NVS (WiFi.persistent()), so on every boot after the 
+ *          first the driver comes up already configured and softAP() has nothing to change. The 
+ *          PHY's RF calibration data is likewise kept in NVS by the framework, so only a quick 
+ *          partial calibration is done at startup. The AP's address isn't among what's kept, so 
+ *          softAPConfig() runs every time. Rather than sleeping for a fixed time, we wait for the 
+ *          driver to report that the AP has started, up to AP_MILLIS.
+ * 
+ */
+void startAp() {
+  unsigned long startMillis = millis();
+  (void)startMillis;                                // Only logged
+#if !defined(CONFIG_ESP_PHY_CALIBRATION_AND_DATA_STORAGE) && !defined(CONFIG_ESP32_PHY_CALIBRATION_AND_DATA_STORAGE)
+  log_w("RF calibration data isn't being stored; every boot does a full calibration.");
+#endif
+
+  // Initialize the AP
+  WiFi.persistent(true);
+  WiFi.mode(WIFI_AP);
+  if (!WiFi.softAP(settings.ssid.c_str(), settings.password.c_str())) {
+    log_e("Unable to start the AP.");
+  }
+  WiFi.softAPConfig(settings.localIp, settings.gateway, settings.subnet);
+  if ((WiFi.waitStatusBits(AP_STARTED_BIT, AP_MILLIS) & AP_STARTED_BIT) == 0) {
+    log_w("AP didn't report starting within %d ms.", AP_MILLIS);
+  }
+
+  // Initialize mDNS, setting the name to be the same as <our SSID>.local
+  if (!MDNS.begin(settings.ssid.c_str())) {
+    log_w("mDNS initialization failed.");
+  }
+  log_i("AP ready in %lu ms (%lu ms after boot).", millis() - startMillis, millis());
+}
+
+/**
+ * @brief   Stop mDNS and the WiFi access point, turning off the radio
+ * 
+ */
+void stopAp() {
+  MDNS.end();
+  WiFi.softAPdisconnect(true);
+  WiFi.mode(WIFI_OFF);
+}
+
 /**
  * @brief   Convenience function to send http 200 response and no content
  * 
@@ -142,6 +386,90 @@ void returnFail(String msg) {
 }
 
 
+/**
+ * @brief   Check that a path from a request is one we're willing to hand to the file system: 
+ *          absolute, no longer than MAX_PATH_CHARS, with no control characters, backslashes, 
+ *          empty segments, "." segments or ".." segments. ("/." is the root, so "/./a" is "/a" 
+ *          and deleting "/." deletes everything.)
+ * 
+ * @param path    The path to check
+ * @return true   It's acceptable
+ * @return false  It isn't
+ */
+bool validPath(const String &path) {
+  if (path.length() == 0 || path.length() > MAX_PATH_CHARS || path[0] != '/') {
+    return false;
+  }
+  for (size_t i = 0; i < path.length(); i++) {
+    char c = path[i];
+    if ((uint8_t)c < ' ' || c == 0x7F || c == '\\' || (c == '/' && i > 0 && path[i - 1] == '/')) {
+      return false;
+    }
+  }
+  return path.indexOf("/./") < 0 && !path.endsWith("/.") && path.indexOf("/../") < 0 && 
+    !path.endsWith("/..");
+}
+
+/**
+ * @brief   Send part of a file as the response to an http GET request with a "Range" header.
+ * 
+ * @details Only a single range is supported: "bytes=<first>-<last>", "bytes=<first>-" or 
+ *          "bytes=-<suffix length>". A satisfiable range gets a 206 response; anything else gets 
+ *          a 416.
+ * 
+ * @param dataFile  The open file
+ * @param dataType  Its MIME data type
+ * @param range     The value of the Range header
+ */
+void sendRange(File &dataFile, const String &dataType, const String &range) {
+  size_t size = dataFile.size();
+  size_t first = 0;
+  size_t last = size - 1;
+  int dash = range.indexOf('-');
+  bool ok = size > 0 && range.startsWith("bytes=") && dash > 0 && range.indexOf(',') < 0;
+  if (ok) {
+    String from = range.substring(6, dash);
+    String to = range.substring(dash + 1);
+    if (from.length() == 0) {
+      // Suffix range: the last n bytes
+      size_t n = to.toInt();
+      ok = n > 0;
+      first = n >= size ? 0 : size - n;
+    } else {
+      first = from.toInt();
+      if (to.length() > 0) {
+        last = min((size_t)to.toInt(), size - 1);
+      }
+      ok = first <= last;
+    }
+  }
+  if (!ok) {
+    server.sendHeader("Content-Range", "bytes */" + String(size));
+    server.send(416, "text/plain", "");
+    return;
+  }
+
+  size_t len = last - first + 1;
+  server.sendHeader("Content-Range", "bytes " + String(first) + "-" + String(last) + "/" + String(size));
+  server.sendHeader("Accept-Ranges", "bytes");
+  server.setContentLength(len);
+  server.send(206, dataType.c_str(), "");
+  dataFile.seek(first);
+  uint8_t buf[RANGE_BUF_BYTES];
+  size_t nSent = 0;
+  while (nSent < len) {
+    size_t n = dataFile.read(buf, min(sizeof(buf), len - nSent));
+    if (n == 0 || server.client().write(buf, n) != n) {
+      break;
+    }
+    server.countBytes(n);
+    nSent += n;
+  }
+  if (nSent != len) {
+    log_e("Expected to send %d bytes, but %d were actually sent.", len, nSent);
+  }
+}
+
 /**
  * @brief   Send the contents of a file on the SD card as the response to an http GET request
  * 
@@ -154,6 +482,9 @@ void returnFail(String msg) {
  *          http request includes the argument "download" the file will be labeled 
  *          "application/octet-stream".
  * 
+ *          If the request has a "Range" header, only the requested part of the file is sent, so 
+ *          a timelapse AVI can be played or a download resumed without fetching it all.
+ * 
  *          When successful, an HTTP 200 response is sent.
  * 
  * @param path    The complete path for the file to be served
@@ -161,6 +492,11 @@ void returnFail(String msg) {
  * @return false  Nope. Couldn't find the file.
  */
 bool loadFromSdCard(String path) {
+  PROFILE_SCOPE("loadFromSdCard");
+  if (!validPath(path)) {
+    return false;
+  }
+  CpuBoost boost(power);
   String dataType = "text/plain";
   if (path.endsWith("/")) {
     path += "index.htm";
@@ -190,6 +526,8 @@ bool loadFromSdCard(String path) {
     dataType = "application/pdf";
   } else if (path.endsWith(".zip")) {
     dataType = "application/zip";
+  } else if (path.endsWith(".avi")) {
+    dataType = "video/x-msvideo";
   }
 
   File dataFile = SD_MMC.open(path.c_str());
@@ -207,6 +545,12 @@ bool loadFromSdCard(String path) {
   if (server.hasArg("download")) {
     dataType = "application/octet-stream";
   }
+  if (server.hasHeader("Range")) {
+    sendRange(dataFile, dataType, server.header("Range"));
+    dataFile.close();
+    return true;
+  }
+  server.sendHeader("Accept-Ranges", "bytes");
   size_t nSent = server.streamFile(dataFile, dataType);
   if (nSent != dataFile.size()) {
     log_e("Expected to send %d bytes, but %d were actually sent.", dataFile.size(), nSent);
@@ -217,65 +561,191 @@ bool loadFromSdCard(String path) {
 }
 
 /**
- * @brief HTTP POST handler for use by /edit/index.htm. Haven't analyzed it.
+ * @brief   The key identifying the current client's upload in uploads: its address and port
+ * 
+ */
+UploadKey uploadKey() {
+  WiFiClient client = server.client();
+  return {(uint32_t)client.remoteIP(), client.remotePort()};
+}
+
+/**
+ * @brief   The size of a file on the SD card; 0 if it doesn't exist
+ * 
+ */
+size_t fileSize(const String &path) {
+  File file = SD_MMC.open(path);
+  size_t size = file ? file.size() : 0;
+  file.close();
+  return size;
+}
+
+/**
+ * @brief   Put an uploaded file in place: replace path with the temporary file it was written to
+ * 
+ * @param tmpPath The temporary file
+ * @param path    Where it belongs
+ * @return true   Success
+ * @return false  Couldn't remove the old file or rename the new one
+ */
+bool commitUpload(const String &tmpPath, const String &path) {
+  if (SD_MMC.exists(path)) {
+    size_t oldSize = fileSize(path);
+    if (!SD_MMC.remove(path)) {
+      return false;
+    }
+    diskUsage.add(path, -(int64_t)oldSize, -1);
+  }
+  size_t size = fileSize(tmpPath);
+  if (!SD_MMC.rename(tmpPath, path)) {
+    return false;
+  }
+  diskUsage.add(path, size, 1);
+  return true;
+}
+
+/**
+ * @brief HTTP POST upload handler for use by /edit/index.htm. The upload's state lives in 
+ *        uploads, keyed by the client's address and port. The data are written to 
+ *        <filename>TEMP_SUFFIX, which replaces the file only once the upload is complete, so an 
+ *        interrupted upload leaves the original as it was. A failure is recorded in 
+ *        postUploadCode for onFilePost to reply with. The code starts over at 200 with the 
+ *        first file of each request: a request whose upload was torn off is dropped without 
+ *        onFilePost being called, so it can't be relied on to reset it.
  * 
  */
 void handleFileUpload() {
+  PROFILE_SCOPE("handleFileUpload");
   if (server.uri() != "/edit") {
     return;
   }
   HTTPUpload &upload = server.upload();
+  UploadKey key = uploadKey();
   if (upload.status == UPLOAD_FILE_START) {
-    if (SD_MMC.exists((char *)upload.filename.c_str())) {
-      SD_MMC.remove((char *)upload.filename.c_str());
+    if (postUploadPass != server.pass()) {
+      postUploadPass = server.pass();
+      postUploadCode = 200;
+    }
+    if (!validPath(upload.filename)) {
+      log_w("Upload: rejected filename \"%.*s\"", MAX_PATH_CHARS, upload.filename.c_str());
+      postUploadCode = 400;
+      return;
+    }
+    if (!uploads.open(key, upload.filename + TEMP_SUFFIX)) {
+      postUploadCode = 500;
     }
-    uploadFile = SD_MMC.open(upload.filename.c_str(), FILE_WRITE);
     log_d("Upload: START, filename: %s", upload.filename.c_str());
-  } else if (upload.status == UPLOAD_FILE_WRITE) {
-    if (uploadFile) {
-      uploadFile.write(upload.buf, upload.currentSize);
+    return;
+  }
+  if (!uploads.isOpen(key)) {
+    return;
+  }
+  if (upload.status == UPLOAD_FILE_WRITE) {
+    if (!uploads.write(upload.buf, upload.currentSize)) {
+      uploads.abort();
+      postUploadCode = 500;
     }
     log_d("Upload: WRITE, Bytes: %d", upload.currentSize);
   } else if (upload.status == UPLOAD_FILE_END) {
-    if (uploadFile) {
-      uploadFile.close();
+    uint32_t micros = uploads.elapsed();
+    String tmpPath = uploads.path();
+    if (!uploads.close() || !commitUpload(tmpPath, upload.filename)) {
+      log_e("Upload: unable to save \"%s\".", upload.filename.c_str());
+      postUploadCode = 500;
+    } else {
+      multipartStats.uploads++;
+      multipartStats.bytes += upload.totalSize;
+      multipartStats.micros += micros;
     }
     log_d("Upload: END, Size: %d", upload.totalSize);
+  } else if (upload.status == UPLOAD_FILE_ABORTED) {
+    uploads.abort();                                // No reply: the server drops the request
+  }
+}
+
+/**
+ * @brief HTTP POST handler for /edit, called once handleFileUpload has dealt with the uploaded 
+ *        files. Replies 200 if they were all saved, 400 if a filename was refused, or 500 if 
+ *        one couldn't be written.
+ * 
+ */
+void onFilePost() {
+  int code = postUploadCode;
+  postUploadCode = 200;
+  if (code == 400) {
+    server.send(400, "text/plain", "BAD PATH\r\n");
+  } else if (code == 500) {
+    returnFail("UPLOAD FAILED");
+  } else {
+    returnOK();
   }
 }
 
 /**
- * @brief function used by handleDelete. Haven't analyzed it.
+ * @brief function used by handleDelete. Deletes the file or directory tree at path. The walk 
+ *        keeps the directories it's working its way down in a list on the heap rather than 
+ *        recursing, so however deep the tree is, the stack can't overflow, and nothing is left 
+ *        half deleted because it was too deep.
  * 
  * @param path 
+ * @return true   Everything was deleted
+ * @return false  Something couldn't be removed and is still there
  */
-void deleteRecursive(String path) {
+bool deleteRecursive(String path) {
+  PROFILE_SCOPE("deleteRecursive");
   File file = SD_MMC.open((char *)path.c_str());
   if (!file.isDirectory()) {
+    size_t size = file.size();
     file.close();
-    SD_MMC.remove((char *)path.c_str());
-    return;
+    if (!SD_MMC.remove((char *)path.c_str())) {
+      return false;
+    }
+    diskUsage.add(path, -(int64_t)size, -1);
+    return true;
   }
+  file.close();
 
-  file.rewindDirectory();
-  while (true) {
-    File entry = file.openNextFile();
-    if (!entry) {
-      break;
+  std::vector<String> dirs;                         // The directories being deleted, innermost last
+  dirs.push_back(path);
+  while (!dirs.empty()) {
+    String dirPath = dirs.back();
+    File dir = SD_MMC.open((char *)dirPath.c_str());
+    if (!dir) {
+      return false;
     }
-    String entryPath = path + "/" + entry.name();
-    if (entry.isDirectory()) {
-      entry.close();
-      deleteRecursive(entryPath);
-    } else {
+    bool deeper = false;
+    while (true) {
+      File entry = dir.openNextFile();
+      if (!entry) {
+        break;
+      }
+      String entryPath = dirPath + "/" + entry.name();
+      if (entry.isDirectory()) {
+        entry.close();
+        dirs.push_back(entryPath);
+        deeper = true;
+        break;
+      }
+      size_t size = entry.size();
       entry.close();
-      SD_MMC.remove((char *)entryPath.c_str());
+      if (!SD_MMC.remove((char *)entryPath.c_str())) {
+        dir.close();
+        return false;
+      }
+      diskUsage.add(entryPath, -(int64_t)size, -1);
+      yield();
     }
-    yield();
+    dir.close();
+    if (deeper) {
+      continue;
+    }
+    if (!SD_MMC.rmdir((char *)dirPath.c_str())) {
+      return false;
+    }
+    diskUsage.removeDir(dirPath);
+    dirs.pop_back();
   }
-
-  SD_MMC.rmdir((char *)path.c_str());
-  file.close();
+  return true;
 }
 
 /**
@@ -287,24 +757,91 @@ void handleDelete() {
     return returnFail("BAD ARGS");
   }
   String path = server.arg(0);
-  if (path == "/" || !SD_MMC.exists((char *)path.c_str())) {
+  if (path == "/" || !validPath(path) || !SD_MMC.exists((char *)path.c_str())) {
     returnFail("BAD PATH");
     return;
   }
-  deleteRecursive(path);
+  if (!deleteRecursive(path)) {
+    return returnFail("DELETE FAILED");
+  }
   returnOK();
 }
 
 /**
- * @brief HTTP PUT handler for /edit/index.htm. Haven't analyzed it.
+ * @brief The PUT /edit handler for requests with a "src" argument. Moves (renames) the file or 
+ *        directory "src" to "path" or, with the argument "copy", copies the file "src" to "path" 
+ *        on the SD card, so nothing has to be downloaded and uploaded again. A move only changes 
+ *        directory entries, whatever the size. A copy goes EDIT_COPY_BYTES at a time through 
+ *        fileCopy; its reply reports the copy's throughput and the running totals as JSON.
+ * 
+ */
+void handleMove() {
+  String src = server.arg("src");
+  String path = server.arg("path");
+  if (src == "/" || path == "/" || !validPath(src) || !validPath(path) || 
+      path.startsWith(src + "/") || !SD_MMC.exists(src) || SD_MMC.exists(path)) {
+    return returnFail("BAD PATH");
+  }
+  if (!server.hasArg("copy")) {
+    File file = SD_MMC.open(src);
+    bool isDir = file.isDirectory();
+    size_t size = isDir ? 0 : file.size();
+    file.close();
+    if (!SD_MMC.rename(src, path)) {
+      return returnFail("MOVE FAILED");
+    }
+    if (isDir) {
+      diskUsage.moveDir(src, path);
+    } else {
+      diskUsage.add(src, -(int64_t)size, -1);
+      diskUsage.add(path, size, 1);
+    }
+    return returnOK();
+  }
+
+  CpuBoost boost(power);
+  if (!fileCopy.begin(src, path)) {
+    return returnFail(String("COPY FAILED: ") + fileCopy.error());
+  }
+  while (fileCopy.step(EDIT_COPY_MICROS)) {
+    yield();
+  }
+  if (!fileCopy.ok()) {
+    return returnFail(String("COPY FAILED: ") + fileCopy.error());
+  }
+  copyStats.copies++;
+  copyStats.bytes += fileCopy.bytes();
+  copyStats.micros += fileCopy.micros();
+  String json = "{\"bytes\":";
+  json += fileCopy.bytes();
+  json += ",\"micros\":";
+  json += fileCopy.micros();
+  json += ",\"MBps\":";
+  json += fileCopy.micros() == 0 ? String("null") : String((double)fileCopy.bytes() / fileCopy.micros(), 3);
+  json += ",\"copies\":";
+  json += copyStats.copies;
+  json += ",\"totalBytes\":";
+  json += String((double)copyStats.bytes, 0);
+  json += ",\"meanMBps\":";
+  json += copyStats.micros == 0 ? String("null") : String((double)copyStats.bytes / copyStats.micros, 3);
+  json += "}";
+  server.send(200, "text/json", json);
+}
+
+/**
+ * @brief HTTP PUT handler for /edit/index.htm. Haven't analyzed it. With a "src" argument, moves 
+ *        or copies instead; see handleMove().
  * 
  */
 void handleCreate() {
   if (server.args() == 0) {
     return returnFail("BAD ARGS");
   }
+  if (server.hasArg("src")) {
+    return handleMove();
+  }
   String path = server.arg(0);
-  if (path == "/" || SD_MMC.exists((char *)path.c_str())) {
+  if (path == "/" || !validPath(path) || SD_MMC.exists((char *)path.c_str())) {
     returnFail("BAD PATH");
     return;
   }
@@ -313,6 +850,7 @@ void handleCreate() {
     File file = SD_MMC.open((char *)path.c_str(), FILE_WRITE);
     if (file) {
       file.write(0);
+      diskUsage.add(path, file.size(), 1);
       file.close();
     }
   } else {
@@ -326,11 +864,12 @@ void handleCreate() {
  * 
  */
 void printDirectory() {
+  PROFILE_SCOPE("printDirectory");
   if (!server.hasArg("dir")) {
     return returnFail("BAD ARGS");
   }
   String path = server.arg("dir");
-  if (path != "/" && !SD_MMC.exists((char *)path.c_str())) {
+  if (!validPath(path) || (path != "/" && !SD_MMC.exists((char *)path.c_str()))) {
     return returnFail("BAD PATH");
   }
   File dir = SD_MMC.open((char *)path.c_str());
@@ -344,7 +883,7 @@ void printDirectory() {
   server.send(200, "text/json", "");
 
   server.sendContent("[");
-  for (int cnt = 0; true; ++cnt) {
+  for (int cnt = 0; cnt < LIST_MAX_ENTRIES; ++cnt) {
     File entry = dir.openNextFile();
     if (!entry) {
       break;
@@ -369,118 +908,1139 @@ void printDirectory() {
 }
 
 /**
- * @brief HTTP GET handler for /snap. User's browser is redirected to this "page" when the user 
- *        clicks the "Take photo" button on /index.htm on on /view.htm. Here we take a photo and 
- *        store on the SD card. Once this is accomplished, the user's browser is redirected to 
- *        /view.htm?image=<path to stored image>, which displays the image for the user.
+ * @brief   Save a photo to the SD card as the next <photoPath>PHOTO_PREFIXn.jpg and commit the 
+ *          image counter to "EEPROM".
  * 
+ * @param buf           The JPEG image
+ * @param len           Its length (bytes)
+ * @param imageFilePath Set to the path of the file the photo was saved in
+ * @return true         Success
+ * @return false        Unable to create the file
  */
-void onSnap() {
-  // Capture image
-  camera_fb_t * fb = esp_camera_fb_get();  
-  if(!fb) {
-    returnFail("Camera capture failed.");
-    return;
-  }
-  log_d("Got the framebuffer.");
-
+bool savePhoto(const uint8_t *buf, size_t len, String &imageFilePath) {
   // Figure out what to call the image file
-  String imageFilePath = String(PHOTO_PATH) + PHOTO_PREFIX + String(++imageCtr) + ".jpg";
+  imageFilePath = settings.photoPath + PHOTO_PREFIX + String(imageCtr + 1) + ".jpg";
   log_d("The file name for the image is '%s'.", imageFilePath.c_str());
 
   // Save the image
   File file = SD_MMC.open(imageFilePath.c_str(), FILE_WRITE);
   if(!file){
-    returnFail("Unable to create the file for the image.");
-    return;
+    return false;
+  }
+  traceBegin("sdWrite");
+  size_t sz = file.write(buf, len);
+  file.close();
+  traceEnd("sdWrite");
+  diskUsage.add(imageFilePath, sz, 1);
+  if (sz != len) {
+    log_e("Expected to write %d bytes, but %d were actually written.", len, sz);
   }
-  size_t sz = file.write(fb->buf, fb->len);
-  log_d("Saved image to: '%s' (%d bytes)", imageFilePath.c_str(), fb->len);
-  EEPROM.writeUShort(IC_ADDR, imageCtr);
+  log_d("Saved image to: '%s' (%d bytes)", imageFilePath.c_str(), len);
+  EEPROM.writeUShort(IC_ADDR, ++imageCtr);
+  traceBegin("eepromCommit");
   EEPROM.commit();
-
-  flashBuiltinLed(SNAP_FLASH_COUNT);
+  traceEnd("eepromCommit");
   log_d("Committed imageCtr (%d) to 'eeprom'.", imageCtr);
+  power.countCapture();
+  return true;
+}
+
+/**
+ * @brief   If keystone correction is enabled, correct the perspective of the photo in fb.
+ * 
+ * @details The lookup table is (re)built from settings.keystoneCorners the first time it's needed 
+ *          for a given frame size or after the corners change. If the correction fails or can't 
+ *          be done within KEYSTONE_MILLIS, the photo is left as is.
+ * 
+ * @param fb      The frame buffer holding the photo
+ * @param out     Set to the corrected JPEG, a malloc()ed buffer the caller must free()
+ * @param outLen  Set to its length (bytes)
+ * @return true   The photo was corrected
+ * @return false  It wasn't; use the original
+ */
+bool correctPerspective(camera_fb_t *fb, uint8_t **out, size_t *outLen) {
+  if (!settings.keystoneEnable) {
+    return false;
+  }
+  uint16_t w = fb->width >> KEYSTONE_SCALE;
+  uint16_t h = fb->height >> KEYSTONE_SCALE;
+  if (!keystone.ready() || keystone.width() != w || keystone.height() != h) {
+    if (!keystone.begin(w, h, settings.keystoneCorners)) {
+      return false;
+    }
+  }
+  return keystone.correctJpeg(fb->buf, fb->len, KEYSTONE_SCALE, KEYSTONE_QUALITY, KEYSTONE_MILLIS, 
+    out, outLen);
+}
+
+/**
+ * @brief   Take a burst of photos and keep only the sharpest.
+ * 
+ * @details Relies on having two frame buffers: the best frame so far is held in one while the 
+ *          next is captured into the other. Each is scored by jpegSharpness(), which works on the 
+ *          JPEG's coefficients without decoding it.
+ * 
+ * @param fb      The first frame of the burst, already captured
+ * @param count   The number of frames in the burst
+ * @return        The sharpest of the frames. The others have been returned to the camera.
+ */
+camera_fb_t *pickSharpest(camera_fb_t *fb, uint8_t count) {
+  uint32_t bestScore = jpegSharpness(fb->buf, fb->len);
+  for (uint8_t i = 1; i < count; i++) {
+    traceBegin("capture");
+    camera_fb_t *next = esp_camera_fb_get();
+    traceEnd("capture");
+    if (!next) {
+      log_w("Burst capture %d failed.", i);
+      break;
+    }
+    uint32_t score = jpegSharpness(next->buf, next->len);
+    log_d("Burst frame %d sharpness: %d", i, score);
+    if (score > bestScore) {
+      esp_camera_fb_return(fb);
+      fb = next;
+      bestScore = score;
+    } else {
+      esp_camera_fb_return(next);
+    }
+  }
+  log_d("Kept the sharpest of %d burst frames (sharpness %d).", count, bestScore);
+  return fb;
+}
+
+/**
+ * @brief   Take a photo and store it on the SD card. This is the capture and storage path for 
+ *          everything that takes photos: /snap and motion-triggered capture.
+ * 
+ * @param burst         The number of frames to choose the sharpest from (1: just one)
+ * @param imageFilePath Set to the path of the file the photo was saved in
+ * @return true         Success
+ * @return false        Capture failed or the photo couldn't be saved
+ */
+bool takePhoto(uint8_t burst, String &imageFilePath) {
+  CpuBoost boost(power);
+
+  // Capture image
+  traceBegin("capture");
+  camera_fb_t * fb = esp_camera_fb_get();  
+  traceEnd("capture");
+  if(!fb) {
+    log_e("Camera capture failed.");
+    return false;
+  }
+  log_d("Got the framebuffer.");
+
+  // If asked for a burst, keep the sharpest frame of it. (Needs both frame buffers.)
+  if (burst > 1 && fbCount > 1) {
+    fb = pickSharpest(fb, burst);
+  }
+
+  // Correct its perspective if we've been asked to
+  uint8_t *jpg = nullptr;
+  size_t jpgLen = 0;
+  bool corrected = correctPerspective(fb, &jpg, &jpgLen);
+
+  // Save the image
+  bool saved = corrected ? savePhoto(jpg, jpgLen, imageFilePath) : savePhoto(fb->buf, fb->len, imageFilePath);
 
   // Clean up
-  file.close();
+  if (corrected) {
+    free(jpg);
+  }
   esp_camera_fb_return(fb);
+  if (!saved) {
+    log_e("Unable to create the file for the image.");
+  }
+  return saved;
+}
+
+/**
+ * @brief HTTP GET handler for /snap. User's browser is redirected to this "page" when the user 
+ *        clicks the "Take photo" button on /index.htm on on /view.htm. Here we take a photo and 
+ *        store on the SD card. Once this is accomplished, the user's browser is redirected to 
+ *        /view.htm?image=<path to stored image>, which displays the image for the user.
+ * 
+ *        With the argument "burst=<n>", n photos (up to BURST_MAX) are taken and only the 
+ *        sharpest is kept.
+ * 
+ */
+void onSnap() {
+  PROFILE_SCOPE("onSnap");
+  uint8_t burst = server.hasArg("burst") ? constrain(server.arg("burst").toInt(), 1, BURST_MAX) : 1;
+  String imageFilePath;
+  if (!takePhoto(burst, imageFilePath)) {
+    returnFail("Unable to take the photo.");
+    return;
+  }
+  flashBuiltinLed(SNAP_FLASH_COUNT);
 
   // Redirect request to the page that will show the new photo
   server.sendHeader("Location", VIEW_URL_FRONT + imageFilePath, true);
   server.send(302, "Found");
 }
 
-void onNotFound() {
-  // Not a request for something handled programmatically; try to get it from the SD card
-  if (loadFromSdCard(server.uri())) {
+/**
+ * @brief HTTP GET handler for /exposure. Reports the state of the exposure controller as JSON.
+ * 
+ */
+void onExposure() {
+  server.send(200, "text/json", exposure.toJson());
+}
+
+/**
+ * @brief   Called from loop() to keep the exposure right between photos. Once every 
+ *          settings.aeIdleMillis a metering pass starts. During a pass, a preview frame is metered every 
+ *          AE_STEP_MILLIS until the exposure is on target or AE_MAX_FRAMES have been used.
+ * 
+ */
+void meterExposure() {
+  unsigned long interval = exposure.converged() ? settings.aeIdleMillis : AE_STEP_MILLIS;
+  if (millis() - aeMillis < interval) {
     return;
   }
+  aeMillis = millis();
+  if (exposure.converged()) {
+    exposure.restart();
+  }
+  CpuBoost boost(power);
+  if (preview.grab()) {
+    exposure.update(preview.luma(), (size_t)preview.width() * preview.height());
+  }
+}
 
-  log_d("Handling page not found.");
-
-  String message = "File Not Found\n\n";
-  message += "URI: ";
-  message += server.uri();
-  message += "\nMethod: ";
-  message += (server.method() == HTTP_GET) ? "GET" : "POST";
-  message += "\nArguments: ";
-  message += server.args();
-  message += "\n";
-
-  for (uint8_t i = 0; i < server.args(); i++) {
-    message += " " + server.argName(i) + ": " + server.arg(i) + "\n";
+/**
+ * @brief   HTTP GET handler for /motion. Configures motion-triggered capture and reports its 
+ *          state and cost as JSON. Optional arguments:
+ *            enable=0|1      Turn it off or on
+ *            interval=<ms>   millis() between checks
+ *            threshold=<n>   Mean per-pixel difference for a block to have changed
+ *            blocks=<n>      Changed blocks that count as motion
+ *          Changing anything resets the statistics.
+ * 
+ */
+void onMotion() {
+  bool changed = false;
+  if (server.hasArg("enable")) {
+    motionEnabled = server.arg("enable").toInt() != 0;
+    motion.reset();
+    changed = true;
+  }
+  if (server.hasArg("interval")) {
+    motionInterval = max(server.arg("interval").toInt(), 50L);
+    changed = true;
+  }
+  if (server.hasArg("threshold")) {
+    motion.setThreshold(constrain(server.arg("threshold").toInt(), 1, 255));
+    changed = true;
+  }
+  if (server.hasArg("blocks")) {
+    motion.setMinBlocks(constrain(server.arg("blocks").toInt(), 1, 65535));
+    changed = true;
+  }
+  if (changed) {
+    motionStats.sinceMillis = millis();
+    motionStats.passes = motionStats.triggers = 0;
+    motionStats.busyMicros = 0;
   }
 
-  server.send(404, "text/plain", message);
+  unsigned long elapsedMillis = millis() - motionStats.sinceMillis;
+  String json = "{\"enabled\":";
+  json += motionEnabled ? "true" : "false";
+  json += ",\"intervalMillis\":";
+  json += motionInterval;
+  json += ",\"threshold\":";
+  json += motion.getThreshold();
+  json += ",\"minBlocks\":";
+  json += motion.getMinBlocks();
+  json += ",\"lastChangedBlocks\":";
+  json += motion.changedBlocks();
+  json += ",\"passes\":";
+  json += motionStats.passes;
+  json += ",\"triggers\":";
+  json += motionStats.triggers;
+  json += ",\"meanPassMicros\":";
+  json += motionStats.passes == 0 ? 0 : (uint32_t)(motionStats.busyMicros / motionStats.passes);
+  json += ",\"cpuPercent\":";
+  json += elapsedMillis == 0 ? 0.0 : motionStats.busyMicros / (elapsedMillis * 10.0);
+  json += ",\"lastPhoto\":\"";
+  json += motionStats.lastPhoto;
+  json += "\"}";
+  server.send(200, "text/json", json);
 }
 
 /**
- * @brief   Arduino setup function: Called once at power-on or reset
+ * @brief   Called from loop() to look for motion every motionInterval millis() and take a photo 
+ *          when there is some. Checking is suspended while the exposure is being adjusted, since 
+ *          that changes every pixel.
  * 
  */
-void setup() {
-  // Get Serial going
-  Serial.begin(9600);
-  delay(SERIAL_MILLIS);
-  Serial.print(BANNER);
-  Serial.setDebugOutput(true);
-
-  // Initialize the builtin little red LED
-  pinMode(LED_BUILTIN, OUTPUT);
-  digitalWrite(LED_BUILTIN, HIGH);  // It's active low
+void detectMotion() {
+  if (!motionEnabled || millis() - motionMillis < motionInterval) {
+    return;
+  }
+  motionMillis = millis();
+  if (settings.aeEnable && !exposure.converged()) {
+    motion.reset();
+    return;
+  }
 
-  // Initialize the AP
-  WiFi.softAP(SSID, PASSWORD);
-  IPAddress localIP LOCAL_IP;
-  IPAddress gateway GATEWAY;
-  IPAddress subnet SUBNET;
-  WiFi.softAPConfig(localIP, gateway, subnet);
-  delay(AP_MILLIS);
+  CpuBoost boost(power);
+  unsigned long startMicros = micros();
+  bool moved = preview.grab() && motion.update(preview.luma(), preview.width(), preview.height());
+  motionStats.busyMicros += micros() - startMicros;
+  motionStats.passes++;
 
-  // Initialize mDNS, setting the name to be the same as <our SSID>.local
-  if (!MDNS.begin(SSID)) {
-    log_w("mDNS initialization failed.");
+  if (moved && millis() - motionPhotoMillis >= MOTION_HOLDOFF) {
+    log_i("Motion detected (%d blocks changed).", motion.changedBlocks());
+    String imageFilePath;
+    if (takePhoto(1, imageFilePath)) {
+      motionStats.triggers++;
+      motionStats.lastPhoto = imageFilePath;
+    }
+    motionPhotoMillis = millis();
+    motion.reset();
   }
+}
 
-  // Register the request handlers
-  server.on("/list", HTTP_GET, printDirectory);
-  server.on("/edit", HTTP_DELETE, handleDelete);
-  server.on("/edit", HTTP_PUT, handleCreate);
+/**
+ * @brief   HTTP GET handler for /timelapse. Starts or stops a timelapse sequence and reports its 
+ *          state as JSON. Arguments:
+ *            interval=<s>    Start a sequence with a frame every s seconds
+ *            count=<n>       Stop after n frames (default: run until stopped)
+ *            sleep=1         Turn off WiFi and light sleep between frames. Needs a count, since 
+ *                            the AP, and so /timelapse, is gone until the sequence is done.
+ *            stop=1          Stop the sequence in progress
+ * 
+ */
+void onTimelapse() {
+  if (server.hasArg("stop")) {
+    timelapse.stop();
+  } else if (server.hasArg("interval")) {
+    long interval = server.arg("interval").toInt();
+    long count = server.hasArg("count") ? server.arg("count").toInt() : 0;
+    bool sleep = server.hasArg("sleep") && server.arg("sleep").toInt() != 0;
+    if (interval < 1 || count < 0 || (sleep && count == 0)) {
+      return returnFail("BAD ARGS");
+    }
+    sensor_t *s = esp_camera_sensor_get();
+    const resolution_info_t &res = resolution[s->status.framesize];
+    if (!timelapse.start(interval * 1000UL, count, res.width, res.height, TL_FPS)) {
+      return returnFail("Unable to start the timelapse.");
+    }
+    timelapseSleep = sleep;
+  }
+  String json = timelapse.toJson();
+  json = json.substring(0, json.length() - 1) + ",\"sleep\":" + (timelapseSleep ? "true" : "false") + "}";
+  server.send(200, "text/json", json);
+}
+
+/**
+ * @brief   Called from loop() to take the timelapse frames when they're due. In sleep mode, the AP 
+ *          is stopped and the time between frames is spent in light sleep. Waking only costs 
+ *          discarding the frames the camera captured while its clock was stopped. The AP is 
+ *          restarted when the sequence ends.
+ * 
+ */
+void runTimelapse() {
+  if (timelapse.running() && timelapse.due()) {
+    CpuBoost boost(power);
+    traceBegin("capture");
+    camera_fb_t *fb = esp_camera_fb_get();
+    traceEnd("capture");
+    if (fb) {
+      timelapse.addFrame(fb->buf, fb->len);
+      esp_camera_fb_return(fb);
+      power.countCapture();
+    } else {
+      log_e("Timelapse capture failed.");
+    }
+  }
+
+  if (!timelapse.running()) {
+    if (apStopped) {
+      startAp();
+      apStopped = false;
+    }
+    return;
+  }
+
+  if (timelapseSleep && timelapse.millisToNext() >= TL_MIN_SLEEP) {
+    if (!apStopped) {
+      stopAp();
+      apStopped = true;
+    }
+    esp_sleep_enable_timer_wakeup((uint64_t)timelapse.millisToNext() * 1000ULL);
+    esp_light_sleep_start();
+    for (uint8_t i = 0; i < TL_WARMUP_FRAMES; i++) {
+      camera_fb_t *fb = esp_camera_fb_get();
+      if (fb) {
+        esp_camera_fb_return(fb);
+      }
+    }
+  }
+}
+
+/**
+ * @brief HTTP GET handler for /power. Reports the power management state and estimates as JSON.
+ * 
+ */
+void onPower() {
+  server.send(200, "text/json", power.toJson());
+}
+
+/**
+ * @brief HTTP GET handler for /access. Reports the access log's state as JSON. With the argument 
+ *        "flush", writes the waiting entries to the SD card first.
+ * 
+ */
+void onAccess() {
+  if (server.hasArg("flush") && !accessLog.flush()) {
+    return returnFail("Unable to write the access log.");
+  }
+  server.send(200, "text/json", accessLog.toJson());
+}
+
+/**
+ * @brief HTTP GET handler for /job. Reports the progress of the running background job, or the 
+ *        results of the last one, as JSON.
+ * 
+ */
+void onJob() {
+  server.send(200, "text/json", jobs.toJson());
+}
+
+/**
+ * @brief HTTP POST handler for /batch. Starts a BatchJob doing the delete, mkdir, move and copy 
+ *        operations in the request body, a JSON array such as 
+ *        [{"op":"move","from":"/a.jpg","to":"/b/a.jpg"},{"op":"delete","path":"/c.jpg"}]. See 
+ *        BatchJob.h for the details. Replies 400 if the body can't be parsed, otherwise with the 
+ *        job's state; follow its progress and get each operation's result from /job.
+ * 
+ */
+void onBatch() {
+  if (!server.hasArg("plain")) {
+    return returnFail("BAD ARGS");
+  }
+  String body = server.arg("plain");
+  if (body.length() > BATCH_MAX_BYTES) {
+    server.send(413, "text/plain", "Too many operations.\r\n");
+    return;
+  }
+  BatchJob *job = new BatchJob(SD_MMC, diskUsage, BATCH_COPY_BYTES, validPath);
+  if (!job->parse(body)) {
+    String why = job->error();
+    delete job;
+    server.send(400, "text/plain", why + "\r\n");
+    return;
+  }
+  if (!jobs.start(job)) {
+    return returnFail("A job is already running.");
+  }
+  server.send(200, "text/json", jobs.toJson());
+}
+
+/**
+ * @brief HTTP GET handler for /du. Reports the card's total, used and free bytes and how much is 
+ *        in the directory "dir" (default "/") and in each directory directly under it, as JSON, 
+ *        from the cached accounting in diskUsage, plus, as "scan", the state of the latest 
+ *        DiskUsageScan. With the argument "scan", also starts a scan to reconcile the cache with 
+ *        the card now rather than when it's due, unless one is already running.
+ * 
+ */
+void onDiskUsage() {
+  String dir = server.hasArg("dir") ? server.arg("dir") : String("/");
+  if (!validPath(dir)) {
+    return returnFail("BAD PATH");
+  }
+  if (server.hasArg("scan") && !duScan.running()) {
+    duScan.start(new DiskUsageScan(SD_MMC, diskUsage));
+  }
+  String json = diskUsage.toJson(dir);
+  json.remove(json.length() - 1);
+  json += ",\"scan\":";
+  json += duScan.toJson();
+  json += "}";
+  server.send(200, "text/json", json);
+}
+
+/**
+ * @brief HTTP GET handler for /bench/sd. Starts an SdBench background job, benchmarking the card 
+ *        with a scratch file of "mb" (default BENCH_SD_MB) megabytes and by creating and deleting 
+ *        "files" (default BENCH_SD_FILES) files in the photo directory. Replies with the job's state; 
+ *        follow its progress and get the results from /job.
+ * 
+ */
+void onBenchSd() {
+  long mb = server.hasArg("mb") ? server.arg("mb").toInt() : BENCH_SD_MB;
+  long files = server.hasArg("files") ? server.arg("files").toInt() : BENCH_SD_FILES;
+  if (mb <= 0 || mb > BENCH_SD_MAX_MB || files < 0 || files > 1000) {
+    return returnFail("Bad mb or files.");
+  }
+  if (!jobs.start(new SdBench(SD_MMC, diskUsage, BENCH_SD_SCRATCH, settings.photoPath, 
+                              mb * 1024UL * 1024, files))) {
+    return returnFail("A job is already running.");
+  }
+  server.send(200, "text/json", jobs.toJson());
+}
+
+/**
+ * @brief Describe a network benchmark result as a JSON object
+ * 
+ */
+String netBenchJson(const NetBenchResult &r) {
+  String json = "{\"bytes\":";
+  json += r.bytes;
+  json += ",\"micros\":";
+  json += r.micros;
+  json += ",\"MBps\":";
+  json += r.micros == 0 ? String("null") : String((double)r.bytes / r.micros, 3);
+  json += ",\"agoMillis\":";
+  json += r.atMillis == 0 ? String("null") : String(millis() - r.atMillis);
+  json += "}";
+  return json;
+}
+
+/**
+ * @brief HTTP GET handler for /bench/net. With the argument "bytes", sends that many bytes of 
+ *        generated data from RAM, timing how long it takes to hand them to the network stack. 
+ *        Nothing is read from the SD card, so comparing with the SD benchmark shows which half 
+ *        of serving a file is the bottleneck. Without arguments, reports the results of the last 
+ *        download and upload (see onBenchUpload()) as JSON.
+ * 
+ */
+void onBenchNet() {
+  if (!server.hasArg("bytes")) {
+    server.send(200, "text/json", String("{\"download\":") + netBenchJson(netDownload) + 
+      ",\"upload\":" + netBenchJson(netUpload) + "}");
+    return;
+  }
+  long len = server.arg("bytes").toInt();
+  if (len <= 0 || (unsigned long)len > BENCH_NET_MAX) {
+    return returnFail("Bad bytes.");
+  }
+
+  CpuBoost boost(power);
+  uint8_t buf[BENCH_NET_CHUNK];
+  for (size_t i = 0; i < sizeof(buf); i++) {
+    buf[i] = 'a' + i % 26;
+  }
+  server.setContentLength(len);
+  server.send(200, "application/octet-stream", "");
+  unsigned long startMicros = micros();
+  size_t nSent = 0;
+  while (nSent < (size_t)len) {
+    size_t n = min(sizeof(buf), (size_t)len - nSent);
+    if (server.client().write(buf, n) != n) {
+      break;
+    }
+    nSent += n;
+  }
+  server.countBytes(nSent);
+  netDownload = {(uint32_t)nSent, (uint32_t)(micros() - startMicros), millis()};
+  log_d("Network benchmark: sent %d bytes in %lu us.", nSent, netDownload.micros);
+}
+
+/**
+ * @brief HTTP POST upload handler for /bench/upload. Counts and times the posted file's data 
+ *        but throws it away, so the SD card plays no part.
+ * 
+ */
+void onBenchUploadData() {
+  HTTPUpload &upload = server.upload();
+  if (upload.status == UPLOAD_FILE_START) {
+    power.boost();
+    netUploadStart = micros();
+    netUpload.bytes = 0;
+  } else if (upload.status == UPLOAD_FILE_WRITE) {
+    netUpload.bytes += upload.currentSize;
+  } else if (upload.status == UPLOAD_FILE_END || upload.status == UPLOAD_FILE_ABORTED) {
+    netUpload.micros = micros() - netUploadStart;
+    netUpload.atMillis = millis();
+    power.relax();
+  }
+}
+
+/**
+ * @brief HTTP POST handler for /bench/upload, called once the upload is done. Replies with the 
+ *        result as JSON.
+ * 
+ */
+void onBenchUpload() {
+  server.send(200, "text/json", netBenchJson(netUpload));
+}
+
+/**
+ * @brief HTTP GET handler for /health. Reports heap and latency trends, with flags for leaks, 
+ *        fragmentation and latency drift, as JSON. With the argument "fscheck", also starts an 
+ *        FsCheck background job; its report is at /job. The job is given diskUsage's figure 
+ *        for the space in use, since SD_MMC.usedBytes() counts the whole FAT and would hold up 
+ *        the reply for seconds on a big card.
+ * 
+ */
+void onHealth() {
+  if (server.hasArg("fscheck") && 
+      !jobs.start(new FsCheck(SD_MMC, diskUsage.usedBytes(), settings.photoPath.c_str(), 
+                              PHOTO_PREFIX, imageCtr))) {
+    return returnFail("A job is already running.");
+  }
+  server.send(200, "text/json", health.toJson());
+}
+
+/**
+ * @brief   Decode the %-escapes in a URI
+ * 
+ */
+String uriDecode(const String &uri) {
+  String decoded;
+  for (size_t i = 0; i < uri.length(); i++) {
+    if (uri[i] == '%' && i + 2 < uri.length() && isxdigit(uri[i + 1]) && isxdigit(uri[i + 2])) {
+      char hex[3] = {uri[i + 1], uri[i + 2], '\0'};
+      decoded += (char)strtol(hex, nullptr, 16);
+      i += 2;
+    } else {
+      decoded += uri[i];
+    }
+  }
+  return decoded;
+}
+
+/**
+ * @brief   The SD card path a FILES_URI/<path> request is about
+ * 
+ */
+String filesPath() {
+  return uriDecode(server.uri().substring(strlen(FILES_URI)));
+}
+
+/**
+ * @brief HTTP PUT and PATCH raw-body handler for FILES_URI/<path>. Streams the request body 
+ *        straight into a file on the SD card, with none of the boundary scanning a multipart 
+ *        upload needs. The WebServer reads exactly Content-Length bytes; send the body as 
+ *        application/octet-stream, since form content types aren't passed through raw.
+ * 
+ * @details A PUT writes <path>TEMP_SUFFIX and, once it's all there, replaces <path> with it.
+ * 
+ *          A PATCH is one piece of a resumable upload. It must have an "Upload-Offset" header 
+ *          equal to the size of <path>PART_SUFFIX (0 if there isn't one yet; HEAD tells what it 
+ *          is) and an "Upload-Length" header giving the size of the whole file. Its body is 
+ *          appended to <path>PART_SUFFIX, which replaces <path> once it reaches Upload-Length. If 
+ *          the connection drops, whatever arrived is kept, so the upload can resume from there.
+ * 
+ */
+void onFileUploadData() {
+  HTTPRaw &raw = server.raw();
+  UploadKey key = uploadKey();
+  bool resumable = server.method() == HTTP_PATCH;
+  if (raw.status == RAW_START) {
+    rawUploadCode = 500;
+    String path = filesPath();
+    if (!validPath(path) || path.endsWith("/")) {
+      log_w("Upload: rejected path \"%.*s\"", MAX_PATH_CHARS, path.c_str());
+      rawUploadCode = 400;
+      return;
+    }
+    if (!resumable) {
+      uploads.open(key, path + TEMP_SUFFIX);
+      return;
+    }
+    String partPath = path + PART_SUFFIX;
+    if (!server.hasHeader("Upload-Offset") || !server.hasHeader("Upload-Length")) {
+      rawUploadCode = 400;
+    } else if ((size_t)server.header("Upload-Offset").toInt() != fileSize(partPath)) {
+      rawUploadCode = 409;
+    } else {
+      uploads.open(key, partPath, FILE_APPEND);
+    }
+    return;
+  }
+  if (!uploads.isOpen(key)) {
+    return;
+  }
+  if (raw.status == RAW_WRITE) {
+    if (!uploads.write(raw.buf, raw.currentSize)) {
+      if (resumable) {
+        uploads.close();
+      } else {
+        uploads.abort();
+      }
+    }
+  } else if (raw.status == RAW_END) {
+    uint32_t micros = uploads.elapsed();
+    uint32_t bytes = uploads.received();
+    String tmpPath = uploads.path();
+    String path = filesPath();
+    if (!uploads.close()) {
+      return;
+    }
+    rawStats.uploads++;
+    rawStats.bytes += bytes;
+    rawStats.micros += micros;
+    if (!resumable) {
+      rawUploadCode = commitUpload(tmpPath, path) ? 201 : 500;
+      return;
+    }
+    size_t length = server.header("Upload-Length").toInt();
+    size_t size = fileSize(tmpPath);
+    if (size < length) {
+      rawUploadCode = 204;
+    } else if (size > length) {
+      log_w("Upload: \"%s\" is longer than its Upload-Length; discarded.", path.c_str());
+      SD_MMC.remove(tmpPath);
+      rawUploadCode = 400;
+    } else {
+      rawUploadCode = commitUpload(tmpPath, path) ? 201 : 500;
+    }
+  } else if (raw.status == RAW_ABORTED) {
+    // Keep what arrived of a resumable upload; it's the point to resume from
+    if (resumable) {
+      uploads.close();
+    } else {
+      uploads.abort();
+    }
+  }
+}
+
+/**
+ * @brief HTTP PUT and PATCH handler for FILES_URI/<path>, called once the body has been 
+ *        received. Replies 201 if the file is complete, or, for a PATCH that isn't the last, 204. 
+ *        A PATCH's reply has an "Upload-Offset" header giving the size of the partial file.
+ *        Replies 409 to a PATCH whose Upload-Offset doesn't match the partial file.
+ * 
+ */
+void onFileUpload() {
+  if (server.method() == HTTP_PATCH) {
+    server.sendHeader("Upload-Offset", String(fileSize(filesPath() + PART_SUFFIX)));
+  }
+  if (rawUploadCode == 400 || rawUploadCode == 409 || rawUploadCode == 500) {
+    server.send(rawUploadCode, "text/plain", rawUploadCode == 409 ? "Offset mismatch.\r\n" : 
+      "Upload failed.\r\n");
+    return;
+  }
+  server.send(rawUploadCode, "text/plain", "");
+}
+
+/**
+ * @brief HTTP HEAD handler for FILES_URI/<path>. If a resumable upload of <path> is partly done, 
+ *        replies 200 with an "Upload-Offset" header giving how much has been received: the offset 
+ *        to resume from. Otherwise replies 404.
+ * 
+ */
+void onFileHead() {
+  String partPath = filesPath() + PART_SUFFIX;
+  if (!validPath(partPath) || !SD_MMC.exists(partPath)) {
+    server.send(404, "text/plain", "");
+    return;
+  }
+  server.sendHeader("Upload-Offset", String(fileSize(partPath)));
+  server.sendHeader("Cache-Control", "no-store");
+  server.send(200, "text/plain", "");
+}
+
+/**
+ * @brief Describe the statistics for uploads by one protocol as a JSON object
+ * 
+ */
+String uploadStatsJson(const UploadStats &st) {
+  String json = "{\"uploads\":";
+  json += st.uploads;
+  json += ",\"bytes\":";
+  json += String((double)st.bytes, 0);
+  json += ",\"MBps\":";
+  json += st.micros == 0 ? String("null") : String((double)st.bytes / st.micros, 3);
+  json += "}";
+  return json;
+}
+
+/**
+ * @brief HTTP GET handler for /uploads. Reports the upload in progress and the upload throughput 
+ *        statistics, overall and for multipart and raw uploads separately, as JSON.
+ * 
+ */
+void onUploads() {
+  String json = uploads.toJson();
+  json = json.substring(0, json.length() - 1) + ",\"multipart\":" + uploadStatsJson(multipartStats) + 
+    ",\"raw\":" + uploadStatsJson(rawStats) + "}";
+  server.send(200, "text/json", json);
+}
+
+/**
+ * @brief HTTP POST raw-body handler for /update. Streams the request body, a firmware image, 
+ *        into the inactive OTA partition as it arrives. Send the body as 
+ *        application/octet-stream; the argument "md5=<32 hex digits>", if present, is checked 
+ *        against the image's MD5.
+ * 
+ */
+void onUpdateData() {
+  HTTPRaw &raw = server.raw();
+  if (raw.status == RAW_START) {
+    otaPass = server.pass();
+    power.boost();
+    ota.start(server.arg("md5"));
+  } else if (raw.status == RAW_WRITE) {
+    ota.write(raw.buf, raw.currentSize);
+  } else if (raw.status == RAW_END) {
+    ota.finish();
+    power.relax();
+  } else if (raw.status == RAW_ABORTED) {
+    ota.abort();
+    power.relax();
+  }
+}
+
+/**
+ * @brief HTTP GET and POST handler for /update. For a POST, called once the image has been 
+ *        received; replies 400 if the request had no raw body (say, it was form-encoded), so no 
+ *        image reached onUpdateData, and 500 if the image wasn't good. Reports the partitions, the update state and 
+ *        the timing of the last update as JSON. With the argument "reboot", restarts 
+ *        OTA_REBOOT_MILLIS later, after the reply has gone; until then everything carries on 
+ *        as usual. A successful update takes effect at the next restart, whenever it is.
+ *
+ *        To update: curl --data-binary @firmware.bin -H "Content-Type: application/octet-stream" \
+ *                     "http://obscuracam.local/update?md5=$(md5sum < firmware.bin | cut -c1-32)&reboot=1"
+ * 
+ */
+void onUpdate() {
+  if (server.method() == HTTP_POST && otaPass != server.pass()) {
+    return server.send(400, "text/plain", "NO IMAGE: send it as application/octet-stream\r\n");
+  }
+  if (server.method() == HTTP_POST && !ota.ready()) {
+    return returnFail("Update failed: " + ota.error());
+  }
+  if (server.hasArg("reboot")) {
+    rebootPending = true;
+    rebootMillis = millis() + OTA_REBOOT_MILLIS;
+  }
+  server.send(200, "text/json", ota.toJson());
+}
+
+/**
+ * @brief HTTP GET handler for /config. Reports the settings in effect (but not the password) and 
+ *        how the last read of CONFIG_PATH went, including how long it took, as JSON. With the 
+ *        argument "reload", reads the file again first, starting from the defaults. The new 
+ *        photo, exposure timing, motion and keystone settings, quality and any frame size no 
+ *        bigger than the one the camera was started with take effect at once. The network 
+ *        settings, aeEnable and bigger frame sizes only take effect at the next boot; until then 
+ *        "rebootNeeded" is true.
+ * 
+ */
+void onConfig() {
+  if (server.hasArg("reload")) {
+    Settings fresh = defaultSettings;
+    configFile.load(SD_MMC, fresh);
+    if (fresh.ssid != settings.ssid || fresh.password != settings.password || 
+        !(fresh.localIp == settings.localIp) || !(fresh.gateway == settings.gateway) || 
+        !(fresh.subnet == settings.subnet) || fresh.aeEnable != settings.aeEnable || 
+        fresh.frameSize > maxFrameSize) {
+      configRebootNeeded = true;
+    }
+    fresh.ssid = settings.ssid;
+    fresh.password = settings.password;
+    fresh.localIp = settings.localIp;
+    fresh.gateway = settings.gateway;
+    fresh.subnet = settings.subnet;
+    fresh.aeEnable = settings.aeEnable;
+    sensor_t *s = esp_camera_sensor_get();
+    if (fresh.frameSize > maxFrameSize) {
+      fresh.frameSize = settings.frameSize;
+    } else if (fresh.frameSize != settings.frameSize) {
+      s->set_framesize(s, fresh.frameSize);
+    }
+    if (fresh.jpegQuality != settings.jpegQuality) {
+      s->set_quality(s, fresh.jpegQuality);
+    }
+    motionEnabled = fresh.motionEnable;
+    motionInterval = fresh.motionMillis;
+    if (memcmp(fresh.keystoneCorners, settings.keystoneCorners, 
+               sizeof(fresh.keystoneCorners)) != 0) {
+      keystone.end();                               // Rebuilt with the new corners when next needed
+    }
+    settings = fresh;
+  }
+  String json = configFile.toJson();
+  json = json.substring(0, json.length() - 1) + ",\"rebootNeeded\":" + (configRebootNeeded ? "true" : "false");
+  json += ",\"settings\":{\"ssid\":";
+  json += jsonString(settings.ssid);
+  json += ",\"ip\":\"";
+  json += settings.localIp.toString();
+  json += "\",\"gateway\":\"";
+  json += settings.gateway.toString();
+  json += "\",\"subnet\":\"";
+  json += settings.subnet.toString();
+  json += "\",\"frameSize\":";
+  json += settings.frameSize;
+  json += ",\"jpegQuality\":";
+  json += settings.jpegQuality;
+  json += ",\"photoPath\":";
+  json += jsonString(settings.photoPath);
+  json += ",\"aeEnable\":";
+  json += settings.aeEnable ? "true" : "false";
+  json += ",\"aeIdleMillis\":";
+  json += settings.aeIdleMillis;
+  json += ",\"motionEnable\":";
+  json += settings.motionEnable ? "true" : "false";
+  json += ",\"motionMillis\":";
+  json += settings.motionMillis;
+  json += ",\"keystoneEnable\":";
+  json += settings.keystoneEnable ? "true" : "false";
+  json += ",\"keystoneCorners\":[";
+  for (uint8_t i = 0; i < 8; i++) {
+    json += i == 0 ? "" : ",";
+    json += String(settings.keystoneCorners[i], 3);
+  }
+  json += "]}}";
+  server.send(200, "text/json", json);
+}
+
+/**
+ * @brief HTTP GET handler for /boot. Reports how long each phase of the last few boots took.
+ * 
+ */
+void onBoot() {
+  server.send(200, "text/json", bootProfiler.toJson());
+}
+
+#if PROFILE_ENABLE
+/**
+ * @brief HTTP GET handler for /scopes. Reports the PROFILE_SCOPE() table as JSON. With the 
+ *        argument "reset", zeroes the counts after reporting them.
+ * 
+ */
+void onScopes() {
+  server.send(200, "text/json", profileToJson());
+  if (server.hasArg("reset")) {
+    profileReset();
+  }
+}
+
+/**
+ * @brief HTTP GET handler for /profile. With the argument "seconds" (and optionally "hz"), starts
+ *        sampling both cores and replies with the sampler's state as JSON; the sampling runs in 
+ *        the background while the ObscuraCam carries on with whatever load is being studied. 
+ *        Without arguments, replies with the state as JSON while sampling is in progress, and 
+ *        with the samples as text, one "<core> <pc> <caller>" line each, once it's done. Feed 
+ *        the text to tools/fold_profile.py along with the firmware ELF to get folded stacks.
+ * 
+ */
+void onProfile() {
+  if (server.hasArg("seconds")) {
+    long seconds = server.arg("seconds").toInt();
+    long hz = server.hasArg("hz") ? server.arg("hz").toInt() : PROF_HZ;
+    if (seconds <= 0 || seconds > PROF_MAX_SECONDS || hz <= 0 || hz > PROF_MAX_HZ) {
+      return returnFail("Bad seconds or hz.");
+    }
+    if (!sampler.start(hz, seconds)) {
+      return returnFail("Unable to start profiling.");
+    }
+    server.send(200, "text/json", sampler.toJson());
+    return;
+  }
+  if (sampler.running()) {
+    server.send(200, "text/json", sampler.toJson());
+    return;
+  }
+
+  CpuBoost boost(power);
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "text/plain", "");
+  for (uint32_t first = 0; first < sampler.samples(); first += PROF_LINES) {
+    server.sendContent(sampler.format(first, PROF_LINES));
+  }
+  server.sendContent("");
+}
+
+/**
+ * @brief HTTP GET handler for /trace.json. Replies with the TRACE_SCOPE() events recorded so far 
+ *        in Chrome Trace Event format, for loading into Perfetto. With the argument "clear", 
+ *        discards them once they've been sent.
+ * 
+ */
+void onTrace() {
+  traceEnable(false);
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", "");
+  server.sendContent("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  server.sendContent(traceMetadataJson());
+  for (uint16_t first = 0; first < traceCount(); first += TRACE_CHUNK) {
+    server.sendContent(traceEventsJson(first, TRACE_CHUNK));
+  }
+  server.sendContent("]}");
+  server.sendContent("");
+  if (server.hasArg("clear")) {
+    traceClear();
+  }
+  traceEnable(true);
+}
+#endif
+
+/**
+ * @brief   Wrap a request handler so that, in PROFILE_ENABLE builds, each call shows up in the 
+ *          trace as a span with the given name.
+ * 
+ * @param name    The span's name; must be a string literal
+ * @param handler The handler to wrap
+ * @return        The wrapped handler
+ */
+WebServer::THandlerFunction traced(const char *name, WebServer::THandlerFunction handler) {
+#if PROFILE_ENABLE
+  return [name, handler]() {
+    TRACE_SCOPE(name);
+    handler();
+  };
+#else
+  (void)name;
+  return handler;
+#endif
+}
+
+void onNotFound() {
+  // Not a request for something handled programmatically; try to get it from the SD card
+  if (loadFromSdCard(server.uri())) {
+    return;
+  }
+
+  log_d("Handling page not found.");
+
+  String message = "File Not Found\n\n";
+  message += "URI: ";
+  message += server.uri().substring(0, MAX_PATH_CHARS);
+  message += "\nMethod: ";
+  message += (server.method() == HTTP_GET) ? "GET" : "POST";
+  message += "\nArguments: ";
+  message += server.args();
+  message += "\n";
+
+  for (uint8_t i = 0; i < server.args() && i < NOT_FOUND_ARGS; i++) {
+    message += " " + server.argName(i).substring(0, NOT_FOUND_CHARS) + ": " + 
+      server.arg(i).substring(0, NOT_FOUND_CHARS) + "\n";
+  }
+
+  server.send(404, "text/plain", message);
+}
+
+/**
+ * @brief   Look for timelapse AVIs that were never finalized and recover them
+ * 
+ */
+void recoverTimelapses() {
+  File dir = SD_MMC.open(TIMELAPSE_PATH);
+  if (!dir || !dir.isDirectory()) {
+    return;
+  }
+  while (true) {
+    File entry = dir.openNextFile();
+    if (!entry) {
+      break;
+    }
+    String path = entry.path();
+    entry.close();
+    if (path.endsWith(".avi")) {
+      AviWriter::recover(SD_MMC, path);
+    }
+  }
+  dir.close();
+}
+
+/**
+ * @brief   Arduino setup function: Called once at power-on or reset
+ * 
+ */
+void setup() {
+  bootProfiler.begin();
+
+  // Get Serial going
+  Serial.begin(9600);
+  delay(SERIAL_MILLIS);
+  Serial.print(BANNER);
+  Serial.setDebugOutput(true);
+  bootProfiler.mark(BOOT_SERIAL);
+
+  // Initialize the builtin little red LED
+  pinMode(LED_BUILTIN, OUTPUT);
+  digitalWrite(LED_BUILTIN, HIGH);  // It's active low
+
+  // Mount SD card
+  if(!SD_MMC.begin("/sdcard", true)){
+    log_e("SD Card Mount failed.");
+    while (true) {
+      flashBuiltinLed(SDMI_FLASH_COUNT);
+      delay(FAIL_MILLIS);
+    }
+  }
+  
+  log_d("SD card mounted.");
+  
+  // Verify there's a card in it
+  uint8_t cardType = SD_MMC.cardType();
+  if(cardType == CARD_NONE){
+    log_e("No SD Card inserted.");
+    while (true) {
+      flashBuiltinLed(SDCI_FLASH_COUNT);
+      delay(FAIL_MILLIS);
+    }
+  }
+  log_d("The SD card reader seems to have a card in it.");
+  bootProfiler.mark(BOOT_SD);
+
+  // Read the settings from the SD card; the AP and the camera depend on them
+  configFile.load(SD_MMC, settings);
+  motionEnabled = settings.motionEnable;
+  motionInterval = settings.motionMillis;
+  bootProfiler.mark(BOOT_CONFIG);
+
+  // Initialize the AP and mDNS
+  startAp();
+  bootProfiler.mark(BOOT_AP);
+
+  // Register the request handlers
+#if PROFILE_ENABLE
+  traceInit();
+#endif
+  accessLog.begin();
+  uploads.begin();
+  ota.begin();
+  server.on("/list", HTTP_GET, traced("GET /list", printDirectory));
+  server.on("/edit", HTTP_DELETE, traced("DELETE /edit", handleDelete));
+  server.on("/edit", HTTP_PUT, traced("PUT /edit", handleCreate));
   server.on(
     "/edit", HTTP_POST,
-    []() {
-      returnOK();
-    },
-    handleFileUpload
+    traced("POST /edit", onFilePost),
+    traced("upload /edit", handleFileUpload)
   );
-  server.on("/snap", HTTP_GET, onSnap);
-  server.onNotFound(onNotFound);
+  server.on("/snap", HTTP_GET, traced("GET /snap", onSnap));
+  server.on("/exposure", HTTP_GET, traced("GET /exposure", onExposure));
+  server.on("/motion", HTTP_GET, traced("GET /motion", onMotion));
+  server.on("/timelapse", HTTP_GET, traced("GET /timelapse", onTimelapse));
+  server.on("/power", HTTP_GET, traced("GET /power", onPower));
+  server.on("/boot", HTTP_GET, traced("GET /boot", onBoot));
+  server.on("/config", HTTP_GET, traced("GET /config", onConfig));
+  server.on("/access", HTTP_GET, traced("GET /access", onAccess));
+  server.on("/job", HTTP_GET, traced("GET /job", onJob));
+  server.on("/batch", HTTP_POST, traced("POST /batch", onBatch));
+  server.on("/du", HTTP_GET, traced("GET /du", onDiskUsage));
+  server.on("/health", HTTP_GET, traced("GET /health", onHealth));
+  server.on("/uploads", HTTP_GET, traced("GET /uploads", onUploads));
+  server.on(UriGlob(FILES_URI "/*"), HTTP_PUT, traced("PUT /files", onFileUpload), onFileUploadData);
+  server.on(UriGlob(FILES_URI "/*"), HTTP_PATCH, traced("PATCH /files", onFileUpload), onFileUploadData);
+  server.on(UriGlob(FILES_URI "/*"), HTTP_HEAD, traced("HEAD /files", onFileHead));
+  server.on("/update", HTTP_GET, traced("GET /update", onUpdate));
+  server.on("/update", HTTP_POST, traced("POST /update", onUpdate), onUpdateData);
+  server.on("/bench/sd", HTTP_GET, traced("GET /bench/sd", onBenchSd));
+  server.on("/bench/net", HTTP_GET, traced("GET /bench/net", onBenchNet));
+  server.on("/bench/upload", HTTP_POST, traced("POST /bench/upload", onBenchUpload), onBenchUploadData);
+#if PROFILE_ENABLE
+  server.on("/scopes", HTTP_GET, onScopes);
+  server.on("/profile", HTTP_GET, onProfile);
+  server.on("/trace.json", HTTP_GET, onTrace);
+#endif
+  server.onNotFound(traced("file", onNotFound));
+  const char *headerKeys[] = {"Range", "Upload-Offset", "Upload-Length"};
+  server.collectHeaders(headerKeys, sizeof(headerKeys) / sizeof(headerKeys[0]));
 
   //Start the Web server
   server.begin();
 
   log_d("HTTP server started successfully.");
+  bootProfiler.mark(BOOT_HTTP);
 
   // Set up the camera configuration we'll use
   camera_config_t config;
@@ -507,17 +2067,20 @@ void setup() {
   config.grab_mode = CAMERA_GRAB_LATEST;
   
   if(psramFound()){
-    log_i("Using UXGA resolution.");
-    config.frame_size = FRAMESIZE_UXGA;
-    config.jpeg_quality = 10;
+    log_i("Using frame size %d.", settings.frameSize);
+    config.frame_size = settings.frameSize;
+    config.jpeg_quality = settings.jpegQuality;
     config.fb_count = 2;
   } else {
-    log_i("Using SVGA resolution because PSRAM not present.");
-    config.frame_size = FRAMESIZE_SVGA;
-    config.jpeg_quality = 12;
+    log_i("Using at most SVGA resolution because PSRAM not present.");
+    config.frame_size = min(settings.frameSize, FRAMESIZE_SVGA);
+    config.jpeg_quality = max(settings.jpegQuality, (uint8_t)12);
     config.fb_count = 1;
   }
+  maxFrameSize = config.frame_size;
   
+  fbCount = config.fb_count;
+
   // Initialize the camera with the configuration we just set up
   esp_err_t err = esp_camera_init(&config);
   if (err != ESP_OK) {
@@ -537,28 +2100,16 @@ void setup() {
   if (sErr < 0) {
     log_e("Flipping the camera sensor orientation failed.");
   }
-  
-  // Mount SD card
-  if(!SD_MMC.begin("/sdcard", true)){
-    log_e("SD Card Mount failed.");
-    while (true) {
-      flashBuiltinLed(SDMI_FLASH_COUNT);
-      delay(FAIL_MILLIS);
-    }
-  }
-  
-  log_d("SD card mounted.");
-  
-  // Verify there's a card in it
-  uint8_t cardType = SD_MMC.cardType();
-  if(cardType == CARD_NONE){
-    log_e("No SD Card inserted.");
-    while (true) {
-      flashBuiltinLed(SDCI_FLASH_COUNT);
-      delay(FAIL_MILLIS);
-    }
+
+  // Take over exposure control from the sensor if we've been asked to
+  if (settings.aeEnable) {
+    exposure.begin(s);
   }
-  log_d("The SD card reader seems to have a card in it.");
+  bootProfiler.mark(BOOT_CAMERA);
+
+  // Finish off any timelapse AVIs that were cut short by a power failure or reset
+  recoverTimelapses();
+  bootProfiler.mark(BOOT_RECOVERY);
   
   // Get "EEPROM" going (it's really flash memory)
   EEPROM.begin(sizeof((uint16_t)0));
@@ -570,9 +2121,23 @@ void setup() {
   // Initialize the image counter
   imageCtr = EEPROM.readUShort(IC_ADDR);
   log_d("Last stored image was Image%d.jpg.", imageCtr);
+  bootProfiler.mark(BOOT_EEPROM);
 
   // Show we're ready
   flashBuiltinLed(READY_FLASH_COUNT);
+  bootProfiler.mark(BOOT_READY_FLASH);
+  bootProfiler.save();
+
+  // From here on, only run the CPU flat out when there's work to do. (This comes after the boot 
+  // profile is done, since the profiler's cycle counts assume a constant clock. For the same 
+  // reason, PROFILE_ENABLE builds leave the clock pinned at full speed throughout.)
+  if (PM_ENABLE && !PROFILE_ENABLE) {
+    power.begin(PM_LIGHT_SLEEP);
+  }
+
+  // Take the baseline health snapshot now that everything's allocated
+  health.begin();
+  ota.markReady();
   log_i("Initialization complete.");
 }
 
@@ -583,5 +2148,55 @@ void setup() {
 void loop() {
   // Let the Web server do its thing
   server.handleClient();
+  if (server.handledRequest()) {
+    health.noteRequest(server.requestMicros());
+  }
+
+  // Keep the exposure right for the next photo
+  if (settings.aeEnable) {
+    meterExposure();
+  }
+
+  // Watch for motion if we've been asked to
+  detectMotion();
+
+  // Take timelapse frames as they come due
+  runTimelapse();
+
+  // Advance the background job, if any
+  if (jobs.running()) {
+    CpuBoost boost(power);
+    jobs.step();
+  }
+
+  // Reconcile the storage accounting with the card when it's due (and first thing after boot). 
+  // The scan has its own runner and only steps when there's nothing else to do -- no request 
+  // just handled and no job running -- so it never keeps a job from starting or delays one.
+  if (!duScan.running() && diskUsage.scanDue()) {
+    duScan.start(new DiskUsageScan(SD_MMC, diskUsage));
+  }
+  if (duScan.running() && !server.handledRequest() && !jobs.running()) {
+    CpuBoost boost(power);
+    duScan.step();
+  }
+
+  // Keep track of how things are holding up
+  health.poll();
+
+  // Write the access log to the SD card when things are quiet
+  accessLog.poll();
+
+  // Restart when asked to, having finished off the timelapse and the access log. (No upload is 
+  // in progress: each is finished, buffer and all, within the request that carries it.)
+  if (rebootPending && (long)(millis() - rebootMillis) >= 0) {
+    timelapse.stop();
+    accessLog.flush();
+    ota.restart();
+  }
+
+#if PROFILE_ENABLE
+  // Stop the sampling profiler when its time is up
+  sampler.poll();
+#endif
   delay(2); // Relinquish control
 }
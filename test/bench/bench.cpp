@@ -0,0 +1,171 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * bench.cpp
+ *
+ * Host benchmarks for the image kernels that sit in a visitor's wait for a photo. Keystone::apply()
+ * remaps an RGB565 image through the tile lookup table; it's timed at the size photos are corrected
+ * at (UXGA scaled down by KEYSTONE_SCALE) for a few sets of screen corners, along with building the
+ * table with begin(). jpegSharpness(), which /snap?burst runs on every frame of a burst, is timed
+ * on the JPEG fixtures tools/bench_fixture.py makes with PIL: a UXGA view of the screen and the
+ * same view blurred. The sharp one must score higher, or the exit status is 1. The absolute
+ * figures aren't the ESP32's, but a change that makes a kernel slower here will make it slower
+ * there.
+ *
+ * Each case is run for at least BENCH_MIN_MILLIS of wall-clock time (the native Arduino stand-in's
+ * clock is simulated, so std::chrono is used instead) and reported as microseconds per call and
+ * megapixels or megabytes per second.
+ *
+ * Build and run it, from the project directory or with the fixtures' directory as the argument,
+ * with:
+ *
+ *     pio run -e bench && .pio/build/bench/program [test/bench]
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "Arduino.h"
+#include "Keystone.h"
+#include "JpegSharpness.h"
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#define BENCH_WIDTH       (800)                     // UXGA >> KEYSTONE_SCALE: photos are corrected
+#define BENCH_HEIGHT      (600)                     //   at this size
+#define BENCH_MIN_MILLIS  (500)                     // Least wall-clock time to time each case for
+#define BENCH_MIN_RUNS    (3)                       // Fewest calls to time each case with
+#define BENCH_FIXTURES    "test/bench"              // Default directory of the JPEG fixtures
+
+struct KeystoneCase {                               // Screen corners to benchmark the remap with
+  const char *name;
+  float corners[8];                                 //   TL, TR, BR, BL, as for Keystone::begin()
+};
+static const KeystoneCase keystoneCases[] = {
+  {"identity", {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f}},
+  {"shelf", {0.12f, 0.05f, 0.88f, 0.05f, 1.0f, 0.95f, 0.0f, 0.95f}},
+  {"skewed", {0.2f, 0.1f, 0.9f, 0.0f, 0.95f, 1.0f, 0.0f, 0.8f}},
+};
+
+static volatile uint32_t sink;                      // Keeps results from being optimized away
+
+/**
+ * @brief Call fn repeatedly for at least BENCH_MIN_MILLIS and BENCH_MIN_RUNS calls
+ *
+ * @return double The mean wall-clock time per call (microseconds)
+ */
+static double timeIt(const std::function<void()> &fn) {
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point start = Clock::now();
+  uint32_t runs = 0;
+  std::chrono::duration<double, std::micro> elapsed;
+  do {
+    fn();
+    runs++;
+    elapsed = Clock::now() - start;
+  } while (runs < BENCH_MIN_RUNS || elapsed.count() < BENCH_MIN_MILLIS * 1000.0);
+  return elapsed.count() / runs;
+}
+
+/**
+ * @brief Benchmark Keystone::begin() and Keystone::apply() for each of keystoneCases
+ *
+ * @return true   Success
+ * @return false  A lookup table couldn't be built
+ */
+static bool benchKeystone() {
+  const size_t pixels = (size_t)BENCH_WIDTH * BENCH_HEIGHT;
+  std::vector<uint8_t> src(pixels * 2), dst(pixels * 2);
+  for (size_t i = 0; i < pixels; i++) {             // A gradient; the contents don't affect timing
+    uint16_t x = i % BENCH_WIDTH, y = i / BENCH_WIDTH;
+    uint16_t c = ((x >> 5) & 0x1F) << 11 | ((y >> 4) & 0x3F) << 5 | ((x + y) >> 6 & 0x1F);
+    src[2 * i] = c >> 8;
+    src[2 * i + 1] = c & 0xFF;
+  }
+
+  printf("Keystone, %dx%d RGB565:\n", BENCH_WIDTH, BENCH_HEIGHT);
+  for (const KeystoneCase &kc : keystoneCases) {
+    Keystone keystone;
+    if (!keystone.begin(BENCH_WIDTH, BENCH_HEIGHT, kc.corners)) {
+      printf("  %-9s begin() failed\n", kc.name);
+      return false;
+    }
+    double beginMicros = timeIt([&]() { keystone.begin(BENCH_WIDTH, BENCH_HEIGHT, kc.corners); });
+    double applyMicros = timeIt([&]() { keystone.apply(src.data(), dst.data()); sink = dst[0]; });
+    printf("  %-9s begin() %8.1f us   apply() %8.1f us  %7.1f Mpixel/s\n", kc.name, beginMicros, 
+      applyMicros, pixels / applyMicros);
+  }
+  return true;
+}
+
+/**
+ * @brief Read a file into memory
+ *
+ * @return true   Success
+ * @return false  It couldn't be read
+ */
+static bool readFile(const std::string &path, std::vector<uint8_t> &data) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (f == nullptr) {
+    return false;
+  }
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    data.insert(data.end(), buf, buf + n);
+  }
+  fclose(f);
+  return true;
+}
+
+/**
+ * @brief Benchmark jpegSharpness() on the sharp and blurred fixtures in dir
+ *
+ * @return true   Success
+ * @return false  A fixture couldn't be read or scored, or the sharp one didn't score higher
+ */
+static bool benchSharpness(const std::string &dir) {
+  const char *names[2] = {"screen.jpg", "screen_blurred.jpg"};
+  uint32_t scores[2];
+  printf("jpegSharpness():\n");
+  for (int i = 0; i < 2; i++) {
+    std::vector<uint8_t> jpg;
+    if (!readFile(dir + "/" + names[i], jpg)) {
+      printf("  Unable to read %s/%s; make it with tools/bench_fixture.py.\n", dir.c_str(), 
+        names[i]);
+      return false;
+    }
+    scores[i] = jpegSharpness(jpg.data(), jpg.size());
+    if (scores[i] == 0) {
+      printf("  %s couldn't be scored.\n", names[i]);
+      return false;
+    }
+    double micros = timeIt([&]() { sink = jpegSharpness(jpg.data(), jpg.size()); });
+    printf("  %-18s %7u bytes  score %8u  %8.1f us  %6.1f MB/s\n", names[i], (unsigned)jpg.size(), 
+      scores[i], micros, jpg.size() / micros);
+  }
+  if (scores[0] <= scores[1]) {
+    printf("  The blurred fixture scored at least as high as the sharp one.\n");
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  std::string fixtures = argc > 1 ? argv[1] : BENCH_FIXTURES;
+  bool ok = benchKeystone();
+  ok = benchSharpness(fixtures) && ok;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * FuzzHarness.cpp
+ *
+ * Implementation of what the fuzz targets share. See FuzzHarness.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "FuzzHarness.h"
+#include "LoggingWebServer.h"
+#include "SD_MMC.h"
+#include <stdarg.h>
+
+void setup();
+extern LoggingWebServer server;
+
+static uint64_t inputStart;                         // nativeMicros() when the input started
+static size_t inputHeap;                            // nativeHeapUsed() when the input started
+static size_t runHeap;                              // nativeHeapUsed() after setup()
+
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv) {
+  // The defaults go ahead of the command line's flags, so that theirs win
+  static char timeout[32], rss[32], malloc[32], maxLen[32];
+  snprintf(timeout, sizeof(timeout), "-timeout=%d", FUZZ_TIMEOUT_SECS);
+  snprintf(rss, sizeof(rss), "-rss_limit_mb=%d", FUZZ_RSS_LIMIT_MB);
+  snprintf(malloc, sizeof(malloc), "-malloc_limit_mb=%d", FUZZ_MALLOC_LIMIT_MB);
+  snprintf(maxLen, sizeof(maxLen), "-max_len=%d", FUZZ_MAX_LEN);
+  static std::vector<char *> args;
+  args.push_back((*argv)[0]);
+  args.insert(args.end(), {timeout, rss, malloc, maxLen});
+  args.insert(args.end(), *argv + 1, *argv + *argc);
+  args.push_back(nullptr);
+  *argc = args.size() - 1;
+  *argv = args.data();
+
+  nativeOnRestart([]() { fuzzFail("The firmware restarted."); });
+  setup();
+  fuzzSeedCard();
+  runHeap = nativeHeapUsed();
+  return 0;
+}
+
+void fuzzSeedCard() {
+  SD_MMC.format();
+  SD_MMC.mkdir("/d");
+  File f = SD_MMC.open("/index.htm", FILE_WRITE);
+  f.print("<html></html>");
+  f.close();
+  f = SD_MMC.open("/d/a.txt", FILE_WRITE);
+  f.print("hello");
+  f.close();
+  f = SD_MMC.open("/range.bin", FILE_WRITE);
+  for (size_t i = 0; i < FUZZ_RANGE_BYTES; i++) {
+    f.write((uint8_t)i);
+  }
+  f.close();
+}
+
+void fuzzBegin() {
+  inputStart = nativeMicros();
+  inputHeap = nativeHeapUsed();
+}
+
+void fuzzEnd(const char *what) {
+  uint64_t micros = nativeMicros() - inputStart;
+  if (micros > FUZZ_INPUT_MILLIS * 1000ULL) {
+    fuzzFail("%s took %llu ms of simulated time; the budget is %d ms.", what,
+      (unsigned long long)(micros / 1000), FUZZ_INPUT_MILLIS);
+  }
+  size_t heap = nativeHeapUsed();
+  if (heap > inputHeap + FUZZ_INPUT_HEAP_BYTES) {
+    fuzzFail("%s grew the heap by %zu bytes; the budget is %d.", what, heap - inputHeap,
+      FUZZ_INPUT_HEAP_BYTES);
+  }
+  if (heap > runHeap + FUZZ_RUN_HEAP_BYTES) {
+    fuzzFail("The heap has grown by %zu bytes since setup(); the budget is %d.", heap - runHeap,
+      FUZZ_RUN_HEAP_BYTES);
+  }
+}
+
+NativeResponse fuzzRequest(HTTPMethod method, const String &url, const String &body,
+                           const String &contentType,
+                           const std::vector<std::pair<String, String>> &headers) {
+  server.nativeRequest(method, url, body, contentType, headers);
+  server.handleClient();
+  return server.nativeTakeResponse();
+}
+
+String fuzzString(const uint8_t *data, size_t size) {
+  String s;
+  s.concat((const char *)data, strnlen((const char *)data, size));
+  return s;
+}
+
+void fuzzFail(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+  abort();
+}
@@ -0,0 +1,93 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * FuzzHarness.h
+ *
+ * What the fuzz targets in this directory share. Each target is built with the whole firmware,
+ * main.cpp included, against the native stand-ins (see test/native/include/Arduino.h), by its own
+ * fuzz-* environment in platformio.ini, and run with libFuzzer:
+ *
+ *     pio run -e fuzz-list && .pio/build/fuzz-list/program corpus/list
+ *
+ * LLVMFuzzerInitialize() runs setup() once and gives libFuzzer default limits -- FUZZ_TIMEOUT_SECS
+ * of real time per input, FUZZ_RSS_LIMIT_MB and FUZZ_MALLOC_LIMIT_MB of memory -- which flags on
+ * the command line override. On top of those, fuzzBegin() and fuzzEnd() hold each input to the
+ * budgets the ESP32 imposes: FUZZ_INPUT_MILLIS of simulated time, and FUZZ_INPUT_HEAP_BYTES of
+ * heap growth (FUZZ_RUN_HEAP_BYTES over the whole run, so slow leaks show up too). Breaking a
+ * budget aborts, so libFuzzer saves the input as a crash.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include "Native.h"
+#include "WebServer.h"
+#include <utility>
+#include <vector>
+
+#define FUZZ_TIMEOUT_SECS (10)                      // Default -timeout: real seconds per input
+#define FUZZ_RSS_LIMIT_MB (1024)                    // Default -rss_limit_mb
+#define FUZZ_MALLOC_LIMIT_MB (4)                    // Default -malloc_limit_mb: the PSRAM size
+#define FUZZ_MAX_LEN      (8192)                    // Default -max_len: longest input (bytes)
+#define FUZZ_INPUT_MILLIS (2000)                    // Most simulated time one input may take
+#define FUZZ_INPUT_HEAP_BYTES (16384)               // Most the heap may grow over one input
+#define FUZZ_RUN_HEAP_BYTES (65536)                 // Most the heap may grow over the whole run
+
+/**
+ * @brief Erase the SD card and put the fixture files on it: /index.htm, /range.bin
+ *        (FUZZ_RANGE_BYTES long) and /d/a.txt, so every input starts from the same card
+ *
+ */
+#define FUZZ_RANGE_BYTES  (5000)                    // The length of /range.bin
+void fuzzSeedCard();
+
+/**
+ * @brief Note the simulated time and the heap in use at the start of an input
+ *
+ */
+void fuzzBegin();
+
+/**
+ * @brief Abort if the input that fuzzBegin() started has broken the time or heap budget
+ *
+ * @param what    What the input was, for the message
+ */
+void fuzzEnd(const char *what);
+
+/**
+ * @brief Have the firmware's web server handle a request
+ *
+ * @param method      The request's method
+ * @param url         Its URL
+ * @param body        Its body, if any
+ * @param contentType Its Content-Type, if it has a body
+ * @param headers     Its other headers
+ * @return            The response
+ */
+NativeResponse fuzzRequest(HTTPMethod method, const String &url, const String &body = String(),
+                           const String &contentType = String(),
+                           const std::vector<std::pair<String, String>> &headers = {});
+
+/**
+ * @brief An input as a String, cut at the first NUL, as an Arduino String would be
+ *
+ */
+String fuzzString(const uint8_t *data, size_t size);
+
+/**
+ * @brief Abort with a message: the input broke an invariant
+ *
+ */
+void fuzzFail(const char *format, ...) __attribute__((format(printf, 1, 2), noreturn));
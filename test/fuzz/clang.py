@@ -0,0 +1,18 @@
+"""
+ObscuraCam v1.0.0
+
+clang.py
+
+PlatformIO extra script for the fuzz-* environments: build with clang rather than
+the host's default compiler, and compile and link with libFuzzer and the address
+and undefined-behaviour sanitizers. (build_flags only reach the compiler.)
+
+Copyright 2024 by D.L. Ehnebuske
+License: GNU Lesser General Public License v2.1
+"""
+Import("env")  # noqa: F821 -- provided by PlatformIO
+
+SANITIZERS = ["-fsanitize=fuzzer,address,undefined", "-fno-omit-frame-pointer"]
+
+env.Replace(CC="clang", CXX="clang++", LINK="clang++")  # noqa: F821
+env.Append(CCFLAGS=SANITIZERS, LINKFLAGS=SANITIZERS)  # noqa: F821
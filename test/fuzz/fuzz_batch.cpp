@@ -0,0 +1,61 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * fuzz_batch.cpp
+ *
+ * Fuzz target for BatchJob: the input is the JSON list of operations POST /batch would take. Any
+ * list it parses must run to completion, step by step, within the simulated-time budget, with no
+ * step taking much longer than BJ_STEP_MICROS.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "FuzzHarness.h"
+#include "SD_MMC.h"
+#include "BatchJob.h"
+#include "DiskUsage.h"
+
+bool validPath(const String &path);
+extern DiskUsage diskUsage;
+
+#define FUZZ_COPY_BYTES   (512)                     // The copy buffer size
+#define FUZZ_STEP_MICROS  (4 * BJ_STEP_MICROS)      // Longest a step may take
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  fuzzSeedCard();
+  fuzzBegin();
+  {
+    BatchJob job(SD_MMC, diskUsage, FUZZ_COPY_BYTES, validPath);
+    if (job.parse(fuzzString(data, size))) {
+      uint64_t begin = nativeMicros();
+      bool more = true;
+      while (more) {
+        uint64_t start = nativeMicros();
+        more = job.step();
+        if (nativeMicros() - start > FUZZ_STEP_MICROS) {
+          fuzzFail("A step took %llu us.", (unsigned long long)(nativeMicros() - start));
+        }
+        if (nativeMicros() - begin > FUZZ_INPUT_MILLIS * 1000ULL) {
+          break;                                    // fuzzEnd() will report it
+        }
+      }
+      String report = job.toJson();
+      if (!report.startsWith("{") || !report.endsWith("}")) {
+        fuzzFail("The report isn't a JSON object: %s", report.c_str());
+      }
+    }
+  }
+  fuzzEnd("BatchJob");
+  return 0;
+}
@@ -0,0 +1,62 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * fuzz_edit.cpp
+ *
+ * Fuzz target for the /edit handlers. The first byte of the input picks the request: a PUT (create
+ * or move) or a DELETE with the rest of the input as its form-encoded body, or a POST uploading
+ * a file, the rest of the input being the file name, a newline and the file's contents. Every
+ * request must get a response, and the fixtures outside what it names must be left alone.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "FuzzHarness.h"
+#include "SD_MMC.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  fuzzSeedCard();
+  fuzzBegin();
+  String rest;
+  rest.concat((const char *)data + 1, size - 1);
+  NativeResponse r;
+  switch (data[0] % 3) {
+  case 0:
+    r = fuzzRequest(HTTP_PUT, "/edit", rest, "application/x-www-form-urlencoded");
+    break;
+  case 1:
+    r = fuzzRequest(HTTP_DELETE, "/edit", rest, "application/x-www-form-urlencoded");
+    break;
+  default: {
+    int nl = rest.indexOf('\n');
+    String name = nl < 0 ? rest : rest.substring(0, nl);
+    String contents = nl < 0 ? String() : rest.substring(nl + 1);
+    r = fuzzRequest(HTTP_POST, "/edit", "--FuzzBoundary\r\nContent-Disposition: form-data; "
+      "name=\"data\"; filename=\"" + name + "\"\r\nContent-Type: application/octet-stream\r\n\r\n" +
+      contents + "\r\n--FuzzBoundary--\r\n", "multipart/form-data; boundary=FuzzBoundary");
+    break;
+  }
+  }
+  if (r.code == 0) {
+    fuzzFail("No response.");
+  }
+  if (rest.indexOf("range") < 0 && SD_MMC.open("/range.bin").size() != FUZZ_RANGE_BYTES) {
+    fuzzFail("A request that didn't name /range.bin changed it.");
+  }
+  fuzzEnd("/edit");
+  return 0;
+}
@@ -0,0 +1,37 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * fuzz_list.cpp
+ *
+ * Fuzz target for the GET /list handler: the input is the query string. The response must be a
+ * JSON array, or an error, and must not list anything outside the directory asked for.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "FuzzHarness.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  fuzzSeedCard();
+  fuzzBegin();
+  NativeResponse r = fuzzRequest(HTTP_GET, "/list?" + fuzzString(data, size));
+  if (r.code == 0) {
+    fuzzFail("No response.");
+  }
+  if (r.code == 200 && (!r.body.startsWith("[") || !r.body.endsWith("]"))) {
+    fuzzFail("A 200 that isn't a JSON array: %s", r.body.c_str());
+  }
+  fuzzEnd("GET /list");
+  return 0;
+}
@@ -0,0 +1,58 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * fuzz_range.cpp
+ *
+ * Fuzz target for sendRange(): the input is the Range header of a GET for /range.bin, a fixture
+ * FUZZ_RANGE_BYTES long. A 206 response must carry exactly the bytes its Content-Range names;
+ * anything else must be a 416 or, with no "bytes=" at all, the whole file.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "FuzzHarness.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  fuzzSeedCard();
+  fuzzBegin();
+  NativeResponse r = fuzzRequest(HTTP_GET, "/range.bin", String(), String(),
+    {{"Range", fuzzString(data, size)}});
+  if (r.code == 206) {
+    unsigned long first, last, total;
+    int at = r.headers.indexOf("Content-Range: bytes ");
+    if (at < 0 || sscanf(r.headers.c_str() + at + 21, "%lu-%lu/%lu", &first, &last, &total) != 3) {
+      fuzzFail("A 206 without a Content-Range.");
+    }
+    if (first > last || last >= total || total != FUZZ_RANGE_BYTES) {
+      fuzzFail("Content-Range bytes %lu-%lu/%lu is impossible.", first, last, total);
+    }
+    if (r.body.length() != last - first + 1) {
+      fuzzFail("Content-Range says %lu bytes, but %u were sent.", last - first + 1,
+        r.body.length());
+    }
+    for (size_t i = 0; i < r.body.length(); i++) {
+      if ((uint8_t)r.body[i] != (uint8_t)(first + i)) {
+        fuzzFail("Byte %lu of the range is wrong.", (unsigned long)i);
+      }
+    }
+  } else if (r.code == 200) {
+    if (r.body.length() != FUZZ_RANGE_BYTES) {
+      fuzzFail("A 200 with %u of the file's %d bytes.", r.body.length(), FUZZ_RANGE_BYTES);
+    }
+  } else if (r.code != 416) {
+    fuzzFail("A ranged GET got a %d.", r.code);
+  }
+  fuzzEnd("GET /range.bin");
+  return 0;
+}
@@ -0,0 +1,52 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * fuzz_valid_path.cpp
+ *
+ * Fuzz target for validPath(), which stands between request arguments and the SD card. A path
+ * it accepts must be absolute, no longer than MAX_PATH_CHARS, and free of control characters,
+ * backslashes, empty segments and "." or ".." segments.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "FuzzHarness.h"
+
+bool validPath(const String &path);
+
+#define FUZZ_MAX_PATH_CHARS (128)                   // main.cpp's MAX_PATH_CHARS
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  fuzzBegin();
+  String path = fuzzString(data, size);
+  if (validPath(path)) {
+    if (path.length() > FUZZ_MAX_PATH_CHARS || path[0] != '/') {
+      fuzzFail("Accepted a relative or overlong path.");
+    }
+    if (path.indexOf("//") >= 0 || path.indexOf('\\') >= 0) {
+      fuzzFail("Accepted a path with an empty segment or a backslash.");
+    }
+    if (path.indexOf("/./") >= 0 || path.endsWith("/.") || path.indexOf("/../") >= 0 ||
+        path.endsWith("/..")) {
+      fuzzFail("Accepted a path with a \".\" or \"..\" segment.");
+    }
+    for (size_t i = 0; i < path.length(); i++) {
+      if ((uint8_t)path[i] < ' ' || path[i] == 0x7F) {
+        fuzzFail("Accepted a path with a control character.");
+      }
+    }
+  }
+  fuzzEnd("validPath()");
+  return 0;
+}
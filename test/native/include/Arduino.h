@@ -0,0 +1,146 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Arduino.h
+ *
+ * Host stand-in for the parts of the arduino-esp32 core the firmware uses, so the firmware's
+ * modules (and main.cpp) can be built and exercised on the host by the native environments in
+ * platformio.ini: the unit tests, the benchmarks, the fuzzers and the soak harness.
+ *
+ * Time is simulated. millis(), micros() and esp_timer_get_time() read a clock that only moves
+ * when delay() is called, when the harness advances it (see Native.h), when the SD card stand-in
+ * charges for the I/O it does (see FS.h), and by NATIVE_READ_MICROS each time it's read, so a
+ * loop waiting on the clock always ends. A run is repeatable, and a harness can cover days of
+ * uptime in seconds.
+ *
+ * PSRAM is ordinary heap. The free-heap figures ESP reports come from the host allocator,
+ * measured against a nominal NATIVE_HEAP_BYTES heap, so a leak shows up the way it would on the
+ * ESP32.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+#include "WString.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+
+#define NATIVE_HEAP_BYTES (320UL * 1024)            // The nominal internal heap size
+#define NATIVE_PSRAM_BYTES (4UL * 1024 * 1024)      // The nominal PSRAM size
+#define NATIVE_CPU_MHZ    (240)                     // The CPU clock at reset (MHz)
+#define NATIVE_READ_MICROS (1)                      // Simulated time a read of the clock takes
+
+using std::min;
+using std::max;
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define F(s)              (s)
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define LOW               (0x0)
+#define HIGH              (0x1)
+#define INPUT             (0x01)
+#define OUTPUT            (0x03)
+
+typedef enum {
+  GPIO_NUM_0 = 0, GPIO_NUM_2 = 2, GPIO_NUM_4 = 4, GPIO_NUM_12 = 12, GPIO_NUM_13 = 13,
+  GPIO_NUM_14 = 14, GPIO_NUM_15 = 15, GPIO_NUM_16 = 16, GPIO_NUM_33 = 33
+} gpio_num_t;
+
+// Pins
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+// Time
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+// Memory
+void *ps_malloc(size_t size);
+void *ps_calloc(size_t n, size_t size);
+void *ps_realloc(void *ptr, size_t size);
+bool psramFound();
+
+// CPU clock
+bool setCpuFrequencyMhz(uint32_t mhz);
+uint32_t getCpuFrequencyMhz();
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+/**
+ * @brief The BSD strlcpy(), which newlib has and older glibcs don't
+ *
+ */
+inline size_t strlcpy(char *dst, const char *src, size_t size) {
+  size_t len = strlen(src);
+  if (size != 0) {
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return len;
+}
+#endif
+
+// FreeRTOS and the hardware timers, as far as the firmware uses them. The host runs everything as
+// one task on core 1, so the critical sections have nothing to exclude.
+typedef struct { int owner; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+typedef void *TaskHandle_t;
+TaskHandle_t xTaskGetCurrentTaskHandle();
+const char *pcTaskGetTaskName(TaskHandle_t handle);
+inline int xPortGetCoreID() { return 1; }
+#define IRAM_ATTR
+typedef struct hw_timer_s hw_timer_t;
+
+class EspClass {
+public:
+  uint32_t getCycleCount();
+  void restart();
+  uint32_t getHeapSize() { return NATIVE_HEAP_BYTES; }
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap() { return getFreeHeap(); }
+  uint32_t getPsramSize() { return NATIVE_PSRAM_BYTES; }
+  uint32_t getFreePsram() { return NATIVE_PSRAM_BYTES; }
+  uint32_t getMaxAllocPsram() { return NATIVE_PSRAM_BYTES; }
+};
+extern EspClass ESP;
+
+class HardwareSerial {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  void setDebugOutput(bool on) { (void)on; }
+  void flush() { fflush(stdout); }
+  size_t print(const String &s) { return fputs(s.c_str(), stdout) < 0 ? 0 : s.length(); }
+  size_t println(const String &s = String()) { return print(s) + print("\n"); }
+  int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+  operator bool() const { return true; }
+};
+extern HardwareSerial Serial;
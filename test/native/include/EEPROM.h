@@ -0,0 +1,40 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * EEPROM.h
+ *
+ * Host stand-in for the core's EEPROM emulation, for the native environment (see Arduino.h). Like
+ * the real one, it's kept in flash (here, for the life of the process), so what was committed
+ * survives a simulated reboot and what wasn't doesn't.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+
+#define NATIVE_EEPROM_BYTES (4096)                  // The most begin() can be given
+
+class EEPROMClass {
+public:
+  bool begin(size_t size);
+  bool commit();
+  uint16_t readUShort(int address);
+  size_t writeUShort(int address, uint16_t value);
+
+private:
+  uint8_t data[NATIVE_EEPROM_BYTES];                // What's been written since begin()
+  size_t bytes = 0;                                 // The size begin() was given
+};
+extern EEPROMClass EEPROM;
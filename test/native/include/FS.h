@@ -0,0 +1,150 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * FS.h
+ *
+ * Host stand-in for the core's file system classes, for the native environment (see Arduino.h).
+ * An fs::FS here is a FAT-like card held in memory:
+ *
+ *   - Names are case-insensitive. Paths must be absolute; a ".." segment aborts the program, since
+ *     the firmware is meant to have refused it long before it got here. Control characters and
+ *     "*:<>?\| in a name make the call fail, as they do on FAT.
+ *   - Directories list their entries in the order they were created, and an openNextFile() loop
+ *     carries on correctly while entries are removed, as it does on the ESP32.
+ *   - What's written through a File only reaches the card at flush() or close(). powerLoss()
+ *     throws away everything not yet flushed, leaving what a reset would leave on a real card.
+ *   - Space is allocated in NATIVE_CLUSTER_BYTES clusters, and usedBytes() counts them, as FatFs
+ *     does.
+ *   - Every call charges the simulated clock for the time the SD card would take.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include <time.h>
+#include <memory>
+
+#define FILE_READ         "r"
+#define FILE_WRITE        "w"
+#define FILE_APPEND       "a"
+
+#define NATIVE_CARD_BYTES (1024ULL * 1024 * 1024)   // Default card capacity
+#define NATIVE_CLUSTER_BYTES (32768)                // Allocation unit
+#define NATIVE_SD_OP_MICROS (500)                   // Simulated time for an open, remove, rename, ...
+#define NATIVE_SD_KB_MICROS (100)                   // Simulated time to move 1 KB to or from the card
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+struct Card;
+struct FileImpl;
+
+class File {
+public:
+  File() {}
+  File(std::shared_ptr<FileImpl> impl) : impl(impl) {}
+
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t size);
+  size_t print(const String &s) { return write((const uint8_t *)s.c_str(), s.length()); }
+  size_t println(const String &s = String()) { return print(s) + print("\n"); }
+  int available();
+  int read();
+  int peek();
+  size_t read(uint8_t *buf, size_t size);
+  size_t readBytes(char *buf, size_t size) { return read((uint8_t *)buf, size); }
+  String readStringUntil(char terminator);
+  String readString();
+  void flush();
+  bool seek(uint32_t pos, SeekMode mode);
+  bool seek(uint32_t pos) { return seek(pos, SeekSet); }
+  size_t position() const;
+  size_t size() const;
+  bool setBufferSize(size_t size) { (void)size; return true; }
+  void close();
+  operator bool() const;
+  time_t getLastWrite();
+  const char *path() const;
+  const char *name() const;
+  bool isDirectory();
+  File openNextFile(const char *mode = FILE_READ);
+  void rewindDirectory();
+
+private:
+  std::shared_ptr<FileImpl> impl;
+};
+
+class FS {
+public:
+  /**
+   * @brief Construct a new, empty, card holding up to capacity bytes
+   *
+   */
+  FS(uint64_t capacity = NATIVE_CARD_BYTES);
+
+  File open(const char *path, const char *mode = FILE_READ, const bool create = false);
+  File open(const String &path, const char *mode = FILE_READ, const bool create = false) {
+    return open(path.c_str(), mode, create);
+  }
+  bool exists(const char *path);
+  bool exists(const String &path) { return exists(path.c_str()); }
+  bool remove(const char *path);
+  bool remove(const String &path) { return remove(path.c_str()); }
+  bool rename(const char *from, const char *to);
+  bool rename(const String &from, const String &to) { return rename(from.c_str(), to.c_str()); }
+  bool mkdir(const char *path);
+  bool mkdir(const String &path) { return mkdir(path.c_str()); }
+  bool rmdir(const char *path);
+  bool rmdir(const String &path) { return rmdir(path.c_str()); }
+
+  /**
+   * @brief The card's capacity and the space allocated to files and directories (bytes)
+   *
+   */
+  uint64_t totalBytes();
+  uint64_t usedBytes();
+
+  /**
+   * @brief Native only: lose everything written but not flushed through the Files open now, as
+   *        a reset would. The Files stay usable, but nothing more they write reaches the card.
+   *
+   */
+  void powerLoss();
+
+  /**
+   * @brief Native only: cut a file short, as a write torn by a reset might leave it
+   *
+   */
+  bool truncate(const char *path, size_t size);
+
+  /**
+   * @brief Native only: erase everything
+   *
+   */
+  void format();
+
+protected:
+  std::shared_ptr<Card> card;
+};
+
+} // namespace fs
+
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
@@ -0,0 +1,40 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * IPAddress.h
+ *
+ * Host stand-in for the core's IPAddress class, for the native environment (see Arduino.h).
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+
+class IPAddress {
+public:
+  IPAddress() : addr(0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) :
+    addr(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+  IPAddress(uint32_t address) : addr(address) {}
+  operator uint32_t() const { return addr; }
+  bool operator==(const IPAddress &other) const { return addr == other.addr; }
+  uint8_t operator[](int index) const { return addr >> (8 * index); }
+  String toString() const;
+  bool fromString(const char *address);
+  bool fromString(const String &address) { return fromString(address.c_str()); }
+
+private:
+  uint32_t addr;                                    // The first octet is the low byte, as on the ESP32
+};
@@ -0,0 +1,94 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Native.h
+ *
+ * Controls for the host stand-ins that only a native harness uses: the simulated clock, the
+ * frames the camera stand-in delivers, what happens on ESP.restart() and how much of the heap is
+ * in use. The firmware itself never includes this.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include <memory>
+#include <string>
+
+/**
+ * @brief The simulated clock: micros() since "reset", and moving it on
+ *
+ */
+uint64_t nativeMicros();
+void nativeAdvanceMicros(uint64_t us);
+
+/**
+ * @brief Bytes of host heap in use, as the free-heap figures see it: not counting what's
+ *        allocated with a NativeAllocator
+ *
+ */
+size_t nativeHeapUsed();
+
+/**
+ * @brief Bytes of host heap allocated with a NativeAllocator
+ *
+ */
+inline size_t nativeUncountedBytes = 0;
+
+/**
+ * @brief An allocator for host heap standing in for what, on the ESP32, isn't in its heap at
+ *        all -- the contents of the files on the SD card, the body of a request still in the
+ *        network -- so that nativeHeapUsed() leaves it out
+ *
+ */
+template <typename T> struct NativeAllocator {
+  typedef T value_type;
+  NativeAllocator() {}
+  template <typename U> NativeAllocator(const NativeAllocator<U> &) {}
+  T *allocate(size_t n) {
+    nativeUncountedBytes += n * sizeof(T);
+    return std::allocator<T>().allocate(n);
+  }
+  void deallocate(T *p, size_t n) {
+    nativeUncountedBytes -= n * sizeof(T);
+    std::allocator<T>().deallocate(p, n);
+  }
+  template <typename U> bool operator==(const NativeAllocator<U> &) const { return true; }
+  template <typename U> bool operator!=(const NativeAllocator<U> &) const { return false; }
+};
+typedef std::basic_string<char, std::char_traits<char>, NativeAllocator<char>> NativeString;
+
+/**
+ * @brief Set what ESP.restart() does. By default it exits the process.
+ *
+ */
+void nativeOnRestart(void (*handler)());
+
+/**
+ * @brief Set the JPEG the camera stand-in returns from esp_camera_fb_get(). The data are copied.
+ *        Until this is called, or after it's called with len 0, captures fail.
+ *
+ * @param jpg     The JPEG image
+ * @param len     Its length (bytes)
+ * @param width   Its width (pixels)
+ * @param height  Its height (pixels)
+ */
+void nativeCameraFrame(const uint8_t *jpg, size_t len, uint16_t width, uint16_t height);
+
+/**
+ * @brief Set the luma jpg2rgb565() fills the decoded images with, for scenes with no motion
+ *        (every frame the same) or with some (the level changes)
+ *
+ */
+void nativeCameraLuma(uint8_t luma);
@@ -0,0 +1,42 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Preferences.h
+ *
+ * Host stand-in for the core's Preferences (NVS) class, for the native environment (see
+ * Arduino.h). The namespaces are kept in memory for the life of the process, so they survive a
+ * simulated reboot as NVS survives a real one.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+
+class Preferences {
+public:
+  bool begin(const char *name, bool readOnly = false, const char *partitionLabel = nullptr);
+  void end();
+  bool clear();
+  bool remove(const char *key);
+  bool isKey(const char *key);
+  size_t putBytes(const char *key, const void *value, size_t len);
+  size_t getBytesLength(const char *key);
+  size_t getBytes(const char *key, void *buf, size_t maxLen);
+
+private:
+  String ns;
+  bool open = false;
+  bool readOnly = true;
+};
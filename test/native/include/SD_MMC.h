@@ -0,0 +1,46 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * SD_MMC.h
+ *
+ * Host stand-in for the core's SD_MMC card, for the native environment: an in-memory fs::FS
+ * card (see FS.h) that begin() always mounts.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "FS.h"
+
+typedef enum {
+  CARD_NONE, CARD_MMC, CARD_SD, CARD_SDHC, CARD_UNKNOWN
+} sdcard_type_t;
+
+namespace fs {
+
+class SDMMCFS : public FS {
+public:
+  bool begin(const char *mountpoint = "/sdcard", bool mode1bit = false,
+             bool formatIfMountFailed = false, int frequency = 20000, uint8_t maxOpenFiles = 5);
+  void end() { mounted = false; }
+  sdcard_type_t cardType() { return mounted ? CARD_SDHC : CARD_NONE; }
+  uint64_t cardSize() { return totalBytes(); }
+
+private:
+  bool mounted = false;
+};
+
+} // namespace fs
+
+extern fs::SDMMCFS SD_MMC;
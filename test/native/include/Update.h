@@ -0,0 +1,49 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Update.h
+ *
+ * Host stand-in for the core's Update library, for the native environment (see Arduino.h). It
+ * makes the checks the ESP32 makes on the way in -- the image's magic byte and, if one was given,
+ * the form of the MD5 -- and throws the image away.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+
+#define UPDATE_SIZE_UNKNOWN (0xFFFFFFFF)
+#define U_FLASH           (0)
+#define U_SPIFFS          (100)
+
+class UpdateClass {
+public:
+  bool begin(size_t size = UPDATE_SIZE_UNKNOWN, int command = U_FLASH, int ledPin = -1,
+             uint8_t ledOn = LOW, const char *label = nullptr);
+  size_t write(uint8_t *data, size_t len);
+  bool end(bool evenIfRemaining = false);
+  void abort();
+  bool setMD5(const char *expected);
+  const char *errorString() { return error; }
+  bool hasError() { return error[0] != '\0'; }
+  bool isRunning() { return running; }
+  size_t progress() { return written; }
+
+private:
+  bool running = false;
+  size_t written = 0;
+  const char *error = "";
+};
+extern UpdateClass Update;
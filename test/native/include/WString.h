@@ -0,0 +1,130 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * WString.h
+ *
+ * Host stand-in for the Arduino core's String class, for the native environment (see
+ * platformio.ini). It has the members the firmware uses, with the core's semantics: numbers
+ * concatenate as their decimal text, doubles with two places unless told otherwise, and
+ * substring() and the searches clamp out-of-range indexes rather than failing.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include <stddef.h>
+#include <string>
+
+class String {
+public:
+  String() {}
+  String(const char *cstr) : s(cstr == nullptr ? "" : cstr) {}
+  String(const char *cstr, size_t len) : s(cstr, len) {}
+  String(const std::string &str) : s(str) {}
+  String(char c) : s(1, c) {}
+  String(unsigned char n, unsigned char base = 10) : s(format((unsigned long long)n, base)) {}
+  String(int n, unsigned char base = 10) : s(format((long long)n, base)) {}
+  String(unsigned int n, unsigned char base = 10) : s(format((unsigned long long)n, base)) {}
+  String(long n, unsigned char base = 10) : s(format((long long)n, base)) {}
+  String(unsigned long n, unsigned char base = 10) : s(format((unsigned long long)n, base)) {}
+  String(long long n, unsigned char base = 10) : s(format(n, base)) {}
+  String(unsigned long long n, unsigned char base = 10) : s(format(n, base)) {}
+  String(float f, unsigned char decimals = 2) : s(format((double)f, decimals)) {}
+  String(double d, unsigned char decimals = 2) : s(format(d, decimals)) {}
+  String(const String &str) = default;
+  String(String &&str) = default;
+  String &operator=(const String &str) = default;
+  // Like the core's, a move frees what this String held, even when str is short
+  String &operator=(String &&str) { std::string(std::move(str.s)).swap(s); return *this; }
+
+  const char *c_str() const { return s.c_str(); }
+  unsigned int length() const { return s.length(); }
+  bool isEmpty() const { return s.empty(); }
+  bool reserve(unsigned int size) { s.reserve(size); return true; }
+
+  char operator[](unsigned int index) const { return index < s.length() ? s[index] : '\0'; }
+  char &operator[](unsigned int index);
+  char charAt(unsigned int index) const { return (*this)[index]; }
+  void setCharAt(unsigned int index, char c) { if (index < s.length()) s[index] = c; }
+
+  bool concat(const String &str) { s += str.s; return true; }
+  bool concat(const char *cstr) { if (cstr != nullptr) s += cstr; return cstr != nullptr; }
+  bool concat(const char *cstr, unsigned int len) { s.append(cstr, len); return true; }
+  bool concat(char c) { s += c; return true; }
+  bool concat(unsigned char n) { return concat(String(n)); }
+  bool concat(int n) { return concat(String(n)); }
+  bool concat(unsigned int n) { return concat(String(n)); }
+  bool concat(long n) { return concat(String(n)); }
+  bool concat(unsigned long n) { return concat(String(n)); }
+  bool concat(long long n) { return concat(String(n)); }
+  bool concat(unsigned long long n) { return concat(String(n)); }
+  bool concat(float f) { return concat(String(f)); }
+  bool concat(double d) { return concat(String(d)); }
+  template <typename T> String &operator+=(const T &rhs) { concat(rhs); return *this; }
+
+  bool equals(const String &str) const { return s == str.s; }
+  bool equals(const char *cstr) const { return s == (cstr == nullptr ? "" : cstr); }
+  bool equalsIgnoreCase(const String &str) const;
+  int compareTo(const String &str) const { return s.compare(str.s); }
+  bool operator==(const String &rhs) const { return equals(rhs); }
+  bool operator==(const char *cstr) const { return equals(cstr); }
+  bool operator!=(const String &rhs) const { return !equals(rhs); }
+  bool operator!=(const char *cstr) const { return !equals(cstr); }
+  bool operator<(const String &rhs) const { return s < rhs.s; }
+  bool operator>(const String &rhs) const { return s > rhs.s; }
+  bool operator<=(const String &rhs) const { return s <= rhs.s; }
+  bool operator>=(const String &rhs) const { return s >= rhs.s; }
+
+  bool startsWith(const String &prefix) const { return startsWith(prefix, 0); }
+  bool startsWith(const String &prefix, unsigned int offset) const;
+  bool endsWith(const String &suffix) const;
+
+  int indexOf(char c, unsigned int from = 0) const { return found(s.find(c, from)); }
+  int indexOf(const String &str, unsigned int from = 0) const { return found(s.find(str.s, from)); }
+  int lastIndexOf(char c) const { return found(s.rfind(c)); }
+  int lastIndexOf(char c, unsigned int from) const { return found(s.rfind(c, from)); }
+  int lastIndexOf(const String &str) const { return found(s.rfind(str.s)); }
+  int lastIndexOf(const String &str, unsigned int from) const { return found(s.rfind(str.s, from)); }
+
+  String substring(unsigned int from) const { return substring(from, s.length()); }
+  String substring(unsigned int from, unsigned int to) const;
+
+  void replace(char find, char with);
+  void replace(const String &find, const String &with);
+  void remove(unsigned int index) { remove(index, (unsigned int)-1); }
+  void remove(unsigned int index, unsigned int count);
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+
+  long toInt() const;
+  float toFloat() const { return (float)toDouble(); }
+  double toDouble() const;
+
+  const char *begin() const { return s.c_str(); }
+  const char *end() const { return s.c_str() + s.length(); }
+
+private:
+  std::string s;
+
+  static int found(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+  static std::string format(long long n, unsigned char base);
+  static std::string format(unsigned long long n, unsigned char base);
+  static std::string format(double d, unsigned char decimals);
+};
+
+String operator+(const String &lhs, const String &rhs);
+String operator+(const char *lhs, const String &rhs);
+inline bool operator==(const char *lhs, const String &rhs) { return rhs == lhs; }
+inline bool operator!=(const char *lhs, const String &rhs) { return rhs != lhs; }
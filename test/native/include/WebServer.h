@@ -0,0 +1,221 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * WebServer.h
+ *
+ * Host stand-in for the core's synchronous WebServer, for the native environment (see
+ * Arduino.h). There's no network: a harness queues a request with nativeRequest(), and the next
+ * handleClient() handles it the way the ESP32's WebServer would -- arguments from the query and
+ * from a form-encoded body, multipart file uploads through the upload callback in
+ * HTTP_UPLOAD_BUFLEN pieces, other bodies through the raw callback, then the request handler or
+ * the not-found handler -- and keeps the response for nativeResponse(). A file upload torn off
+ * before its part's closing delimiter ends UPLOAD_FILE_ABORTED and, as on the ESP32, the request
+ * is dropped: neither handler is called and there's no response.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include "Native.h"
+#include "FS.h"
+#include "WiFi.h"
+#include "uri/Uri.h"
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// The http_parser method numbers the ESP32's WebServer uses
+enum HTTPMethod {
+  HTTP_DELETE = 0, HTTP_GET = 1, HTTP_HEAD = 2, HTTP_POST = 3, HTTP_PUT = 4, HTTP_OPTIONS = 6,
+  HTTP_PATCH = 28
+};
+#define HTTP_ANY          ((HTTPMethod)255)
+
+enum HTTPUploadStatus {
+  UPLOAD_FILE_START, UPLOAD_FILE_WRITE, UPLOAD_FILE_END, UPLOAD_FILE_ABORTED
+};
+enum HTTPRawStatus { RAW_START, RAW_WRITE, RAW_END, RAW_ABORTED };
+
+#define HTTP_UPLOAD_BUFLEN (1436)                   // Most bytes per call of the upload callback
+#define HTTP_RAW_BUFLEN   (1436)                    // Most bytes per call of the raw callback
+#define CONTENT_LENGTH_UNKNOWN ((size_t) -1)
+#define CONTENT_LENGTH_NOT_SET ((size_t) -2)
+
+typedef struct {
+  HTTPUploadStatus status;
+  String filename;
+  String name;
+  String type;
+  size_t totalSize;
+  size_t currentSize;
+  uint8_t buf[HTTP_UPLOAD_BUFLEN];
+} HTTPUpload;
+
+typedef struct {
+  HTTPRawStatus status;
+  size_t totalSize;
+  size_t currentSize;
+  uint8_t buf[HTTP_RAW_BUFLEN];
+} HTTPRaw;
+
+/**
+ * @brief Native only: the response to the last request handled
+ *
+ */
+struct NativeResponse {
+  int code;                                         // The status code; 0 if nothing was sent
+  String contentType;
+  String headers;                                   // "Name: value\r\n" for each header sent
+  String body;                                      // Everything sent after the headers
+};
+
+class WebServer {
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  WebServer(int port = 80) : port(port) {}
+  virtual ~WebServer() {}
+
+  void begin() { listening = true; }
+  void handleClient();
+
+  void on(const Uri &uri, HTTPMethod method, THandlerFunction fn) { on(uri, method, fn, nullptr); }
+  void on(const Uri &uri, HTTPMethod method, THandlerFunction fn, THandlerFunction ufn);
+  void onNotFound(THandlerFunction fn) { notFound = fn; }
+  void collectHeaders(const char *headerKeys[], const size_t headerKeysCount);
+
+  String uri() { return requestUri; }
+  HTTPMethod method() { return requestMethod; }
+  WiFiClient client() { return WiFiClient(this); }
+  HTTPUpload &upload() { return *currentUpload; }
+  HTTPRaw &raw() { return *currentRaw; }
+
+  String arg(const String &name);
+  String arg(int i);
+  String argName(int i);
+  int args() { return (int)requestArgs.size(); }
+  bool hasArg(const String &name);
+  String header(const String &name);
+  bool hasHeader(const String &name);
+
+  void send(int code, const char *contentType = nullptr, const String &content = String(""));
+  void send(int code, char *contentType, const String &content) {
+    send(code, (const char *)contentType, content);
+  }
+  void send(int code, const String &contentType, const String &content) {
+    send(code, contentType.c_str(), content);
+  }
+  void send(int code, const char *contentType, const char *content) {
+    send(code, contentType, String(content));
+  }
+  void sendHeader(const String &name, const String &value, bool first = false);
+  void setContentLength(const size_t contentLength) { contentLength_ = contentLength; }
+  void sendContent(const String &content) { sendContent(content.c_str(), content.length()); }
+  void sendContent(const char *content, size_t size);
+  template <typename T>
+  size_t streamFile(T &file, const String &contentType, const int code = 200) {
+    setContentLength(file.size());
+    send(code, contentType, "");
+    uint8_t buf[512];
+    size_t n, sent = 0;
+    while ((n = file.read(buf, sizeof(buf))) > 0) {
+      sent += clientWrite(buf, n);
+    }
+    return sent;
+  }
+
+  /**
+   * @brief Native only: queue a request for the next handleClient() to handle
+   *
+   * @param method      Its method
+   * @param url         Its URL: the path and, optionally, "?" and a query string
+   * @param body        Its body, if any
+   * @param contentType Its Content-Type, if it has a body
+   * @param headers     Its other headers
+   * @param ip          The client's address
+   * @param port        The client's port
+   */
+  void nativeRequest(HTTPMethod method, const String &url, String body = String(),
+                     const String &contentType = String(),
+                     const std::vector<std::pair<String, String>> &headers = {},
+                     IPAddress ip = IPAddress(192, 168, 4, 2), uint16_t port = 49152);
+
+  /**
+   * @brief Native only: whether a queued request is waiting to be handled
+   *
+   */
+  bool nativePending() const { return pending; }
+
+  /**
+   * @brief Native only: the response to the last request handled
+   *
+   */
+  const NativeResponse &nativeResponse() const { return response; }
+
+  /**
+   * @brief Native only: take the response to the last request handled, so that it no longer
+   *        counts against the heap the way a response streamed to a client wouldn't
+   *
+   */
+  NativeResponse nativeTakeResponse() {
+    NativeResponse taken = response;
+    response = NativeResponse{0, String(), String(), String()};
+    return taken;
+  }
+
+  // For WiFiClient
+  size_t clientWrite(const uint8_t *buf, size_t size);
+  IPAddress clientIp() const { return requestIp; }
+  uint16_t clientPort() const { return requestPort; }
+
+private:
+  struct Handler {
+    std::unique_ptr<Uri> uri;
+    HTTPMethod method;
+    THandlerFunction fn;
+    THandlerFunction ufn;
+  };
+
+  int port;
+  bool listening = false;
+  std::vector<Handler> handlers;
+  THandlerFunction notFound;
+  std::vector<String> headerKeys;                   // The headers collectHeaders() asked for
+
+  bool pending = false;                             // The queued request
+  HTTPMethod pendingMethod = HTTP_GET;
+  String pendingUrl;
+  NativeString pendingBody;                         // Not in the heap, but "in the network"
+  String pendingType;
+  std::vector<std::pair<String, String>> pendingHeaders;
+  IPAddress pendingIp;
+  uint16_t pendingPort = 0;
+
+  HTTPMethod requestMethod = HTTP_GET;              // The request being handled
+  String requestUri;
+  IPAddress requestIp;
+  uint16_t requestPort = 0;
+  std::vector<std::pair<String, String>> requestArgs;
+  std::vector<std::pair<String, String>> requestHeaders;
+  std::unique_ptr<HTTPUpload> currentUpload;
+  std::unique_ptr<HTTPRaw> currentRaw;
+  size_t contentLength_ = CONTENT_LENGTH_NOT_SET;
+  NativeResponse response;
+
+  void parseArgs(const String &query);
+  bool parseMultipart(Handler *handler, const String &boundary);
+  void feedRaw(Handler *handler);
+};
@@ -0,0 +1,67 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * WiFi.h
+ *
+ * Host stand-in for the core's WiFi library, for the native environment (see Arduino.h). The
+ * soft AP always comes up, at the address it's configured with. A WiFiClient is the client of the
+ * request the WebServer stand-in is handling (see WebServer.h): it has that request's address and
+ * port, and what's written to it goes into the response.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include "IPAddress.h"
+
+typedef enum { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+
+#define AP_STARTED_BIT    (1 << 3)                  // WiFi.waitStatusBits() bit: the soft AP is up
+
+class WebServer;
+
+class WiFiClient {
+public:
+  WiFiClient() : server(nullptr) {}
+  WiFiClient(WebServer *server) : server(server) {}
+  size_t write(const uint8_t *buf, size_t size);
+  size_t write(uint8_t c) { return write(&c, 1); }
+  IPAddress remoteIP() const;
+  uint16_t remotePort() const;
+  uint8_t connected() const { return server != nullptr; }
+  operator bool() const { return server != nullptr; }
+
+private:
+  WebServer *server;                                // Whose request this is the client of
+};
+
+class WiFiClass {
+public:
+  void persistent(bool persistent) { (void)persistent; }
+  bool mode(wifi_mode_t m) { wifiMode = m; return true; }
+  wifi_mode_t getMode() { return wifiMode; }
+  bool softAP(const char *ssid, const char *passphrase = nullptr, int channel = 1,
+              int ssidHidden = 0, int maxConnection = 4);
+  bool softAPConfig(IPAddress localIp, IPAddress gateway, IPAddress subnet);
+  bool softAPdisconnect(bool wifiOff = false);
+  IPAddress softAPIP() { return apIp; }
+  int waitStatusBits(int bits, uint32_t timeoutMillis);
+
+private:
+  wifi_mode_t wifiMode = WIFI_OFF;
+  bool apUp = false;
+  IPAddress apIp = IPAddress(192, 168, 4, 1);
+};
+extern WiFiClass WiFi;
@@ -0,0 +1,77 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * esp_camera.h
+ *
+ * Host stand-in for the esp32-camera driver, for the native environment (see Arduino.h). Every
+ * capture returns the JPEG the harness gave nativeCameraFrame() (see Native.h); until it's given
+ * one, captures fail. Like the driver, it hands out at most fb_count frame buffers at a time.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "esp_err.h"
+#include "sensor.h"
+
+typedef enum { LEDC_CHANNEL_0, LEDC_CHANNEL_1 } ledc_channel_t;
+typedef enum { LEDC_TIMER_0, LEDC_TIMER_1 } ledc_timer_t;
+typedef enum { CAMERA_GRAB_WHEN_EMPTY, CAMERA_GRAB_LATEST } camera_grab_mode_t;
+typedef enum { CAMERA_FB_IN_PSRAM, CAMERA_FB_IN_DRAM } camera_fb_location_t;
+
+typedef struct {
+  int pin_pwdn;
+  int pin_reset;
+  int pin_xclk;
+  int pin_sccb_sda;
+  int pin_sccb_scl;
+  int pin_d7;
+  int pin_d6;
+  int pin_d5;
+  int pin_d4;
+  int pin_d3;
+  int pin_d2;
+  int pin_d1;
+  int pin_d0;
+  int pin_vsync;
+  int pin_href;
+  int pin_pclk;
+  int xclk_freq_hz;
+  ledc_timer_t ledc_timer;
+  ledc_channel_t ledc_channel;
+  pixformat_t pixel_format;
+  framesize_t frame_size;
+  int jpeg_quality;
+  size_t fb_count;
+  camera_fb_location_t fb_location;
+  camera_grab_mode_t grab_mode;
+} camera_config_t;
+
+typedef struct {
+  uint8_t *buf;
+  size_t len;
+  size_t width;
+  size_t height;
+  pixformat_t format;
+  struct timeval timestamp;
+} camera_fb_t;
+
+esp_err_t esp_camera_init(const camera_config_t *config);
+esp_err_t esp_camera_deinit();
+camera_fb_t *esp_camera_fb_get();
+void esp_camera_fb_return(camera_fb_t *fb);
+sensor_t *esp_camera_sensor_get();
@@ -0,0 +1,32 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * esp_err.h
+ *
+ * Host stand-in for the ESP-IDF error codes, for the native environment (see Arduino.h).
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include <stdint.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK            (0)                       // Success
+#define ESP_FAIL          (-1)                      // Generic failure
+#define ESP_ERR_NO_MEM    (0x101)                   // Out of memory
+#define ESP_ERR_INVALID_ARG (0x102)                 // Invalid argument
+#define ESP_ERR_NOT_FOUND (0x105)                   // Requested resource not found
+#define ESP_ERR_NOT_SUPPORTED (0x106)               // Operation or feature not supported
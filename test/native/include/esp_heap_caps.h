@@ -0,0 +1,40 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * esp_heap_caps.h
+ *
+ * Host stand-in for the ESP-IDF heap_caps_*() functions, for the native environment (see
+ * Arduino.h). Every capability is the one host heap, and the statistics are measured against
+ * NATIVE_HEAP_BYTES.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_EXEC   (1 << 0)
+#define MALLOC_CAP_32BIT  (1 << 1)
+#define MALLOC_CAP_8BIT   (1 << 2)
+#define MALLOC_CAP_DMA    (1 << 3)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+void *heap_caps_malloc(size_t size, uint32_t caps);
+void heap_caps_free(void *ptr);
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_minimum_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
@@ -0,0 +1,60 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * esp_log.h
+ *
+ * Host stand-in for the core's log_?() macros, for the native environment (see Arduino.h). As on
+ * the ESP32, CORE_DEBUG_LEVEL decides at compile time which levels are kept; they go to stderr.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+
+#ifndef CORE_DEBUG_LEVEL
+#define CORE_DEBUG_LEVEL  (1)
+#endif
+
+/**
+ * @brief Write a log line to stderr: "[<millis()>][<letter>][<file>:<line>] <func>(): <message>"
+ *
+ */
+void nativeLog(char letter, const char *file, int line, const char *func, const char *format, ...);
+
+#define NATIVE_LOG(letter, format, ...) nativeLog(letter, __FILE__, __LINE__, __func__, format, ##__VA_ARGS__)
+#if CORE_DEBUG_LEVEL >= 1
+#define log_e(format, ...) NATIVE_LOG('E', format, ##__VA_ARGS__)
+#else
+#define log_e(format, ...) do {} while (0)
+#endif
+#if CORE_DEBUG_LEVEL >= 2
+#define log_w(format, ...) NATIVE_LOG('W', format, ##__VA_ARGS__)
+#else
+#define log_w(format, ...) do {} while (0)
+#endif
+#if CORE_DEBUG_LEVEL >= 3
+#define log_i(format, ...) NATIVE_LOG('I', format, ##__VA_ARGS__)
+#else
+#define log_i(format, ...) do {} while (0)
+#endif
+#if CORE_DEBUG_LEVEL >= 4
+#define log_d(format, ...) NATIVE_LOG('D', format, ##__VA_ARGS__)
+#else
+#define log_d(format, ...) do {} while (0)
+#endif
+#if CORE_DEBUG_LEVEL >= 5
+#define log_v(format, ...) NATIVE_LOG('V', format, ##__VA_ARGS__)
+#else
+#define log_v(format, ...) do {} while (0)
+#endif
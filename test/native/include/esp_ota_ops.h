@@ -0,0 +1,36 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * esp_ota_ops.h
+ *
+ * Host stand-in for the ESP-IDF OTA partition functions, for the native environment (see
+ * Arduino.h). There are two app partitions, "app0" and "app1". A successful Update.end() makes the
+ * other one the boot partition; the running one never changes.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct {
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+} esp_partition_t;
+
+const esp_partition_t *esp_ota_get_running_partition();
+const esp_partition_t *esp_ota_get_boot_partition();
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start);
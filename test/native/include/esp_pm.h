@@ -0,0 +1,44 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * esp_pm.h
+ *
+ * Host stand-in for the ESP-IDF power management types, for the native environment (see
+ * Arduino.h). CONFIG_PM_ENABLE isn't defined, so PowerManager never creates a lock and falls back
+ * to setCpuFrequencyMhz(); the functions here all report that power management isn't supported.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+  ESP_PM_CPU_FREQ_MAX, ESP_PM_APB_FREQ_MAX, ESP_PM_NO_LIGHT_SLEEP
+} esp_pm_lock_type_t;
+
+typedef struct esp_pm_lock *esp_pm_lock_handle_t;
+
+typedef struct {
+  int max_freq_mhz;
+  int min_freq_mhz;
+  bool light_sleep_enable;
+} esp_pm_config_esp32_t;
+
+esp_err_t esp_pm_configure(const void *config);
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char *name,
+                             esp_pm_lock_handle_t *handle);
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle);
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle);
@@ -0,0 +1,28 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * esp_sleep.h
+ *
+ * Host stand-in for ESP-IDF light sleep, for the native environment (see Arduino.h). Sleeping
+ * moves the simulated clock on to the wakeup time.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t us);
+esp_err_t esp_light_sleep_start();
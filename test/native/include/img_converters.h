@@ -0,0 +1,36 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * img_converters.h
+ *
+ * Host stand-in for the esp32-camera image converters, for the native environment (see
+ * Arduino.h). There's no JPEG codec here: jpg2rgb565() reads the size from the JPEG's frame header
+ * and fills the image with the luma set by nativeCameraLuma() (see Native.h), and fmt2jpg()
+ * produces a minimal JPEG of the right size. That's enough for the code around them to run.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_camera.h"
+
+typedef enum {
+  JPG_SCALE_NONE, JPG_SCALE_2X, JPG_SCALE_4X, JPG_SCALE_8X, JPG_SCALE_MAX = JPG_SCALE_8X
+} jpg_scale_t;
+
+bool jpg2rgb565(const uint8_t *src, size_t src_len, uint8_t *out, jpg_scale_t scale);
+bool fmt2jpg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format,
+             uint8_t quality, uint8_t **out, size_t *out_len);
@@ -0,0 +1,70 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * sensor.h
+ *
+ * Host stand-in for the esp32-camera sensor interface, for the native environment (see
+ * Arduino.h). The frame sizes are in the driver's order, so a framesize_t means the same thing
+ * here as on the ESP32. The sensor's setters just record what they're given in its status.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include <stdint.h>
+
+typedef enum {
+  PIXFORMAT_RGB565, PIXFORMAT_YUV422, PIXFORMAT_YUV420, PIXFORMAT_GRAYSCALE, PIXFORMAT_JPEG,
+  PIXFORMAT_RGB888, PIXFORMAT_RAW, PIXFORMAT_RGB444, PIXFORMAT_RGB555
+} pixformat_t;
+
+typedef enum {
+  FRAMESIZE_96X96, FRAMESIZE_QQVGA, FRAMESIZE_QCIF, FRAMESIZE_HQVGA, FRAMESIZE_240X240,
+  FRAMESIZE_QVGA, FRAMESIZE_CIF, FRAMESIZE_HVGA, FRAMESIZE_VGA, FRAMESIZE_SVGA, FRAMESIZE_XGA,
+  FRAMESIZE_HD, FRAMESIZE_SXGA, FRAMESIZE_UXGA, FRAMESIZE_FHD, FRAMESIZE_P_HD, FRAMESIZE_P_3MP,
+  FRAMESIZE_QXGA, FRAMESIZE_QHD, FRAMESIZE_WQXGA, FRAMESIZE_P_FHD, FRAMESIZE_QSXGA, FRAMESIZE_INVALID
+} framesize_t;
+
+typedef struct {
+  const uint16_t width;
+  const uint16_t height;
+  const int aspect_ratio;
+} resolution_info_t;
+
+extern const resolution_info_t resolution[];
+
+typedef struct {
+  framesize_t framesize;
+  uint8_t quality;
+  uint8_t aec;
+  uint16_t aec_value;
+  uint8_t agc;
+  uint8_t agc_gain;
+  uint8_t hmirror;
+  uint8_t vflip;
+} camera_status_t;
+
+typedef struct _sensor sensor_t;
+typedef struct _sensor {
+  camera_status_t status;
+  pixformat_t pixformat;
+  int (*set_framesize)(sensor_t *sensor, framesize_t framesize);
+  int (*set_quality)(sensor_t *sensor, int quality);
+  int (*set_exposure_ctrl)(sensor_t *sensor, int enable);
+  int (*set_aec_value)(sensor_t *sensor, int value);
+  int (*set_gain_ctrl)(sensor_t *sensor, int enable);
+  int (*set_agc_gain)(sensor_t *sensor, int gain);
+  int (*set_hmirror)(sensor_t *sensor, int enable);
+  int (*set_vflip)(sensor_t *sensor, int enable);
+} sensor_t;
@@ -0,0 +1,27 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * soc.h
+ *
+ * Host stand-in for the ESP32's register definitions, for the native environment (see
+ * Arduino.h). Register writes do nothing.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include <stdint.h>
+
+#define WRITE_PERI_REG(addr, val) ((void)(addr), (void)(val))
+#define READ_PERI_REG(addr) ((void)(addr), 0)
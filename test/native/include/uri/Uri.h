@@ -0,0 +1,40 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Uri.h
+ *
+ * Host stand-in for the core's WebServer Uri class, for the native environment (see
+ * WebServer.h): a URI a handler is registered for, which matches a request's URI exactly.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Arduino.h"
+#include <vector>
+
+class Uri {
+public:
+  Uri(const char *uri) : uri(uri) {}
+  Uri(const String &uri) : uri(uri) {}
+  virtual ~Uri() {}
+  virtual Uri *clone() const { return new Uri(uri); }
+  virtual bool canHandle(const String &requestUri, std::vector<String> &pathArgs) {
+    (void)pathArgs;
+    return requestUri == uri;
+  }
+
+protected:
+  const String uri;
+};
@@ -0,0 +1,36 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * UriGlob.h
+ *
+ * Host stand-in for the core's WebServer UriGlob class, for the native environment (see
+ * WebServer.h): a URI with shell-style wildcards, matched with fnmatch() as on the ESP32.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#pragma once
+#include "Uri.h"
+#include <fnmatch.h>
+
+class UriGlob : public Uri {
+public:
+  explicit UriGlob(const char *uri) : Uri(uri) {}
+  explicit UriGlob(const String &uri) : Uri(uri) {}
+  Uri *clone() const override { return new UriGlob(uri); }
+  bool canHandle(const String &requestUri, std::vector<String> &pathArgs) override {
+    (void)pathArgs;
+    return fnmatch(uri.c_str(), requestUri.c_str(), 0) == 0;
+  }
+};
@@ -0,0 +1,209 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Arduino.cpp
+ *
+ * Implementation of the host stand-in for the arduino-esp32 core: the simulated clock, the heap
+ * figures, ESP, Serial and the log. See Arduino.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "Arduino.h"
+#include "Native.h"
+#include "esp_timer.h"
+#include <malloc.h>
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define __SANITIZE_ADDRESS__ 1                      // clang's way of saying so; gcc's is this
+#endif
+#endif
+#ifdef __SANITIZE_ADDRESS__
+extern "C" size_t __sanitizer_get_current_allocated_bytes();  // sanitizer/allocator_interface.h
+#endif
+#include <stdarg.h>
+
+EspClass ESP;
+HardwareSerial Serial;
+
+static uint64_t clockMicros = 0;                    // The simulated clock
+static uint32_t cpuMhz = NATIVE_CPU_MHZ;            // The CPU clock (MHz)
+static size_t heapBase = 0;                         // Host heap in use before the firmware started
+static size_t heapLow = NATIVE_HEAP_BYTES;          // Least free heap seen
+static void (*onRestart)() = nullptr;               // What ESP.restart() does
+static uint8_t pins[40];                            // The level last written to each pin
+
+// Native.h
+
+uint64_t nativeMicros() {
+  return clockMicros;
+}
+
+void nativeAdvanceMicros(uint64_t us) {
+  clockMicros += us;
+}
+
+size_t nativeHeapUsed() {
+#ifdef __SANITIZE_ADDRESS__
+  // ASan has its own allocator, which mallinfo2() knows nothing about
+  size_t used = __sanitizer_get_current_allocated_bytes();
+#else
+  size_t used = mallinfo2().uordblks;
+#endif
+  used -= min(used, nativeUncountedBytes);
+  if (heapBase == 0) {
+    heapBase = used;
+  }
+  return used > heapBase ? used - heapBase : 0;
+}
+
+void nativeOnRestart(void (*handler)()) {
+  onRestart = handler;
+}
+
+// Pins
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  (void)pin;
+  (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin < sizeof(pins)) {
+    pins[pin] = val;
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < sizeof(pins) ? pins[pin] : LOW;
+}
+
+// Time
+
+unsigned long micros() {
+  clockMicros += NATIVE_READ_MICROS;
+  return (unsigned long)(uint32_t)clockMicros;
+}
+
+unsigned long millis() {
+  clockMicros += NATIVE_READ_MICROS;
+  return (unsigned long)(uint32_t)(clockMicros / 1000);
+}
+
+int64_t esp_timer_get_time() {
+  clockMicros += NATIVE_READ_MICROS;
+  return (int64_t)clockMicros;
+}
+
+void delay(uint32_t ms) {
+  clockMicros += (uint64_t)ms * 1000;
+}
+
+void delayMicroseconds(uint32_t us) {
+  clockMicros += us;
+}
+
+void yield() {
+}
+
+// Memory
+
+void *ps_malloc(size_t size) {
+  return malloc(size);
+}
+
+void *ps_calloc(size_t n, size_t size) {
+  return calloc(n, size);
+}
+
+void *ps_realloc(void *ptr, size_t size) {
+  return realloc(ptr, size);
+}
+
+bool psramFound() {
+  return true;
+}
+
+// CPU clock
+
+bool setCpuFrequencyMhz(uint32_t mhz) {
+  if (mhz != 80 && mhz != 160 && mhz != 240) {
+    return false;
+  }
+  cpuMhz = mhz;
+  return true;
+}
+
+uint32_t getCpuFrequencyMhz() {
+  return cpuMhz;
+}
+
+// FreeRTOS
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return (TaskHandle_t)&Serial;
+}
+
+const char *pcTaskGetTaskName(TaskHandle_t handle) {
+  (void)handle;
+  return "loopTask";
+}
+
+// ESP
+
+uint32_t EspClass::getCycleCount() {
+  return (uint32_t)(micros() * (uint64_t)cpuMhz);
+}
+
+void EspClass::restart() {
+  if (onRestart != nullptr) {
+    onRestart();
+  }
+  exit(0);
+}
+
+uint32_t EspClass::getFreeHeap() {
+  size_t used = nativeHeapUsed();
+  uint32_t free = used < NATIVE_HEAP_BYTES ? NATIVE_HEAP_BYTES - used : 0;
+  if (free < heapLow) {
+    heapLow = free;
+  }
+  return free;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  getFreeHeap();
+  return heapLow;
+}
+
+// Serial and the log
+
+int HardwareSerial::printf(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  int n = vprintf(format, args);
+  va_end(args);
+  return n;
+}
+
+void nativeLog(char letter, const char *file, int line, const char *func, const char *format, ...) {
+  const char *name = strrchr(file, '/');
+  fprintf(stderr, "[%6lu][%c][%s:%d] %s(): ", (unsigned long)(clockMicros / 1000), letter,
+    name == nullptr ? file : name + 1, line, func);
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
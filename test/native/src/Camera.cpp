@@ -0,0 +1,214 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Camera.cpp
+ *
+ * Implementation of the host stand-ins for the esp32-camera driver and its image converters. See
+ * esp_camera.h and img_converters.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "Arduino.h"
+#include "Native.h"
+#include "esp_camera.h"
+#include "img_converters.h"
+#include <vector>
+
+const resolution_info_t resolution[] = {
+  {96, 96, 0}, {160, 120, 0}, {176, 144, 0}, {240, 176, 0}, {240, 240, 0}, {320, 240, 0},
+  {400, 296, 0}, {480, 320, 0}, {640, 480, 0}, {800, 600, 0}, {1024, 768, 0}, {1280, 720, 0},
+  {1280, 1024, 0}, {1600, 1200, 0}, {1920, 1080, 0}, {720, 1280, 0}, {864, 1536, 0},
+  {2048, 1536, 0}, {2560, 1440, 0}, {2560, 1600, 0}, {1080, 1920, 0}, {2560, 1920, 0}
+};
+
+static bool cameraUp = false;                       // Whether esp_camera_init() has succeeded
+static size_t fbCount = 1;                          // Frame buffers the driver was given
+static size_t fbOut = 0;                            // Frame buffers handed out and not returned
+static std::vector<uint8_t> frame;                  // What the camera "sees"
+static uint16_t frameWidth = 0;
+static uint16_t frameHeight = 0;
+static uint8_t luma = 128;                          // What jpg2rgb565() fills images with
+
+// Native.h
+
+void nativeCameraFrame(const uint8_t *jpg, size_t len, uint16_t width, uint16_t height) {
+  frame.assign(jpg, jpg + len);
+  frameWidth = width;
+  frameHeight = height;
+}
+
+void nativeCameraLuma(uint8_t level) {
+  luma = level;
+}
+
+// The sensor
+
+static int setFramesize(sensor_t *s, framesize_t size) {
+  if (size >= FRAMESIZE_INVALID) {
+    return -1;
+  }
+  s->status.framesize = size;
+  return 0;
+}
+
+static int setQuality(sensor_t *s, int quality) {
+  s->status.quality = quality;
+  return 0;
+}
+
+static int setExposureCtrl(sensor_t *s, int enable) {
+  s->status.aec = enable;
+  return 0;
+}
+
+static int setAecValue(sensor_t *s, int value) {
+  s->status.aec_value = value;
+  return 0;
+}
+
+static int setGainCtrl(sensor_t *s, int enable) {
+  s->status.agc = enable;
+  return 0;
+}
+
+static int setAgcGain(sensor_t *s, int gain) {
+  s->status.agc_gain = gain;
+  return 0;
+}
+
+static int setHmirror(sensor_t *s, int enable) {
+  s->status.hmirror = enable;
+  return 0;
+}
+
+static int setVflip(sensor_t *s, int enable) {
+  s->status.vflip = enable;
+  return 0;
+}
+
+static sensor_t sensor = {
+  {FRAMESIZE_UXGA, 10, 1, 300, 1, 0, 0, 0}, PIXFORMAT_JPEG, setFramesize, setQuality,
+  setExposureCtrl, setAecValue, setGainCtrl, setAgcGain, setHmirror, setVflip
+};
+
+// esp_camera.h
+
+esp_err_t esp_camera_init(const camera_config_t *config) {
+  if (cameraUp) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  fbCount = config->fb_count == 0 ? 1 : config->fb_count;
+  sensor.status.framesize = config->frame_size;
+  sensor.status.quality = config->jpeg_quality;
+  sensor.pixformat = config->pixel_format;
+  cameraUp = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_camera_deinit() {
+  cameraUp = false;
+  return ESP_OK;
+}
+
+camera_fb_t *esp_camera_fb_get() {
+  if (!cameraUp || frame.empty() || fbOut == fbCount) {
+    return nullptr;
+  }
+  nativeAdvanceMicros(1000000 / 25);                // A frame time at 25 fps
+  camera_fb_t *fb = new camera_fb_t;
+  fb->buf = (uint8_t *)malloc(frame.size());
+  memcpy(fb->buf, frame.data(), frame.size());
+  fb->len = frame.size();
+  fb->width = frameWidth;
+  fb->height = frameHeight;
+  fb->format = PIXFORMAT_JPEG;
+  uint64_t now = nativeMicros();
+  fb->timestamp = {(time_t)(now / 1000000), (suseconds_t)(now % 1000000)};
+  fbOut++;
+  return fb;
+}
+
+void esp_camera_fb_return(camera_fb_t *fb) {
+  if (fb == nullptr) {
+    return;
+  }
+  free(fb->buf);
+  delete fb;
+  fbOut--;
+}
+
+sensor_t *esp_camera_sensor_get() {
+  return cameraUp ? &sensor : nullptr;
+}
+
+// img_converters.h
+
+// Find the size in a JPEG's SOF0 or SOF2 frame header
+static bool jpegSize(const uint8_t *src, size_t len, uint16_t &w, uint16_t &h) {
+  if (len < 4 || src[0] != 0xFF || src[1] != 0xD8) {
+    return false;
+  }
+  size_t at = 2;
+  while (at + 4 <= len && src[at] == 0xFF) {
+    uint8_t marker = src[at + 1];
+    size_t segLen = (src[at + 2] << 8) | src[at + 3];
+    if ((marker == 0xC0 || marker == 0xC2) && at + 9 <= len) {
+      h = (src[at + 5] << 8) | src[at + 6];
+      w = (src[at + 7] << 8) | src[at + 8];
+      return w != 0 && h != 0;
+    }
+    at += 2 + segLen;
+  }
+  return false;
+}
+
+bool jpg2rgb565(const uint8_t *src, size_t src_len, uint8_t *out, jpg_scale_t scale) {
+  uint16_t w, h;
+  if (!jpegSize(src, src_len, w, h)) {
+    return false;
+  }
+  size_t pixels = (size_t)(w >> scale) * (h >> scale);
+  uint16_t px = ((luma >> 3) << 11) | ((luma >> 2) << 5) | (luma >> 3);
+  for (size_t i = 0; i < pixels; i++) {            // Big-endian, as the decoder writes them
+    out[2 * i] = px >> 8;
+    out[2 * i + 1] = px & 0xFF;
+  }
+  return true;
+}
+
+bool fmt2jpg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format,
+             uint8_t quality, uint8_t **out, size_t *out_len) {
+  (void)src;
+  (void)src_len;
+  (void)format;
+  (void)quality;
+  static const uint8_t head[] = {                   // SOI, then an SOF0 with the size to fill in
+    0xFF, 0xD8, 0xFF, 0xC0, 0x00, 0x0B, 0x08, 0, 0, 0, 0, 0x01, 0x01, 0x11, 0x00
+  };
+  uint8_t *jpg = (uint8_t *)malloc(sizeof(head) + 2);
+  if (jpg == nullptr) {
+    return false;
+  }
+  memcpy(jpg, head, sizeof(head));
+  jpg[7] = height >> 8;
+  jpg[8] = height & 0xFF;
+  jpg[9] = width >> 8;
+  jpg[10] = width & 0xFF;
+  jpg[sizeof(head)] = 0xFF;                         // EOI
+  jpg[sizeof(head) + 1] = 0xD9;
+  *out = jpg;
+  *out_len = sizeof(head) + 2;
+  return true;
+}
@@ -0,0 +1,304 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Esp.cpp
+ *
+ * Implementation of the host stand-ins for the ESP-IDF functions and the core libraries around
+ * them: the reset reason and random numbers, heap_caps, light sleep, the OTA partitions, Update,
+ * Preferences, IPAddress and SD_MMC. See the corresponding headers for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "Arduino.h"
+#include "Native.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_ota_ops.h"
+#include "Update.h"
+#include "Preferences.h"
+#include "IPAddress.h"
+#include "SD_MMC.h"
+#include <map>
+#include <string>
+#include <vector>
+
+#define NATIVE_RANDOM_SEED (0x2545F491UL)           // esp_random()'s starting state
+#define NATIVE_IMAGE_MAGIC (0xE9)                   // The first byte of an ESP32 app image
+
+UpdateClass Update;
+fs::SDMMCFS SD_MMC;
+
+// esp_system.h
+
+esp_reset_reason_t esp_reset_reason() {
+  return ESP_RST_POWERON;
+}
+
+uint32_t esp_random() {
+  static uint32_t state = NATIVE_RANDOM_SEED;
+  state ^= state << 13;                             // xorshift32
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+// esp_heap_caps.h
+
+void *heap_caps_malloc(size_t size, uint32_t caps) {
+  (void)caps;
+  return malloc(size);
+}
+
+void heap_caps_free(void *ptr) {
+  free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? ESP.getFreePsram() : ESP.getFreeHeap();
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? ESP.getFreePsram() : ESP.getMinFreeHeap();
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? ESP.getMaxAllocPsram() : ESP.getMaxAllocHeap();
+}
+
+// esp_pm.h
+
+esp_err_t esp_pm_configure(const void *config) {
+  (void)config;
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char *name,
+                             esp_pm_lock_handle_t *handle) {
+  (void)type;
+  (void)arg;
+  (void)name;
+  *handle = nullptr;
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle) {
+  (void)handle;
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle) {
+  (void)handle;
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+// esp_sleep.h
+
+static uint64_t wakeupMicros = 0;                   // Light sleep's timer wakeup
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t us) {
+  wakeupMicros = us;
+  return ESP_OK;
+}
+
+esp_err_t esp_light_sleep_start() {
+  nativeAdvanceMicros(wakeupMicros);
+  return ESP_OK;
+}
+
+// esp_ota_ops.h
+
+static const esp_partition_t partitions[2] = {
+  {0x10000, 0x140000, "app0"},
+  {0x150000, 0x140000, "app1"}
+};
+static const esp_partition_t *bootPartition = &partitions[0];
+
+const esp_partition_t *esp_ota_get_running_partition() {
+  return &partitions[0];
+}
+
+const esp_partition_t *esp_ota_get_boot_partition() {
+  return bootPartition;
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start) {
+  (void)start;
+  return &partitions[1];
+}
+
+// Update.h
+
+bool UpdateClass::begin(size_t size, int command, int ledPin, uint8_t ledOn, const char *label) {
+  (void)command;
+  (void)ledPin;
+  (void)ledOn;
+  (void)label;
+  if (running) {
+    error = "Already running";
+    return false;
+  }
+  if (size != UPDATE_SIZE_UNKNOWN && size > partitions[1].size) {
+    error = "Not enough space";
+    return false;
+  }
+  running = true;
+  written = 0;
+  error = "";
+  return true;
+}
+
+size_t UpdateClass::write(uint8_t *data, size_t len) {
+  if (!running || hasError()) {
+    return 0;
+  }
+  if (written == 0 && len > 0 && data[0] != NATIVE_IMAGE_MAGIC) {
+    error = "Magic byte is wrong, not 0xE9";
+    return 0;
+  }
+  if (written + len > partitions[1].size) {
+    error = "Not enough space";
+    return 0;
+  }
+  written += len;
+  return len;
+}
+
+bool UpdateClass::end(bool evenIfRemaining) {
+  (void)evenIfRemaining;
+  if (!running || hasError()) {
+    return false;
+  }
+  running = false;
+  if (written == 0) {
+    error = "Bad Size Given";
+    return false;
+  }
+  bootPartition = &partitions[1];
+  return true;
+}
+
+void UpdateClass::abort() {
+  running = false;
+  error = "Aborted";
+}
+
+bool UpdateClass::setMD5(const char *expected) {
+  if (strlen(expected) != 32) {
+    return false;
+  }
+  for (const char *c = expected; *c != '\0'; c++) {
+    if (!isxdigit((unsigned char)*c)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Preferences.h
+
+static std::map<std::string, std::map<std::string, std::vector<uint8_t>>> nvs;  // Survives reboots
+
+bool Preferences::begin(const char *name, bool readOnly, const char *partitionLabel) {
+  (void)partitionLabel;
+  if (open || strlen(name) > 15) {
+    return false;
+  }
+  ns = name;
+  this->readOnly = readOnly;
+  open = true;
+  return true;
+}
+
+void Preferences::end() {
+  open = false;
+}
+
+bool Preferences::clear() {
+  if (!open || readOnly) {
+    return false;
+  }
+  nvs[ns.c_str()].clear();
+  return true;
+}
+
+bool Preferences::remove(const char *key) {
+  if (!open || readOnly) {
+    return false;
+  }
+  return nvs[ns.c_str()].erase(key) != 0;
+}
+
+bool Preferences::isKey(const char *key) {
+  return open && nvs[ns.c_str()].count(key) != 0;
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t len) {
+  if (!open || readOnly || strlen(key) > 15) {
+    return 0;
+  }
+  const uint8_t *bytes = (const uint8_t *)value;
+  nvs[ns.c_str()][key].assign(bytes, bytes + len);
+  return len;
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+  if (!isKey(key)) {
+    return 0;
+  }
+  return nvs[ns.c_str()][key].size();
+}
+
+size_t Preferences::getBytes(const char *key, void *buf, size_t maxLen) {
+  size_t len = getBytesLength(key);
+  if (len == 0 || len > maxLen) {
+    return 0;
+  }
+  memcpy(buf, nvs[ns.c_str()][key].data(), len);
+  return len;
+}
+
+// IPAddress.h
+
+String IPAddress::toString() const {
+  char text[16];
+  snprintf(text, sizeof(text), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+  return String(text);
+}
+
+bool IPAddress::fromString(const char *address) {
+  unsigned a, b, c, d;
+  char extra;
+  if (sscanf(address, "%u.%u.%u.%u%c", &a, &b, &c, &d, &extra) != 4 ||
+      a > 255 || b > 255 || c > 255 || d > 255) {
+    return false;
+  }
+  *this = IPAddress(a, b, c, d);
+  return true;
+}
+
+// SD_MMC.h
+
+bool fs::SDMMCFS::begin(const char *mountpoint, bool mode1bit, bool formatIfMountFailed, int frequency,
+                    uint8_t maxOpenFiles) {
+  (void)mountpoint;
+  (void)mode1bit;
+  (void)formatIfMountFailed;
+  (void)frequency;
+  (void)maxOpenFiles;
+  mounted = true;
+  return true;
+}
@@ -0,0 +1,482 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * FS.cpp
+ *
+ * Implementation of the host stand-in for the file system classes. See FS.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "FS.h"
+#include "Native.h"
+#include <map>
+#include <string>
+#include <vector>
+
+#define NATIVE_NAME_CHARS (255)                     // Longest name FAT allows
+
+namespace fs {
+
+// The card's contents, paths and directory: on the ESP32 they're on the card, not in the heap
+typedef std::vector<uint8_t, NativeAllocator<uint8_t>> Bytes;
+typedef NativeString Path;
+
+// What a file holds, shared by the card and the Files open on it
+struct Data {
+  Bytes bytes;                                      // The contents as of the last flush
+  time_t mtime;                                     // When they were last flushed
+};
+
+// A file or directory on the card
+struct Node {
+  Path path;                                 // Its path, as it was created
+  bool dir;                                         // Whether it's a directory
+  uint32_t seq;                                     // Its place in its directory's listing
+  std::shared_ptr<Data> data;                       // Its contents (files only)
+};
+
+// The card: every node, keyed by its path in lower case
+struct Card {
+  std::map<Path, Node, std::less<Path>, NativeAllocator<std::pair<const Path, Node>>> nodes;
+  uint64_t capacity;                                // Bytes available for clusters
+  uint32_t nextSeq;                                 // The seq for the next node created
+  uint32_t generation;                              // Bumped by powerLoss()
+};
+
+// An open file or directory
+struct FileImpl {
+  std::shared_ptr<Card> card;
+  Path path;                                 // As given to open(), tidied
+  bool dir;
+  bool isOpen;
+  bool readable;
+  bool writable;
+  bool append;
+  bool dirty;                                       // Whether buf has changes not flushed
+  uint32_t generation;                              // card->generation when opened
+  std::shared_ptr<Data> data;                       // Where flushes go (files only)
+  Bytes buf;                                        // The contents as this File sees them
+  size_t pos;
+  uint32_t listSeq;                                 // seq of the last entry openNextFile() gave
+
+  ~FileImpl() { flushTo(); }
+  void flushTo();
+};
+
+namespace {
+
+void charge(size_t bytes) {
+  nativeAdvanceMicros(NATIVE_SD_OP_MICROS + bytes * NATIVE_SD_KB_MICROS / 1024);
+}
+
+Path lower(const Path &s) {
+  Path l = s;
+  for (char &c : l) {
+    c = tolower((unsigned char)c);
+  }
+  return l;
+}
+
+/**
+ * @brief Tidy a path up: collapse repeated '/'s and drop a trailing one. Aborts on a ".."
+ *        segment. "" if the path isn't one FAT would accept.
+ *
+ */
+Path tidy(const char *path) {
+  if (path == nullptr || path[0] != '/') {
+    return "";
+  }
+  Path out;
+  Path name;
+  for (const char *p = path; ; p++) {
+    if (*p == '/' || *p == '\0') {
+      if (name == "..") {
+        fprintf(stderr, "FS: \"%s\" has a \"..\" segment; the firmware should have refused it.\n", path);
+        abort();
+      }
+      if (!name.empty() && name != ".") {
+        out += "/" + name;
+      }
+      name.clear();
+      if (*p == '\0') {
+        break;
+      }
+    } else {
+      if ((uint8_t)*p < ' ' || strchr("\"*:<>?\\|", *p) != nullptr || name.length() >= NATIVE_NAME_CHARS) {
+        return "";
+      }
+      name += *p;
+    }
+  }
+  return out.empty() ? "/" : out;
+}
+
+Path parentOf(const Path &path) {
+  size_t slash = path.rfind('/');
+  return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+uint64_t clusters(size_t bytes) {
+  return (bytes + NATIVE_CLUSTER_BYTES - 1) / NATIVE_CLUSTER_BYTES;
+}
+
+Node *find(Card &card, const Path &path) {
+  auto it = card.nodes.find(lower(path));
+  return it == card.nodes.end() ? nullptr : &it->second;
+}
+
+uint64_t used(const Card &card) {
+  uint64_t n = 0;
+  for (const auto &kv : card.nodes) {
+    n += kv.second.dir ? 1 : clusters(kv.second.data->bytes.size());
+  }
+  return n * NATIVE_CLUSTER_BYTES;
+}
+
+bool mkdirOn(Card &card, const char *path) {
+  charge(0);
+  Path p = tidy(path);
+  Node *parent = p.empty() || p == "/" ? nullptr : find(card, parentOf(p));
+  if (parent == nullptr || !parent->dir || find(card, p) != nullptr ||
+      used(card) + NATIVE_CLUSTER_BYTES > card.capacity) {
+    return false;
+  }
+  card.nodes[lower(p)] = {p, true, card.nextSeq++, nullptr};
+  return true;
+}
+
+File openOn(const std::shared_ptr<Card> &card, const char *path, const char *mode, bool create) {
+  charge(0);
+  Path p = tidy(path);
+  if (p.empty() || mode == nullptr || strchr("rwa", mode[0]) == nullptr) {
+    return File();
+  }
+  bool plus = strchr(mode, '+') != nullptr;
+  Node *node = find(*card, p);
+  if (node == nullptr) {
+    if (mode[0] == 'r') {
+      return File();
+    }
+    if (find(*card, parentOf(p)) == nullptr) {
+      if (!create) {
+        return File();
+      }
+      for (size_t slash = p.find('/', 1); slash != Path::npos; slash = p.find('/', slash + 1)) {
+        if (find(*card, p.substr(0, slash)) == nullptr && !mkdirOn(*card, p.substr(0, slash).c_str())) {
+          return File();
+        }
+      }
+    }
+    Node *parent = find(*card, parentOf(p));
+    if (parent == nullptr || !parent->dir) {
+      return File();
+    }
+    Node n = {p, false, card->nextSeq++, std::allocate_shared<Data>(NativeAllocator<Data>())};
+    n.data->mtime = nativeMicros() / 1000000;
+    node = &(card->nodes[lower(p)] = n);
+  } else if (node->dir && mode[0] != 'r') {
+    return File();
+  } else if (mode[0] == 'w') {
+    node->data->bytes.clear();
+  }
+
+  auto impl = std::make_shared<FileImpl>();
+  impl->card = card;
+  impl->path = node->path;
+  impl->dir = node->dir;
+  impl->isOpen = true;
+  impl->readable = mode[0] == 'r' || plus;
+  impl->writable = mode[0] != 'r' || plus;
+  impl->append = mode[0] == 'a';
+  impl->dirty = false;
+  impl->generation = card->generation;
+  impl->data = node->data;
+  impl->pos = 0;
+  impl->listSeq = 0;
+  if (!node->dir) {
+    impl->buf = node->data->bytes;
+  }
+  return File(impl);
+}
+
+} // namespace
+
+void FileImpl::flushTo() {
+  if (!isOpen || dir || !dirty) {
+    return;
+  }
+  dirty = false;
+  if (generation != card->generation) {
+    return;
+  }
+  charge(buf.size() > data->bytes.size() ? buf.size() - data->bytes.size() : 0);
+  data->bytes = buf;
+  data->mtime = nativeMicros() / 1000000;
+}
+
+size_t File::write(const uint8_t *src, size_t size) {
+  if (!*this || !impl->writable || impl->dir) {
+    return 0;
+  }
+  if (impl->append) {
+    impl->pos = impl->buf.size();
+  }
+  size_t end = impl->pos + size;
+  uint64_t grow = (clusters(end) - clusters(impl->buf.size())) * (uint64_t)NATIVE_CLUSTER_BYTES;
+  if (end > impl->buf.size() && used(*impl->card) + grow > impl->card->capacity) {
+    return 0;
+  }
+  charge(size);
+  if (end > impl->buf.size()) {
+    impl->buf.resize(end);
+  }
+  memcpy(impl->buf.data() + impl->pos, src, size);
+  impl->pos = end;
+  impl->dirty = true;
+  return size;
+}
+
+int File::available() {
+  return !*this || impl->dir || impl->pos >= impl->buf.size() ? 0 : impl->buf.size() - impl->pos;
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::peek() {
+  return available() == 0 || !impl->readable ? -1 : impl->buf[impl->pos];
+}
+
+size_t File::read(uint8_t *dst, size_t size) {
+  if (!*this || !impl->readable || impl->dir || impl->pos >= impl->buf.size()) {
+    return 0;
+  }
+  size_t n = min(size, impl->buf.size() - impl->pos);
+  charge(n);
+  memcpy(dst, impl->buf.data() + impl->pos, n);
+  impl->pos += n;
+  return n;
+}
+
+String File::readStringUntil(char terminator) {
+  String s;
+  int c;
+  while ((c = read()) >= 0 && c != terminator) {
+    s += (char)c;
+  }
+  return s;
+}
+
+String File::readString() {
+  String s;
+  int c;
+  while ((c = read()) >= 0) {
+    s += (char)c;
+  }
+  return s;
+}
+
+void File::flush() {
+  if (*this) {
+    impl->flushTo();
+  }
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  if (!*this || impl->dir) {
+    return false;
+  }
+  int64_t to = mode == SeekSet ? (int64_t)pos : mode == SeekCur ? (int64_t)impl->pos + pos :
+    (int64_t)impl->buf.size() + pos;
+  if (to < 0) {
+    return false;
+  }
+  impl->pos = to;
+  return true;
+}
+
+size_t File::position() const {
+  return *this ? impl->pos : 0;
+}
+
+size_t File::size() const {
+  return !*this || impl->dir ? 0 : impl->buf.size();
+}
+
+void File::close() {
+  if (*this) {
+    impl->flushTo();
+    impl->isOpen = false;
+  }
+}
+
+File::operator bool() const {
+  return impl && impl->isOpen;
+}
+
+time_t File::getLastWrite() {
+  return !*this || impl->dir ? 0 : impl->data->mtime;
+}
+
+const char *File::path() const {
+  return *this ? impl->path.c_str() : nullptr;
+}
+
+const char *File::name() const {
+  return *this ? impl->path.c_str() + impl->path.rfind('/') + 1 : nullptr;
+}
+
+bool File::isDirectory() {
+  return *this && impl->dir;
+}
+
+File File::openNextFile(const char *mode) {
+  if (!*this || !impl->dir) {
+    return File();
+  }
+  Path prefix = lower(impl->path == "/" ? "/" : impl->path + "/");
+  const Node *next = nullptr;
+  for (const auto &kv : impl->card->nodes) {
+    const Node &n = kv.second;
+    if (kv.first.compare(0, prefix.length(), prefix) == 0 && kv.first.length() > prefix.length() &&
+        kv.first.find('/', prefix.length()) == Path::npos && n.seq > impl->listSeq &&
+        (next == nullptr || n.seq < next->seq)) {
+      next = &n;
+    }
+  }
+  if (next == nullptr) {
+    return File();
+  }
+  impl->listSeq = next->seq;
+  return openOn(impl->card, next->path.c_str(), mode, false);
+}
+
+void File::rewindDirectory() {
+  if (*this) {
+    impl->listSeq = 0;
+  }
+}
+
+FS::FS(uint64_t capacity) : card(std::make_shared<Card>()) {
+  card->capacity = capacity;
+  card->nextSeq = 1;
+  card->generation = 0;
+  format();
+}
+
+File FS::open(const char *path, const char *mode, const bool create) {
+  return openOn(card, path, mode, create);
+}
+
+bool FS::exists(const char *path) {
+  charge(0);
+  Path p = tidy(path);
+  return !p.empty() && find(*card, p) != nullptr;
+}
+
+bool FS::remove(const char *path) {
+  charge(0);
+  Path p = tidy(path);
+  Node *node = p.empty() ? nullptr : find(*card, p);
+  if (node == nullptr || node->dir) {
+    return false;
+  }
+  card->nodes.erase(lower(p));
+  return true;
+}
+
+bool FS::rename(const char *from, const char *to) {
+  charge(0);
+  Path f = tidy(from);
+  Path t = tidy(to);
+  Node *node = f.empty() || t.empty() || f == "/" ? nullptr : find(*card, f);
+  Node *parent = t.empty() ? nullptr : find(*card, parentOf(t));
+  Path lf = lower(f);
+  Path lt = lower(t);
+  if (node == nullptr || parent == nullptr || !parent->dir || find(*card, t) != nullptr ||
+      lt.compare(0, lf.length() + 1, lf + "/") == 0) {
+    return false;
+  }
+
+  // Move the node and, for a directory, everything under it
+  std::vector<std::pair<Path, Node>> moved;
+  for (auto it = card->nodes.begin(); it != card->nodes.end(); ) {
+    if (it->first == lf || it->first.compare(0, lf.length() + 1, lf + "/") == 0) {
+      Node n = it->second;
+      n.path = t + n.path.substr(f.length());
+      moved.push_back({lt + it->first.substr(lf.length()), n});
+      it = card->nodes.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (auto &m : moved) {
+    if (m.first == lt) {
+      m.second.seq = card->nextSeq++;
+    }
+    card->nodes[m.first] = m.second;
+  }
+  return true;
+}
+
+bool FS::mkdir(const char *path) {
+  return mkdirOn(*card, path);
+}
+
+bool FS::rmdir(const char *path) {
+  charge(0);
+  Path p = tidy(path);
+  Node *node = p.empty() || p == "/" ? nullptr : find(*card, p);
+  if (node == nullptr || !node->dir) {
+    return false;
+  }
+  Path prefix = lower(p) + "/";
+  auto it = card->nodes.lower_bound(prefix);
+  if (it != card->nodes.end() && it->first.compare(0, prefix.length(), prefix) == 0) {
+    return false;
+  }
+  card->nodes.erase(lower(p));
+  return true;
+}
+
+uint64_t FS::totalBytes() {
+  return card->capacity;
+}
+
+uint64_t FS::usedBytes() {
+  return used(*card);
+}
+
+void FS::powerLoss() {
+  card->generation++;
+}
+
+bool FS::truncate(const char *path, size_t size) {
+  Node *node = find(*card, tidy(path));
+  if (node == nullptr || node->dir || size > node->data->bytes.size()) {
+    return false;
+  }
+  node->data->bytes.resize(size);
+  return true;
+}
+
+void FS::format() {
+  card->nodes.clear();
+  card->nodes["/"] = {"/", true, 0, nullptr};
+}
+
+} // namespace fs
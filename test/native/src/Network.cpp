@@ -0,0 +1,105 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * Network.cpp
+ *
+ * Implementation of the host stand-ins for WiFi, mDNS and the EEPROM emulation. See WiFi.h,
+ * ESPmDNS.h and EEPROM.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "WiFi.h"
+#include "ESPmDNS.h"
+#include "EEPROM.h"
+
+WiFiClass WiFi;
+MDNSResponder MDNS;
+EEPROMClass EEPROM;
+
+static uint8_t flash[NATIVE_EEPROM_BYTES];         // What's been committed
+
+// WiFi.h
+
+bool WiFiClass::softAP(const char *ssid, const char *passphrase, int channel, int ssidHidden,
+                       int maxConnection) {
+  (void)channel;
+  (void)ssidHidden;
+  (void)maxConnection;
+  if (wifiMode != WIFI_AP && wifiMode != WIFI_AP_STA) {
+    return false;
+  }
+  size_t ssidLen = strlen(ssid);
+  size_t passLen = passphrase == nullptr ? 0 : strlen(passphrase);
+  apUp = ssidLen > 0 && ssidLen <= 32 && (passLen == 0 || (passLen >= 8 && passLen <= 63));
+  return apUp;
+}
+
+bool WiFiClass::softAPConfig(IPAddress localIp, IPAddress gateway, IPAddress subnet) {
+  (void)gateway;
+  (void)subnet;
+  apIp = localIp;
+  return true;
+}
+
+bool WiFiClass::softAPdisconnect(bool wifiOff) {
+  apUp = false;
+  if (wifiOff) {
+    wifiMode = WIFI_OFF;
+  }
+  return true;
+}
+
+int WiFiClass::waitStatusBits(int bits, uint32_t timeoutMillis) {
+  int status = apUp ? AP_STARTED_BIT : 0;
+  if ((status & bits) == 0) {
+    delay(timeoutMillis);
+  }
+  return status & bits;
+}
+
+// EEPROM.h
+
+bool EEPROMClass::begin(size_t size) {
+  if (size == 0 || size > sizeof(data)) {
+    return false;
+  }
+  bytes = size;
+  memcpy(data, flash, size);
+  return true;
+}
+
+bool EEPROMClass::commit() {
+  if (bytes == 0) {
+    return false;
+  }
+  memcpy(flash, data, bytes);
+  return true;
+}
+
+uint16_t EEPROMClass::readUShort(int address) {
+  if (address < 0 || (size_t)address + 2 > bytes) {
+    return 0;
+  }
+  return data[address] | (data[address + 1] << 8);
+}
+
+size_t EEPROMClass::writeUShort(int address, uint16_t value) {
+  if (address < 0 || (size_t)address + 2 > bytes) {
+    return 0;
+  }
+  data[address] = value & 0xFF;
+  data[address + 1] = value >> 8;
+  return 2;
+}
@@ -0,0 +1,156 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * WString.cpp
+ *
+ * Implementation of the host stand-in for the String class. See WString.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "WString.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+
+char &String::operator[](unsigned int index) {
+  static char dummy;
+  if (index >= s.length()) {
+    dummy = '\0';
+    return dummy;
+  }
+  return s[index];
+}
+
+bool String::equalsIgnoreCase(const String &str) const {
+  return s.length() == str.s.length() && strcasecmp(s.c_str(), str.s.c_str()) == 0;
+}
+
+bool String::startsWith(const String &prefix, unsigned int offset) const {
+  return offset <= s.length() && prefix.s.length() <= s.length() - offset &&
+    s.compare(offset, prefix.s.length(), prefix.s) == 0;
+}
+
+bool String::endsWith(const String &suffix) const {
+  return suffix.s.length() <= s.length() &&
+    s.compare(s.length() - suffix.s.length(), suffix.s.length(), suffix.s) == 0;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (from > to) {
+    unsigned int t = from;
+    from = to;
+    to = t;
+  }
+  if (from >= s.length()) {
+    return String();
+  }
+  if (to > s.length()) {
+    to = s.length();
+  }
+  return String(s.substr(from, to - from));
+}
+
+void String::replace(char find, char with) {
+  for (char &c : s) {
+    if (c == find) {
+      c = with;
+    }
+  }
+}
+
+void String::replace(const String &find, const String &with) {
+  if (find.s.empty()) {
+    return;
+  }
+  for (size_t pos = s.find(find.s); pos != std::string::npos; pos = s.find(find.s, pos + with.s.length())) {
+    s.replace(pos, find.s.length(), with.s);
+  }
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+  if (index < s.length()) {
+    s.erase(index, count);
+  }
+}
+
+void String::toLowerCase() {
+  for (char &c : s) {
+    c = tolower((unsigned char)c);
+  }
+}
+
+void String::toUpperCase() {
+  for (char &c : s) {
+    c = toupper((unsigned char)c);
+  }
+}
+
+void String::trim() {
+  size_t first = 0;
+  while (first < s.length() && isspace((unsigned char)s[first])) {
+    first++;
+  }
+  size_t last = s.length();
+  while (last > first && isspace((unsigned char)s[last - 1])) {
+    last--;
+  }
+  s = s.substr(first, last - first);
+}
+
+long String::toInt() const {
+  return atol(s.c_str());
+}
+
+double String::toDouble() const {
+  return atof(s.c_str());
+}
+
+std::string String::format(long long n, unsigned char base) {
+  if (base == 10) {
+    return std::to_string(n);
+  }
+  return n < 0 ? "-" + format((unsigned long long)-n, base) : format((unsigned long long)n, base);
+}
+
+std::string String::format(unsigned long long n, unsigned char base) {
+  if (base < 2 || base > 36) {
+    base = 10;
+  }
+  std::string digits;
+  do {
+    digits.insert(digits.begin(), "0123456789abcdefghijklmnopqrstuvwxyz"[n % base]);
+    n /= base;
+  } while (n != 0);
+  return digits;
+}
+
+std::string String::format(double d, unsigned char decimals) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", decimals, d);
+  return buf;
+}
+
+String operator+(const String &lhs, const String &rhs) {
+  String sum = lhs;
+  sum.concat(rhs);
+  return sum;
+}
+
+String operator+(const char *lhs, const String &rhs) {
+  String sum = lhs;
+  sum.concat(rhs);
+  return sum;
+}
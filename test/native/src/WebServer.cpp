@@ -0,0 +1,365 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * WebServer.cpp
+ *
+ * Implementation of the host stand-in for the WebServer. See WebServer.h for the details.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "WebServer.h"
+
+namespace {
+
+int hexValue(char c) {
+  return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+    c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+}
+
+// Undo URL encoding, as the ESP32's WebServer::urlDecode() does
+String urlDecode(const String &text) {
+  String decoded;
+  for (size_t i = 0; i < text.length(); i++) {
+    char c = text[i];
+    if (c == '+') {
+      decoded += ' ';
+    } else if (c == '%' && i + 2 < text.length() && hexValue(text[i + 1]) >= 0 &&
+               hexValue(text[i + 2]) >= 0) {
+      decoded += (char)(hexValue(text[i + 1]) * 16 + hexValue(text[i + 2]));
+      i += 2;
+    } else {
+      decoded += c;
+    }
+  }
+  return decoded;
+}
+
+// The value of parameter name in a header value like 'form-data; name="x"; filename="y"'
+String headerParam(const String &value, const char *name) {
+  String key = String(name) + "=";
+  int at = 0;
+  while ((at = value.indexOf(key, at)) >= 0) {
+    if (at == 0 || value[at - 1] == ' ' || value[at - 1] == ';') {
+      break;
+    }
+    at += key.length();
+  }
+  if (at < 0) {
+    return String();
+  }
+  at += key.length();
+  if (at < (int)value.length() && value[at] == '"') {
+    int end = value.indexOf('"', at + 1);
+    return end < 0 ? String() : value.substring(at + 1, end);
+  }
+  int end = value.indexOf(';', at);
+  return end < 0 ? value.substring(at) : value.substring(at, end);
+}
+
+} // namespace
+
+// WiFiClient
+
+size_t WiFiClient::write(const uint8_t *buf, size_t size) {
+  return server == nullptr ? 0 : server->clientWrite(buf, size);
+}
+
+IPAddress WiFiClient::remoteIP() const {
+  return server == nullptr ? IPAddress() : server->clientIp();
+}
+
+uint16_t WiFiClient::remotePort() const {
+  return server == nullptr ? 0 : server->clientPort();
+}
+
+// WebServer
+
+void WebServer::on(const Uri &uri, HTTPMethod method, THandlerFunction fn, THandlerFunction ufn) {
+  handlers.push_back({std::unique_ptr<Uri>(uri.clone()), method, fn, ufn});
+}
+
+void WebServer::collectHeaders(const char *keys[], const size_t count) {
+  headerKeys.clear();
+  for (size_t i = 0; i < count; i++) {
+    headerKeys.push_back(String(keys[i]));
+  }
+}
+
+String WebServer::arg(const String &name) {
+  for (auto &a : requestArgs) {
+    if (a.first == name) {
+      return a.second;
+    }
+  }
+  return String();
+}
+
+String WebServer::arg(int i) {
+  return i >= 0 && i < args() ? requestArgs[i].second : String();
+}
+
+String WebServer::argName(int i) {
+  return i >= 0 && i < args() ? requestArgs[i].first : String();
+}
+
+bool WebServer::hasArg(const String &name) {
+  for (auto &a : requestArgs) {
+    if (a.first == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+String WebServer::header(const String &name) {
+  for (auto &h : requestHeaders) {
+    if (h.first.equalsIgnoreCase(name)) {
+      return h.second;
+    }
+  }
+  return String();
+}
+
+bool WebServer::hasHeader(const String &name) {
+  for (auto &h : requestHeaders) {
+    if (h.first.equalsIgnoreCase(name)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void WebServer::send(int code, const char *contentType, const String &content) {
+  if (response.code == 0) {
+    response.code = code;
+    response.contentType = contentType == nullptr ? "" : contentType;
+  }
+  response.body += content;
+}
+
+void WebServer::sendHeader(const String &name, const String &value, bool first) {
+  String line = name + ": " + value + "\r\n";
+  response.headers = first ? line + response.headers : response.headers + line;
+}
+
+void WebServer::sendContent(const char *content, size_t size) {
+  clientWrite((const uint8_t *)content, size);
+}
+
+size_t WebServer::clientWrite(const uint8_t *buf, size_t size) {
+  response.body.concat((const char *)buf, size);
+  return size;
+}
+
+void WebServer::nativeRequest(HTTPMethod method, const String &url, String body,
+                              const String &contentType,
+                              const std::vector<std::pair<String, String>> &headers, IPAddress ip,
+                              uint16_t port) {
+  pending = true;
+  pendingMethod = method;
+  pendingUrl = url;
+  pendingBody.assign(body.c_str(), body.length());
+  body = String();
+  pendingType = contentType;
+  pendingHeaders = headers;
+  pendingIp = ip;
+  pendingPort = port;
+}
+
+void WebServer::parseArgs(const String &query) {
+  int at = 0;
+  while (at < (int)query.length()) {
+    int end = query.indexOf('&', at);
+    if (end < 0) {
+      end = query.length();
+    }
+    String pair = query.substring(at, end);
+    int eq = pair.indexOf('=');
+    if (pair.length() != 0) {
+      requestArgs.push_back(eq < 0 ? std::make_pair(urlDecode(pair), String()) :
+        std::make_pair(urlDecode(pair.substring(0, eq)), urlDecode(pair.substring(eq + 1))));
+    }
+    at = end + 1;
+  }
+}
+
+bool WebServer::parseMultipart(Handler *handler, const String &boundary) {
+  const NativeString &body = pendingBody;
+  std::string delimiter = std::string("--") + boundary.c_str();
+  std::string nextPart = "\r\n" + delimiter;
+  size_t at = body.find(delimiter.c_str(), 0, delimiter.length());
+  while (at != NativeString::npos) {
+    at += delimiter.length();
+    if (body.compare(at, 2, "--") == 0) {
+      return true;                                  // The closing delimiter
+    }
+    size_t headEnd = body.find("\r\n\r\n", at);
+    if (headEnd == NativeString::npos) {
+      return true;
+    }
+    String disposition;
+    String type;
+    String head(body.data() + at, headEnd - at);
+    for (int line = 0; line < (int)head.length(); ) {
+      int end = head.indexOf("\r\n", line);
+      if (end < 0) {
+        end = head.length();
+      }
+      String h = head.substring(line, end);
+      if (h.startsWith("Content-Disposition:")) {
+        disposition = h.substring(20);
+      } else if (h.startsWith("Content-Type:")) {
+        type = h.substring(13);
+        type.trim();
+      }
+      line = end + 2;
+    }
+    size_t dataStart = headEnd + 4;
+    size_t dataEnd = body.find(nextPart.c_str(), dataStart, nextPart.length());
+    String name = headerParam(disposition, "name");
+    bool isFile = disposition.indexOf("filename=") >= 0;
+    if (!isFile) {
+      if (dataEnd == NativeString::npos) {
+        return true;
+      }
+      requestArgs.push_back(std::make_pair(name, String(body.data() + dataStart,
+        dataEnd - dataStart)));
+      at = dataEnd + 2;
+      continue;
+    }
+
+    // A file: feed it to the upload callback, a buffer at a time
+    bool upload = handler != nullptr && handler->ufn;
+    currentUpload.reset(new HTTPUpload());
+    HTTPUpload &u = *currentUpload;
+    u.filename = headerParam(disposition, "filename");
+    u.name = name;
+    u.type = type.length() == 0 ? String("text/plain") : type;
+    u.totalSize = 0;
+    u.currentSize = 0;
+    u.status = UPLOAD_FILE_START;
+    if (upload) {
+      handler->ufn();
+    }
+    bool torn = dataEnd == NativeString::npos;
+    size_t end = torn ? body.length() : dataEnd;
+    for (size_t pos = dataStart; pos < end; ) {
+      size_t n = min(end - pos, (size_t)HTTP_UPLOAD_BUFLEN);
+      memcpy(u.buf, body.c_str() + pos, n);
+      u.currentSize = n;
+      u.totalSize += n;
+      u.status = UPLOAD_FILE_WRITE;
+      if (upload) {
+        handler->ufn();
+      }
+      pos += n;
+    }
+    u.currentSize = 0;
+    u.status = torn ? UPLOAD_FILE_ABORTED : UPLOAD_FILE_END;
+    if (upload) {
+      handler->ufn();
+    }
+    if (torn) {
+      return false;
+    }
+    at = dataEnd + 2;
+  }
+  return true;
+}
+
+void WebServer::feedRaw(Handler *handler) {
+  currentRaw.reset(new HTTPRaw());
+  HTTPRaw &r = *currentRaw;
+  r.totalSize = 0;
+  r.currentSize = 0;
+  r.status = RAW_START;
+  handler->ufn();
+  for (size_t pos = 0; pos < pendingBody.length(); ) {
+    size_t n = min(pendingBody.length() - pos, (size_t)HTTP_RAW_BUFLEN);
+    memcpy(r.buf, pendingBody.c_str() + pos, n);
+    r.currentSize = n;
+    r.totalSize += n;
+    r.status = RAW_WRITE;
+    handler->ufn();
+    pos += n;
+  }
+  r.currentSize = 0;
+  r.status = RAW_END;
+  handler->ufn();
+}
+
+void WebServer::handleClient() {
+  if (!listening || !pending) {
+    return;
+  }
+  pending = false;
+  response = NativeResponse{0, String(), String(), String()};
+  contentLength_ = CONTENT_LENGTH_NOT_SET;
+  requestMethod = pendingMethod;
+  requestIp = pendingIp;
+  requestPort = pendingPort;
+  int q = pendingUrl.indexOf('?');
+  requestUri = q < 0 ? pendingUrl : pendingUrl.substring(0, q);
+  requestArgs.clear();
+  if (q >= 0) {
+    parseArgs(pendingUrl.substring(q + 1));
+  }
+  requestHeaders.clear();
+  for (auto &h : pendingHeaders) {
+    for (auto &key : headerKeys) {
+      if (h.first.equalsIgnoreCase(key)) {
+        requestHeaders.push_back(h);
+      }
+    }
+  }
+
+  Handler *handler = nullptr;
+  std::vector<String> pathArgs;
+  for (auto &h : handlers) {
+    if ((h.method == HTTP_ANY || h.method == requestMethod) &&
+        h.uri->canHandle(requestUri, pathArgs)) {
+      handler = &h;
+      break;
+    }
+  }
+
+  bool parsed = true;
+  if (pendingBody.length() != 0 || pendingType.length() != 0) {
+    if (pendingType.startsWith("multipart/form-data")) {
+      parsed = parseMultipart(handler, headerParam(pendingType, "boundary"));
+    } else if (pendingType.startsWith("application/x-www-form-urlencoded")) {
+      parseArgs(String(pendingBody.data(), pendingBody.length()));
+    } else if (handler != nullptr && handler->ufn) {
+      feedRaw(handler);
+    } else {
+      requestArgs.push_back(std::make_pair(String("plain"),
+        String(pendingBody.data(), pendingBody.length())));
+    }
+  }
+
+  if (!parsed) {
+    // An upload was torn off: the real server drops the request, with no handler and no reply
+  } else if (handler != nullptr) {
+    handler->fn();
+  } else if (notFound) {
+    notFound();
+  } else {
+    send(404, "text/plain", "Not found: " + requestUri);
+  }
+  currentUpload.reset();
+  currentRaw.reset();
+  NativeString().swap(pendingBody);
+  pendingHeaders.clear();
+}
@@ -0,0 +1,406 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * soak.cpp
+ *
+ * Soak test the firmware on the host, the way tools/soak.py soaks a device, but for simulated
+ * days that take minutes. The whole firmware, main.cpp included, runs against the native stand-ins
+ * (see test/native/include/Arduino.h): setup() once, then loop(), with the simulated clock moved
+ * on between requests. The request mix is soak.py's -- snaps, photo views, directory listings,
+ * uploads and deletes -- with the oldest photos pruned so the card stays a steady size.
+ *
+ * Regressions, each of which makes the exit status 1:
+ *   - Heap in use at the end more than SOAK_HEAP_GROWTH_BYTES above what it was after the first
+ *     hour, or the free heap ever below SOAK_MIN_FREE_HEAP
+ *   - A request type's median latency over its last SOAK_WINDOW requests more than
+ *     SOAK_DRIFT_FACTOR times the median over its first SOAK_WINDOW
+ *   - Failed requests
+ *   - A torn-off upload that gets a reply or leaves a file, or an upload after one that fails
+ *   - A flag raised by GET /health (its leak flag needs a run of at least HM_WARMUP_SECONDS plus
+ *     HM_LEAK_SECONDS to be judged)
+ *   - An uploaded file or photo whose contents aren't what was written, or an FsCheck (GET
+ *     /health?fscheck) that doesn't come back ok
+ *
+ * Build and run it with, e.g., 24 simulated hours and random seed 1:
+ *
+ *     pio run -e soak && .pio/build/soak/program 24 1
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include "Arduino.h"
+#include "Native.h"
+#include "LoggingWebServer.h"
+#include "HealthMonitor.h"
+#include "SD_MMC.h"
+#include <stdarg.h>
+#include <vector>
+
+#define SOAK_HOURS        (24)                      // Default simulated hours to run
+#define SOAK_PAUSE_MILLIS (2000)                    // Mean simulated time between requests
+#define SOAK_IDLE_MILLIS  (50)                      // Clock step between loop() calls when idle
+#define SOAK_HEALTH_MILLIS (300000UL)               // Time between GET /health polls
+#define SOAK_FRAME_BYTES  (4096)                    // Size of the camera stand-in's JPEG
+#define SOAK_PHOTOS_KEPT  (64)                      // Photos kept before the oldest is deleted
+#define SOAK_UPLOADS_KEPT (32)                      // Uploads kept before one must be deleted
+#define SOAK_WINDOW       (1024)                    // Requests per latency window
+#define SOAK_DRIFT_FACTOR (2)                       // Latency growth that counts as drift
+#define SOAK_HEAP_GROWTH_BYTES (16384)              // Heap growth after the first hour allowed
+#define SOAK_MIN_FREE_HEAP (32768)                  // Least free heap allowed
+#define SOAK_HEALTH_FLAGS (4)                       // The flags GET /health reports
+#define SOAK_DIR          "/soak"                   // Where uploads go
+#define PHOTO_DIR         "/photos"                 // Where photos go: main.cpp's PHOTO_PATH
+
+void setup();
+void loop();
+extern LoggingWebServer server;
+
+enum SoakOp { SNAP, VIEW, LIST, UPLOAD, DELETE, OP_COUNT };
+static const char *opNames[OP_COUNT] = {"snap", "view", "list", "upload", "delete"};
+static const uint8_t opWeights[OP_COUNT] = {2, 6, 3, 2, 2};                // As in tools/soak.py
+static const size_t uploadSizes[] = {512, 4096, 65536, 262144};
+
+struct Latency {                                    // One request type's latencies
+  uint32_t count;                                   //   Requests
+  uint32_t failures;                                //   How many failed
+  uint32_t early[SOAK_WINDOW];                      //   The first SOAK_WINDOW
+  uint32_t late[SOAK_WINDOW];                       //   The last SOAK_WINDOW (a ring)
+};
+struct Upload {                                     // An uploaded file still on the card
+  char path[32];
+  uint32_t size;
+  uint32_t seed;                                    //   Its contents come from this
+};
+
+static Latency latency[OP_COUNT];
+static String photos[SOAK_PHOTOS_KEPT];             // The photos kept, a ring, oldest first
+static uint16_t photoFirst, photoCount;
+static Upload uploads[SOAK_UPLOADS_KEPT];
+static uint16_t uploadCount;
+static uint32_t rng = 1;                            // xorshift32 state
+static uint16_t problems;
+static const char *healthFlags[SOAK_HEALTH_FLAGS] = {
+  "leak", "fragmentation", "latencyDrift", "overBudget"
+};
+static bool healthFlagged[SOAK_HEALTH_FLAGS];            // Which were raised at the last poll
+
+static uint32_t random32() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static void problem(const char *format, ...) __attribute__((format(printf, 1, 2)));
+static void problem(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  printf("REGRESSION: ");
+  vprintf(format, args);
+  printf("\n");
+  va_end(args);
+  problems++;
+}
+
+// Run loop() until the clock reaches the given time
+static void idleUntil(uint64_t micros) {
+  while (nativeMicros() < micros) {
+    loop();
+    nativeAdvanceMicros(SOAK_IDLE_MILLIS * 1000);
+  }
+}
+
+// Have loop() handle a request; its response, with the latency noted against op
+static NativeResponse request(SoakOp op, HTTPMethod method, const String &url,
+                              String body = String(), const String &type = String()) {
+  server.nativeRequest(method, url, std::move(body), type);
+  loop();
+  NativeResponse r = server.nativeTakeResponse();
+  if (op == OP_COUNT) {
+    return r;
+  }
+  Latency &l = latency[op];
+  uint32_t micros = server.requestMicros();
+  if (l.count < SOAK_WINDOW) {
+    l.early[l.count] = micros;
+  }
+  l.late[l.count % SOAK_WINDOW] = micros;
+  l.count++;
+  if (r.code < 200 || r.code >= 400) {
+    l.failures++;
+  }
+  return r;
+}
+
+static String formBody(const char *name, const String &value) {
+  return String(name) + "=" + value;
+}
+
+static String contents(uint32_t seed, size_t size) {
+  String s;
+  uint32_t saved = rng;
+  rng = seed;
+  for (size_t i = 0; i < size; i++) {
+    s += (char)(random32() & 0xFF);
+  }
+  rng = saved;
+  return s;
+}
+
+static void deleteUpload(uint16_t ix) {
+  request(DELETE, HTTP_DELETE, "/edit", formBody("path", uploads[ix].path),
+    "application/x-www-form-urlencoded");
+  uploads[ix] = uploads[--uploadCount];
+}
+
+static void snap() {
+  NativeResponse r = request(SNAP, HTTP_GET, "/snap");
+  int at = r.headers.indexOf("image=");
+  if (r.code != 302 || at < 0) {
+    return;
+  }
+  String path = r.headers.substring(at + 6, r.headers.indexOf("\r\n", at));
+  if (photoCount == SOAK_PHOTOS_KEPT) {
+    request(DELETE, HTTP_DELETE, "/edit", formBody("path", photos[photoFirst]),
+      "application/x-www-form-urlencoded");
+    photoFirst = (photoFirst + 1) % SOAK_PHOTOS_KEPT;
+    photoCount--;
+  }
+  photos[(photoFirst + photoCount++) % SOAK_PHOTOS_KEPT] = path;
+}
+
+// A multipart POST /edit body uploading data to path; torn, it stops short of the closing delimiter
+static String uploadBody(const char *path, const String &data, bool torn = false) {
+  String body = "--SoakBoundary\r\nContent-Disposition: form-data; name=\"data\"; filename=\"" +
+    String(path) + "\"\r\nContent-Type: application/octet-stream\r\n\r\n" + data;
+  return torn ? body : body + "\r\n--SoakBoundary--\r\n";
+}
+
+static void upload() {
+  if (uploadCount == SOAK_UPLOADS_KEPT) {
+    return deleteUpload(random32() % uploadCount);
+  }
+  Upload &u = uploads[uploadCount];
+  snprintf(u.path, sizeof(u.path), SOAK_DIR "/s%06u.bin", (unsigned)(random32() % 1000000));
+  u.size = uploadSizes[random32() % (sizeof(uploadSizes) / sizeof(uploadSizes[0]))];
+  u.seed = random32() | 1;
+  for (uint16_t i = 0; i < uploadCount; i++) {
+    if (strcmp(uploads[i].path, u.path) == 0) {
+      return;                                       // Don't overwrite one we're keeping
+    }
+  }
+  String body = uploadBody(u.path, contents(u.seed, u.size));     // Not held through the request
+  NativeResponse r = request(UPLOAD, HTTP_POST, "/edit", std::move(body),
+    "multipart/form-data; boundary=SoakBoundary");
+  if (r.code == 200) {
+    uploadCount++;
+  }
+}
+
+// An upload torn off -- the connection dropped mid-file -- gets no reply and must leave nothing
+// behind, nor spoil the next upload's reply: try one to a good name and one to a name refused at
+// UPLOAD_FILE_START, each followed by a whole upload
+static void checkTornUploads() {
+  static const char *path = SOAK_DIR "/torn.bin";
+  String data = contents(1, 4096);
+  for (const char *tornPath : {path, SOAK_DIR "/../torn.bin"}) {
+    NativeResponse r = request(OP_COUNT, HTTP_POST, "/edit", uploadBody(tornPath, data, true),
+      "multipart/form-data; boundary=SoakBoundary");
+    if (r.code != 0) {
+      problem("a torn upload to %s got a %d reply", tornPath, r.code);
+    }
+    if (SD_MMC.exists(path) || SD_MMC.exists(String(path) + ".tmp")) {
+      problem("a torn upload to %s left a file behind", tornPath);
+    }
+    r = request(OP_COUNT, HTTP_POST, "/edit", uploadBody(path, data),
+      "multipart/form-data; boundary=SoakBoundary");
+    File f = SD_MMC.open(path);
+    if (r.code != 200 || !f || f.readString() != data) {
+      problem("after a torn upload to %s, an upload got %d", tornPath, r.code);
+    }
+    f.close();
+    request(OP_COUNT, HTTP_DELETE, "/edit", formBody("path", path),
+      "application/x-www-form-urlencoded");
+  }
+}
+
+static void step() {
+  uint16_t total = 0;
+  for (uint8_t op = 0; op < OP_COUNT; op++) {
+    total += opWeights[op];
+  }
+  uint16_t pick = random32() % total;
+  uint8_t op = 0;
+  while (pick >= opWeights[op]) {
+    pick -= opWeights[op++];
+  }
+  switch (op) {
+  case SNAP:
+    return snap();
+  case VIEW:
+    if (photoCount == 0) {
+      return snap();
+    }
+    request(VIEW, HTTP_GET, photos[(photoFirst + random32() % photoCount) % SOAK_PHOTOS_KEPT]);
+    return;
+  case LIST:
+    request(LIST, HTTP_GET, "/list?dir=" PHOTO_DIR);
+    return;
+  case UPLOAD:
+    return upload();
+  default:
+    if (uploadCount == 0) {
+      return upload();
+    }
+    return deleteUpload(random32() % uploadCount);
+  }
+}
+
+// Note which of GET /health's flags are raised. (Only the flags are kept: the response grows as
+// the health monitor fills its ring, and the heap checks are about the firmware's heap.)
+static void pollHealth() {
+  String health = request(OP_COUNT, HTTP_GET, "/health").body;
+  for (uint8_t i = 0; i < SOAK_HEALTH_FLAGS; i++) {
+    healthFlagged[i] = health.indexOf("\"" + String(healthFlags[i]) + "\":true") >= 0;
+  }
+}
+
+static uint32_t median(const uint32_t *samples, uint32_t n) {
+  std::vector<uint32_t> sorted(samples, samples + n);
+  std::nth_element(sorted.begin(), sorted.begin() + n / 2, sorted.end());
+  return sorted[n / 2];
+}
+
+static void checkLatency() {
+  for (uint8_t op = 0; op < OP_COUNT; op++) {
+    Latency &l = latency[op];
+    uint32_t n = min(l.count, (uint32_t)SOAK_WINDOW);
+    if (n < 8) {
+      continue;
+    }
+    uint32_t early = median(l.early, n);
+    uint32_t late = median(l.late, n);
+    printf("%-7s n=%-7u fail=%-4u median %u us -> %u us\n", opNames[op], l.count, l.failures,
+      early, late);
+    if (late > early * SOAK_DRIFT_FACTOR) {
+      problem("%s latency drifted from %u to %u us", opNames[op], early, late);
+    }
+    if (l.failures != 0) {
+      problem("%u %s requests failed", l.failures, opNames[op]);
+    }
+  }
+}
+
+static void checkFiles() {
+  for (uint16_t i = 0; i < uploadCount; i++) {
+    File f = SD_MMC.open(uploads[i].path);
+    if (!f || f.readString() != contents(uploads[i].seed, uploads[i].size)) {
+      problem("%s doesn't hold what was uploaded", uploads[i].path);
+    }
+  }
+  for (uint16_t i = 0; i < photoCount; i++) {
+    String path = photos[(photoFirst + i) % SOAK_PHOTOS_KEPT];
+    File f = SD_MMC.open(path);
+    if (!f || f.size() != SOAK_FRAME_BYTES) {
+      problem("%s isn't the photo that was taken", path.c_str());
+    }
+  }
+
+  // Start the check once any job running (say, the disk usage scan) is done
+  while (request(OP_COUNT, HTTP_GET, "/health?fscheck").code != 200) {
+    idleUntil(nativeMicros() + 1000000);
+  }
+  String job;
+  do {
+    // Each request runs loop() once, stepping the check; look before another job can replace it
+    nativeAdvanceMicros(SOAK_IDLE_MILLIS * 1000);
+    job = request(OP_COUNT, HTTP_GET, "/job").body;
+  } while (job.indexOf("\"name\":\"fsCheck\"") < 0 || job.indexOf("\"running\":false") < 0);
+  if (job.indexOf("\"ok\":true") < 0) {
+    problem("file system check: %s", job.c_str());
+  }
+}
+
+int main(int argc, char **argv) {
+  float hours = argc > 1 ? atof(argv[1]) : SOAK_HOURS;
+  rng = argc > 2 ? strtoul(argv[2], nullptr, 0) | 1 : 1;
+  nativeOnRestart([]() {
+    printf("REGRESSION: the firmware restarted\n");
+    exit(1);
+  });
+  static uint8_t frame[SOAK_FRAME_BYTES];
+  frame[0] = 0xFF;
+  frame[1] = 0xD8;
+  for (size_t i = 2; i < sizeof(frame) - 2; i++) {
+    frame[i] = random32() % 0xFF;
+  }
+  frame[sizeof(frame) - 2] = 0xFF;
+  frame[sizeof(frame) - 1] = 0xD9;
+  nativeCameraFrame(frame, sizeof(frame), 800, 600);
+
+  setup();
+  for (const char *dir : {PHOTO_DIR, SOAK_DIR}) {
+    request(OP_COUNT, HTTP_PUT, "/edit", formBody("path", dir),
+      "application/x-www-form-urlencoded");
+  }
+  checkTornUploads();
+  uint64_t start = nativeMicros();
+  uint64_t end = start + (uint64_t)(hours * 3600e6);
+  uint64_t nextHealth = start;
+  uint64_t nextHour = start + 3600000000ULL;
+  size_t hourOneHeap = 0;
+  while (nativeMicros() < end) {
+    if (nativeMicros() >= nextHealth) {
+      pollHealth();
+      nextHealth += SOAK_HEALTH_MILLIS * 1000;
+    }
+    if (nativeMicros() >= nextHour) {
+      size_t used = nativeHeapUsed();
+      if (hourOneHeap == 0) {
+        hourOneHeap = used;
+      }
+      printf("%6.1f h  heap used %zu  min free %u  uploads %u  photos %u\n",
+        (nativeMicros() - start) / 3600e6, used, ESP.getMinFreeHeap(), uploadCount, photoCount);
+      fflush(stdout);
+      nextHour += 3600000000ULL;
+    }
+    step();
+    idleUntil(nativeMicros() + (random32() % (2 * SOAK_PAUSE_MILLIS)) * 1000);
+  }
+
+  size_t used = nativeHeapUsed();
+  if (hourOneHeap != 0 && used > hourOneHeap + SOAK_HEAP_GROWTH_BYTES) {
+    problem("heap in use grew from %zu to %zu bytes after the first hour", hourOneHeap, used);
+  }
+  if (ESP.getMinFreeHeap() < SOAK_MIN_FREE_HEAP) {
+    problem("free heap fell to %u bytes", ESP.getMinFreeHeap());
+  }
+  checkLatency();
+  if (hours * 3600 < HM_WARMUP_SECONDS + HM_LEAK_SECONDS) {
+    printf("Too short a run for GET /health to judge a leak: that takes %.1f h.\n",
+      (HM_WARMUP_SECONDS + HM_LEAK_SECONDS) / 3600.0);
+  }
+  for (uint8_t i = 0; i < SOAK_HEALTH_FLAGS; i++) {
+    if (healthFlagged[i]) {
+      problem("GET /health flags %s", healthFlags[i]);
+    }
+  }
+  checkFiles();
+  if (problems == 0) {
+    printf("No regressions.\n");
+  } else {
+    printf("%u regressions.\n", problems);
+  }
+  return problems == 0 ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * test_main.cpp
+ *
+ * Unit tests for AviWriter, run on the host with pio test -e native: a file cut short by a power
+ * failure part way through a timelapse can be recovered, up to the last frame that was written.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include <unity.h>
+#include "Arduino.h"
+#include "FS.h"
+#include "AviWriter.h"
+
+#define FRAME_BYTES       (1001)                    // Odd, so the chunks are padded
+
+static uint32_t get32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Fill a frame with a pattern that depends on which frame it is
+static void makeFrame(uint8_t *jpg, uint8_t n) {
+  for (size_t i = 0; i < FRAME_BYTES; i++) {
+    jpg[i] = n + i;
+  }
+}
+
+static String contents(fs::FS &fs, const char *path) {
+  File f = fs.open(path);
+  String s = f ? f.readString() : String();
+  return s;
+}
+
+// Write four frames, two with addFrame() and two as chunks, and lose power without closing
+static void writeAndLosePower(fs::FS &card, AviWriter &avi) {
+  uint8_t jpg[FRAME_BYTES];
+  TEST_ASSERT_TRUE(avi.open(card, "/tl.avi", 640, 480, 10, 100));
+  for (uint8_t n = 0; n < 2; n++) {
+    makeFrame(jpg, n);
+    TEST_ASSERT_TRUE(avi.addFrame(jpg, sizeof(jpg)));
+  }
+  uint8_t chunks[2 * AviWriter::chunkSize(FRAME_BYTES)];
+  for (uint8_t n = 2; n < 4; n++) {
+    makeFrame(jpg, n);
+    AviWriter::formatChunk(chunks + (n - 2) * AviWriter::chunkSize(FRAME_BYTES), jpg, sizeof(jpg));
+  }
+  TEST_ASSERT_TRUE(avi.addChunks(chunks, sizeof(chunks)));
+  card.powerLoss();
+}
+
+void test_frames_survive_power_loss() {
+  fs::FS card;
+  AviWriter avi;
+  writeAndLosePower(card, avi);
+  File f = card.open("/tl.avi");
+  TEST_ASSERT_EQUAL(AVI_HEADER_BYTES + 4 * AviWriter::chunkSize(FRAME_BYTES), f.size());
+}
+
+void test_recover_truncated() {
+  fs::FS card;
+  {
+    AviWriter avi;
+    writeAndLosePower(card, avi);
+  }                                                 // Its close() after the power loss is lost
+
+  // Tear the last frame, as a reset part way through a write might
+  uint32_t whole = AVI_HEADER_BYTES + 3 * AviWriter::chunkSize(FRAME_BYTES);
+  TEST_ASSERT_TRUE(card.truncate("/tl.avi", whole + 100));
+  TEST_ASSERT_TRUE(AviWriter::recover(card, "/tl.avi"));
+
+  String avi = contents(card, "/tl.avi");
+  const uint8_t *h = (const uint8_t *)avi.c_str();
+  TEST_ASSERT_GREATER_OR_EQUAL(whole + 8 + 3 * 16, avi.length());  // The torn frame's tail may stay
+  TEST_ASSERT_EQUAL(whole + 3 * 16, get32(h + 4));                   // RIFF size
+  TEST_ASSERT_EQUAL(3, get32(h + 48));                               // dwTotalFrames
+  TEST_ASSERT_EQUAL(3, get32(h + 140));                              // strh dwLength
+  TEST_ASSERT_EQUAL(FRAME_BYTES, get32(h + 60));                     // dwSuggestedBufferSize
+  TEST_ASSERT_EQUAL(100000, get32(h + 32));                          // dwMicroSecPerFrame
+  TEST_ASSERT_EQUAL(whole - 220, get32(h + 216));                    // movi LIST size
+  TEST_ASSERT_EQUAL_MEMORY("idx1", h + whole, 4);
+  for (uint32_t i = 0; i < 3; i++) {
+    const uint8_t *e = h + whole + 8 + 16 * i;
+    uint32_t offset = get32(e + 8);
+    TEST_ASSERT_EQUAL_MEMORY("00dc", e, 4);
+    TEST_ASSERT_EQUAL(4 + i * AviWriter::chunkSize(FRAME_BYTES), offset);
+    TEST_ASSERT_EQUAL(FRAME_BYTES, get32(e + 12));
+    TEST_ASSERT_EQUAL_UINT8(i, h[220 + offset + AVI_CHUNK_HEADER]);  // The frame's first byte
+  }
+
+  // Once finalized, it isn't recovered again
+  TEST_ASSERT_FALSE(AviWriter::recover(card, "/tl.avi"));
+}
+
+void test_recover_headers_only() {
+  fs::FS card;
+  {
+    AviWriter avi;
+    TEST_ASSERT_TRUE(avi.open(card, "/empty.avi", 640, 480, 10, 100));
+    card.powerLoss();
+  }
+  TEST_ASSERT_TRUE(AviWriter::recover(card, "/empty.avi"));
+  String avi = contents(card, "/empty.avi");
+  TEST_ASSERT_EQUAL(AVI_HEADER_BYTES + 8, avi.length());
+  TEST_ASSERT_EQUAL(0, get32((const uint8_t *)avi.c_str() + 48));
+}
+
+void test_closed_file_not_recovered() {
+  fs::FS card;
+  uint8_t jpg[FRAME_BYTES];
+  makeFrame(jpg, 0);
+  AviWriter avi;
+  TEST_ASSERT_TRUE(avi.open(card, "/done.avi", 640, 480, 10, 100));
+  TEST_ASSERT_TRUE(avi.addFrame(jpg, sizeof(jpg)));
+  TEST_ASSERT_TRUE(avi.close());
+  TEST_ASSERT_FALSE(AviWriter::recover(card, "/done.avi"));
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_frames_survive_power_loss);
+  RUN_TEST(test_recover_truncated);
+  RUN_TEST(test_recover_headers_only);
+  RUN_TEST(test_closed_file_not_recovered);
+  return UNITY_END();
+}
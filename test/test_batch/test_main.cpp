@@ -0,0 +1,128 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * test_main.cpp
+ *
+ * Unit tests for BatchJob, run on the host with pio test -e native: operations that depend on
+ * earlier ones in the batch see their effects.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include <unity.h>
+#include "Arduino.h"
+#include "FS.h"
+#include "BatchJob.h"
+#include "DiskUsage.h"
+
+static bool anyPath(const String &path) {
+  return path.startsWith("/");
+}
+
+static void makeFile(fs::FS &card, const char *path, const char *text) {
+  File f = card.open(path, FILE_WRITE);
+  f.print(text);
+  f.close();
+}
+
+static String contents(fs::FS &card, const char *path) {
+  File f = card.open(path);
+  return f ? f.readString() : String("(missing)");
+}
+
+// Parse and run a batch to completion, reporting its changes to du; its JSON report
+static String runBatch(fs::FS &card, const char *json, DiskUsage &du) {
+  BatchJob job(card, du, 512, anyPath);
+  if (!job.parse(json)) {
+    return job.error();
+  }
+  while (job.step()) {
+  }
+  return job.toJson();
+}
+
+static String runBatch(fs::FS &card, const char *json) {
+  DiskUsage du(0);
+  return runBatch(card, json, du);
+}
+
+void test_chained_moves() {
+  fs::FS card;
+  card.mkdir("/z");
+  makeFile(card, "/a.jpg", "A");
+  makeFile(card, "/z/b.jpg", "B");
+  String report = runBatch(card, "[{\"op\":\"move\",\"from\":\"/z/b.jpg\",\"to\":\"/c.jpg\"},"
+    "{\"op\":\"move\",\"from\":\"/a.jpg\",\"to\":\"/z/b.jpg\"}]");
+  TEST_ASSERT_TRUE(report.indexOf("\"failed\":0") >= 0);
+  TEST_ASSERT_EQUAL_STRING("B", contents(card, "/c.jpg").c_str());
+  TEST_ASSERT_EQUAL_STRING("A", contents(card, "/z/b.jpg").c_str());
+  TEST_ASSERT_FALSE(card.exists("/a.jpg"));
+}
+
+void test_delete_then_mkdir() {
+  fs::FS card;
+  makeFile(card, "/x", "old");
+  String report = runBatch(card, "[{\"op\":\"delete\",\"path\":\"/x\"},"
+    "{\"op\":\"mkdir\",\"path\":\"/x\"},"
+    "{\"op\":\"copy\",\"from\":\"/y\",\"to\":\"/x/y\"}]");
+  TEST_ASSERT_TRUE(report.indexOf("\"failed\":1") >= 0);          // There's no /y
+  File x = card.open("/x");
+  TEST_ASSERT_TRUE(x.isDirectory());
+}
+
+void test_copy_then_delete_source() {
+  fs::FS card;
+  card.mkdir("/photos");
+  makeFile(card, "/photos/1.jpg", "one");
+  makeFile(card, "/photos/2.jpg", "two");
+  DiskUsage du(0);
+  du.add("/photos/1.jpg", 3, 1);
+  du.add("/photos/2.jpg", 3, 1);
+  String report = runBatch(card, "[{\"op\":\"mkdir\",\"path\":\"/keep\"},"
+    "{\"op\":\"mkdir\",\"path\":\"/keep/sub\"},"
+    "{\"op\":\"copy\",\"from\":\"/photos/2.jpg\",\"to\":\"/keep/sub/2.jpg\"},"
+    "{\"op\":\"copy\",\"from\":\"/photos/1.jpg\",\"to\":\"/keep/1.jpg\"},"
+    "{\"op\":\"delete\",\"path\":\"/photos\"}]", du);
+  TEST_ASSERT_TRUE(report.indexOf("\"failed\":0") >= 0);
+  TEST_ASSERT_TRUE(du.toJson("/").indexOf("\"dir\":\"/\",\"bytes\":6,\"files\":2") >= 0);
+  TEST_ASSERT_TRUE(du.toJson("/keep").indexOf("\"bytes\":6,\"files\":2") >= 0);
+  TEST_ASSERT_TRUE(du.toJson("/photos").indexOf("\"bytes\":0,\"files\":0") >= 0);
+  TEST_ASSERT_EQUAL_STRING("one", contents(card, "/keep/1.jpg").c_str());
+  TEST_ASSERT_EQUAL_STRING("two", contents(card, "/keep/sub/2.jpg").c_str());
+  TEST_ASSERT_FALSE(card.exists("/photos"));
+}
+
+void test_delete_deep_tree() {
+  fs::FS card;
+  String path = "";
+  for (int depth = 0; depth < 20; depth++) {
+    path += "/d";
+    TEST_ASSERT_TRUE(card.mkdir(path));
+    makeFile(card, (path + "/f.jpg").c_str(), "x");
+  }
+  String report = runBatch(card, "[{\"op\":\"delete\",\"path\":\"/d\"}]");
+  TEST_ASSERT_TRUE(report.indexOf("\"result\":\"ok\"") >= 0);
+  TEST_ASSERT_FALSE(card.exists("/d"));
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_chained_moves);
+  RUN_TEST(test_delete_then_mkdir);
+  RUN_TEST(test_copy_then_delete_source);
+  RUN_TEST(test_delete_deep_tree);
+  return UNITY_END();
+}
@@ -0,0 +1,86 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * test_main.cpp
+ *
+ * Unit tests for MotionDetector, run on the host with pio test -e native: motion is found whatever
+ * the frame's width and alignment, and the word and byte SAD kernels agree.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include <unity.h>
+#include "Arduino.h"
+#include "MotionDetector.h"
+
+#define W_ODD             (50)                      // Not a multiple of 4
+#define H                 (40)
+
+static uint8_t frameA[4 + 64 * H];
+static uint8_t frameB[4 + 64 * H];
+
+// Fill a w x h frame at f with a flat gray, optionally with a bright square at (16, 16)
+static void paint(uint8_t *f, uint16_t w, bool square) {
+  memset(f, 100, (size_t)w * H);
+  if (square) {
+    for (int y = 16; y < 32; y++) {
+      memset(f + y * w + 16, 220, 16);
+    }
+  }
+}
+
+static void checkMotion(uint8_t *a, uint8_t *b, uint16_t w) {
+  MotionDetector md(20, 2);
+  paint(a, w, false);
+  paint(b, w, true);
+  TEST_ASSERT_FALSE(md.update(a, w, H));            // No reference yet
+  TEST_ASSERT_FALSE(md.update(a, w, H));
+  TEST_ASSERT_EQUAL(0, md.changedBlocks());
+  TEST_ASSERT_TRUE(md.update(b, w, H));
+  TEST_ASSERT_EQUAL(4, md.changedBlocks());
+}
+
+void test_aligned() {
+  checkMotion(frameA, frameB, 64);
+}
+
+void test_odd_width() {
+  checkMotion(frameA, frameB, W_ODD);
+}
+
+void test_unaligned() {
+  checkMotion(frameA + 1, frameB + 3, 64);
+}
+
+void test_kernels_agree() {
+  for (size_t i = 0; i < sizeof(frameA); i++) {
+    frameA[i] = i * 37;
+    frameB[i] = i * 11 + 5;
+  }
+  for (int x = 0; x < 64 - MD_BLOCK; x += 4) {
+    uint32_t bytes = blockSad8Bytes(frameA + x, frameB + x, 64);
+    TEST_ASSERT_EQUAL(bytes, blockSad8(frameA + x, frameB + x, 64));
+  }
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_aligned);
+  RUN_TEST(test_odd_width);
+  RUN_TEST(test_unaligned);
+  RUN_TEST(test_kernels_agree);
+  return UNITY_END();
+}
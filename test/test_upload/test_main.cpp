@@ -0,0 +1,100 @@
+/****
+ * ObscuraCam v1.0.0
+ *
+ * test_main.cpp
+ *
+ * Unit tests for UploadManager, run on the host with pio test -e native: data reach the file
+ * through the buffer, only the client that started an upload can add to it, and an upload that
+ * was never finished is abandoned when the next one starts.
+ *
+ ****
+ *
+ * Copyright 2024 by D.L. Ehnebuske
+ * License: GNU Lesser General Public License v2.1
+ *
+ * This is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software Foundation; eitherversion 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ ****/
+#include <unity.h>
+#include "Arduino.h"
+#include "FS.h"
+#include "UploadManager.h"
+
+#define BUF_BYTES         (64)
+
+static const UploadKey alice = {0x0100000A, 50000};  // 10.0.0.1:50000
+static const UploadKey alicePort = {0x0100000A, 50001};
+static const UploadKey bob = {0x0200000A, 50000};    // 10.0.0.2:50000, same port
+
+static String contents(fs::FS &card, const char *path) {
+  File f = card.open(path);
+  return f ? f.readString() : String("(missing)");
+}
+
+void test_buffered_write() {
+  fs::FS card;
+  UploadManager uploads(card, BUF_BYTES);
+  TEST_ASSERT_TRUE(uploads.begin());
+  TEST_ASSERT_TRUE(uploads.open(alice, "/a.txt"));
+  String text;
+  for (int i = 0; i < 50; i++) {
+    String piece = String(i) + ",";
+    TEST_ASSERT_TRUE(uploads.write((const uint8_t *)piece.c_str(), piece.length()));
+    text += piece;
+  }
+  TEST_ASSERT_EQUAL(text.length(), uploads.received());
+  TEST_ASSERT_TRUE(uploads.close());
+  TEST_ASSERT_FALSE(uploads.isOpen(alice));
+  TEST_ASSERT_EQUAL_STRING(text.c_str(), contents(card, "/a.txt").c_str());
+}
+
+void test_keys() {
+  fs::FS card;
+  UploadManager uploads(card, BUF_BYTES);
+  uploads.begin();
+  TEST_ASSERT_TRUE(uploads.open(alice, "/a.txt"));
+  TEST_ASSERT_TRUE(uploads.isOpen(alice));
+  TEST_ASSERT_FALSE(uploads.isOpen(alicePort));
+  TEST_ASSERT_FALSE(uploads.isOpen(bob));
+  uploads.close();
+}
+
+void test_unfinished_upload_abandoned() {
+  fs::FS card;
+  UploadManager uploads(card, BUF_BYTES);
+  uploads.begin();
+  TEST_ASSERT_TRUE(uploads.open(alice, "/a.tmp"));
+  uploads.write((const uint8_t *)"partial", 7);
+  TEST_ASSERT_TRUE(uploads.open(bob, "/b.tmp"));
+  TEST_ASSERT_FALSE(card.exists("/a.tmp"));
+  TEST_ASSERT_TRUE(uploads.isOpen(bob));
+  TEST_ASSERT_TRUE(uploads.toJson().indexOf("\"failures\":1") >= 0);
+  uploads.close();
+}
+
+void test_open_fails() {
+  fs::FS card;
+  UploadManager uploads(card, BUF_BYTES);
+  TEST_ASSERT_FALSE(uploads.open(alice, "/a.txt"));  // No buffer yet
+  uploads.begin();
+  TEST_ASSERT_FALSE(uploads.open(alice, "/no/such/dir/a.txt"));
+  TEST_ASSERT_FALSE(uploads.isOpen(alice));
+  TEST_ASSERT_FALSE(uploads.write((const uint8_t *)"x", 1));
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_buffered_write);
+  RUN_TEST(test_keys);
+  RUN_TEST(test_unfinished_upload_abandoned);
+  RUN_TEST(test_open_fails);
+  return UNITY_END();
+}
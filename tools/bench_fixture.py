@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""
+ObscuraCam v1.0.0
+
+bench_fixture.py
+
+Generate the JPEG fixtures test/bench/bench.cpp scores with jpegSharpness():
+a synthetic view of the screen at the camera's photo size (UXGA), as the
+OV2640 would encode it -- baseline, 4:2:2 chroma -- and the same view blurred,
+the way a visitor walking through the trailer blurs a shot. The benchmark
+times the scoring of both and checks that the sharp one scores higher.
+
+The drawing is seeded, so with the same Pillow the files come out the same.
+Run it from the project directory to regenerate them:
+
+    tools/bench_fixture.py
+
+Copyright 2024 by D.L. Ehnebuske
+License: GNU Lesser General Public License v2.1
+"""
+import argparse
+import os
+import random
+
+from PIL import Image, ImageDraw, ImageFilter, ImageFont
+
+WIDTH, HEIGHT = 1600, 1200          # FRAMESIZE_UXGA, main.cpp's CAM_FRAME_SIZE
+QUALITY = 75                        # Gives about the size of an OV2640 UXGA photo
+BLUR_RADIUS = 4                     # Gaussian blur of the shaken shot (pixels)
+SEED = 1
+
+
+def draw_screen():
+    """The screen, seen from the shelf above it: a bright trapezoid of text and
+    shapes on the dark trailer wall."""
+    rng = random.Random(SEED)
+    img = Image.new("RGB", (WIDTH, HEIGHT), (24, 20, 28))
+    draw = ImageDraw.Draw(img)
+    for y in range(0, HEIGHT, 4):                           # Uneven lighting on the wall
+        shade = 20 + 16 * y // HEIGHT
+        draw.line([(0, y), (WIDTH, y)], fill=(shade, shade - 4, shade + 6), width=4)
+    quad = [(190, 60), (1410, 60), (1600, 1140), (0, 1140)]
+    draw.polygon(quad, fill=(210, 214, 200))
+    font = ImageFont.load_default(size=36)
+    for row in range(14):
+        y = 110 + row * 72
+        inset = 190 * (1140 - y) // 1080
+        words = " ".join("".join(rng.choice("abcdefghijklmnopqrstuvwxyz")
+                                 for _ in range(rng.randint(2, 8))) for _ in range(8))
+        draw.text((inset + 40, y), words, fill=(20, 20, 30), font=font)
+    for _ in range(24):
+        x, y = rng.randint(300, 1300), rng.randint(150, 1050)
+        r = rng.randint(10, 60)
+        color = tuple(rng.randint(0, 255) for _ in range(3))
+        draw.ellipse([x - r, y - r, x + r, y + r], outline=color, width=5)
+    return img
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[2])
+    parser.add_argument("--dir", default="test/bench", help="where to put the fixtures")
+    args = parser.parse_args()
+
+    sharp = draw_screen()
+    blurred = sharp.filter(ImageFilter.GaussianBlur(BLUR_RADIUS))
+    for name, img in (("screen.jpg", sharp), ("screen_blurred.jpg", blurred)):
+        path = os.path.join(args.dir, name)
+        img.save(path, "JPEG", quality=QUALITY, subsampling="4:2:2", progressive=False,
+                 optimize=False)
+        print("%s: %d bytes" % (path, os.path.getsize(path)))
+
+
+if __name__ == "__main__":
+    main()
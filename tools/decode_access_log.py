@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""
+ObscuraCam v1.0.0
+
+decode_access_log.py
+
+Decode the ObscuraCam's binary access log (/logs/access.bin and access.old on the
+SD card, or fetched from http://obscuracam.local/logs/access.bin) into one
+tab-separated line per request, or, with --summary, per-URI counts, bytes and
+latencies. See include/AccessLog.h for the format.
+
+    tools/decode_access_log.py access.old access.bin
+    tools/decode_access_log.py --summary access.bin
+
+Copyright 2024 by D.L. Ehnebuske
+License: GNU Lesser General Public License v2.1
+"""
+import argparse
+import collections
+import struct
+import sys
+
+MAGIC = b"OCAL"
+VERSION = 1
+URI_BYTES = 28
+ENTRY = struct.Struct("<IIIIHBB%ds" % URI_BYTES)
+BOOT = 0xFF
+
+# HTTPMethod values (from http_parser) that the ObscuraCam serves
+METHODS = {0: "DELETE", 1: "GET", 2: "HEAD", 3: "POST", 4: "PUT", 6: "OPTIONS", 28: "PATCH"}
+
+
+def read_log(f, name):
+    """Yield (boot, millis, ip, method, status, bytes, micros, uri) for each entry of a log file."""
+    header = f.read(8)
+    if len(header) < 8 or header[:4] != MAGIC:
+        sys.exit("%s: not an ObscuraCam access log" % name)
+    version, size = struct.unpack("<HH", header[4:])
+    if version != VERSION or size != ENTRY.size:
+        sys.exit("%s: unsupported version %d (entry size %d)" % (name, version, size))
+    boot = 0
+    while True:
+        raw = f.read(ENTRY.size)
+        if len(raw) < ENTRY.size:
+            return
+        millis, ip, nbytes, micros, status, method, uri_len, uri = ENTRY.unpack(raw)
+        if method == BOOT:
+            boot += 1
+            continue
+        uri = uri.rstrip(b"\0").decode("utf-8", "replace")
+        if uri_len > len(uri):
+            uri = "..." + uri
+        address = ".".join(str((ip >> shift) & 0xFF) for shift in (0, 8, 16, 24))
+        yield boot, millis, address, METHODS.get(method, str(method)), status, nbytes, micros, uri
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[2])
+    parser.add_argument("logs", nargs="+", type=argparse.FileType("rb"),
+                        help="access log files, oldest first")
+    parser.add_argument("--summary", action="store_true", help="summarize by method and URI")
+    args = parser.parse_args()
+
+    entries = []
+    for f in args.logs:
+        entries.extend(read_log(f, f.name))
+
+    if not args.summary:
+        print("boot\tseconds\tclient\tmethod\tstatus\tbytes\tms\turi")
+        for boot, millis, ip, method, status, nbytes, micros, uri in entries:
+            print("%d\t%.3f\t%s\t%s\t%d\t%d\t%.1f\t%s" %
+                  (boot, millis / 1000, ip, method, status, nbytes, micros / 1000, uri))
+        return
+
+    groups = collections.defaultdict(list)
+    for _, _, _, method, status, nbytes, micros, uri in entries:
+        groups[(method, uri)].append((status, nbytes, micros))
+    print("count\terrors\tbytes\tmean ms\tp95 ms\tmax ms\tmethod\turi")
+    for (method, uri), reqs in sorted(groups.items(), key=lambda g: -len(g[1])):
+        latencies = [r[2] / 1000 for r in reqs]
+        print("%d\t%d\t%d\t%.1f\t%.1f\t%.1f\t%s\t%s" %
+              (len(reqs), sum(1 for r in reqs if r[0] >= 400), sum(r[1] for r in reqs),
+               sum(latencies) / len(latencies), percentile(latencies, 95), max(latencies),
+               method, uri))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""
+ObscuraCam v1.0.0
+
+fold_profile.py
+
+Turn the samples from the ObscuraCam's /profile endpoint into folded stacks, one
+"core;caller;function count" line per distinct stack, ready for flamegraph.pl or
+speedscope. Addresses are symbolized with the toolchain's addr2line against the
+firmware ELF the samples came from.
+
+    curl 'http://obscuracam.local/profile?seconds=20'
+    ...exercise the camera...
+    curl http://obscuracam.local/profile > samples.txt
+    tools/fold_profile.py .pio/build/esp32cam-profile/firmware.elf samples.txt > folded.txt
+    flamegraph.pl folded.txt > profile.svg
+
+Copyright 2024 by D.L. Ehnebuske
+License: GNU Lesser General Public License v2.1
+"""
+import argparse
+import collections
+import shutil
+import subprocess
+import sys
+
+ADDR2LINE = "xtensa-esp32-elf-addr2line"
+
+
+def read_samples(f):
+    """Yield (core, pc, caller) for each well-formed line of the dump."""
+    for line in f:
+        fields = line.split()
+        if len(fields) != 3:
+            continue
+        try:
+            yield int(fields[0]), int(fields[1], 16), int(fields[2], 16)
+        except ValueError:
+            continue
+
+
+def symbolize(addr2line, elf, addrs):
+    """Map each address to the name of the function containing it."""
+    addrs = sorted(addrs)
+    out = subprocess.run(
+        [addr2line, "-f", "-C", "-e", elf] + ["0x%08x" % a for a in addrs],
+        check=True, capture_output=True, text=True).stdout.splitlines()
+    names = {}
+    for i, addr in enumerate(addrs):
+        name = out[2 * i] if 2 * i < len(out) else "??"
+        names[addr] = "0x%08x" % addr if name == "??" else name
+    return names
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[2])
+    parser.add_argument("elf", help="the firmware ELF the samples were taken from")
+    parser.add_argument("samples", nargs="?", type=argparse.FileType("r"), default=sys.stdin,
+                        help="the /profile dump (default: stdin)")
+    parser.add_argument("--addr2line", default=ADDR2LINE, help="addr2line to use")
+    parser.add_argument("--no-caller", action="store_true",
+                        help="fold on the sampled function only")
+    args = parser.parse_args()
+
+    if shutil.which(args.addr2line) is None:
+        sys.exit("%s not found; pass --addr2line or put the toolchain on PATH" % args.addr2line)
+
+    samples = list(read_samples(args.samples))
+    if not samples:
+        sys.exit("no samples")
+    addrs = {pc for _, pc, _ in samples} | {caller for _, _, caller in samples}
+    names = symbolize(args.addr2line, args.elf, addrs)
+
+    stacks = collections.Counter()
+    for core, pc, caller in samples:
+        frames = ["core%d" % core]
+        if not args.no_caller:
+            frames.append(names[caller])
+        frames.append(names[pc])
+        stacks[";".join(frames)] += 1
+    for stack, count in stacks.most_common():
+        print(stack, count)
+
+
+if __name__ == "__main__":
+    main()
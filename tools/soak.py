@@ -0,0 +1,196 @@
+#!/usr/bin/env python3
+"""
+ObscuraCam v1.0.0
+
+soak.py
+
+Soak test a running ObscuraCam: drive its handlers with a randomized mix of
+snaps, photo views, directory listings, uploads and deletes for hours or days,
+while polling /health for heap and latency trends. At the end, run the on-device
+file system check and report any regressions. The exit status is 1 if any were
+found.
+
+    tools/soak.py --hours 24 --base http://obscuracam.local
+
+test/soak/soak.cpp runs the same mix against the firmware built for the host,
+for simulated days in minutes.
+
+Copyright 2024 by D.L. Ehnebuske
+License: GNU Lesser General Public License v2.1
+"""
+import argparse
+import json
+import os
+import random
+import statistics
+import sys
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+
+# The request mix: operation name and relative weight
+MIX = [("snap", 2), ("view", 6), ("list", 3), ("upload", 2), ("delete", 2)]
+SOAK_DIR = "/soak"
+
+
+class Device:
+    def __init__(self, base, timeout):
+        self.base = base.rstrip("/")
+        self.timeout = timeout
+
+    def request(self, method, path, body=None, headers=None):
+        """Make a request; return (status, body bytes, seconds taken)."""
+        req = urllib.request.Request(self.base + path, data=body, method=method,
+                                     headers=headers or {})
+        start = time.monotonic()
+        try:
+            with urllib.request.urlopen(req, timeout=self.timeout) as resp:
+                data = resp.read()
+                status = resp.status
+        except urllib.error.HTTPError as e:
+            data, status = e.read(), e.code
+        except (urllib.error.URLError, OSError) as e:
+            data, status = str(e).encode(), 0
+        return status, data, time.monotonic() - start
+
+    def json(self, path):
+        status, data, _ = self.request("GET", path)
+        return json.loads(data) if status == 200 else None
+
+
+class Soak:
+    def __init__(self, device):
+        self.dev = device
+        self.photos = []
+        self.uploads = []
+        self.latency = {name: [] for name, _ in MIX}
+        self.failures = {name: 0 for name, _ in MIX}
+        self.health = []
+
+    def snap(self):
+        status, _, t = self.dev.request("GET", "/snap")
+        ok = status in (200, 302)
+        if ok:
+            listing = self.dev.json("/list?dir=/photos")
+            if listing:
+                self.photos = [e["name"] for e in listing if e["type"] == "file"]
+        return ok, t
+
+    def view(self):
+        if not self.photos:
+            return self.snap()
+        status, _, t = self.dev.request("GET", urllib.parse.quote(random.choice(self.photos)))
+        return status == 200, t
+
+    def list(self):
+        status, _, t = self.dev.request("GET", "/list?dir=/photos")
+        return status == 200, t
+
+    def upload(self):
+        path = "%s/s%06d.bin" % (SOAK_DIR, random.randrange(1000000))
+        content = os.urandom(random.choice([512, 4096, 65536, 262144]))
+        boundary = "soak%016x" % random.getrandbits(64)
+        body = (("--%s\r\nContent-Disposition: form-data; name=\"data\"; filename=\"%s\"\r\n"
+                 "Content-Type: application/octet-stream\r\n\r\n") % (boundary, path)).encode()
+        body += content + ("\r\n--%s--\r\n" % boundary).encode()
+        status, _, t = self.dev.request(
+            "POST", "/edit", body, {"Content-Type": "multipart/form-data; boundary=" + boundary})
+        if status == 200:
+            self.uploads.append(path)
+        return status == 200, t
+
+    def delete(self):
+        if not self.uploads:
+            return self.upload()
+        path = self.uploads.pop(random.randrange(len(self.uploads)))
+        status, _, t = self.dev.request("DELETE", "/edit", urllib.parse.urlencode({"path": path}).encode(),
+                                        {"Content-Type": "application/x-www-form-urlencoded"})
+        return status == 200, t
+
+    def run(self, seconds, health_every, pause):
+        self.dev.request("PUT", "/edit", urllib.parse.urlencode({"path": SOAK_DIR}).encode(),
+                         {"Content-Type": "application/x-www-form-urlencoded"})
+        names = [name for name, _ in MIX]
+        weights = [weight for _, weight in MIX]
+        end = time.monotonic() + seconds
+        next_health = 0
+        while time.monotonic() < end:
+            if time.monotonic() >= next_health:
+                h = self.dev.json("/health")
+                if h:
+                    self.health.append((time.monotonic(), h))
+                    print("%6.2f h  heap %d  largest %d  flags %s" %
+                          ((seconds - (end - time.monotonic())) / 3600, h["freeHeap"],
+                           h["largestBlock"], h["flags"]), flush=True)
+                next_health = time.monotonic() + health_every
+            op = random.choices(names, weights)[0]
+            ok, t = getattr(self, op)()
+            self.latency[op].append(t)
+            if not ok:
+                self.failures[op] += 1
+            time.sleep(pause)
+        while self.uploads:
+            self.delete()
+
+    def fs_check(self):
+        status, _, _ = self.dev.request("GET", "/health?fscheck")
+        if status != 200:
+            return None
+        while True:
+            job = self.dev.json("/job")
+            if job and job.get("name") == "fsCheck" and not job["running"]:
+                return job["job"]
+            time.sleep(1)
+
+    def report(self, drift_factor):
+        problems = []
+        for name, _ in MIX:
+            samples = self.latency[name]
+            if len(samples) < 8:
+                continue
+            quarter = len(samples) // 4
+            early = statistics.median(samples[:quarter])
+            late = statistics.median(samples[-quarter:])
+            print("%-7s n=%-6d fail=%-4d median %.0f ms -> %.0f ms" %
+                  (name, len(samples), self.failures[name], early * 1000, late * 1000))
+            if late > early * drift_factor:
+                problems.append("%s latency drifted from %.0f to %.0f ms" %
+                                (name, early * 1000, late * 1000))
+            if self.failures[name]:
+                problems.append("%d %s requests failed" % (self.failures[name], name))
+        if self.health:
+            for flag, raised in self.health[-1][1]["flags"].items():
+                if raised:
+                    problems.append("device flags %s" % flag)
+        fs = self.fs_check()
+        if fs is None:
+            problems.append("file system check could not be run")
+        elif not fs["ok"]:
+            problems.append("file system check: %s" % json.dumps(fs))
+        return problems
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[2])
+    parser.add_argument("--base", default="http://obscuracam.local", help="the ObscuraCam's URL")
+    parser.add_argument("--hours", type=float, default=24, help="how long to run")
+    parser.add_argument("--health-every", type=float, default=300, help="seconds between /health polls")
+    parser.add_argument("--pause", type=float, default=0.5, help="seconds between requests")
+    parser.add_argument("--drift", type=float, default=2.0,
+                        help="latency growth, early to late median, that counts as drift")
+    parser.add_argument("--timeout", type=float, default=30, help="request timeout (s)")
+    parser.add_argument("--seed", type=int, help="random seed, for repeatable mixes")
+    args = parser.parse_args()
+
+    random.seed(args.seed)
+    soak = Soak(Device(args.base, args.timeout))
+    soak.run(args.hours * 3600, args.health_every, args.pause)
+    problems = soak.report(args.drift)
+    for p in problems:
+        print("REGRESSION:", p)
+    sys.exit(1 if problems else 0)
+
+
+if __name__ == "__main__":
+    main()
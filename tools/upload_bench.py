@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""
+ObscuraCam v1.0.0
+
+upload_bench.py
+
+Benchmark uploads to a running ObscuraCam: upload a number of generated files,
+one after another, as multipart POSTs to /edit, raw-body PUTs to /files/<path>
+or both, and report each upload's throughput and the overall throughput seen
+by the client, along with the device's own figures from /uploads. The files
+are deleted afterwards.
+
+The ObscuraCam's web server handles one request at a time, so uploads sent at
+once don't run concurrently: the later ones wait their turn in the TCP
+backlog. Uploading in parallel would only measure that queueing, so the
+uploads are sent one at a time.
+
+    tools/upload_bench.py --files 8 --kb 512 --method both
+
+Copyright 2024 by D.L. Ehnebuske
+License: GNU Lesser General Public License v2.1
+"""
+import argparse
+import json
+import os
+import statistics
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+
+BENCH_DIR = "/ulbench"
+
+
+def request(base, method, path, body=None, headers=None, timeout=120):
+    req = urllib.request.Request(base + path, data=body, method=method, headers=headers or {})
+    try:
+        with urllib.request.urlopen(req, timeout=timeout) as resp:
+            return resp.status, resp.read()
+    except urllib.error.HTTPError as e:
+        return e.code, e.read()
+
+
+def form(fields):
+    return (urllib.parse.urlencode(fields).encode(),
+            {"Content-Type": "application/x-www-form-urlencoded"})
+
+
+def upload_multipart(base, path, content):
+    boundary = "bench%s" % os.urandom(8).hex()
+    body = (("--%s\r\nContent-Disposition: form-data; name=\"data\"; filename=\"%s\"\r\n"
+             "Content-Type: application/octet-stream\r\n\r\n") % (boundary, path)).encode()
+    body += content + ("\r\n--%s--\r\n" % boundary).encode()
+    return request(base, "POST", "/edit", body,
+                   {"Content-Type": "multipart/form-data; boundary=" + boundary})[0]
+
+
+def upload_raw(base, path, content):
+    return request(base, "PUT", "/files" + urllib.parse.quote(path), content,
+                   {"Content-Type": "application/octet-stream"})[0]
+
+
+UPLOADERS = {"multipart": (upload_multipart, 200), "put": (upload_raw, 201)}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[2])
+    parser.add_argument("--base", default="http://obscuracam.local", help="the ObscuraCam's URL")
+    parser.add_argument("--files", type=int, default=8, help="number of files to upload")
+    parser.add_argument("--kb", type=int, default=256, help="size of each file (KB)")
+    parser.add_argument("--method", choices=["multipart", "put", "both"], default="both",
+                        help="upload protocol to benchmark")
+    args = parser.parse_args()
+    base = args.base.rstrip("/")
+
+    request(base, "PUT", "/edit", *form({"path": BENCH_DIR}))
+    content = os.urandom(args.kb * 1024)
+    paths = ["%s/f%03d.bin" % (BENCH_DIR, i) for i in range(args.files)]
+
+    methods = ["multipart", "put"] if args.method == "both" else [args.method]
+    for method in methods:
+        upload, expected = UPLOADERS[method]
+        rates = []
+        start = time.monotonic()
+        for path in paths:
+            t0 = time.monotonic()
+            if upload(base, path, content) == expected:
+                rates.append(len(content) / (time.monotonic() - t0) / 1e6)
+        elapsed = time.monotonic() - start
+
+        total = len(rates) * len(content)
+        print("%s: %d/%d uploads ok, %d bytes in %.2f s: %.3f MB/s overall (client)" %
+              (method, len(rates), len(paths), total, elapsed, total / elapsed / 1e6))
+        if rates:
+            print("%s: per upload %.3f min, %.3f median, %.3f max MB/s" %
+                  (method, min(rates), statistics.median(rates), max(rates)))
+    status, data = request(base, "GET", "/uploads")
+    if status == 200:
+        print("device:", json.dumps(json.loads(data)))
+
+    request(base, "DELETE", "/edit", *form({"path": BENCH_DIR}))
+
+
+if __name__ == "__main__":
+    main()
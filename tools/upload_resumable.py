@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""
+ObscuraCam v1.0.0
+
+upload_resumable.py
+
+Upload a file to a running ObscuraCam so that a dropped connection doesn't mean
+starting over. The file is sent as a series of PATCH /files/<path> requests,
+each carrying the next chunk with its Upload-Offset and the Upload-Length of the
+whole file. After a failure, HEAD /files/<path> tells how much the ObscuraCam
+has, and the upload carries on from there.
+
+    tools/upload_resumable.py SdRoot/edit/ace.js /edit/ace.js
+
+Copyright 2024 by D.L. Ehnebuske
+License: GNU Lesser General Public License v2.1
+"""
+import argparse
+import os
+import sys
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+
+
+def request(url, method, body=None, headers=None, timeout=60):
+    """Make a request; return (status, headers), with status 0 for a network failure."""
+    req = urllib.request.Request(url, data=body, method=method, headers=headers or {})
+    try:
+        with urllib.request.urlopen(req, timeout=timeout) as resp:
+            resp.read()
+            return resp.status, resp.headers
+    except urllib.error.HTTPError as e:
+        return e.code, e.headers
+    except (urllib.error.URLError, OSError):
+        return 0, {}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[2])
+    parser.add_argument("file", help="the local file to upload")
+    parser.add_argument("path", help="where to put it on the SD card, e.g. /edit/ace.js")
+    parser.add_argument("--base", default="http://obscuracam.local", help="the ObscuraCam's URL")
+    parser.add_argument("--chunk", type=int, default=64, help="bytes per PATCH (KB)")
+    parser.add_argument("--retries", type=int, default=10, help="failures to tolerate in a row")
+    args = parser.parse_args()
+
+    url = args.base.rstrip("/") + "/files" + urllib.parse.quote(args.path)
+    length = os.path.getsize(args.file)
+    status, headers = request(url, "HEAD")
+    offset = int(headers.get("Upload-Offset", 0)) if status == 200 else 0
+    if offset:
+        print("resuming at %d of %d bytes" % (offset, length))
+
+    failures = 0
+    with open(args.file, "rb") as f:
+        while True:
+            f.seek(offset)
+            chunk = f.read(args.chunk * 1024)
+            status, headers = request(url, "PATCH", chunk, {
+                "Content-Type": "application/octet-stream",
+                "Upload-Offset": str(offset),
+                "Upload-Length": str(length)})
+            if status == 201:
+                print("uploaded %d bytes" % length)
+                return
+            if status in (204, 409) and "Upload-Offset" in headers:
+                offset = int(headers["Upload-Offset"])
+                failures = 0 if status == 204 else failures + 1
+            else:
+                failures += 1
+                time.sleep(min(2 ** failures, 30))
+                status, headers = request(url, "HEAD")
+                offset = int(headers.get("Upload-Offset", 0)) if status == 200 else 0
+            if failures > args.retries:
+                sys.exit("giving up at %d of %d bytes (last status %d)" % (offset, length, status))
+            print("%d of %d bytes" % (offset, length), end="\r", flush=True)
+
+
+if __name__ == "__main__":
+    main()